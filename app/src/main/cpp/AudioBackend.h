@@ -0,0 +1,155 @@
+#ifndef AUDIO_BACKEND_H
+#define AUDIO_BACKEND_H
+
+#include "WavFileUtils.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <oboe/Oboe.h>
+#include <string>
+#include <vector>
+
+// Input side of full-duplex mode. The output callback pulls exactly the
+// frames it's about to render, so the mic, the sequencer and the output all
+// share one block instead of meeting through the input ring.
+class DuplexInput {
+public:
+  virtual ~DuplexInput() = default;
+
+  // Fills n mono frames. Frames the source couldn't deliver are zeroed.
+  virtual void read(float *mono, int n) = 0;
+  // Sees every rendered block, for sources that feed the output back
+  virtual void onOutput(const float *interleaved, int n, int channels) {}
+
+  uint32_t shortReads() const {
+    return mShortReads.load(std::memory_order_relaxed);
+  }
+
+protected:
+  std::atomic<uint32_t> mShortReads{0};
+};
+
+// Oboe input stream opened without a callback and read non-blocking from
+// the output callback, the same scheme as oboe's FullDuplexStream. The first
+// callbacks drain whatever piled up while the streams were starting, after
+// that input sits one burst behind at most.
+class OboeDuplexInput : public DuplexInput {
+public:
+  explicit OboeDuplexInput(std::shared_ptr<oboe::AudioStream> stream)
+      : mStream(std::move(stream)),
+        mChannels(std::max(1, (int)mStream->getChannelCount())),
+        mScratch(kChunk * mChannels) {}
+
+  void read(float *mono, int n) override {
+    if (mDrainCallbacks > 0) {
+      --mDrainCallbacks;
+      while (readChunk(kChunk) == kChunk) {
+      }
+    }
+    int done = 0;
+    while (done < n) {
+      int want = std::min(kChunk, n - done);
+      int got = readChunk(want);
+      downmix(mono + done, got);
+      done += got;
+      if (got < want)
+        break;
+    }
+    if (done < n) {
+      std::fill(mono + done, mono + n, 0.0f);
+      mShortReads.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+private:
+  static const int kChunk = 256;
+
+  int readChunk(int frames) {
+    auto result = mStream->read(mScratch.data(), frames, 0);
+    return result ? std::max(0, (int)result.value()) : 0;
+  }
+
+  void downmix(float *mono, int frames) const {
+    if (mChannels == 1) {
+      std::copy(mScratch.begin(), mScratch.begin() + frames, mono);
+      return;
+    }
+    for (int i = 0; i < frames; ++i)
+      mono[i] = (mScratch[i * mChannels] + mScratch[i * mChannels + 1]) * 0.5f;
+  }
+
+  std::shared_ptr<oboe::AudioStream> mStream;
+  int mChannels;
+  std::vector<float> mScratch;
+  int mDrainCallbacks = 10;
+};
+
+// Desktop stand-ins, so the duplex path runs on Linux without a device.
+
+// Every output block comes back as the next block's input: one block of
+// round trip, like a cable from the headphone out to the mic in.
+class LoopbackInput : public DuplexInput {
+public:
+  void read(float *mono, int n) override {
+    int count = std::min(n, (int)mLast.size());
+    std::copy(mLast.begin(), mLast.begin() + count, mono);
+    std::fill(mono + count, mono + n, 0.0f);
+    if (count < n && !mLast.empty())
+      mShortReads.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void onOutput(const float *interleaved, int n, int channels) override {
+    mLast.resize(n);
+    for (int i = 0; i < n; ++i)
+      mLast[i] = channels == 2
+                     ? (interleaved[i * 2] + interleaved[i * 2 + 1]) * 0.5f
+                     : interleaved[i * channels];
+  }
+
+private:
+  std::vector<float> mLast;
+};
+
+// Plays a WAV file (mixed to mono, no rate conversion) as the mic, looping
+// or followed by silence
+class FileInput : public DuplexInput {
+public:
+  bool load(const std::string &path, bool loop = true) {
+    std::vector<float> data, slices;
+    int sampleRate = 0, channels = 0;
+    if (!WavFileUtils::loadWav(path, data, sampleRate, channels, slices) ||
+        channels < 1)
+      return false;
+    mData.resize(data.size() / channels);
+    for (size_t i = 0; i < mData.size(); ++i) {
+      float sum = 0.0f;
+      for (int c = 0; c < channels; ++c)
+        sum += data[i * channels + c];
+      mData[i] = sum / channels;
+    }
+    mPos = 0;
+    mLoop = loop;
+    return true;
+  }
+
+  void read(float *mono, int n) override {
+    for (int i = 0; i < n; ++i) {
+      if (mPos >= mData.size()) {
+        if (!mLoop || mData.empty()) {
+          std::fill(mono + i, mono + n, 0.0f);
+          return;
+        }
+        mPos = 0;
+      }
+      mono[i] = mData[mPos++];
+    }
+  }
+
+private:
+  std::vector<float> mData;
+  size_t mPos = 0;
+  bool mLoop = true;
+};
+
+#endif // AUDIO_BACKEND_H
@@ -1,5 +1,6 @@
 #define TSF_IMPLEMENTATION
 #include "AudioEngine.h"
+#include "Resampler.h"
 #include "WavFileUtils.h" // New
 #include "engines/BitcrusherFx.h"
 #include <fstream> // Should be in Utils but ensuring
@@ -29,6 +30,15 @@ struct FastRandom {
 
 // (Using fast_tanh from Utils.h)
 
+// Sends are 2000 + slot * 10, the slot's mix one above. Slots 10-16 would
+// land in 2100-2169, the filter pedal range, so only the slots on either
+// side count.
+static bool isFxSendId(int parameterId) {
+  const int sendEnd = 2000 + FxPlan::kSlots * 10;
+  return (parameterId >= 2000 && parameterId < 2100) ||
+         (parameterId >= 2170 && parameterId < sendEnd);
+}
+
 static inline float softLimit(float x) {
   if (std::isnan(x))
     return 0.0f;
@@ -49,7 +59,7 @@ AudioEngine::AudioEngine() {
   mSampleRate = 48000.0; // Default to common Android rate
   mBpm = 120.0f;
   setupTracks();
-  for (int i = 0; i < 17; ++i)
+  for (int i = 0; i < FxPlan::kSlots; ++i)
     mFxChainDest[i] = -1;
 
   // FX Slot Filters (Slots 9/10)
@@ -69,32 +79,24 @@ AudioEngine::AudioEngine() {
   mSidechainSourceTrack = -1;
   mSidechainSourceDrumIdx = -1;
 
-  for (int i = 0; i < 17; ++i) {
+  for (int i = 0; i < FxPlan::kSlots; ++i) {
     mFxMixLevels[i] = 1.0f;
     mFxChainDest[i] = -1;
-    mFxFeedbacksL[i] = 0.0f;
-    mFxFeedbacksR[i] = 0.0f;
   }
+  mFxPlan.compile(mFxChainDest);
 
   // Initialize Filter Pedals
   for (int i = 0; i < 3; ++i) {
-    mFilterPedalL[i].clear();
-    mFilterPedalR[i].clear();
-    mFilterPedalL[i].setMix(1.0f);
-    mFilterPedalR[i].setMix(1.0f);
+    mFilterPedal[i].clear();
+    mFilterPedal[i].setMix(1.0f);
   }
 
   // Initialize other FX Mixes to 1.0 (Since we use per-track sends/mixes now)
-  mChorusFxL.setMix(1.0f);
-  mChorusFxR.setMix(1.0f);
-  mPhaserFxL.setMix(1.0f);
-  mPhaserFxR.setMix(1.0f);
-  mFlangerFxL.setMix(1.0f);
-  mFlangerFxR.setMix(1.0f);
-  mOctaverFxL.setMix(1.0f);
-  mOctaverFxR.setMix(1.0f);
-  mTapeEchoFxL.setMix(1.0f);
-  mTapeEchoFxR.setMix(1.0f);
+  mChorusFx.setMix(1.0f);
+  mPhaserFx.setMix(1.0f);
+  mFlangerFx.setMix(1.0f);
+  mOctaverFx.setMix(1.0f);
+  mTapeEchoFx.setMix(1.0f);
 
   // Reverb and Delay can stay wet-only by default too
   mDelayFx.setMix(1.0f);
@@ -123,23 +125,12 @@ void AudioEngine::initTrack(int i) {
             std::end(mTracks[i].smoothedFxSends), 0.0f);
   std::fill(std::begin(mTracks[i].fxMix), std::end(mTracks[i].fxMix), 0.0f);
 
-  // Initialize defaults
-  mTracks[i].subtractiveEngine.setSustain(1.0f);
-  mTracks[i].subtractiveEngine.setDecay(0.5f);
-
-  mTracks[i].fmEngine.resetToDefaults();
-  mTracks[i].fmEngine.setParameter(101, 0.5f); // Decay
-  mTracks[i].fmEngine.setParameter(102, 1.0f); // Sustain
-
-  // Analog Drum Defaults
-  mTracks[i].analogDrumEngine.resetToDefaults();
-
-  // FM Drum Defaults
-  for (int k = 0; k < 4; k++) {
-    mTracks[i].fmDrumEngine.setParameter(k, 0, 0.5f); // Pitch
-    mTracks[i].fmDrumEngine.setParameter(k, 1, 0.5f); // Tone
-    mTracks[i].fmDrumEngine.setParameter(k, 2, 0.4f); // Decay
-  }
+  // Initialize defaults. Only the active engine is instantiated, others get
+  // the same defaults when a later setEngineType creates them.
+  mTracks[i].parametersSet.reset();
+  ensureEngine(i, mTracks[i].engineType);
+  for (int type = 0; type <= 9; ++type)
+    applyEngineDefaults(mTracks[i], type);
 
   // Sync parameters array with audible defaults so UI doesn't zero them out
   mTracks[i].parameters[0] = 0.7f;     // Volume
@@ -203,7 +194,8 @@ void AudioEngine::initTrack(int i) {
     setParameter(i, 9, 0.5f);   // PAN CENTER
   } else if (type == 1) {       // FM
     // Use the "Vibe" preset (ID 11) directly to guarantee good sound
-    mTracks[i].fmEngine.loadPreset(11);
+    mTracks[i].fmEngine->loadPreset(11);
+    mTracks[i].fmPreset = 11;
 
     // Ensure envelope is enabled
     setParameter(i, 350, 1.0f);
@@ -222,7 +214,7 @@ void AudioEngine::initTrack(int i) {
       setParameter(i, baseId + 1, 0.5f); // Tone/Feedback
     }
   } else if (type == 4) { // Wavetable
-    mTracks[i].wavetableEngine.resetToDefaults();
+    mTracks[i].wavetableEngine->resetToDefaults();
     setParameter(i, 458, 1.0f); // Cutoff
     // ADSR A=2, D=10, S=30, R=50 (approx scaled 0.0-1.0 or raw?)
     // Assuming 0-1 scale: 0.02, 0.1, 0.3, 0.5
@@ -234,7 +226,7 @@ void AudioEngine::initTrack(int i) {
     setParameter(i, 475, 0.0f); // Bits (0=Full)
     setParameter(i, 476, 0.0f); // Srate (0=Full)
   } else if (type == 3) {       // Granular
-    mTracks[i].granularEngine.resetToDefaults();
+    mTracks[i].granularEngine->resetToDefaults();
 
     // Explicitly reset ALL parameters to match Engine defaults
     // This ensures that when "Restore Patch" is clicked, everything resets
@@ -348,49 +340,40 @@ bool AudioEngine::start() {
   mSampleRate = mStream->getSampleRate();
 
   for (auto &t : mTracks) {
-    t.subtractiveEngine.setSampleRate(mSampleRate);
-    t.fmEngine.setSampleRate(mSampleRate);
-    t.samplerEngine.setSampleRate(mSampleRate);
-    t.granularEngine.setSampleRate(mSampleRate);
-    t.wavetableEngine.setSampleRate(mSampleRate);
-    t.fmDrumEngine.setSampleRate(mSampleRate);
-    t.analogDrumEngine.setSampleRate(mSampleRate);
-    t.soundFontEngine.setSampleRate(mSampleRate);
-    t.audioInEngine.setSampleRate(mSampleRate);
+    if (t.subtractiveEngine)
+      t.subtractiveEngine->setSampleRate(mSampleRate);
+    if (t.fmEngine)
+      t.fmEngine->setSampleRate(mSampleRate);
+    if (t.samplerEngine)
+      t.samplerEngine->setSampleRate(mSampleRate);
+    if (t.granularEngine)
+      t.granularEngine->setSampleRate(mSampleRate);
+    if (t.wavetableEngine)
+      t.wavetableEngine->setSampleRate(mSampleRate);
+    if (t.fmDrumEngine)
+      t.fmDrumEngine->setSampleRate(mSampleRate);
+    if (t.analogDrumEngine)
+      t.analogDrumEngine->setSampleRate(mSampleRate);
+    if (t.soundFontEngine)
+      t.soundFontEngine->setSampleRate(mSampleRate);
+    if (t.audioInEngine)
+      t.audioInEngine->setSampleRate(mSampleRate);
   }
 
   // Initialize Filter Pedals
   for (int i = 0; i < 3; ++i) {
-    mFilterPedalL[i].clear();
-    mFilterPedalR[i].clear();
+    mFilterPedal[i].clear();
   }
 
   // Input stream for recording
-  oboe::AudioStreamBuilder inBuilder;
-  inBuilder.setDirection(oboe::Direction::Input)
-      ->setFormat(oboe::AudioFormat::Float)
-      ->setChannelCount(oboe::ChannelCount::Stereo) // Request Stereo
-      ->setPerformanceMode(oboe::PerformanceMode::LowLatency)
-      ->setSharingMode(oboe::SharingMode::Exclusive)
-      ->setInputPreset(oboe::InputPreset::Camcorder)
-      ->setSampleRate(mStream->getSampleRate())
-      ->setCallback(this);
-
-  result = inBuilder.openStream(mInputStream);
-  if (result != oboe::Result::OK) {
-    LOGD("CRITICAL: Error opening input stream: %s",
-         oboe::convertToText(result));
-  } else {
-    result = mInputStream->requestStart();
-    if (result != oboe::Result::OK) {
-      LOGD("CRITICAL: Error starting input stream: %s",
-           oboe::convertToText(result));
-    } else {
-      LOGD("SUCCESS: Input stream started at %d Hz",
-           mInputStream->getSampleRate());
-    }
+  {
+    std::lock_guard<std::mutex> streams(mInputStreamMutex);
+    openInputStream(oboe::ChannelCount::Stereo, mDuplexMode);
   }
 
+  // The rate may have changed
+  reserveDelayMemory();
+
   return mStream->requestStart() == oboe::Result::OK;
 }
 
@@ -400,6 +383,19 @@ void AudioEngine::stop() {
     mStream->close();
     mStream.reset();
   }
+  std::lock_guard<std::mutex> streams(mInputStreamMutex);
+  closeInputStream();
+}
+
+// The output callback stops reading before the stream goes, the stream is
+// stopped and closed without mLock
+void AudioEngine::closeInputStream() {
+  std::unique_ptr<DuplexInput> input;
+  {
+    std::lock_guard<std::recursive_mutex> lock(mLock);
+    input = std::move(mDuplexInput);
+  }
+  input.reset();
   if (mInputStream) {
     mInputStream->stop();
     mInputStream->close();
@@ -407,6 +403,79 @@ void AudioEngine::stop() {
   }
 }
 
+// Normally the input stream has its own callback that fills the input ring.
+// In duplex mode it has none: the output callback reads it non-blocking for
+// each block it renders, see OboeDuplexInput. The stream is opened without
+// mLock, only installing the duplex reader holds up the audio thread.
+void AudioEngine::openInputStream(int channelCount, bool duplex) {
+  oboe::AudioStreamBuilder inBuilder;
+  inBuilder.setDirection(oboe::Direction::Input)
+      ->setFormat(oboe::AudioFormat::Float)
+      ->setChannelCount(channelCount)
+      ->setPerformanceMode(oboe::PerformanceMode::LowLatency)
+      ->setSharingMode(oboe::SharingMode::Exclusive)
+      ->setInputPreset(oboe::InputPreset::Camcorder)
+      ->setCallback(duplex ? nullptr : this);
+
+  if (mStream) {
+    inBuilder.setSampleRate(mStream->getSampleRate());
+  } else if (mSampleRate > 0) {
+    inBuilder.setSampleRate(mSampleRate);
+  }
+
+  if (mInputDeviceId > 0) {
+    inBuilder.setDeviceId(mInputDeviceId);
+  }
+
+  std::unique_ptr<DuplexInput> input;
+  oboe::Result result = inBuilder.openStream(mInputStream);
+  if (result != oboe::Result::OK) {
+    LOGD("CRITICAL: Error opening input stream with device %d: %s",
+         mInputDeviceId, oboe::convertToText(result));
+  } else if ((result = mInputStream->requestStart()) != oboe::Result::OK) {
+    LOGD("CRITICAL: Error starting input stream: %s",
+         oboe::convertToText(result));
+  } else {
+    LOGD("SUCCESS: Input stream started on device %d at %d Hz%s",
+         mInputDeviceId, mInputStream->getSampleRate(),
+         duplex ? " (duplex)" : "");
+    if (duplex)
+      input = std::make_unique<OboeDuplexInput>(mInputStream);
+  }
+
+  std::lock_guard<std::recursive_mutex> lock(mLock);
+  mDuplexInput = std::move(input);
+  mDuplexMode = duplex;
+}
+
+// One callback reads the mic and renders the output for the same block, so
+// monitoring and recording are a buffer behind instead of riding the ring
+void AudioEngine::setDuplexMode(bool enabled) {
+  std::lock_guard<std::mutex> streams(mInputStreamMutex);
+  if (enabled == mDuplexMode)
+    return;
+  int channels = mInputStream ? mInputStream->getChannelCount()
+                              : oboe::ChannelCount::Stereo;
+  closeInputStream();
+  if (!mStream) {
+    std::lock_guard<std::recursive_mutex> lock(mLock);
+    mDuplexMode = enabled;
+    return;
+  }
+  openInputStream(channels, enabled);
+  // The mic no longer waits in a ring, so the output buffer is the round
+  // trip. Double buffering instead of the usual four bursts.
+  mStream->setBufferSizeInFrames(mStream->getFramesPerBurst() *
+                                 (enabled ? 2 : 4));
+}
+
+// Desktop runs and tests: replaces the device input for duplex rendering
+// through renderOutput, e.g. with a LoopbackInput or FileInput
+void AudioEngine::setDuplexInput(std::unique_ptr<DuplexInput> input) {
+  std::lock_guard<std::recursive_mutex> lock(mLock);
+  mDuplexInput = std::move(input);
+}
+
 // Internal Note Logic
 void AudioEngine::triggerNoteLocked(int trackIndex, int note, int velocity,
                                     bool isSequencerTrigger, float gate,
@@ -482,12 +551,16 @@ void AudioEngine::triggerNoteLocked(int trackIndex, int note, int velocity,
     // 2. Setup Frequency & Track State
     float freq = (track.engineType == 5)
                      ? 440.0f
-                     : 440.0f * powf(2.0f, (note - 69) / 12.0f);
+                     : FastMath::noteToFreq((float)note);
     track.currentFrequency = freq;
-    track.subtractiveEngine.setFrequency(freq, mSampleRate);
-    track.fmEngine.setFrequency(freq, mSampleRate);
-    track.wavetableEngine.setFrequency(freq, mSampleRate);
-    track.analogDrumEngine.setSampleRate(mSampleRate);
+    if (track.subtractiveEngine)
+      track.subtractiveEngine->setFrequency(freq, mSampleRate);
+    if (track.fmEngine)
+      track.fmEngine->setFrequency(freq, mSampleRate);
+    if (track.wavetableEngine)
+      track.wavetableEngine->setFrequency(freq, mSampleRate);
+    if (track.analogDrumEngine)
+      track.analogDrumEngine->setSampleRate(mSampleRate);
 
     track.isActive = true;
     track.mSilenceFrames = 0;
@@ -516,33 +589,34 @@ void AudioEngine::triggerNoteLocked(int trackIndex, int note, int velocity,
     // 4. Trigger Actual Synthesis Engines
     switch (track.engineType) {
     case 0:
-      track.subtractiveEngine.triggerNote(note, velocity);
+      track.subtractiveEngine->triggerNote(note, velocity);
       break;
     case 1:
-      track.fmEngine.triggerNote(note, velocity);
+      track.fmEngine->triggerNote(note, velocity);
       break;
     case 2:
-      track.samplerEngine.triggerNote(note, velocity);
+      track.samplerEngine->triggerNote(note, velocity);
       break;
     case 3:
-      track.granularEngine.triggerNote(note, velocity);
+      track.granularEngine->triggerNote(note, velocity);
       break;
     case 4:
-      track.wavetableEngine.triggerNote(note, velocity);
+      track.wavetableEngine->triggerNote(note, velocity);
       break;
     case 5:
-      track.fmDrumEngine.triggerNote(note, velocity);
+      track.fmDrumEngine->triggerNote(note, velocity);
       break;
     case 6:
-      track.analogDrumEngine.triggerNote(note, velocity);
+      track.analogDrumEngine->triggerNote(note, velocity);
       break;
     case 8: // AUDIO IN
-      track.audioInEngine.triggerNote(note, velocity);
+      track.audioInEngine->triggerNote(note, velocity);
       break;
     case 9: // SOUNDFONT
-      track.soundFontEngine.noteOn(note, velocity);
+      track.soundFontEngine->noteOn(note, velocity);
       break;
     }
+    enforceVoiceLimit();
 
     // 5. Recording Logic
     // Record if it's a manual tap OR an Arp trigger (but NOT a sequencer
@@ -579,7 +653,7 @@ void AudioEngine::triggerNoteLocked(int trackIndex, int note, int velocity,
                                              (double)subStep});
           }
         } else if (track.engineType == 2 &&
-                   track.samplerEngine.getPlayMode() == 2) {
+                   track.samplerEngine->getPlayMode() == 2) {
           int drumIdx = -1;
           if (note >= 60)
             drumIdx = note - 60;
@@ -612,16 +686,21 @@ void AudioEngine::setParameter(int trackIndex, int parameterId, float value) {
     return;
   if (parameterId < 0 || parameterId >= 2500)
     return;
-  std::lock_guard<std::recursive_mutex> lock(mLock);
-  // Update state (Base Value)
-  mTracks[trackIndex].parameters[parameterId] = value;
-  // Also update Applied Value so it takes effect immediately (until next step
-  // reset)
-  mTracks[trackIndex].appliedParameters[parameterId] = value;
-  mTracks[trackIndex].mParametersDirty = true;
+  {
+    std::lock_guard<std::recursive_mutex> lock(mLock);
+    // Update state (Base Value)
+    mTracks[trackIndex].parameters[parameterId] = value;
+    mTracks[trackIndex].parametersSet.set(parameterId);
+    // Also update Applied Value so it takes effect immediately (until next
+    // step reset)
+    mTracks[trackIndex].appliedParameters[parameterId] = value;
+    mTracks[trackIndex].mParametersDirty = true;
 
-  // Push to engine
-  updateEngineParameter(trackIndex, parameterId, value);
+    // Push to engine
+    updateEngineParameter(trackIndex, parameterId, value);
+  }
+  if (isFxSendId(parameterId))
+    reserveDelayMemory();
 }
 
 void AudioEngine::setParameterPreview(int trackIndex, int parameterId,
@@ -630,10 +709,14 @@ void AudioEngine::setParameterPreview(int trackIndex, int parameterId,
     return;
   if (parameterId < 0 || parameterId >= 2500)
     return;
-  std::lock_guard<std::recursive_mutex> lock(mLock);
-  // Update only Applied Value (Temporary sound change)
-  mTracks[trackIndex].appliedParameters[parameterId] = value;
-  updateEngineParameter(trackIndex, parameterId, value);
+  {
+    std::lock_guard<std::recursive_mutex> lock(mLock);
+    // Update only Applied Value (Temporary sound change)
+    mTracks[trackIndex].appliedParameters[parameterId] = value;
+    updateEngineParameter(trackIndex, parameterId, value);
+  }
+  if (isFxSendId(parameterId))
+    reserveDelayMemory();
 }
 
 void AudioEngine::updateEngineParameter(int trackIndex, int parameterId,
@@ -668,17 +751,13 @@ void AudioEngine::updateEngineParameter(int trackIndex, int parameterId,
 
       if (filterIdx != -1) {
         if (subParam == 0) { // Cutoff
-          mFilterPedalL[filterIdx].setCutoff(value);
-          mFilterPedalR[filterIdx].setCutoff(value);
+          mFilterPedal[filterIdx].setCutoff(value);
         } else if (subParam == 1) { // Resonance
-          mFilterPedalL[filterIdx].setResonance(value);
-          mFilterPedalR[filterIdx].setResonance(value);
+          mFilterPedal[filterIdx].setResonance(value);
         } else if (subParam == 2) { // Mode
-          mFilterPedalL[filterIdx].setMode(value);
-          mFilterPedalR[filterIdx].setMode(value);
+          mFilterPedal[filterIdx].setMode(value);
         } else if (subParam == 3) { // Mix
-          mFilterPedalL[filterIdx].setMix(value);
-          mFilterPedalR[filterIdx].setMix(value);
+          mFilterPedal[filterIdx].setMix(value);
           mFxMixLevels[12 + (filterIdx == 0 ? 0 : (filterIdx == 1 ? 3 : 4))] =
               value; // Update global mix for render loop (slots 12, 15, 16)
         }
@@ -711,6 +790,10 @@ void AudioEngine::updateEngineParameter(int trackIndex, int parameterId,
           mReverbFx.setType(static_cast<int>(value * 3.9f));
         else if (subId == 6)
           mReverbFx.setTone(value);
+        else if (subId == 7) // Algorithm: tank, FDN
+          mReverbFx.setAlgorithm(value >= 0.5f
+                                     ? GalacticReverb::Algorithm::Fdn
+                                     : GalacticReverb::Algorithm::Tank);
       }
       // Add other global FX here if they need trackIndex -1 support
     }
@@ -724,16 +807,19 @@ void AudioEngine::updateEngineParameter(int trackIndex, int parameterId,
   Track &track = mTracks[trackIndex];
 
   // Specific Logic for Global / Sends
-  if (parameterId >= 2000 && parameterId < 2100) {
+  if (isFxSendId(parameterId)) {
     // If it's 2103 but targeted at a track, we treat it as global for now
     // or ignore if it should only be truly global.
     // Given the UI sends -1 for 2103, the top block handles it.
 
     int fxIndex = (parameterId - 2000) / 10;
     int subId = (parameterId - 2000) % 10;
-    if (fxIndex >= 0 && fxIndex < 17) {
+    if (fxIndex >= 0 && fxIndex < FxPlan::kSlots) {
       if (subId == 0) {
         track.fxSends[fxIndex] = value;
+        // Sticky, the lines are allocated by reserveDelayMemory
+        if (value > 0.0f)
+          mFxMemoryWanted |= 1u << fxIndex;
       } else if (subId == 1) {
         track.fxMix[fxIndex] = value;
       }
@@ -741,251 +827,15 @@ void AudioEngine::updateEngineParameter(int trackIndex, int parameterId,
     return;
   }
 
-  // Common Track Params (< 100)
-  if (parameterId < 100) {
-    switch (parameterId) {
-    case 0:
-      track.volume = std::max(0.001f, value);
-      break;
-    case 9:
-      track.pan = std::clamp(value, 0.0f, 1.0f);
-      {
-        float angle = track.pan * (float)M_PI * 0.5f;
-        track.panL = cosf(angle);
-        track.panR = sinf(angle);
-      }
-      break;
-    case 1: // Common Filter Cutoff
-      track.subtractiveEngine.setCutoff(value);
-      track.fmEngine.setFilter(value);
-      track.samplerEngine.setFilterCutoff(value);
-      track.wavetableEngine.setFilterCutoff(value);
-      track.granularEngine.setParameter(1, value);
-      track.soundFontEngine.setParameter(1, value);
-      break;
-    case 2: // Common Resonance
-      track.subtractiveEngine.setResonance(value);
-      track.fmEngine.setResonance(value);
-      track.samplerEngine.setFilterResonance(value);
-      track.wavetableEngine.setResonance(value);
-      track.granularEngine.setParameter(2, value);
-      track.soundFontEngine.setParameter(2, value);
-      break;
-    case 3: // Env Amount
-      track.subtractiveEngine.setFilterEnvAmount(value);
-      track.fmEngine.setParameter(3, value);
-      track.soundFontEngine.setParameter(3, value);
-      break;
-    case 4:
-      track.subtractiveEngine.setOscWaveform(1, value);
-      break;
-    case 5:
-      track.subtractiveEngine.setOscVolume(0, std::max(0.001f, value));
-      break;
-    case 6:
-      track.subtractiveEngine.setDetune(value);
-      track.soundFontEngine.setParameter(6, value);
-      break;
-    case 7:
-      track.subtractiveEngine.setLfoRate(value);
-      track.soundFontEngine.setParameter(7, value);
-      break;
-    case 8:
-      track.subtractiveEngine.setLfoDepth(value);
-      track.soundFontEngine.setParameter(8, value);
-      break;
-    }
-  }
-  // ADSR / Internal Params (100-149)
-  else if (parameterId >= 100 && parameterId < 150) {
-    switch (parameterId) {
-    case 123: // Audio In Filter Mode
-      track.audioInEngine.setParameter(123, value);
-      break;
-    case 100:
-      track.subtractiveEngine.setAttack(value);
-      track.samplerEngine.setAttack(value);
-      track.granularEngine.setAttack(value);
-      track.wavetableEngine.setAttack(value);
-      track.fmEngine.setParameter(100, value);
-      track.audioInEngine.setParameter(100, value);
-      track.soundFontEngine.setParameter(100, value);
-      break;
-    case 101:
-      track.subtractiveEngine.setDecay(value);
-      track.samplerEngine.setDecay(value);
-      track.granularEngine.setDecay(value);
-      track.wavetableEngine.setDecay(value);
-      track.fmEngine.setParameter(101, value);
-      track.audioInEngine.setParameter(101, value);
-      track.soundFontEngine.setParameter(101, value);
-      break;
-    case 102:
-      track.subtractiveEngine.setSustain(value);
-      track.samplerEngine.setParameter(parameterId, value);
-      track.granularEngine.setParameter(parameterId, value);
-      track.fmEngine.setParameter(parameterId, value);
-      track.wavetableEngine.setSustain(value);
-      track.audioInEngine.setParameter(parameterId, value);
-      track.soundFontEngine.setParameter(102, value);
-      break;
-    case 103:
-      track.subtractiveEngine.setRelease(value);
-      track.samplerEngine.setParameter(parameterId, value);
-      track.granularEngine.setParameter(parameterId, value);
-      track.fmEngine.setParameter(parameterId, value);
-      track.wavetableEngine.setRelease(value);
-      track.audioInEngine.setParameter(parameterId, value);
-      track.soundFontEngine.setParameter(103, value);
-      break;
-    case 104:
-      track.subtractiveEngine.setOscWaveform(0, value);
-      break;
-    case 105:
-      track.subtractiveEngine.setOscWaveform(1, value);
-      break;
-    case 106:
-      track.subtractiveEngine.setDetune(value);
-      break;
-    case 107:
-      track.subtractiveEngine.setOscVolume(0, value);
-      break;
-    case 108:
-      track.subtractiveEngine.setOscVolume(1, value);
-      break;
-    case 109:
-      track.subtractiveEngine.setOscVolume(2, value);
-      break;
-    case 110:
-      track.subtractiveEngine.setNoiseLevel(value);
-      break;
-    case 112:
-    case 113:
-    case 122: // Wavefold
-      track.subtractiveEngine.setParameter(parameterId, value);
-      track.samplerEngine.setParameter(parameterId, value);
-      track.audioInEngine.setParameter(parameterId, value);
-      track.soundFontEngine.setParameter(parameterId, value);
-      break;
-    case 118:
-      track.subtractiveEngine.setFilterEnvAmount(value);
-      track.samplerEngine.setFilterEnvAmount(value);
-      track.audioInEngine.setParameter(118, value);
-      break;
-    case 114:
-      track.subtractiveEngine.setFilterAttack(value);
-      track.samplerEngine.setParameter(parameterId, value);
-      break;
-    case 115:
-      track.subtractiveEngine.setFilterDecay(value);
-      track.samplerEngine.setParameter(parameterId, value);
-      break;
-    case 116:
-      track.subtractiveEngine.setFilterSustain(value);
-      track.samplerEngine.setParameter(parameterId, value);
-      break;
-    case 117:
-      track.subtractiveEngine.setFilterRelease(value);
-      track.samplerEngine.setParameter(parameterId, value);
-      break;
-    }
-  }
-  // Filter & Env (120-149)
-  else if (parameterId >= 120 && parameterId < 150) {
-    track.subtractiveEngine.setParameter(parameterId, value);
-    track.samplerEngine.setParameter(parameterId, value);
-    track.granularEngine.setParameter(parameterId, value);
-    track.wavetableEngine.setParameter(parameterId, value);
-    track.fmDrumEngine.setParameter(track.selectedFmDrumInstrument, parameterId,
-                                    value);
-    track.audioInEngine.setParameter(parameterId, value);
-  }
-  // FM / Sound Design (150-199)
-  else if (parameterId >= 150 && parameterId < 200) {
-    if (track.engineType == 0) { // Subtractive
-      track.subtractiveEngine.setParameter(parameterId, value);
-    } else if (track.engineType == 1) { // FM
-      if (parameterId == 156) {
-        track.fmEngine.setParameter(156, value); // Mode
-      } else {
-        track.fmEngine.setParameter(parameterId, value);
-      }
-    }
-  }
-  // FM Drum (200-299)
-  else if (parameterId >= 200 && parameterId < 300) {
-    track.fmDrumEngine.setParameter((parameterId - 200) / 10,
-                                    (parameterId - 200) % 10, value);
-  }
-  // Sampler & Engine Sub-params (300-399)
-  else if (parameterId >= 300 && parameterId < 400) {
-    if (parameterId == 350) {
-      track.subtractiveEngine.setUseEnvelope(value > 0.5f);
-      track.fmEngine.setUseEnvelope(value > 0.5f);
-      track.samplerEngine.setParameter(350, value);
-      track.granularEngine.setParameter(350, value);
-    } else if (parameterId == 355) {
-      // User requested Curve: val * val * 0.3 (Max 0.3s)
-      float glideVal = value * value * 0.3f;
-      track.subtractiveEngine.setParameter(355, glideVal);
-      track.fmEngine.setParameter(355, glideVal);
-      track.samplerEngine.setParameter(355, glideVal);
-      track.granularEngine.setParameter(355, glideVal);
-      track.wavetableEngine.setParameter(355, glideVal);
-      track.soundFontEngine.setParameter(355, glideVal);
-    } else if (track.engineType == 5) {
-      track.fmDrumEngine.setParameter(track.selectedFmDrumInstrument,
-                                      parameterId - 300, value);
-    } else {
-      track.samplerEngine.setParameter(parameterId, value);
-    }
-  }
-  // Granular (400-449)
-  else if (parameterId >= 400 && parameterId < 450) {
-    track.granularEngine.setParameter(parameterId, value);
-  }
-  // Wavetable (450-489)
-  else if (parameterId >= 450 && parameterId < 490) {
-    if (parameterId == 450)
-      track.wavetableEngine.setParameter(0, value);
-    else if (parameterId == 451)
-      track.wavetableEngine.setParameter(1, value);
-    else if (parameterId == 454)
-      track.wavetableEngine.setAttack(value);
-    else if (parameterId == 455)
-      track.wavetableEngine.setDecay(value);
-    else if (parameterId == 456)
-      track.wavetableEngine.setSustain(value);
-    else if (parameterId == 457)
-      track.wavetableEngine.setRelease(value);
-    else if (parameterId == 458)
-      track.wavetableEngine.setFilterCutoff(value);
-    else if (parameterId == 459)
-      track.wavetableEngine.setResonance(value);
-    else if (parameterId == 461)
-      track.wavetableEngine.setParameter(11, value);
-    else if (parameterId == 464)
-      track.wavetableEngine.setParameter(14, value);
-    else if (parameterId == 465)
-      track.wavetableEngine.setParameter(15, value);
-    else if (parameterId == 466)
-      track.wavetableEngine.setParameter(16, value);
-    else if (parameterId == 467)
-      track.wavetableEngine.setParameter(17, value);
-    else if (parameterId == 470) // Filter Mode (Added)
-      track.wavetableEngine.setParameter(20, value);
-    else if (parameterId == 471) // Filter Atk (Added)
-      track.wavetableEngine.setParameter(21, value);
-    else if (parameterId == 472) // Filter Dcy (Shared handle)
-      track.wavetableEngine.setParameter(11, value);
-    else if (parameterId == 473) // Filter Sus (Added)
-      track.wavetableEngine.setParameter(23, value);
-    else if (parameterId == 474) // Filter Rel (Added)
-      track.wavetableEngine.setParameter(24, value);
-    else if (parameterId == 475) // Bits (Moved from 530)
-      track.wavetableEngine.setParameter(30, value);
-    else if (parameterId == 476) // Srate (Moved from 531)
-      track.wavetableEngine.setParameter(31, value);
+  if (parameterId == 0) {
+    track.volume = std::max(0.001f, value);
+  } else if (parameterId == 9) {
+    track.pan = std::clamp(value, 0.0f, 1.0f);
+    float angle = track.pan * (float)M_PI * 0.5f;
+    track.panL = cosf(angle);
+    track.panR = sinf(angle);
+  } else if (parameterId < 490 || (parameterId >= 600 && parameterId < 700)) {
+    applyEngineParameter(track, parameterId, value);
   }
   // LP LFO (Pedal 10)
   else if (parameterId >= 490 && parameterId < 500) {
@@ -1028,21 +878,21 @@ void AudioEngine::updateEngineParameter(int trackIndex, int parameterId,
         mReverbFx.setType(static_cast<int>(value * 3.9f));
       else if (subId == 6)
         mReverbFx.setTone(value);
+      else if (subId == 7) // Algorithm: tank, FDN
+        mReverbFx.setAlgorithm(value >= 0.5f
+                                   ? GalacticReverb::Algorithm::Fdn
+                                   : GalacticReverb::Algorithm::Tank);
       break;
     case 1: // Chorus
       if (subId == 0) {
-        mChorusFxL.setRate(value);
-        mChorusFxR.setRate(value);
+        mChorusFx.setRate(value);
       } else if (subId == 1) {
-        mChorusFxL.setDepth(value);
-        mChorusFxR.setDepth(value);
+        mChorusFx.setDepth(value);
       } else if (subId == 2) {
-        mChorusFxL.setMix(value);
-        mChorusFxR.setMix(value);
+        mChorusFx.setMix(value);
         mFxMixLevels[2] = value;
       } else if (subId == 3) {
-        mChorusFxL.setVoices(value);
-        mChorusFxR.setVoices(value);
+        mChorusFx.setVoices(value);
       }
       break;
     case 2: // Delay
@@ -1064,28 +914,24 @@ void AudioEngine::updateEngineParameter(int trackIndex, int parameterId,
       break;
     case 3: // Bitcrusher
       if (subId == 0) {
-        mBitcrusherFxL.setBits(value);
-        mBitcrusherFxR.setBits(value);
+        mBitcrusherFx.setBits(value);
       } else if (subId == 1) {
-        mBitcrusherFxL.setRate(value);
-        mBitcrusherFxR.setRate(value);
+        mBitcrusherFx.setRate(value);
       } else if (subId == 2) {
-        mBitcrusherFxL.setMix(value);
-        mBitcrusherFxR.setMix(value);
+        mBitcrusherFx.setMix(value);
         mFxMixLevels[1] = value;
+      } else if (subId == 3) { // Oversampling 1x/2x/4x
+        mBitcrusherFx.setOversampling(1 << (int)(value * 2.99f));
       }
       break;
     case 4: // Overdrive
       if (subId == 0) {
-        mOverdriveFxL.setDrive(value);
-        mOverdriveFxR.setDrive(value);
+        mOverdriveFx.setDrive(value);
       } else if (subId == 1) {
         // Repurposed MIX knob as DISTORTION
-        mOverdriveFxL.setDistortion(value);
-        mOverdriveFxR.setDistortion(value);
+        mOverdriveFx.setDistortion(value);
         // Ensure Mix is 1.0 internally
-        mOverdriveFxL.setMix(1.0f);
-        mOverdriveFxR.setMix(1.0f);
+        mOverdriveFx.setMix(1.0f);
         // Send Level to mixer is handled by LEVEL knob?
         // Note: mFxMixLevels[0] was set by this knob (MIX).
         // Since we repurposed it, we'll set mix level to 1.0 fixed or
@@ -1093,26 +939,25 @@ void AudioEngine::updateEngineParameter(int trackIndex, int parameterId,
         // For now, let's just default it to 1.0 here to ensure sound passes.
         mFxMixLevels[0] = 1.0f;
       } else if (subId == 2) {
-        mOverdriveFxL.setLevel(value);
-        mOverdriveFxR.setLevel(value);
+        mOverdriveFx.setLevel(value);
       } else if (subId == 3) {
-        mOverdriveFxL.setTone(value);
-        mOverdriveFxR.setTone(value);
+        mOverdriveFx.setTone(value);
+      } else if (subId == 4) { // Anti-aliasing: off, ADAA, 2x, 4x
+        static const AntiAlias modes[] = {AntiAlias::Off, AntiAlias::Adaa1,
+                                          AntiAlias::Oversample2x,
+                                          AntiAlias::Oversample4x};
+        mOverdriveFx.setAntiAlias(modes[(int)(value * 3.99f)]);
       }
       break;
     case 5: // Phaser
       if (subId == 0) {
-        mPhaserFxL.setRate(value);
-        mPhaserFxR.setRate(value);
+        mPhaserFx.setRate(value);
       } else if (subId == 1) {
-        mPhaserFxL.setDepth(value);
-        mPhaserFxR.setDepth(value);
+        mPhaserFx.setDepth(value);
       } else if (subId == 2) {
-        mPhaserFxL.setMix(value);
-        mPhaserFxR.setMix(value);
+        mPhaserFx.setMix(value);
       } else if (subId == 3) {
-        mPhaserFxL.setIntensity(value);
-        mPhaserFxR.setIntensity(value);
+        mPhaserFx.setIntensity(value);
       }
       break;
     case 6: // Tape Wobble
@@ -1135,31 +980,24 @@ void AudioEngine::updateEngineParameter(int trackIndex, int parameterId,
         int idx = (int)(value * 8.99f);
         float r = rates[idx];
         if (subId == 0) {
-          mSlicerFxL.setRate1(r);
-          mSlicerFxR.setRate1(r);
+          mSlicerFx.setRate1(r);
         } else if (subId == 1) {
-          mSlicerFxL.setRate2(r);
-          mSlicerFxR.setRate2(r);
+          mSlicerFx.setRate2(r);
         } else if (subId == 2) {
-          mSlicerFxL.setRate3(r);
-          mSlicerFxR.setRate3(r);
+          mSlicerFx.setRate3(r);
         }
       } else if (subId == 3) {
         bool v = (value > 0.5f);
-        mSlicerFxL.setActive1(v);
-        mSlicerFxR.setActive1(v);
+        mSlicerFx.setActive1(v);
       } else if (subId == 4) {
         bool v = (value > 0.5f);
-        mSlicerFxL.setActive2(v);
-        mSlicerFxR.setActive2(v);
+        mSlicerFx.setActive2(v);
       } else if (subId == 5) {
         bool v = (value > 0.5f);
-        mSlicerFxL.setActive3(v);
-        mSlicerFxR.setActive3(v);
+        mSlicerFx.setActive3(v);
       } else if (subId == 6) {
         // DEPTH knob
-        mSlicerFxL.setDepth(value);
-        mSlicerFxR.setDepth(value);
+        mSlicerFx.setDepth(value);
         mFxMixLevels[7] = 1.0f; // Bus Mix should be full for Slicer
       }
       break;
@@ -1201,12 +1039,6 @@ void AudioEngine::updateEngineParameter(int trackIndex, int parameterId,
       break;
     }
   }
-  // Analog Drum (600-699)
-  else if (parameterId >= 600 && parameterId < 700) {
-    int drumIdx = (parameterId - 600) / 10;
-    int subId = (parameterId - 600) % 10;
-    track.analogDrumEngine.setParameter(drumIdx, subId, value);
-  }
   // Midi Channels (800-809)
   else if (parameterId >= 800 && parameterId < 810) {
     if (parameterId == 800)
@@ -1221,42 +1053,31 @@ void AudioEngine::updateEngineParameter(int trackIndex, int parameterId,
     switch (fxId) {
     case 0: // Flanger
       if (subId == 0) {
-        mFlangerFxL.setRate(value);
-        mFlangerFxR.setRate(value);
+        mFlangerFx.setRate(value);
       } else if (subId == 1) {
-        mFlangerFxL.setDepth(value);
-        mFlangerFxR.setDepth(value);
+        mFlangerFx.setDepth(value);
       } else if (subId == 2) {
-        mFlangerFxL.setMix(value);
-        mFlangerFxR.setMix(value);
+        mFlangerFx.setMix(value);
       } else if (subId == 3) {
-        mFlangerFxL.setFeedback(value);
-        mFlangerFxR.setFeedback(value);
+        mFlangerFx.setFeedback(value);
       } else if (subId == 4) {
         float delay = value * 0.02f;
-        mFlangerFxL.setDelay(delay);
-        mFlangerFxR.setDelay(delay);
+        mFlangerFx.setDelay(delay);
       }
       break;
     case 1: // TapeEcho
       if (subId == 0) {
-        mTapeEchoFxL.setDelayTime(value);
-        mTapeEchoFxR.setDelayTime(value);
+        mTapeEchoFx.setDelayTime(value);
       } else if (subId == 1) {
-        mTapeEchoFxL.setFeedback(value);
-        mTapeEchoFxR.setFeedback(value);
+        mTapeEchoFx.setFeedback(value);
       } else if (subId == 2) {
-        mTapeEchoFxL.setMix(value);
-        mTapeEchoFxR.setMix(value);
+        mTapeEchoFx.setMix(value);
       } else if (subId == 3) {
-        mTapeEchoFxL.setDrive(value);
-        mTapeEchoFxR.setDrive(value);
+        mTapeEchoFx.setDrive(value);
       } else if (subId == 4) {
-        mTapeEchoFxL.setWow(value);
-        mTapeEchoFxR.setWow(value);
+        mTapeEchoFx.setWow(value);
       } else if (subId == 5) {
-        mTapeEchoFxL.setFlutter(value);
-        mTapeEchoFxR.setFlutter(value);
+        mTapeEchoFx.setFlutter(value);
       }
       break;
       //    case 2: // Auto-Panner (Replaced by Filter Chain - logic handled in
@@ -1265,19 +1086,19 @@ void AudioEngine::updateEngineParameter(int trackIndex, int parameterId,
       //      break;
     case 3: // Octaver
       if (subId == 0) {
-        mOctaverFxL.setMix(value);
-        mOctaverFxR.setMix(value);
+        mOctaverFx.setMix(value);
       } else if (subId == 1) {
-        mOctaverFxL.setMode(value);
-        mOctaverFxR.setMode(value);
+        mOctaverFx.setMode(value);
       } else if (subId == 2) {
-        mOctaverFxL.setUnison(value);
-        mOctaverFxR.setUnison(value);
+        mOctaverFx.setUnison(value);
       } else if (subId == 3) {
-        mOctaverFxL.setDetune(value);
-        mOctaverFxR.setDetune(value);
+        mOctaverFx.setDetune(value);
       }
       break;
+    case 4: // Convolution
+      if (subId == 0)
+        mConvolutionFx.setMix(value);
+      break;
     }
   }
   // Multi-Filter Pedals (2100-2114) - Replaces AutoPanner
@@ -1290,17 +1111,13 @@ void AudioEngine::updateEngineParameter(int trackIndex, int parameterId,
     int bus = (filterIdx == 0) ? 12 : (filterIdx == 1) ? 15 : 16;
     if (filterIdx >= 0 && filterIdx < 3) {
       if (subId == 0) { // Cutoff
-        mFilterPedalL[filterIdx].setCutoff(value);
-        mFilterPedalR[filterIdx].setCutoff(value);
+        mFilterPedal[filterIdx].setCutoff(value);
       } else if (subId == 1) { // Resonance
-        mFilterPedalL[filterIdx].setResonance(value);
-        mFilterPedalR[filterIdx].setResonance(value);
+        mFilterPedal[filterIdx].setResonance(value);
       } else if (subId == 2) { // Mode
-        mFilterPedalL[filterIdx].setMode(value);
-        mFilterPedalR[filterIdx].setMode(value);
+        mFilterPedal[filterIdx].setMode(value);
       } else if (subId == 3) {                 // Global Mix
-        mFilterPedalL[filterIdx].setMix(1.0f); // Always wet internally
-        mFilterPedalR[filterIdx].setMix(1.0f);
+        mFilterPedal[filterIdx].setMix(1.0f); // Always wet internally
         // mFxMixLevels[bus] = value; // REMOVED: Caused silence when mix=0
       }
     }
@@ -1309,61 +1126,410 @@ void AudioEngine::updateEngineParameter(int trackIndex, int parameterId,
 
 // End of updateEngineParameter
 
-// Processing Commands
-void AudioEngine::processCommands() {
-  std::vector<AudioCommand> todo;
-  {
-    std::lock_guard<std::mutex> lock(mCommandLock);
-    if (mCommandQueue.empty())
-      return;
-    todo.swap(mCommandQueue);
-  }
-  for (const auto &cmd : todo) {
-    switch (cmd.type) {
-    case AudioCommand::NOTE_ON:
-      triggerNoteLocked(cmd.trackIndex, cmd.data1, (int)cmd.value, false);
+// The engines' own parameters, the ranges ensureEngine replays. Dispatch
+// only looks at the engine set, so a new engine can take them before it
+// joins the track.
+void AudioEngine::applyEngineParameter(TrackEngines &track, int parameterId,
+                                       float value) {
+  // Common Params (< 100)
+  if (parameterId < 100) {
+    switch (parameterId) {
+    case 1: // Common Filter Cutoff
+      if (track.subtractiveEngine)
+        track.subtractiveEngine->setCutoff(value);
+      if (track.fmEngine)
+        track.fmEngine->setFilter(value);
+      if (track.samplerEngine)
+        track.samplerEngine->setFilterCutoff(value);
+      if (track.wavetableEngine)
+        track.wavetableEngine->setFilterCutoff(value);
+      if (track.granularEngine)
+        track.granularEngine->setParameter(1, value);
+      if (track.soundFontEngine)
+        track.soundFontEngine->setParameter(1, value);
       break;
-    case AudioCommand::NOTE_OFF:
-      releaseNoteLocked(cmd.trackIndex, cmd.data1, false);
+    case 2: // Common Resonance
+      if (track.subtractiveEngine)
+        track.subtractiveEngine->setResonance(value);
+      if (track.fmEngine)
+        track.fmEngine->setResonance(value);
+      if (track.samplerEngine)
+        track.samplerEngine->setFilterResonance(value);
+      if (track.wavetableEngine)
+        track.wavetableEngine->setResonance(value);
+      if (track.granularEngine)
+        track.granularEngine->setParameter(2, value);
+      if (track.soundFontEngine)
+        track.soundFontEngine->setParameter(2, value);
       break;
-    case AudioCommand::PARAM_SET:
-      setParameter(cmd.trackIndex, cmd.data1,
-                   cmd.value); // Call the new setParameter
+    case 3: // Env Amount
+      if (track.subtractiveEngine)
+        track.subtractiveEngine->setFilterEnvAmount(value);
+      if (track.fmEngine)
+        track.fmEngine->setParameter(3, value);
+      if (track.soundFontEngine)
+        track.soundFontEngine->setParameter(3, value);
       break;
-    case AudioCommand::GLOBAL_PARAM_SET:
+    case 4:
+      if (track.subtractiveEngine)
+        track.subtractiveEngine->setOscWaveform(1, value);
+      break;
+    case 5:
+      if (track.subtractiveEngine)
+        track.subtractiveEngine->setOscVolume(0, std::max(0.001f, value));
+      break;
+    case 6:
+      if (track.subtractiveEngine)
+        track.subtractiveEngine->setDetune(value);
+      if (track.soundFontEngine)
+        track.soundFontEngine->setParameter(6, value);
+      break;
+    case 7:
+      if (track.subtractiveEngine)
+        track.subtractiveEngine->setLfoRate(value);
+      if (track.soundFontEngine)
+        track.soundFontEngine->setParameter(7, value);
+      break;
+    case 8:
+      if (track.subtractiveEngine)
+        track.subtractiveEngine->setLfoDepth(value);
+      if (track.soundFontEngine)
+        track.soundFontEngine->setParameter(8, value);
       break;
     }
   }
-}
-
-void AudioEngine::releaseNoteLocked(int trackIndex, int note,
-                                    bool isSequencerTrigger) {
-  if (trackIndex >= 0 && trackIndex < mTracks.size()) {
-    Track &track = mTracks[trackIndex];
-    if (track.engineType == 7) {
-      enqueueMidiEvent(0x80, track.midiOutChannel - 1, note, 0);
-      track.isActive = false;
-    } else {
-      if (!isSequencerTrigger) {
-        track.mPhysicallyHeldNoteCount--;
-        if (track.mPhysicallyHeldNoteCount <= 0) {
-          track.mPhysicallyHeldNoteCount = 0;
-          track.arpeggiator.onAllPhysicallyReleased();
-        }
-        if (track.arpeggiator.getMode() != ArpMode::OFF) {
-          track.arpeggiator.removeNote(note);
-        }
-      }
-
-      // ALWAYS release engine notes for manual interaction,
-      // even if Arp is ON, otherwise they get stuck when unlatching or
-      // switching.
-      for (int i = 0; i < Track::MAX_POLYPHONY; ++i) {
-        if (track.mActiveNotes[i].active &&
-            track.mActiveNotes[i].note == note) {
-          track.mActiveNotes[i].active = false;
-          mGlobalVoiceCount--;
-          break;
+  // ADSR / Internal Params (100-149)
+  else if (parameterId >= 100 && parameterId < 150) {
+    switch (parameterId) {
+    case 123: // Audio In Filter Mode
+      if (track.audioInEngine)
+        track.audioInEngine->setParameter(123, value);
+      break;
+    case 100:
+      if (track.subtractiveEngine)
+        track.subtractiveEngine->setAttack(value);
+      if (track.samplerEngine)
+        track.samplerEngine->setAttack(value);
+      if (track.granularEngine)
+        track.granularEngine->setAttack(value);
+      if (track.wavetableEngine)
+        track.wavetableEngine->setAttack(value);
+      if (track.fmEngine)
+        track.fmEngine->setParameter(100, value);
+      if (track.audioInEngine)
+        track.audioInEngine->setParameter(100, value);
+      if (track.soundFontEngine)
+        track.soundFontEngine->setParameter(100, value);
+      break;
+    case 101:
+      if (track.subtractiveEngine)
+        track.subtractiveEngine->setDecay(value);
+      if (track.samplerEngine)
+        track.samplerEngine->setDecay(value);
+      if (track.granularEngine)
+        track.granularEngine->setDecay(value);
+      if (track.wavetableEngine)
+        track.wavetableEngine->setDecay(value);
+      if (track.fmEngine)
+        track.fmEngine->setParameter(101, value);
+      if (track.audioInEngine)
+        track.audioInEngine->setParameter(101, value);
+      if (track.soundFontEngine)
+        track.soundFontEngine->setParameter(101, value);
+      break;
+    case 102:
+      if (track.subtractiveEngine)
+        track.subtractiveEngine->setSustain(value);
+      if (track.samplerEngine)
+        track.samplerEngine->setParameter(parameterId, value);
+      if (track.granularEngine)
+        track.granularEngine->setParameter(parameterId, value);
+      if (track.fmEngine)
+        track.fmEngine->setParameter(parameterId, value);
+      if (track.wavetableEngine)
+        track.wavetableEngine->setSustain(value);
+      if (track.audioInEngine)
+        track.audioInEngine->setParameter(parameterId, value);
+      if (track.soundFontEngine)
+        track.soundFontEngine->setParameter(102, value);
+      break;
+    case 103:
+      if (track.subtractiveEngine)
+        track.subtractiveEngine->setRelease(value);
+      if (track.samplerEngine)
+        track.samplerEngine->setParameter(parameterId, value);
+      if (track.granularEngine)
+        track.granularEngine->setParameter(parameterId, value);
+      if (track.fmEngine)
+        track.fmEngine->setParameter(parameterId, value);
+      if (track.wavetableEngine)
+        track.wavetableEngine->setRelease(value);
+      if (track.audioInEngine)
+        track.audioInEngine->setParameter(parameterId, value);
+      if (track.soundFontEngine)
+        track.soundFontEngine->setParameter(103, value);
+      break;
+    case 104:
+      if (track.subtractiveEngine)
+        track.subtractiveEngine->setOscWaveform(0, value);
+      break;
+    case 105:
+      if (track.subtractiveEngine)
+        track.subtractiveEngine->setOscWaveform(1, value);
+      break;
+    case 106:
+      if (track.subtractiveEngine)
+        track.subtractiveEngine->setDetune(value);
+      break;
+    case 107:
+      if (track.subtractiveEngine)
+        track.subtractiveEngine->setOscVolume(0, value);
+      break;
+    case 108:
+      if (track.subtractiveEngine)
+        track.subtractiveEngine->setOscVolume(1, value);
+      break;
+    case 109:
+      if (track.subtractiveEngine)
+        track.subtractiveEngine->setOscVolume(2, value);
+      break;
+    case 110:
+      if (track.subtractiveEngine)
+        track.subtractiveEngine->setNoiseLevel(value);
+      break;
+    case 112:
+    case 113:
+    case 122: // Wavefold
+      if (track.subtractiveEngine)
+        track.subtractiveEngine->setParameter(parameterId, value);
+      if (track.samplerEngine)
+        track.samplerEngine->setParameter(parameterId, value);
+      if (track.audioInEngine)
+        track.audioInEngine->setParameter(parameterId, value);
+      if (track.soundFontEngine)
+        track.soundFontEngine->setParameter(parameterId, value);
+      break;
+    case 118:
+      if (track.subtractiveEngine)
+        track.subtractiveEngine->setFilterEnvAmount(value);
+      if (track.samplerEngine)
+        track.samplerEngine->setFilterEnvAmount(value);
+      if (track.audioInEngine)
+        track.audioInEngine->setParameter(118, value);
+      break;
+    case 114:
+      if (track.subtractiveEngine)
+        track.subtractiveEngine->setFilterAttack(value);
+      if (track.samplerEngine)
+        track.samplerEngine->setParameter(parameterId, value);
+      break;
+    case 115:
+      if (track.subtractiveEngine)
+        track.subtractiveEngine->setFilterDecay(value);
+      if (track.samplerEngine)
+        track.samplerEngine->setParameter(parameterId, value);
+      break;
+    case 116:
+      if (track.subtractiveEngine)
+        track.subtractiveEngine->setFilterSustain(value);
+      if (track.samplerEngine)
+        track.samplerEngine->setParameter(parameterId, value);
+      break;
+    case 117:
+      if (track.subtractiveEngine)
+        track.subtractiveEngine->setFilterRelease(value);
+      if (track.samplerEngine)
+        track.samplerEngine->setParameter(parameterId, value);
+      break;
+    }
+  }
+  // Filter & Env (120-149)
+  else if (parameterId >= 120 && parameterId < 150) {
+    if (track.subtractiveEngine)
+      track.subtractiveEngine->setParameter(parameterId, value);
+    if (track.samplerEngine)
+      track.samplerEngine->setParameter(parameterId, value);
+    if (track.granularEngine)
+      track.granularEngine->setParameter(parameterId, value);
+    if (track.wavetableEngine)
+      track.wavetableEngine->setParameter(parameterId, value);
+    if (track.fmDrumEngine)
+      track.fmDrumEngine->setParameter(track.selectedFmDrumInstrument,
+                                       parameterId, value);
+    if (track.audioInEngine)
+      track.audioInEngine->setParameter(parameterId, value);
+  }
+  // FM / Sound Design (150-199)
+  else if (parameterId >= 150 && parameterId < 200) {
+    if (track.engineType == 0) { // Subtractive
+      track.subtractiveEngine->setParameter(parameterId, value);
+    } else if (track.engineType == 1) { // FM
+      if (parameterId == 156) {
+        track.fmEngine->setParameter(156, value); // Mode
+      } else {
+        track.fmEngine->setParameter(parameterId, value);
+      }
+    }
+  }
+  // FM Drum (200-299)
+  else if (parameterId >= 200 && parameterId < 300 && track.fmDrumEngine) {
+    track.fmDrumEngine->setParameter((parameterId - 200) / 10,
+                                    (parameterId - 200) % 10, value);
+  }
+  // Sampler & Engine Sub-params (300-399)
+  else if (parameterId >= 300 && parameterId < 400) {
+    if (parameterId == 350) {
+      if (track.subtractiveEngine)
+        track.subtractiveEngine->setUseEnvelope(value > 0.5f);
+      if (track.fmEngine)
+        track.fmEngine->setUseEnvelope(value > 0.5f);
+      if (track.samplerEngine)
+        track.samplerEngine->setParameter(350, value);
+      if (track.granularEngine)
+        track.granularEngine->setParameter(350, value);
+    } else if (parameterId == 355) {
+      // User requested Curve: val * val * 0.3 (Max 0.3s)
+      float glideVal = value * value * 0.3f;
+      if (track.subtractiveEngine)
+        track.subtractiveEngine->setParameter(355, glideVal);
+      if (track.fmEngine)
+        track.fmEngine->setParameter(355, glideVal);
+      if (track.samplerEngine)
+        track.samplerEngine->setParameter(355, glideVal);
+      if (track.granularEngine)
+        track.granularEngine->setParameter(355, glideVal);
+      if (track.wavetableEngine)
+        track.wavetableEngine->setParameter(355, glideVal);
+      if (track.soundFontEngine)
+        track.soundFontEngine->setParameter(355, glideVal);
+    } else if (parameterId == 357) { // Saturation anti-aliasing, see AntiAlias
+      float mode = (float)(int)(value * 4.99f);
+      if (track.subtractiveEngine)
+        track.subtractiveEngine->setParameter(357, mode);
+      if (track.fmEngine)
+        track.fmEngine->setParameter(357, mode);
+      if (track.wavetableEngine)
+        track.wavetableEngine->setParameter(357, mode);
+    } else if (track.engineType == 5) {
+      track.fmDrumEngine->setParameter(track.selectedFmDrumInstrument,
+                                      parameterId - 300, value);
+    } else {
+      if (track.samplerEngine)
+        track.samplerEngine->setParameter(parameterId, value);
+    }
+  }
+  // Granular (400-449)
+  else if (parameterId >= 400 && parameterId < 450) {
+    if (track.granularEngine)
+      track.granularEngine->setParameter(parameterId, value);
+  }
+  // Wavetable (450-489)
+  else if (parameterId >= 450 && parameterId < 490 && track.wavetableEngine) {
+    if (parameterId == 450)
+      track.wavetableEngine->setParameter(0, value);
+    else if (parameterId == 451)
+      track.wavetableEngine->setParameter(1, value);
+    else if (parameterId == 454)
+      track.wavetableEngine->setAttack(value);
+    else if (parameterId == 455)
+      track.wavetableEngine->setDecay(value);
+    else if (parameterId == 456)
+      track.wavetableEngine->setSustain(value);
+    else if (parameterId == 457)
+      track.wavetableEngine->setRelease(value);
+    else if (parameterId == 458)
+      track.wavetableEngine->setFilterCutoff(value);
+    else if (parameterId == 459)
+      track.wavetableEngine->setResonance(value);
+    else if (parameterId == 461)
+      track.wavetableEngine->setParameter(11, value);
+    else if (parameterId == 464)
+      track.wavetableEngine->setParameter(14, value);
+    else if (parameterId == 465)
+      track.wavetableEngine->setParameter(15, value);
+    else if (parameterId == 466)
+      track.wavetableEngine->setParameter(16, value);
+    else if (parameterId == 467)
+      track.wavetableEngine->setParameter(17, value);
+    else if (parameterId == 470) // Filter Mode (Added)
+      track.wavetableEngine->setParameter(20, value);
+    else if (parameterId == 471) // Filter Atk (Added)
+      track.wavetableEngine->setParameter(21, value);
+    else if (parameterId == 472) // Filter Dcy (Shared handle)
+      track.wavetableEngine->setParameter(11, value);
+    else if (parameterId == 473) // Filter Sus (Added)
+      track.wavetableEngine->setParameter(23, value);
+    else if (parameterId == 474) // Filter Rel (Added)
+      track.wavetableEngine->setParameter(24, value);
+    else if (parameterId == 475) // Bits (Moved from 530)
+      track.wavetableEngine->setParameter(30, value);
+    else if (parameterId == 476) // Srate (Moved from 531)
+      track.wavetableEngine->setParameter(31, value);
+  }
+  // Analog Drum (600-699)
+  else if (parameterId >= 600 && parameterId < 700) {
+    int drumIdx = (parameterId - 600) / 10;
+    int subId = (parameterId - 600) % 10;
+    if (track.analogDrumEngine)
+      track.analogDrumEngine->setParameter(drumIdx, subId, value);
+  }
+}
+
+// Processing Commands
+void AudioEngine::processCommands() {
+  std::vector<AudioCommand> todo;
+  {
+    std::lock_guard<std::mutex> lock(mCommandLock);
+    if (mCommandQueue.empty())
+      return;
+    todo.swap(mCommandQueue);
+  }
+  for (const auto &cmd : todo) {
+    switch (cmd.type) {
+    case AudioCommand::NOTE_ON:
+      triggerNoteLocked(cmd.trackIndex, cmd.data1, (int)cmd.value, false);
+      break;
+    case AudioCommand::NOTE_OFF:
+      releaseNoteLocked(cmd.trackIndex, cmd.data1, false);
+      break;
+    case AudioCommand::PARAM_SET:
+      setParameter(cmd.trackIndex, cmd.data1,
+                   cmd.value); // Call the new setParameter
+      break;
+    case AudioCommand::GLOBAL_PARAM_SET:
+      break;
+    }
+  }
+}
+
+void AudioEngine::releaseNoteLocked(int trackIndex, int note,
+                                    bool isSequencerTrigger) {
+  if (trackIndex >= 0 && trackIndex < mTracks.size()) {
+    Track &track = mTracks[trackIndex];
+    if (track.engineType == 7) {
+      enqueueMidiEvent(0x80, track.midiOutChannel - 1, note, 0);
+      track.isActive = false;
+    } else {
+      if (!isSequencerTrigger) {
+        track.mPhysicallyHeldNoteCount--;
+        if (track.mPhysicallyHeldNoteCount <= 0) {
+          track.mPhysicallyHeldNoteCount = 0;
+          track.arpeggiator.onAllPhysicallyReleased();
+        }
+        if (track.arpeggiator.getMode() != ArpMode::OFF) {
+          track.arpeggiator.removeNote(note);
+        }
+      }
+
+      // ALWAYS release engine notes for manual interaction,
+      // even if Arp is ON, otherwise they get stuck when unlatching or
+      // switching.
+      for (int i = 0; i < Track::MAX_POLYPHONY; ++i) {
+        if (track.mActiveNotes[i].active &&
+            track.mActiveNotes[i].note == note) {
+          track.mActiveNotes[i].active = false;
+          mGlobalVoiceCount--;
+          break;
         }
       }
       if (mIsRecording && mIsPlaying && !isSequencerTrigger) {
@@ -1396,15 +1562,24 @@ void AudioEngine::releaseNoteLocked(int trackIndex, int note,
         }
       }
 
-      track.subtractiveEngine.releaseNote(note);
-      track.fmEngine.releaseNote(note);
-      track.samplerEngine.releaseNote(note);
-      track.fmDrumEngine.releaseNote(note);
-      track.granularEngine.releaseNote(note);
-      track.wavetableEngine.releaseNote(note);
-      track.analogDrumEngine.releaseNote(note);
-      track.audioInEngine.releaseNote(note);
-      track.soundFontEngine.noteOff(note);
+      if (track.subtractiveEngine)
+        track.subtractiveEngine->releaseNote(note);
+      if (track.fmEngine)
+        track.fmEngine->releaseNote(note);
+      if (track.samplerEngine)
+        track.samplerEngine->releaseNote(note);
+      if (track.fmDrumEngine)
+        track.fmDrumEngine->releaseNote(note);
+      if (track.granularEngine)
+        track.granularEngine->releaseNote(note);
+      if (track.wavetableEngine)
+        track.wavetableEngine->releaseNote(note);
+      if (track.analogDrumEngine)
+        track.analogDrumEngine->releaseNote(note);
+      if (track.audioInEngine)
+        track.audioInEngine->releaseNote(note);
+      if (track.soundFontEngine)
+        track.soundFontEngine->noteOff(note);
     }
   }
 }
@@ -1429,56 +1604,69 @@ AudioEngine::onAudioReady(oboe::AudioStream *audioStream, void *audioData,
   if (audioStream->getDirection() == oboe::Direction::Input) {
     float *input = static_cast<float *>(audioData);
     int channels = audioStream->getChannelCount();
-    for (int i = 0; i < numFrames; ++i) {
-      float combined = 0.0f;
-      if (channels == 2) {
-        combined = (input[i * 2] + input[i * 2 + 1]) * 0.5f;
-      } else {
-        combined = input[i];
+    if (channels == 2) {
+      float mono[256];
+      for (int i = 0; i < numFrames; i += 256) {
+        int count = std::min(256, numFrames - i);
+        for (int k = 0; k < count; ++k)
+          mono[k] = (input[(i + k) * 2] + input[(i + k) * 2 + 1]) * 0.5f;
+        mInputRing.write(mono, count);
       }
-      mInputRingBuffer[mInputWritePtr % 8192] = combined;
-      mInputWritePtr++;
-    }
-
-    // If resampling is active, ignore microphone input
-    if (mIsResampling) {
-      return oboe::DataCallbackResult::Continue;
+    } else {
+      mInputRing.write(input, numFrames);
     }
 
-    if (mIsRecordingSample && mRecordingTrackIndex != -1) {
-      auto &track = mTracks[mRecordingTrackIndex];
-      float *input = static_cast<float *>(audioData);
-      int channels = audioStream->getChannelCount();
+    captureInput(input, numFrames, channels);
+    return oboe::DataCallbackResult::Continue;
+  }
 
-      for (int i = 0; i < numFrames; ++i) {
-        float sampleToPush = 0.0f;
-        if (channels == 2) {
-          sampleToPush = (input[i * 2] + input[i * 2 + 1]) * 0.5f;
-        } else {
-          sampleToPush = input[i];
-        }
+  mSampleRate = static_cast<double>(audioStream->getSampleRate());
+  if (mSampleRate <= 0.0)
+    mSampleRate = 48000.0;
+  renderOutput(static_cast<float *>(audioData), numFrames,
+               audioStream->getChannelCount());
+  return oboe::DataCallbackResult::Continue;
+}
 
-        if (track.engineType == 2)
-          track.samplerEngine.pushSample(sampleToPush);
-        else if (track.engineType == 3)
-          track.granularEngine.pushSample(sampleToPush);
-      }
+// Feeds the mic to a sample recording in progress. In duplex mode this runs
+// on the output callback, so the take lines up with what was playing.
+void AudioEngine::captureInput(const float *input, int numFrames,
+                               int channels) {
+  // If resampling is active, ignore microphone input
+  if (mIsResampling)
+    return;
+  if (!mIsRecordingSample)
+    return;
+  // The UI thread swaps engines in and out under mLock. Only held while
+  // recording, so the input callback doesn't wait on renders otherwise.
+  std::lock_guard<std::recursive_mutex> lock(mLock);
+  if (!mIsRecordingSample || mRecordingTrackIndex == -1)
+    return;
+  auto &track = mTracks[mRecordingTrackIndex];
+  for (int i = 0; i < numFrames; ++i) {
+    float sampleToPush = 0.0f;
+    if (channels == 2) {
+      sampleToPush = (input[i * 2] + input[i * 2 + 1]) * 0.5f;
+    } else {
+      sampleToPush = input[i];
     }
-    return oboe::DataCallbackResult::Continue;
+
+    if (track.engineType == 2 && track.samplerEngine)
+      track.samplerEngine->pushSample(sampleToPush);
+    else if (track.engineType == 3 && track.granularEngine)
+      track.granularEngine->pushSample(sampleToPush);
   }
+}
 
+// Everything the output callback does, minus the stream. Also the entry
+// point for driving the engine without a device (see AudioBackend.h).
+void AudioEngine::renderOutput(float *output, int numFrames, int numChannels) {
   // --- No Global Lock Here ---
 
   auto start = std::chrono::steady_clock::now();
-  float *output = static_cast<float *>(audioData);
-  int numChannels = audioStream->getChannelCount();
-  mSampleRate = static_cast<double>(audioStream->getSampleRate());
-  if (mSampleRate <= 0.0)
-    mSampleRate = 48000.0;
-
   memset(output, 0, numFrames * numChannels * sizeof(float));
 
-  const int kBlockSize = 256;
+  const int kBlockSize = kMaxRenderBlock;
 
   float samplesPerStep =
       (static_cast<float>(mSampleRate) * 60.0f) / (std::max(1.0f, mBpm) * 4.0f);
@@ -1585,7 +1773,7 @@ AudioEngine::onAudioReady(oboe::AudioStream *audioStream, void *audioData,
 
             // Drum Sequencer
             bool isSamplerChops = (track.engineType == 2 &&
-                                   track.samplerEngine.getPlayMode() >= 3);
+                                   track.samplerEngine->getPlayMode() >= 3);
             if (track.engineType == 5 || track.engineType == 6 ||
                 isSamplerChops) {
               for (int d = 0; d < 16; ++d) {
@@ -1689,8 +1877,19 @@ AudioEngine::onAudioReady(oboe::AudioStream *audioStream, void *audioData,
         }
       }
 
+      // Duplex: this block's mic, read right before it's rendered
+      mDuplexFrames = nullptr;
+      if (mDuplexInput) {
+        mDuplexInput->read(mInputBlock, framesToDo);
+        mDuplexFrames = mInputBlock;
+        captureInput(mInputBlock, framesToDo, 1);
+      }
+
       // Audio Block Rendering
       renderStereo(&output[frameIdx * numChannels], framesToDo);
+      if (mDuplexInput)
+        mDuplexInput->onOutput(&output[frameIdx * numChannels], framesToDo,
+                               numChannels);
     }
 
     // Push to resampling recorder (Sampler/Granular)
@@ -1702,9 +1901,9 @@ AudioEngine::onAudioReady(oboe::AudioStream *audioStream, void *audioData,
                        output[(frameIdx + k) * numChannels + 1]) *
                       0.5f;
         if (recTrack.engineType == 2)
-          recTrack.samplerEngine.pushSample(mixed);
+          recTrack.samplerEngine->pushSample(mixed);
         else if (recTrack.engineType == 3)
-          recTrack.granularEngine.pushSample(mixed);
+          recTrack.granularEngine->pushSample(mixed);
       }
     }
   }
@@ -1748,8 +1947,6 @@ AudioEngine::onAudioReady(oboe::AudioStream *audioStream, void *audioData,
     }
     maxPeak = 0.0f; // Reset max peak every second
   }
-
-  return oboe::DataCallbackResult::Continue;
 }
 
 void AudioEngine::triggerNote(int trackIndex, int note, int velocity) {
@@ -1798,7 +1995,7 @@ void AudioEngine::setStep(int trackIndex, int stepIndex, bool active,
     int drumIdx = -1;
     bool isSamplerChops =
         (mTracks[trackIndex].engineType == 2 &&
-         mTracks[trackIndex].samplerEngine.getPlayMode() == 2);
+         mTracks[trackIndex].samplerEngine->getPlayMode() == 2);
 
     if (mTracks[trackIndex].engineType == 5 ||
         mTracks[trackIndex].engineType == 6 || isSamplerChops) {
@@ -1900,14 +2097,22 @@ void AudioEngine::setPlaying(bool playing) {
       track.isActive = false;
 
       // Panic: Force silence
-      track.subtractiveEngine.allNotesOff();
-      track.fmEngine.allNotesOff();
-      track.samplerEngine.allNotesOff();
-      track.fmDrumEngine.allNotesOff();
-      track.granularEngine.allNotesOff();
-      track.wavetableEngine.allNotesOff();
-      track.analogDrumEngine.allNotesOff();
-      track.soundFontEngine.allNotesOff();
+      if (track.subtractiveEngine)
+        track.subtractiveEngine->allNotesOff();
+      if (track.fmEngine)
+        track.fmEngine->allNotesOff();
+      if (track.samplerEngine)
+        track.samplerEngine->allNotesOff();
+      if (track.fmDrumEngine)
+        track.fmDrumEngine->allNotesOff();
+      if (track.granularEngine)
+        track.granularEngine->allNotesOff();
+      if (track.wavetableEngine)
+        track.wavetableEngine->allNotesOff();
+      if (track.analogDrumEngine)
+        track.analogDrumEngine->allNotesOff();
+      if (track.soundFontEngine)
+        track.soundFontEngine->allNotesOff();
     }
   } else {
     for (auto &track : mTracks) {
@@ -1926,16 +2131,13 @@ void AudioEngine::setPlaying(bool playing) {
     mHpLfoL.setCutoff(0.0f);
     mHpLfoR.setCutoff(0.0f);
     mReverbFx.clear();
+    mConvolutionFx.clear();
     mTapeWobbleFx.clear();
-    mPhaserFxL.clear();
-    mPhaserFxR.clear();
-    mChorusFxL.clear();
-    mChorusFxR.clear();
-    mFlangerFxL.clear();
-    mFlangerFxR.clear();
+    mPhaserFx.clear();
+    mChorusFx.clear();
+    mFlangerFx.clear();
     for (int i = 0; i < 3; ++i) {
-      mFilterPedalL[i].clear();
-      mFilterPedalR[i].clear();
+      mFilterPedal[i].clear();
     }
     mHpLfoL.reset(mSampleRate);
     mHpLfoR.reset(mSampleRate);
@@ -2012,11 +2214,17 @@ void AudioEngine::setSelectedFmDrumInstrument(int trackIndex, int drumIndex) {
 
 void AudioEngine::setParameterLock(int trackIndex, int stepIndex,
                                    int parameterId, float value) {
-  std::lock_guard<std::recursive_mutex> lock(mLock);
-  if (trackIndex >= 0 && trackIndex < mTracks.size()) {
-    mTracks[trackIndex].sequencer.setParameterLock(stepIndex, parameterId,
-                                                   value);
+  {
+    std::lock_guard<std::recursive_mutex> lock(mLock);
+    if (trackIndex >= 0 && trackIndex < mTracks.size()) {
+      mTracks[trackIndex].sequencer.setParameterLock(stepIndex, parameterId,
+                                                     value);
+    }
+    // The send only gets applied on the audio thread, too late to allocate
+    if (isFxSendId(parameterId) && parameterId % 10 == 0 && value > 0.0f)
+      mFxMemoryWanted |= 1u << ((parameterId - 2000) / 10);
   }
+  reserveDelayMemory();
 }
 
 void AudioEngine::clearParameterLocks(int trackIndex, int stepIndex) {
@@ -2028,10 +2236,19 @@ void AudioEngine::clearParameterLocks(int trackIndex, int stepIndex) {
 
 void AudioEngine::setRouting(int destTrack, int sourceTrack, int source,
                              int dest, float amount, int destParamId) {
-  std::lock_guard<std::recursive_mutex> lock(mLock);
-  RoutingEntry entry = {sourceTrack, static_cast<ModSource>(source),
-                        static_cast<ModDestination>(dest), destParamId, amount};
-  mRoutingMatrix.addConnection(destTrack, entry);
+  {
+    std::lock_guard<std::recursive_mutex> lock(mLock);
+    RoutingEntry entry = {sourceTrack, static_cast<ModSource>(source),
+                          static_cast<ModDestination>(dest), destParamId,
+                          amount};
+    mRoutingMatrix.addConnection(destTrack, entry);
+    // A modulated send can open with the knob at 0, and the route only
+    // applies on the audio thread, so reserve for it now
+    if (entry.destination == ModDestination::Parameter &&
+        isFxSendId(destParamId) && destParamId % 10 == 0 && amount != 0.0f)
+      mFxMemoryWanted |= 1u << ((destParamId - 2000) / 10);
+  }
+  reserveDelayMemory();
 }
 
 void AudioEngine::applyModulations() {
@@ -2174,12 +2391,18 @@ void AudioEngine::setArpConfig(int trackIndex, int mode, int octaves,
       track.arpeggiator.clear();
       for (int i = 0; i < AudioEngine::Track::MAX_POLYPHONY; ++i) {
         if (track.mActiveNotes[i].active) {
-          track.subtractiveEngine.releaseNote(track.mActiveNotes[i].note);
-          track.fmEngine.releaseNote(track.mActiveNotes[i].note);
-          track.samplerEngine.releaseNote(track.mActiveNotes[i].note);
-          track.fmDrumEngine.releaseNote(track.mActiveNotes[i].note);
-          track.granularEngine.releaseNote(track.mActiveNotes[i].note);
-          track.wavetableEngine.releaseNote(track.mActiveNotes[i].note);
+          if (track.subtractiveEngine)
+            track.subtractiveEngine->releaseNote(track.mActiveNotes[i].note);
+          if (track.fmEngine)
+            track.fmEngine->releaseNote(track.mActiveNotes[i].note);
+          if (track.samplerEngine)
+            track.samplerEngine->releaseNote(track.mActiveNotes[i].note);
+          if (track.fmDrumEngine)
+            track.fmDrumEngine->releaseNote(track.mActiveNotes[i].note);
+          if (track.granularEngine)
+            track.granularEngine->releaseNote(track.mActiveNotes[i].note);
+          if (track.wavetableEngine)
+            track.wavetableEngine->releaseNote(track.mActiveNotes[i].note);
           track.mActiveNotes[i].active = false;
         }
       }
@@ -2220,14 +2443,16 @@ void AudioEngine::getGranularPlayheads(int trackIndex,
                                        int maxCount) {
   std::lock_guard<std::recursive_mutex> lock(mLock);
   if (trackIndex >= 0 && trackIndex < mTracks.size()) {
-    mTracks[trackIndex].granularEngine.getPlayheads(out, maxCount);
+    if (mTracks[trackIndex].granularEngine)
+      mTracks[trackIndex].granularEngine->getPlayheads(out, maxCount);
   }
 }
 
 void AudioEngine::normalizeSample(int trackIndex) {
   std::lock_guard<std::recursive_mutex> lock(mLock);
   if (trackIndex >= 0 && trackIndex < mTracks.size()) {
-    mTracks[trackIndex].samplerEngine.normalize();
+    if (mTracks[trackIndex].samplerEngine)
+      mTracks[trackIndex].samplerEngine->normalize();
   }
 }
 
@@ -2237,13 +2462,13 @@ void AudioEngine::saveSample(int trackIndex, const std::string &path) {
   auto &track = mTracks[trackIndex];
   // Currently only support SamplerEngine saving
   if (track.engineType == 2) { // Sampler
-    std::vector<float> data = track.samplerEngine.getSampleData();
-    std::vector<float> slices = track.samplerEngine.getSlicePoints();
-    WavFileUtils::writeWav(path, data, 48000, 1, slices);
+    std::vector<float> data = track.samplerEngine->getSampleData();
+    std::vector<float> slices = track.samplerEngine->getSlicePoints();
+    WavFileUtils::writeWav(path, data, (int)mSampleRate, 1, slices);
   } else if (track.engineType == 3) { // Granular (Standardized to 3)
-    std::vector<float> data = track.granularEngine.getSampleData();
+    std::vector<float> data = track.granularEngine->getSampleData();
     std::vector<float> slices;
-    WavFileUtils::writeWav(path, data, 48000, 1, slices);
+    WavFileUtils::writeWav(path, data, (int)mSampleRate, 1, slices);
   }
 }
 
@@ -2257,19 +2482,49 @@ void AudioEngine::loadSample(int trackIndex, const std::string &path) {
   int sampleRate, channels;
 
   if (WavFileUtils::loadWav(path, data, sampleRate, channels, slices)) {
+    if (track.engineType == 2 || track.engineType == 3) {
+      // Sampler/Granular buffers are mono at the engine rate. Convert once
+      // here so voices play back at ratio 1. Slices are normalized, no fixup.
+      if (channels > 1) {
+        size_t frames = data.size() / channels;
+        for (size_t f = 0; f < frames; ++f) {
+          float sum = 0.0f;
+          for (int c = 0; c < channels; ++c)
+            sum += data[f * channels + c];
+          data[f] = sum / channels;
+        }
+        data.resize(frames);
+      }
+      data = Resampler::convert(data, sampleRate, mSampleRate);
+    }
     if (track.engineType == 2) {
-      track.samplerEngine.loadSample(data);
-      track.samplerEngine.setSlicePoints(slices);
+      track.samplerEngine->loadSample(data);
+      track.samplerEngine->setSlicePoints(slices);
     } else if (track.engineType == 3) { // Granular (Standardized to 3)
-      track.granularEngine.setSource(data);
+      track.granularEngine->setSource(data);
     } else if (track.engineType == 4) { // Wavetable
-      track.wavetableEngine.loadWavetable(data);
+      track.wavetableEngine->loadWavetable(data);
     }
     track.lastSamplePath = path;
     saveAppState();
   }
 }
 
+void AudioEngine::setCompactStorage(int trackIndex, bool compact) {
+  if (trackIndex < 0 || trackIndex >= mTracks.size())
+    return;
+  // Not a parameter: converting the buffer allocates, and parameters also
+  // run on the audio thread through p-locks and mod routes. Kept on the
+  // track for engines built later.
+  std::lock_guard<std::recursive_mutex> lock(mLock);
+  auto &track = mTracks[trackIndex];
+  track.compactStorage = compact;
+  if (track.samplerEngine)
+    track.samplerEngine->setCompactStorage(compact);
+  if (track.granularEngine)
+    track.granularEngine->setCompactStorage(compact);
+}
+
 void AudioEngine::setAppDataDir(const std::string &dir) { mAppDataDir = dir; }
 
 void AudioEngine::saveAppState() {
@@ -2319,11 +2574,11 @@ void AudioEngine::trimSample(int trackIndex) {
   std::lock_guard<std::recursive_mutex> lock(mLock);
   if (trackIndex >= 0 && trackIndex < (int)mTracks.size()) {
     if (mTracks[trackIndex].engineType == 2) {
-      mTracks[trackIndex].samplerEngine.trim();
+      mTracks[trackIndex].samplerEngine->trim();
     } else if (mTracks[trackIndex].engineType == 3) { // Granular
       float start = mTracks[trackIndex].parameters[330];
       float end = mTracks[trackIndex].parameters[331];
-      mTracks[trackIndex].granularEngine.trim(start, end);
+      mTracks[trackIndex].granularEngine->trim(start, end);
     }
   }
 }
@@ -2335,44 +2590,22 @@ std::vector<float> AudioEngine::getRecordedSampleData(int trackIndex,
     return {};
 
   auto &track = mTracks[trackIndex];
-  const std::vector<float> *source = nullptr;
+  std::vector<float> source;
 
   if (track.engineType == 2) {
-    source = &track.samplerEngine.getSampleData();
+    source = track.samplerEngine->getSampleData();
   } else if (track.engineType == 3) {
-    source = &track.granularEngine.getSampleData();
+    source = track.granularEngine->getSampleData();
   }
 
-  if (!source || source->empty())
+  if (source.empty())
     return {};
 
-  float sourceRate = static_cast<float>(mSampleRate);
+  double sourceRate = mSampleRate;
   if (sourceRate <= 0)
-    sourceRate = 48000.0f;
-
-  if (std::abs(sourceRate - targetSampleRate) < 1.0f) {
-    return *source; // No resampling needed
-  }
+    sourceRate = 48000.0;
 
-  double ratio = static_cast<double>(sourceRate) / targetSampleRate;
-  size_t targetSize = static_cast<size_t>(source->size() / ratio);
-  std::vector<float> result(targetSize);
-
-  for (size_t i = 0; i < targetSize; ++i) {
-    double pos = i * ratio;
-    int idx = static_cast<int>(pos);
-    float frac = static_cast<float>(pos - idx);
-
-    // Get 4 points for cubic interpolation
-    float y0 = source->at(std::max(0, idx - 1));
-    float y1 = source->at(idx);
-    float y2 = source->at(std::min((int)source->size() - 1, idx + 1));
-    float y3 = source->at(std::min((int)source->size() - 1, idx + 2));
-
-    result[i] = cubicInterpolation(y0, y1, y2, y3, frac);
-  }
-
-  return result;
+  return Resampler::convert(source, sourceRate, targetSampleRate);
 }
 
 void AudioEngine::startRecordingSample(int trackIndex) {
@@ -2382,9 +2615,9 @@ void AudioEngine::startRecordingSample(int trackIndex) {
     mIsRecordingLocked = false; // Reset lock on new recording start
     mRecordingTrackIndex = trackIndex;
     if (mTracks[trackIndex].engineType == 2)
-      mTracks[trackIndex].samplerEngine.clearBuffer();
+      mTracks[trackIndex].samplerEngine->clearBuffer();
     else if (mTracks[trackIndex].engineType == 3) // Granular
-      mTracks[trackIndex].granularEngine.clearSource();
+      mTracks[trackIndex].granularEngine->clearSource();
   }
 }
 
@@ -2401,21 +2634,346 @@ void AudioEngine::setRecordingLocked(bool locked) {
   mIsRecordingLocked = locked;
 }
 
+// Building an engine and replaying the track into it can take a while, so
+// that happens outside the lock, and so does tearing down the one switched
+// away from. Only the swaps hold up the audio thread.
 void AudioEngine::setEngineType(int trackIndex, int type) {
+  if (trackIndex < 0 || trackIndex >= mTracks.size())
+    return;
+  TrackEngines built, old;
+  EngineSeed seed;
+  bool fresh = prepareEngine(trackIndex, type, built, seed);
   std::lock_guard<std::recursive_mutex> lock(mLock);
-  if (trackIndex >= 0 && trackIndex < mTracks.size()) {
-    mTracks[trackIndex].engineType = type;
+  Track &track = mTracks[trackIndex];
+  int oldType = track.engineType;
+  if (fresh)
+    installEngine(trackIndex, type, built, seed);
+  track.engineType = type;
+  // Drop the old engine unless it carries something the parameters can't
+  // rebuild (samples, tables, banks). It's freed with `old`, after the unlock.
+  if (oldType != type && !engineHoldsContent(trackIndex, oldType))
+    swapEngine(track, old, oldType);
+}
+
+// Not with mLock held, that would keep the audio thread waiting for the build
+void AudioEngine::ensureEngine(int trackIndex, int type) {
+  TrackEngines built;
+  EngineSeed seed;
+  if (!prepareEngine(trackIndex, type, built, seed))
+    return;
+  std::lock_guard<std::recursive_mutex> lock(mLock);
+  installEngine(trackIndex, type, built, seed);
+}
+
+bool AudioEngine::isReplayedId(int parameterId) {
+  // Track level params (volume, pan) and the global FX ranges stay out
+  return parameterId > 0 && parameterId < 700 && parameterId != 9 &&
+         (parameterId < 490 || parameterId >= 600);
+}
+
+// Builds the track's engine of `type` into `built`, unless the track already
+// has one. What it's built from is copied under the lock into `seed`, the
+// build itself runs without it.
+bool AudioEngine::prepareEngine(int trackIndex, int type, TrackEngines &built,
+                                EngineSeed &seed) {
+  {
+    std::lock_guard<std::recursive_mutex> lock(mLock);
+    Track &track = mTracks[trackIndex];
+    if (hasEngine(track, type))
+      return false;
+    seed.sampleRate = (float)mSampleRate;
+    seed.filterMode = track.filterMode;
+    seed.fmPreset = track.fmPreset;
+    seed.compactStorage = track.compactStorage;
+    for (int id = 0; id < 700; ++id) {
+      seed.parameters[id] = track.parameters[id];
+      seed.set[id] = track.parametersSet[id];
+    }
+    built.selectedFmDrumInstrument = track.selectedFmDrumInstrument;
+  }
+
+  switch (type) {
+  case 0:
+    built.subtractiveEngine.create();
+    built.subtractiveEngine->setSampleRate(seed.sampleRate);
+    break;
+  case 1:
+    built.fmEngine.create();
+    built.fmEngine->setSampleRate(seed.sampleRate);
+    break;
+  case 2:
+    built.samplerEngine.create();
+    built.samplerEngine->setSampleRate(seed.sampleRate);
+    break;
+  case 3:
+    built.granularEngine.create();
+    built.granularEngine->setSampleRate(seed.sampleRate);
+    break;
+  case 4:
+    built.wavetableEngine.create();
+    built.wavetableEngine->setSampleRate(seed.sampleRate);
+    break;
+  case 5:
+    built.fmDrumEngine.create();
+    built.fmDrumEngine->setSampleRate(seed.sampleRate);
+    break;
+  case 6:
+    built.analogDrumEngine.create();
+    built.analogDrumEngine->setSampleRate(seed.sampleRate);
+    break;
+  case 8:
+    built.audioInEngine.create();
+    built.audioInEngine->setSampleRate(seed.sampleRate);
+    break;
+  case 9:
+    built.soundFontEngine.create();
+    built.soundFontEngine->setSampleRate(seed.sampleRate);
+    break;
+  }
+
+  applyEngineDefaults(built, type);
+  if (type == 0)
+    built.subtractiveEngine->setFilterMode(seed.filterMode);
+  if (type == 1 && seed.fmPreset >= 0)
+    built.fmEngine->loadPreset(seed.fmPreset);
+  if (type == 2)
+    built.samplerEngine->setCompactStorage(seed.compactStorage);
+  if (type == 3)
+    built.granularEngine->setCompactStorage(seed.compactStorage);
+
+  // Migrate the track's sound onto the new engine by replaying what was set.
+  // Dispatch depends on engineType, so replay as the new type.
+  built.engineType = type;
+  for (int id = 1; id < 700; ++id) {
+    if (isReplayedId(id) && seed.set[id])
+      applyEngineParameter(built, id, seed.parameters[id]);
+  }
+  return true;
+}
+
+// With mLock held. Catches the new engine up on anything set since the seed
+// was taken, then moves it into the track. If the track got one of that type
+// meanwhile, the new one stays in `built` and is freed by the caller.
+void AudioEngine::installEngine(int trackIndex, int type, TrackEngines &built,
+                                const EngineSeed &seed) {
+  Track &track = mTracks[trackIndex];
+  for (int id = 1; id < 700; ++id) {
+    if (isReplayedId(id) && track.parametersSet[id] &&
+        (!seed.set[id] || track.parameters[id] != seed.parameters[id]))
+      applyEngineParameter(built, id, track.parameters[id]);
+  }
+  if (track.compactStorage != seed.compactStorage) {
+    if (type == 2)
+      built.samplerEngine->setCompactStorage(track.compactStorage);
+    if (type == 3)
+      built.granularEngine->setCompactStorage(track.compactStorage);
+  }
+  if (!hasEngine(track, type))
+    swapEngine(track, built, type);
+}
+
+bool AudioEngine::hasEngine(const TrackEngines &engines, int type) {
+  switch (type) {
+  case 0:
+    return (bool)engines.subtractiveEngine;
+  case 1:
+    return (bool)engines.fmEngine;
+  case 2:
+    return (bool)engines.samplerEngine;
+  case 3:
+    return (bool)engines.granularEngine;
+  case 4:
+    return (bool)engines.wavetableEngine;
+  case 5:
+    return (bool)engines.fmDrumEngine;
+  case 6:
+    return (bool)engines.analogDrumEngine;
+  case 8:
+    return (bool)engines.audioInEngine;
+  case 9:
+    return (bool)engines.soundFontEngine;
+  default:
+    return true; // Nothing to build
+  }
+}
+
+void AudioEngine::applyEngineDefaults(TrackEngines &track, int type) {
+  switch (type) {
+  case 0:
+    if (track.subtractiveEngine) {
+      track.subtractiveEngine->setSustain(1.0f);
+      track.subtractiveEngine->setDecay(0.5f);
+    }
+    break;
+  case 1:
+    if (track.fmEngine) {
+      track.fmEngine->resetToDefaults();
+      track.fmEngine->setParameter(101, 0.5f);
+      track.fmEngine->setParameter(102, 1.0f);
+    }
+    break;
+  case 5:
+    if (track.fmDrumEngine) {
+      for (int k = 0; k < 4; k++) {
+        track.fmDrumEngine->setParameter(k, 0, 0.5f); // Pitch
+        track.fmDrumEngine->setParameter(k, 1, 0.5f); // Tone
+        track.fmDrumEngine->setParameter(k, 2, 0.4f); // Decay
+      }
+    }
+    break;
+  case 6:
+    if (track.analogDrumEngine)
+      track.analogDrumEngine->resetToDefaults();
+    break;
+  default:
+    break;
+  }
+}
+
+bool AudioEngine::engineHoldsContent(int trackIndex, int type) {
+  const Track &track = mTracks[trackIndex];
+  bool recording = mIsRecordingSample && mRecordingTrackIndex == trackIndex;
+  switch (type) {
+  case 2:
+    return track.samplerEngine &&
+           (recording || track.samplerEngine->hasContent());
+  case 3:
+    return track.granularEngine &&
+           (recording || track.granularEngine->hasContent());
+  case 4:
+    return track.wavetableEngine && track.wavetableEngine->hasContent();
+  case 5:
+    // Per-instrument edits only live in the engine
+    return (bool)track.fmDrumEngine;
+  case 9:
+    return track.soundFontEngine && track.soundFontEngine->hasContent();
+  default:
+    return false;
+  }
+}
+
+// Pointer moves only, fine under mLock. Swapping into an empty set takes
+// the engine out of the track, to be freed after the unlock.
+void AudioEngine::swapEngine(TrackEngines &a, TrackEngines &b, int type) {
+  switch (type) {
+  case 0:
+    std::swap(a.subtractiveEngine, b.subtractiveEngine);
+    break;
+  case 1:
+    std::swap(a.fmEngine, b.fmEngine);
+    break;
+  case 2:
+    std::swap(a.samplerEngine, b.samplerEngine);
+    break;
+  case 3:
+    std::swap(a.granularEngine, b.granularEngine);
+    break;
+  case 4:
+    std::swap(a.wavetableEngine, b.wavetableEngine);
+    break;
+  case 5:
+    std::swap(a.fmDrumEngine, b.fmDrumEngine);
+    break;
+  case 6:
+    std::swap(a.analogDrumEngine, b.analogDrumEngine);
+    break;
+  case 8:
+    std::swap(a.audioInEngine, b.audioInEngine);
+    break;
+  case 9:
+    std::swap(a.soundFontEngine, b.soundFontEngine);
+    break;
+  default:
+    break;
   }
 }
 
+std::string AudioEngine::getFootprintReport() {
+  std::lock_guard<std::recursive_mutex> lock(mLock);
+  const size_t allEngines =
+      decltype(Track::subtractiveEngine)::engineBytes() +
+      decltype(Track::fmEngine)::engineBytes() +
+      decltype(Track::fmDrumEngine)::engineBytes() +
+      decltype(Track::samplerEngine)::engineBytes() +
+      decltype(Track::granularEngine)::engineBytes() +
+      decltype(Track::wavetableEngine)::engineBytes() +
+      decltype(Track::analogDrumEngine)::engineBytes() +
+      decltype(Track::audioInEngine)::engineBytes() +
+      decltype(Track::soundFontEngine)::engineBytes();
+
+  std::string report;
+  char line[160];
+  size_t totalBefore = 0, totalAfter = 0;
+  for (int i = 0; i < (int)mTracks.size(); ++i) {
+    const Track &t = mTracks[i];
+    // Track struct (parameter arrays, slots) plus sequencer step storage
+    size_t fixed = sizeof(Track);
+    fixed += t.sequencer.getSteps().capacity() * sizeof(Step);
+    for (const auto &seq : t.drumSequencers)
+      fixed += seq.getSteps().capacity() * sizeof(Step);
+
+    size_t live = 0;
+    int liveCount = 0;
+    auto count = [&](const auto &slot) {
+      if (slot) {
+        live += slot.engineBytes();
+        ++liveCount;
+      }
+    };
+    count(t.subtractiveEngine);
+    count(t.fmEngine);
+    count(t.fmDrumEngine);
+    count(t.samplerEngine);
+    count(t.granularEngine);
+    count(t.wavetableEngine);
+    count(t.analogDrumEngine);
+    count(t.audioInEngine);
+    count(t.soundFontEngine);
+
+    // Before: all nine engines embedded, no slots or replay bookkeeping
+    size_t before = fixed - 9 * sizeof(void *) - sizeof(t.parametersSet) -
+                    2 * sizeof(int) + allEngines;
+    size_t after = fixed + live;
+    totalBefore += before;
+    totalAfter += after;
+    snprintf(line, sizeof(line),
+             "track %d type %d: %zu -> %zu bytes (%d engine%s live)\n", i,
+             t.engineType, before, after, liveCount, liveCount == 1 ? "" : "s");
+    report += line;
+  }
+  snprintf(line, sizeof(line), "total: %zu -> %zu bytes\n", totalBefore,
+           totalAfter);
+  report += line;
+
+  // Before: 192000 frames a side each, allocated up front
+  size_t linesBefore = 4 * 192000 * sizeof(float);
+  size_t linesAfter =
+      2 * (size_t)(mDelayFx.capacity() + mTapeEchoFx.capacity()) *
+      sizeof(FxDelaySample);
+  snprintf(line, sizeof(line), "delay + tape echo lines: %zu -> %zu bytes\n",
+           linesBefore, linesAfter);
+  report += line;
+
+  // Every FX delay line, 16 bit when built with FX_DELAY_16BIT
+  size_t fxLines = mReverbFx.lineBytes() + mDelayFx.lineBytes() +
+                   mChorusFx.lineBytes() + mTapeWobbleFx.lineBytes() +
+                   mFlangerFx.lineBytes() + mTapeEchoFx.lineBytes() +
+                   mOctaverFx.lineBytes();
+  snprintf(line, sizeof(line), "fx delay lines (%d bit): %zu bytes\n",
+           (int)(8 * sizeof(FxDelaySample)), fxLines);
+  report += line;
+  return report;
+}
+
 std::vector<float> AudioEngine::getSamplerWaveform(int trackIndex,
                                                    int numPoints) {
   std::lock_guard<std::recursive_mutex> lock(mLock);
   if (trackIndex >= 0 && trackIndex < mTracks.size()) {
     if (mTracks[trackIndex].engineType == 2)
-      return mTracks[trackIndex].samplerEngine.getAmplitudeWaveform(numPoints);
+      return mTracks[trackIndex].samplerEngine->getAmplitudeWaveform(numPoints);
     else if (mTracks[trackIndex].engineType == 3)
-      return mTracks[trackIndex].granularEngine.getAmplitudeWaveform(numPoints);
+      return mTracks[trackIndex].granularEngine->getAmplitudeWaveform(
+          numPoints);
   }
   return {};
 }
@@ -2442,7 +3000,8 @@ bool AudioEngine::getStepActive(int trackIndex, int stepIndex, int drumIndex) {
 void AudioEngine::resetSampler(int trackIndex) {
   std::lock_guard<std::recursive_mutex> lock(mLock);
   if (trackIndex >= 0 && trackIndex < mTracks.size()) {
-    mTracks[trackIndex].samplerEngine.clearBuffer();
+    if (mTracks[trackIndex].samplerEngine)
+      mTracks[trackIndex].samplerEngine->clearBuffer();
   }
 }
 
@@ -2450,15 +3009,17 @@ std::vector<float> AudioEngine::getSamplerSlicePoints(int trackIndex) {
   std::lock_guard<std::recursive_mutex> lock(mLock);
   if (trackIndex >= 0 && trackIndex < mTracks.size()) {
     if (mTracks[trackIndex].engineType == 2)
-      return mTracks[trackIndex].samplerEngine.getSlicePoints();
+      return mTracks[trackIndex].samplerEngine->getSlicePoints();
   }
   return {};
 }
 
 void AudioEngine::setSoundFontMapping(int trackIndex, int knobIndex,
                                       int paramId) {
-  if (trackIndex >= 0 && trackIndex < 8) {
-    mTracks[trackIndex].soundFontEngine.setMapping(knobIndex, paramId);
+  std::lock_guard<std::recursive_mutex> lock(mLock);
+  if (trackIndex >= 0 && trackIndex < 8 &&
+      mTracks[trackIndex].soundFontEngine) {
+    mTracks[trackIndex].soundFontEngine->setMapping(knobIndex, paramId);
   }
 }
 
@@ -2477,19 +3038,95 @@ void AudioEngine::setMasterVolume(float volume) {
   mMasterVolume = volume * 1.5f; // 50% boost at max
 }
 
+void AudioEngine::setVoiceLimit(int voices) {
+  std::lock_guard<std::recursive_mutex> lock(mLock);
+  mVoiceLimit = std::max(1, voices);
+  enforceVoiceLimit();
+}
+
+void AudioEngine::setTrackVoicePriority(int trackIndex, int priority) {
+  std::lock_guard<std::recursive_mutex> lock(mLock);
+  if (trackIndex >= 0 && trackIndex < (int)mTracks.size())
+    mTracks[trackIndex].voicePriority = std::clamp(priority, 0, 2);
+}
+
+// Calls f with the track's engine if it's one of the 16-voice polyphonic
+// ones. Drums, granular and soundfont manage their own voices.
+template <typename F>
+bool AudioEngine::withPolyEngine(Track &track, F &&f) {
+  switch (track.engineType) {
+  case 0:
+    f(*track.subtractiveEngine);
+    return true;
+  case 1:
+    f(*track.fmEngine);
+    return true;
+  case 2:
+    f(*track.samplerEngine);
+    return true;
+  case 4:
+    f(*track.wavetableEngine);
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Keeps the voices playing across all tracks under mVoiceLimit. Each engine
+// offers its cheapest voice (quiet, released, old); the cheapest of those,
+// after track priority, gets a fast release. Runs after every note-on.
+void AudioEngine::enforceVoiceLimit() {
+  int live = 0;
+  for (auto &track : mTracks)
+    withPolyEngine(track, [&](auto &e) { live += e.liveVoiceCount(); });
+
+  while (live > mVoiceLimit) {
+    Track *victimTrack = nullptr;
+    int victimVoice = -1;
+    float best = 0.0f;
+    for (auto &track : mTracks) {
+      withPolyEngine(track, [&](auto &e) {
+        float score;
+        int voice = e.stealCandidate(score);
+        if (voice < 0)
+          return;
+        score += 2.0f * track.voicePriority; // Outweighs level and age
+        if (!victimTrack || score < best) {
+          victimTrack = &track;
+          victimVoice = voice;
+          best = score;
+        }
+      });
+    }
+    if (!victimTrack)
+      break;
+    withPolyEngine(*victimTrack,
+                   [&](auto &e) { e.stealVoice(victimVoice); });
+    --live;
+  }
+}
+
 void AudioEngine::panic() {
   std::lock_guard<std::recursive_mutex> lock(mLock);
   for (auto &track : mTracks) {
     track.mSilenceFrames = 0;
     // Release all notes in the engine
-    track.subtractiveEngine.allNotesOff();
-    track.fmEngine.allNotesOff();
-    track.fmDrumEngine.allNotesOff();
-    track.analogDrumEngine.allNotesOff();
-    track.wavetableEngine.allNotesOff();
-    track.samplerEngine.allNotesOff();
-    track.granularEngine.allNotesOff();
-    track.soundFontEngine.allNotesOff();
+    if (track.subtractiveEngine)
+      track.subtractiveEngine->allNotesOff();
+    if (track.fmEngine)
+      track.fmEngine->allNotesOff();
+    if (track.fmDrumEngine)
+      track.fmDrumEngine->allNotesOff();
+    if (track.analogDrumEngine)
+      track.analogDrumEngine->allNotesOff();
+    if (track.wavetableEngine)
+      track.wavetableEngine->allNotesOff();
+    if (track.samplerEngine)
+      track.samplerEngine->allNotesOff();
+    if (track.granularEngine)
+      track.granularEngine->allNotesOff();
+    if (track.soundFontEngine)
+      track.soundFontEngine->allNotesOff();
 
     for (int v = 0; v < Track::MAX_POLYPHONY; ++v) {
       track.mActiveNotes[v].active = false;
@@ -2557,12 +3194,55 @@ void AudioEngine::setMacroSource(int macroIndex, int sourceType,
 }
 
 void AudioEngine::setFxChain(int sourceFx, int destFx) {
-  if (sourceFx < 0 || sourceFx >= 17)
+  if (sourceFx < 0 || sourceFx >= FxPlan::kSlots)
+    return;
+  if (destFx < -1 || destFx >= FxPlan::kSlots)
     return;
-  if (destFx < -1 || destFx >= 17)
+  {
+    std::lock_guard<std::recursive_mutex> lock(mLock);
+    mFxChainDest[sourceFx] = destFx;
+    mFxPlan.compile(mFxChainDest);
+    if (mFxPlan.cyclic)
+      LOGD("FX chain loops without reaching the master, muting slots 0x%05x",
+           mFxPlan.cyclic);
+    if (destFx >= 0)
+      mFxMemoryWanted |= 1u << destFx;
+  }
+  reserveDelayMemory();
+}
+
+// The delay and tape echo get their lines the first time anything is sent
+// or chained to them, sized for the stream's rate, and new ones if the rate
+// changes. They're allocated before taking the lock so only the swap holds
+// up the audio thread, and the old ones are freed after. Not from the audio
+// thread.
+void AudioEngine::reserveDelayMemory() {
+  int delayFrames = 0, echoFrames = 0;
+  {
+    std::lock_guard<std::recursive_mutex> lock(mLock);
+    int frames = DelayFx::capacityFor(mSampleRate);
+    if ((mFxMemoryWanted & (1u << 5)) && mDelayFx.capacity() != frames)
+      delayFrames = frames;
+    frames = TapeEchoFx::capacityFor(mSampleRate);
+    if ((mFxMemoryWanted & (1u << 13)) && mTapeEchoFx.capacity() != frames)
+      echoFrames = frames;
+  }
+  if (delayFrames == 0 && echoFrames == 0)
     return;
+
+  DelayLine<> delay[2], echo[2];
+  for (int i = 0; i < 2; ++i) {
+    if (delayFrames)
+      delay[i].setSize(delayFrames);
+    if (echoFrames)
+      echo[i].setSize(echoFrames);
+  }
   std::lock_guard<std::recursive_mutex> lock(mLock);
-  mFxChainDest[sourceFx] = destFx;
+  // Skipped if the rate moved on meanwhile, the next call catches up
+  if (delayFrames && delayFrames == DelayFx::capacityFor(mSampleRate))
+    mDelayFx.swapLines(delay[0], delay[1]);
+  if (echoFrames && echoFrames == TapeEchoFx::capacityFor(mSampleRate))
+    mTapeEchoFx.swapLines(echo[0], echo[1]);
 }
 
 void AudioEngine::setTrackVolume(int trackIndex, float volume) {
@@ -2585,9 +3265,11 @@ void AudioEngine::onErrorAfterClose(oboe::AudioStream *audioStream,
 }
 
 void AudioEngine::setFilterMode(int trackIndex, int mode) {
+  std::lock_guard<std::recursive_mutex> lock(mLock);
   if (trackIndex >= 0 && trackIndex < 8) {
     if (mTracks[trackIndex].engineType == 0) { // Subtractive
-      mTracks[trackIndex].subtractiveEngine.setFilterMode(mode);
+      mTracks[trackIndex].filterMode = mode;
+      mTracks[trackIndex].subtractiveEngine->setFilterMode(mode);
     }
   }
 }
@@ -2601,6 +3283,90 @@ void AudioEngine::setArpTriplet(int trackIndex, bool isTriplet) {
 
 float AudioEngine::getCpuLoad() { return mCpuLoad.load(); }
 
+// CPU load, mic input latency and what the anti-aliased nonlinear stages
+// cost. Costs are per output sample, the share is of the time one sample at
+// this rate gets.
+std::string AudioEngine::getProfileReport() {
+  std::lock_guard<std::recursive_mutex> lock(mLock);
+  std::string report;
+  char line[160];
+  snprintf(line, sizeof(line), "cpu load: %.1f%%\n", mCpuLoad.load() * 100.0f);
+  report += line;
+
+  auto add = [&](const char *name, const char *mode, float latency, float ns) {
+    snprintf(line, sizeof(line),
+             "%s: %s, %.2f samples latency, %.0f ns/sample (%.2f%%)\n", name,
+             mode, latency, ns, ns * mSampleRate * 1e-7f);
+    report += line;
+  };
+  add("overdrive L+R", antiAliasName(mOverdriveFx.antiAlias()),
+      mOverdriveFx.latency(), mOverdriveFx.costNs());
+  char factor[8];
+  snprintf(factor, sizeof(factor), "%dx", mBitcrusherFx.oversampling());
+  add("bitcrusher L+R", factor, mBitcrusherFx.latency(),
+      mBitcrusherFx.costNs());
+
+  if (mConvolutionFx.loaded()) {
+    snprintf(line, sizeof(line),
+             "convolution: %.2f s IR, %u late tail blocks\n",
+             mConvolutionFx.lengthSeconds(mSampleRate),
+             mConvolutionFx.lateBlocks());
+    report += line;
+  }
+
+  report += "fx plan:";
+  for (int k = 0; k < mFxPlan.count; ++k)
+    report += " " + std::to_string(mFxPlan.order[k]);
+  if (mFxPlan.cyclic) {
+    report += ", looping without output:";
+    for (int slot = 0; slot < FxPlan::kSlots; ++slot)
+      if (mFxPlan.isCyclic(slot))
+        report += " " + std::to_string(slot);
+  }
+  report += "\n";
+
+  // Averaged over sleeping blocks too, so an idle slot drifts down to zero
+  for (int k = 0; k < mFxPlan.count; ++k) {
+    int slot = mFxPlan.order[k];
+    float ns = mFxCost[slot].ns();
+    snprintf(line, sizeof(line),
+             "fx %d: %s, %.0f ns/sample (%.2f%%), %d samples tail\n", slot,
+             mFxTail[slot].asleep() ? "asleep" : "awake", ns,
+             ns * mSampleRate * 1e-7f, fxTailSamples(slot, mSampleRate));
+    report += line;
+  }
+
+  InputRing::Stats in = mInputRing.stats();
+  if (mDuplexInput)
+    snprintf(line, sizeof(line), "input: duplex, %u short reads\n",
+             mDuplexInput->shortReads());
+  else
+    snprintf(line, sizeof(line),
+             "input: %.1f ms latency (floor %.1f ms), drift %+.0f ppm, %u "
+             "resyncs, %u underruns\n",
+             in.latency * 1000.0f / mSampleRate,
+             in.floor * 1000.0f / mSampleRate, in.driftPpm, in.resyncs,
+             in.underruns);
+  report += line;
+
+  for (int i = 0; i < (int)mTracks.size(); ++i) {
+    const Track &t = mTracks[i];
+    char name[48];
+    auto addEngine = [&](const char *type, const auto &engine) {
+      snprintf(name, sizeof(name), "track %d %s", i, type);
+      add(name, antiAliasName(engine.antiAlias()),
+          antiAliasLatency(engine.antiAlias()), engine.shaperCostNs());
+    };
+    if (t.engineType == 0 && t.subtractiveEngine)
+      addEngine("subtractive", *t.subtractiveEngine);
+    else if (t.engineType == 1 && t.fmEngine)
+      addEngine("fm voices", *t.fmEngine);
+    else if (t.engineType == 4 && t.wavetableEngine)
+      addEngine("wavetable voices", *t.wavetableEngine);
+  }
+  return report;
+}
+
 void AudioEngine::enqueueMidiEvent(int type, int channel, int data1,
                                    int data2) {
   std::lock_guard<std::mutex> lock(mMidiLock);
@@ -2623,13 +3389,20 @@ void AudioEngine::restorePresets() {
   std::lock_guard<std::recursive_mutex> lock(mLock);
   for (auto &track : mTracks) {
     track.volume = 0.8f;
-    track.subtractiveEngine.resetToDefaults();
-    track.fmEngine.resetToDefaults();
-    track.fmDrumEngine.resetToDefaults();
-    track.analogDrumEngine.resetToDefaults();
-    track.samplerEngine.resetToDefaults();
-    track.granularEngine.resetToDefaults();
-    track.wavetableEngine.resetToDefaults();
+    if (track.subtractiveEngine)
+      track.subtractiveEngine->resetToDefaults();
+    if (track.fmEngine)
+      track.fmEngine->resetToDefaults();
+    if (track.fmDrumEngine)
+      track.fmDrumEngine->resetToDefaults();
+    if (track.analogDrumEngine)
+      track.analogDrumEngine->resetToDefaults();
+    if (track.samplerEngine)
+      track.samplerEngine->resetToDefaults();
+    if (track.granularEngine)
+      track.granularEngine->resetToDefaults();
+    if (track.wavetableEngine)
+      track.wavetableEngine->resetToDefaults();
 
     // CRITICAL: Also clear the parameter buffers so UI and Engine stay in
     // sync We set meaningful defaults so the UI knobs show the correct
@@ -2637,6 +3410,8 @@ void AudioEngine::restorePresets() {
     std::fill(std::begin(track.parameters), std::end(track.parameters), 0.0f);
     std::fill(std::begin(track.appliedParameters),
               std::end(track.appliedParameters), 0.0f);
+    track.parametersSet.reset();
+    track.fmPreset = -1;
 
     // Common EG Defaults
     track.parameters[100] = 0.01f; // Attack
@@ -2692,7 +3467,13 @@ std::vector<Step> AudioEngine::getSequencerSteps(int trackIndex) {
 void AudioEngine::loadFmPreset(int trackIndex, int presetId) {
   std::lock_guard<std::recursive_mutex> lock(mLock);
   if (trackIndex >= 0 && trackIndex < mTracks.size()) {
-    mTracks[trackIndex].fmEngine.loadPreset(presetId);
+    auto &track = mTracks[trackIndex];
+    if (track.fmEngine)
+      track.fmEngine->loadPreset(presetId);
+    // The preset supersedes earlier FM edits, don't replay those over it
+    track.fmPreset = presetId;
+    for (int id = 150; id < 200; ++id)
+      track.parametersSet.reset(id);
   }
 }
 
@@ -2700,8 +3481,57 @@ void AudioEngine::setResampling(bool isResampling) {
   mIsResampling = isResampling;
 }
 
+void AudioEngine::renderTrackBlock(Track &track, int numFrames) {
+  float *L = track.blockL;
+  float *R = track.blockR;
+  switch (track.engineType) {
+  case 0:
+    for (int i = 0; i < numFrames; ++i)
+      L[i] = track.subtractiveEngine->render();
+    break;
+  case 1:
+    track.fmEngine->renderBlock(L, numFrames);
+    break;
+  case 2:
+    for (int i = 0; i < numFrames; ++i)
+      L[i] = track.samplerEngine->render();
+    break;
+  case 3:
+    track.granularEngine->renderBlock(L, R, numFrames);
+    return;
+  case 4:
+    track.wavetableEngine->renderBlock(L, numFrames);
+    break;
+  case 5:
+    track.fmDrumEngine->renderBlock(L, numFrames);
+    break;
+  case 6:
+    for (int i = 0; i < numFrames; ++i)
+      L[i] = track.analogDrumEngine->render();
+    break;
+  case 8: // AUDIO IN
+    for (int i = 0; i < numFrames; ++i)
+      L[i] = track.audioInEngine->render(mInputBlock[i]);
+    break;
+  case 9: // SOUNDFONT
+    track.soundFontEngine->render(L, R, numFrames);
+    return;
+  default:
+    std::fill(L, L + numFrames, 0.0f);
+    break;
+  }
+  // Mono engines
+  std::copy(L, L + numFrames, R);
+}
+
 void AudioEngine::renderStereo(float *outBuffer, int numFrames) {
   // Lock handled by onAudioReady caller
+  if (numFrames > kMaxRenderBlock) {
+    for (int off = 0; off < numFrames; off += kMaxRenderBlock)
+      renderStereo(outBuffer + off * 2,
+                   std::min(kMaxRenderBlock, numFrames - off));
+    return;
+  }
   // Master volume and safety
   if (!std::isfinite(mMasterVolume))
     mMasterVolume = 0.5f;
@@ -2725,30 +3555,32 @@ void AudioEngine::renderStereo(float *outBuffer, int numFrames) {
   applyModulations();
   // ----------------------------------
 
-  for (int i = 0; i < numFrames; ++i) {
+  // Notes and params only change between calls, so every engine can render
+  // its whole block up front. The frame loop below just mixes.
+  // Mic for this block: already in place in duplex mode, otherwise from the
+  // input callback's ring, drift-compensated at the lowest safe latency
+  if (!mDuplexFrames) {
+    mInputRing.setSampleRate(sampleRate);
+    mInputRing.read(mInputBlock, numFrames);
+  }
+  mDuplexFrames = nullptr;
 
-    // Safe ring-buffer read with 2048 samples of latency for stability
-    uint32_t writePos = mInputWritePtr.load();
-    int32_t distance = static_cast<int32_t>(writePos - mInputReadPtr);
-    if (distance < 128 || distance > 8000) {
-      mInputReadPtr = writePos - 2048; // Resync if definitely out of bounds
-    }
-    float inputSample = mInputRingBuffer[mInputReadPtr % 8192];
-    mInputReadPtr++;
+  for (auto &track : mTracks) {
+    if (!track.isActive && track.mSilenceFrames > 2400)
+      continue; // Skipped for the whole block, see frame loop
+    renderTrackBlock(track, numFrames);
+  }
 
+  // Sends accumulate into the FX buses for the whole block, the slots then
+  // run one after the other in plan order (see FxGraph.h)
+  for (int b = 0; b < FxPlan::kSlots; ++b) {
+    std::fill(mFxBusL[b], mFxBusL[b] + numFrames, 0.0f);
+    std::fill(mFxBusR[b], mFxBusR[b] + numFrames, 0.0f);
+  }
+
+  for (int i = 0; i < numFrames; ++i) {
     float mixedSampleL = 0.0f;
     float mixedSampleR = 0.0f;
-    float sidechainSignal = 0.0f;
-    float fxBusesL[17];
-    float fxBusesR[17];
-    for (int b = 0; b < 17; ++b) {
-      // Load feedback from previous sample (Backward Chaining)
-      fxBusesL[b] = mFxFeedbacksL[b];
-      fxBusesR[b] = mFxFeedbacksR[b];
-      // Clear for next accumulation
-      mFxFeedbacksL[b] = 0.0f;
-      mFxFeedbacksR[b] = 0.0f;
-    }
 
     for (int t = 0; t < (int)mTracks.size(); ++t) {
       Track &track = mTracks[t];
@@ -2759,36 +3591,8 @@ void AudioEngine::renderStereo(float *outBuffer, int numFrames) {
         continue;
       }
 
-      float rawSampleL = 0.0f, rawSampleR = 0.0f;
-      switch (track.engineType) {
-      case 0:
-        rawSampleL = rawSampleR = track.subtractiveEngine.render();
-        break;
-      case 1:
-        rawSampleL = rawSampleR = track.fmEngine.render();
-        break;
-      case 2:
-        rawSampleL = rawSampleR = track.samplerEngine.render();
-        break;
-      case 3:
-        track.granularEngine.render(&rawSampleL, &rawSampleR);
-        break;
-      case 4:
-        rawSampleL = rawSampleR = track.wavetableEngine.render();
-        break;
-      case 5:
-        rawSampleL = rawSampleR = track.fmDrumEngine.render();
-        break;
-      case 6:
-        rawSampleL = rawSampleR = track.analogDrumEngine.render();
-        break;
-      case 8: // AUDIO IN
-        rawSampleL = rawSampleR = track.audioInEngine.render(inputSample);
-        break;
-      case 9: // SOUNDFONT
-        track.soundFontEngine.render(&rawSampleL, &rawSampleR, 1);
-        break;
-      }
+      float rawSampleL = track.blockL[i];
+      float rawSampleR = track.blockR[i];
 
       if (!std::isfinite(rawSampleL))
         rawSampleL = 0.0f;
@@ -2864,15 +3668,15 @@ void AudioEngine::renderStereo(float *outBuffer, int numFrames) {
       }
 
       float trackDryKill = 0.0f;
-      for (int f = 0; f < 17; ++f) {
+      for (int f = 0; f < FxPlan::kSlots; ++f) {
         if (track.fxSends[f] > 0.001f || track.smoothedFxSends[f] > 0.001f) {
           track.smoothedFxSends[f] +=
               0.01f * (track.fxSends[f] - track.smoothedFxSends[f]);
 
           // Per-track mix balance
           float wetAmount = track.smoothedFxSends[f] * track.fxMix[f];
-          fxBusesL[f] += preFaderL * wetAmount;
-          fxBusesR[f] += preFaderR * wetAmount;
+          mFxBusL[f][i] += preFaderL * wetAmount;
+          mFxBusR[f][i] += preFaderR * wetAmount;
 
           // Accumulate dry kill for insert-style behavior
           if (wetAmount > trackDryKill)
@@ -2893,188 +3697,214 @@ void AudioEngine::renderStereo(float *outBuffer, int numFrames) {
       track.follower.process(monoSum);
     }
 
-    float currentSampleL = mixedSampleL;
-    float currentSampleR = mixedSampleR;
-    float wetSampleL = 0.0f;
-    float wetSampleR = 0.0f;
-    float spreadL = 0.0f, spreadR = 0.0f;
-
-    auto routeFx = [&](int index, float valL, float valR,
-                       bool isDelta = false) {
-      int dest = mFxChainDest[index];
-      float outL, outR;
-
-      // Calculate Full Wet Output (Recover from Delta if needed)
-      if (isDelta) {
-        outL = (fxBusesL[index] + valL) * mFxMixLevels[index];
-        outR = (fxBusesR[index] + valR) * mFxMixLevels[index];
-      } else {
-        outL = valL * mFxMixLevels[index];
-        outR = valR * mFxMixLevels[index];
-      }
-
-      if (dest >= 0 && dest < 17) {
-        // Serial Chaining
-        // Determine Direction based on Hardcoded Execution Order
-        // IDs: 0, 1, 9, 10, 2, 3, 4, 5, 6, 7, 8, 11, 12, 13, 14
-        const int order[17] = {0, 1, 4,  5,  6,  7,  8,  9, 10,
-                               2, 3, 11, 12, 15, 16, 13, 14};
-        bool isForward = order[dest] > order[index];
-
-        if (isForward) {
-          fxBusesL[dest] += outL; // Pass Full Signal (Unity Gain)
-          fxBusesR[dest] += outR;
-        } else {
-          // Backward Chain -> Use Feedback Buffer for Next Sample
-          mFxFeedbacksL[dest] += outL;
-          mFxFeedbacksR[dest] += outR;
-        }
-      } else {
-        // Main Mix: Add to accumulator
-        wetSampleL += outL;
-        wetSampleR += outR;
-      }
-    };
-
-    // Serial Chain Processing - Skip if bus is idle
-    if (std::abs(fxBusesL[0]) > 0.00001f || std::abs(fxBusesR[0]) > 0.00001f)
-      routeFx(0, mOverdriveFxL.process(fxBusesL[0]),
-              mOverdriveFxR.process(fxBusesR[0]), true); // Delta
-
-    if (std::abs(fxBusesL[1]) > 0.00001f || std::abs(fxBusesR[1]) > 0.00001f)
-      routeFx(1, mBitcrusherFxL.process(fxBusesL[1]),
-              mBitcrusherFxR.process(fxBusesR[1]), true); // Delta
-
-    if (std::abs(fxBusesL[9]) > 0.00001f || std::abs(fxBusesR[9]) > 0.00001f) {
-      float hpL = mHpLfoL.process(fxBusesL[9], sampleRate);
-      mHpLfoR.syncFrom(mHpLfoL);
-      float hpR = mHpLfoR.process(fxBusesR[9], sampleRate);
-      routeFx(9, hpL, hpR);
-    }
-
-    if (std::abs(fxBusesL[10]) > 0.00001f ||
-        std::abs(fxBusesR[10]) > 0.00001f) {
-      float lpL = mLpLfoL.process(fxBusesL[10], sampleRate);
-      mLpLfoR.syncFrom(mLpLfoL); // KILL PHASE SWIRL
-      float lpR = mLpLfoR.process(fxBusesR[10], sampleRate);
-      routeFx(10, lpL, lpR);
-    }
-
-    if (std::abs(fxBusesL[2]) > 0.00001f || std::abs(fxBusesR[2]) > 0.00001f) {
-      routeFx(2, mChorusFxL.process(fxBusesL[2], sampleRate),
-              mChorusFxR.process(fxBusesR[2], sampleRate));
-    }
-
-    if (std::abs(fxBusesL[3]) > 0.00001f || std::abs(fxBusesR[3]) > 0.00001f) {
-      routeFx(3, mPhaserFxL.process(fxBusesL[3], sampleRate),
-              mPhaserFxR.process(fxBusesR[3], sampleRate));
-    }
+    mDryL[i] = mixedSampleL;
+    mDryR[i] = mixedSampleR;
+  }
 
-    if (std::abs(fxBusesL[4]) > 0.00001f || std::abs(fxBusesR[4]) > 0.00001f) {
-      // Use new Stereo Process API
-      float wL = 0, wR = 0;
-      mTapeWobbleFx.processStereo(fxBusesL[4], fxBusesR[4], wL, wR, sampleRate);
-      routeFx(4, wL, wR, true); // Delta
+  std::fill(mWetL, mWetL + numFrames, 0.0f);
+  std::fill(mWetR, mWetR + numFrames, 0.0f);
+  for (int k = 0; k < mFxPlan.count; ++k) {
+    int slot = mFxPlan.order[k];
+    float input = FxTail::meanSquare(mFxBusL[slot], mFxBusR[slot], numFrames);
+    if (mFxTail[slot].sleep(input, fxTailSamples(slot, sampleRate))) {
+      mFxCost[slot].skip();
+      continue;
     }
+    float output = mFxCost[slot].measure(
+        [&] { return processFxSlot(slot, numFrames, sampleRate); }, numFrames);
+    mFxTail[slot].update(input, output, numFrames);
+  }
 
-    if (std::abs(fxBusesL[5]) > 1.0e-12f || std::abs(fxBusesR[5]) > 1.0e-12f ||
-        !mDelayFx.isSilent()) {
-      float dL = 0, dR = 0;
-      mDelayFx.processStereo(fxBusesL[5], fxBusesR[5], dL, dR, sampleRate);
-      int dest = mFxChainDest[5];
-      if (dest >= 0 && dest < 17) {
-        fxBusesL[dest] += dL * mFxMixLevels[5];
-        fxBusesR[dest] += dR * mFxMixLevels[5];
-      } else {
-        spreadL += dL;
-        spreadR += dR;
-      }
-    }
+  for (int i = 0; i < numFrames; ++i) {
+    float finalL = (mDryL[i] + mWetL[i]) * mMasterVolume;
+    float finalR = (mDryR[i] + mWetR[i]) * mMasterVolume;
 
-    if (std::abs(fxBusesL[6]) > 1.0e-12f || std::abs(fxBusesR[6]) > 1.0e-12f ||
-        !mReverbFx.isSilent()) { // Use isSilent gate
-      float rL = 0, rR = 0;
-      mReverbFx.processStereoWet(fxBusesL[6], fxBusesR[6], rL, rR);
-      int dest = mFxChainDest[6];
-      if (dest >= 0 && dest < 17) {
-        fxBusesL[dest] += rL * mFxMixLevels[6];
-        fxBusesR[dest] += rR * mFxMixLevels[6];
-      } else {
-        spreadL += rL;
-        spreadR += rR;
-      }
-    }
+    if (!std::isfinite(finalL))
+      finalL = 0.0f;
+    if (!std::isfinite(finalR))
+      finalR = 0.0f;
 
-    if (std::abs(fxBusesL[7]) > 0.00001f || std::abs(fxBusesR[7]) > 0.00001f) {
-      routeFx(
-          7, mSlicerFxL.process(fxBusesL[7], mSampleCount + i, mSamplesPerStep),
-          mSlicerFxR.process(fxBusesR[7], mSampleCount + i, mSamplesPerStep),
-          true); // Delta
-    }
+    outBuffer[i * 2] = softLimit(finalL);
+    outBuffer[i * 2 + 1] = softLimit(finalR);
+  }
+}
 
-    if (std::abs(fxBusesL[8]) > 0.00001f || std::abs(fxBusesR[8]) > 0.00001f) {
-      routeFx(8, mCompressorFx.process(fxBusesL[8], sidechainSignal),
-              mCompressorFx.process(fxBusesR[8], sidechainSignal));
-    }
+// How long a slot has to stay quiet in and out before it can sleep, see
+// FxTail
+int AudioEngine::fxTailSamples(int slot, float sampleRate) const {
+  switch (slot) {
+  case 0:
+    return mOverdriveFx.tailSamples(sampleRate);
+  case 1:
+    return mBitcrusherFx.tailSamples(sampleRate);
+  case 2:
+    return mChorusFx.tailSamples(sampleRate);
+  case 3:
+    return mPhaserFx.tailSamples(sampleRate);
+  case 4:
+    return mTapeWobbleFx.tailSamples(sampleRate);
+  case 5:
+    return mDelayFx.tailSamples(sampleRate);
+  case 6:
+    return mReverbFx.tailSamples(sampleRate);
+  case 7:
+    return mSlicerFx.tailSamples(sampleRate);
+  case 8:
+    return mCompressorFx.tailSamples(sampleRate);
+  case 9:
+    return mHpLfoL.tailSamples(sampleRate);
+  case 10:
+    return mLpLfoL.tailSamples(sampleRate);
+  case 11:
+    return mFlangerFx.tailSamples(sampleRate);
+  case 12:
+    return mFilterPedal[0].tailSamples(sampleRate);
+  case 13:
+    return mTapeEchoFx.tailSamples(sampleRate);
+  case 14:
+    return mOctaverFx.tailSamples(sampleRate);
+  case 15:
+  case 16:
+    return mFilterPedal[slot - 14].tailSamples(sampleRate);
+  case 17:
+    return mConvolutionFx.tailSamples(sampleRate);
+  default:
+    return 0;
+  }
+}
 
-    if (std::abs(fxBusesL[11]) > 0.00001f ||
-        std::abs(fxBusesR[11]) > 0.00001f) {
-      float fL, fR;
-      fL = mFlangerFxL.process(fxBusesL[11], sampleRate);
-      fR = mFlangerFxR.process(fxBusesR[11], sampleRate);
-      routeFx(11, fL, fR);
-    }
+// Runs one slot over the block and hands its wet signal, at the slot's mix
+// level, to the slot it's chained to or to the master. The plan guarantees
+// the destination hasn't run yet. Returns the mean square of what it handed
+// on, before the level.
+float AudioEngine::processFxSlot(int slot, int numFrames, float sampleRate) {
+  float *inL = mFxBusL[slot];
+  float *inR = mFxBusR[slot];
+  float *outL = mFxOutL;
+  float *outR = mFxOutR;
+  bool isDelta = false;      // Module returned wet - input
+  bool fullToMaster = false; // Delay and reverb skip the mix level on master
 
-    // Filter 1 (Slot 12)
-    if (std::abs(fxBusesL[12]) > 0.00001f ||
-        std::abs(fxBusesR[12]) > 0.00001f) {
-      float sL = mFilterPedalL[0].process(fxBusesL[12], sampleRate);
-      float sR = mFilterPedalR[0].process(fxBusesR[12], sampleRate);
-      routeFx(12, sL, sR, false); // Wet
+  // The block FX work in place on a copy of the bus, the input is still
+  // needed for the delta outputs
+  auto copyIn = [&](float dc = 0.0f) {
+    for (int i = 0; i < numFrames; ++i) {
+      outL[i] = inL[i] + dc;
+      outR[i] = inR[i] + dc;
     }
+  };
 
-    // Filter 2 (Slot 15)
-    if (std::abs(fxBusesL[15]) > 0.00001f ||
-        std::abs(fxBusesR[15]) > 0.00001f) {
-      float sL = mFilterPedalL[1].process(fxBusesL[15], sampleRate);
-      float sR = mFilterPedalR[1].process(fxBusesR[15], sampleRate);
-      routeFx(15, sL, sR, false); // Wet
+  switch (slot) {
+  case 0:
+    copyIn();
+    mOverdriveFx.processBlock(outL, outR, numFrames);
+    isDelta = true;
+    break;
+  case 1:
+    copyIn();
+    mBitcrusherFx.processBlock(outL, outR, numFrames);
+    isDelta = true;
+    break;
+  case 2:
+    copyIn();
+    mChorusFx.processBlock(outL, outR, numFrames, sampleRate);
+    break;
+  case 3:
+    copyIn();
+    mPhaserFx.processBlock(outL, outR, numFrames, sampleRate);
+    break;
+  case 4:
+    for (int i = 0; i < numFrames; ++i)
+      mTapeWobbleFx.processStereo(inL[i], inR[i], outL[i], outR[i],
+                                  sampleRate);
+    isDelta = true;
+    break;
+  case 5:
+    for (int i = 0; i < numFrames; ++i)
+      mDelayFx.processStereo(inL[i], inR[i], outL[i], outR[i], sampleRate);
+    fullToMaster = true;
+    break;
+  case 6:
+    mReverbFx.processBlockWet(inL, inR, outL, outR, numFrames);
+    fullToMaster = true;
+    break;
+  case 7:
+    copyIn();
+    mSlicerFx.processBlock(outL, outR, numFrames, mSampleCount,
+                           mSamplesPerStep);
+    isDelta = true;
+    break;
+  case 8:
+    // No sidechain source is wired up yet
+    copyIn();
+    mCompressorFx.processBlock(outL, outR, numFrames);
+    break;
+  case 9:
+    for (int i = 0; i < numFrames; ++i) {
+      outL[i] = mHpLfoL.process(inL[i], sampleRate);
+      mHpLfoR.syncFrom(mHpLfoL);
+      outR[i] = mHpLfoR.process(inR[i], sampleRate);
     }
-
-    // Filter 3 (Slot 16)
-    if (std::abs(fxBusesL[16]) > 0.00001f ||
-        std::abs(fxBusesR[16]) > 0.00001f) {
-      float sL = mFilterPedalL[2].process(fxBusesL[16], sampleRate);
-      float sR = mFilterPedalR[2].process(fxBusesR[16], sampleRate);
-      routeFx(16, sL, sR, false); // Wet
+    break;
+  case 10:
+    for (int i = 0; i < numFrames; ++i) {
+      outL[i] = mLpLfoL.process(inL[i], sampleRate);
+      mLpLfoR.syncFrom(mLpLfoL); // KILL PHASE SWIRL
+      outR[i] = mLpLfoR.process(inR[i], sampleRate);
     }
+    break;
+  case 11:
+    copyIn();
+    mFlangerFx.processBlock(outL, outR, numFrames, sampleRate);
+    break;
+  case 12: // Filter 1
+  case 15: // Filter 2
+  case 16: // Filter 3
+  {
+    int pedal = slot == 12 ? 0 : slot - 14;
+    copyIn();
+    mFilterPedal[pedal].processBlock(outL, outR, numFrames, sampleRate);
+    break;
+  }
+  case 13:
+    // Anti-Denormal DC Offset for Echo Loop
+    copyIn(1.0e-18f);
+    mTapeEchoFx.processBlock(outL, outR, numFrames, sampleRate);
+    break;
+  case 14:
+    copyIn();
+    mOctaverFx.processBlock(outL, outR, numFrames, sampleRate);
+    break;
+  case 17:
+    copyIn();
+    mConvolutionFx.processBlock(outL, outR, numFrames);
+    fullToMaster = true;
+    break;
+  default:
+    return 0.0f;
+  }
 
-    if (std::abs(fxBusesL[13]) > 0.00001f ||
-        std::abs(fxBusesR[13]) > 0.00001f || !mTapeEchoFxL.isSilent() ||
-        !mTapeEchoFxR.isSilent()) {
-      // Anti-Denormal DC Offset for Echo Loop
-      float dc = 1.0e-18f;
-      routeFx(13, mTapeEchoFxL.process(fxBusesL[13] + dc, sampleRate),
-              mTapeEchoFxR.process(fxBusesR[13] + dc, sampleRate));
+  int dest = mFxChainDest[slot];
+  float *toL = dest >= 0 ? mFxBusL[dest] : mWetL;
+  float *toR = dest >= 0 ? mFxBusR[dest] : mWetR;
+  // Serial chains pass the full signal on at unity, plus the slot's level
+  float level = (fullToMaster && dest < 0) ? 1.0f : mFxMixLevels[slot];
+  float energy = 0.0f;
+  if (isDelta) {
+    for (int i = 0; i < numFrames; ++i) {
+      float l = inL[i] + outL[i], r = inR[i] + outR[i];
+      toL[i] += l * level;
+      toR[i] += r * level;
+      energy += l * l + r * r;
     }
-
-    if (std::abs(fxBusesL[14]) > 0.00001f ||
-        std::abs(fxBusesR[14]) > 0.00001f) {
-      routeFx(14, mOctaverFxL.process(fxBusesL[14], sampleRate),
-              mOctaverFxR.process(fxBusesR[14], sampleRate));
+  } else {
+    for (int i = 0; i < numFrames; ++i) {
+      toL[i] += outL[i] * level;
+      toR[i] += outR[i] * level;
+      energy += outL[i] * outL[i] + outR[i] * outR[i];
     }
-
-    float finalL = (mixedSampleL + wetSampleL + spreadL) * mMasterVolume;
-    float finalR = (mixedSampleR + wetSampleR + spreadR) * mMasterVolume;
-
-    if (!std::isfinite(finalL))
-      finalL = 0.0f;
-    if (!std::isfinite(finalR))
-      finalR = 0.0f;
-
-    outBuffer[i * 2] = softLimit(finalL);
-    outBuffer[i * 2 + 1] = softLimit(finalR);
   }
+  return energy / (float)(2 * numFrames);
 }
 
 // Reset Punch Active flags for all tracks after processing the block
@@ -3133,13 +3963,13 @@ void AudioEngine::renderToWav(int numCycles, const std::string &path) {
     mSampleCount += chunk;
   }
 
-  WavFileUtils::writeWav(path, output, 48000, 2, {});
+  WavFileUtils::writeWav(path, output, (int)mSampleRate, 2, {});
 }
 
 void AudioEngine::loadWavetable(int trackIndex, const std::string &path) {
   if (trackIndex >= 0 && trackIndex < mTracks.size()) {
     if (mTracks[trackIndex].engineType == 4) { // Wavetable Engine
-      mTracks[trackIndex].wavetableEngine.loadWavetable(path);
+      mTracks[trackIndex].wavetableEngine->loadWavetable(path);
     }
   }
 }
@@ -3147,7 +3977,7 @@ void AudioEngine::loadWavetable(int trackIndex, const std::string &path) {
 void AudioEngine::loadDefaultWavetable(int trackIndex) {
   if (trackIndex >= 0 && trackIndex < (int)mTracks.size()) {
     if (mTracks[trackIndex].engineType == 4) {
-      mTracks[trackIndex].wavetableEngine.loadDefaultWavetable();
+      mTracks[trackIndex].wavetableEngine->loadDefaultWavetable();
     }
   }
 }
@@ -3165,73 +3995,85 @@ void AudioEngine::getStepActiveStates(int trackIndex, bool *out, int maxSize) {
   }
 }
 void AudioEngine::setInputDevice(int deviceId) {
-  std::lock_guard<std::recursive_mutex> lock(mLock);
-
-  if (mInputStream) {
-    mInputStream->stop();
-    mInputStream->close();
-    mInputStream.reset();
-  }
-
-  oboe::AudioStreamBuilder inBuilder;
-  inBuilder.setDirection(oboe::Direction::Input)
-      ->setFormat(oboe::AudioFormat::Float)
-      ->setChannelCount(oboe::ChannelCount::Mono)
-      ->setPerformanceMode(oboe::PerformanceMode::LowLatency)
-      ->setSharingMode(oboe::SharingMode::Exclusive)
-      ->setInputPreset(oboe::InputPreset::Camcorder)
-      ->setCallback(this);
-
-  if (mStream) {
-    inBuilder.setSampleRate(mStream->getSampleRate());
-  } else if (mSampleRate > 0) {
-    inBuilder.setSampleRate(mSampleRate);
+  std::lock_guard<std::mutex> streams(mInputStreamMutex);
+  closeInputStream();
+  mInputDeviceId = deviceId;
+  openInputStream(oboe::ChannelCount::Mono, mDuplexMode);
+}
+// Opening the bank and copying out an instance can take a while, so that
+// happens before taking the lock, and the replaced one is closed after it.
+// Only the swap holds up the audio thread.
+void AudioEngine::loadSoundFont(int trackIndex, const std::string &path) {
+  if (trackIndex < 0 || trackIndex >= (int)mTracks.size())
+    return;
+  SoundFontEngine::Loaded loaded =
+      SoundFontEngine::open(path, (float)mSampleRate);
+  // Loading is allowed before switching the track over
+  ensureEngine(trackIndex, 9);
+  {
+    std::lock_guard<std::recursive_mutex> lock(mLock);
+    if (mTracks[trackIndex].soundFontEngine)
+      loaded = mTracks[trackIndex].soundFontEngine->install(std::move(loaded));
   }
+  SoundFontEngine::release(loaded);
+}
 
-  if (deviceId > 0) {
-    inBuilder.setDeviceId(deviceId);
-  }
+// Decoding and transforming the IR can take a while, so that happens before
+// taking the lock. Only the swap holds up the audio thread.
+void AudioEngine::loadImpulseResponse(const std::string &path) {
+  std::vector<float> data, slices;
+  int sampleRate, channels;
+  if (!WavFileUtils::loadWav(path, data, sampleRate, channels, slices) ||
+      channels < 1)
+    return;
+  data = Resampler::convert(data, sampleRate, mSampleRate, channels);
+
+  // First two channels, a mono IR is used for both sides
+  size_t frames = data.size() / channels;
+  std::vector<float> left(frames), right;
+  for (size_t f = 0; f < frames; ++f)
+    left[f] = data[f * channels];
+  if (channels > 1) {
+    right.resize(frames);
+    for (size_t f = 0; f < frames; ++f)
+      right[f] = data[f * channels + 1];
+  }
+  auto conv = ConvolutionReverbFx::build(std::move(left), std::move(right));
+  if (!conv)
+    return;
 
-  oboe::Result result = inBuilder.openStream(mInputStream);
-  if (result != oboe::Result::OK) {
-    LOGD("CRITICAL: Error re-opening input stream with device %d: %s", deviceId,
-         oboe::convertToText(result));
-  } else {
-    result = mInputStream->requestStart();
-    if (result != oboe::Result::OK) {
-      LOGD("CRITICAL: Error starting re-opened input stream: %s",
-           oboe::convertToText(result));
-    } else {
-      LOGD("SUCCESS: Re-opened input stream on device %d at %d Hz", deviceId,
-           mInputStream->getSampleRate());
-    }
-  }
-}
-void AudioEngine::loadSoundFont(int trackIndex, const std::string &path) {
-  if (trackIndex >= 0 && trackIndex < (int)mTracks.size()) {
+  std::unique_ptr<ConvolutionReverbFx::Convolver> old;
+  {
     std::lock_guard<std::recursive_mutex> lock(mLock);
-    mTracks[trackIndex].soundFontEngine.load(path);
+    old = mConvolutionFx.setConvolver(std::move(conv));
   }
+  // Joins the old IR's worker, now that the audio thread can run again
+  old.reset();
 }
 
 void AudioEngine::setSoundFontPreset(int trackIndex, int presetIndex) {
   if (trackIndex >= 0 && trackIndex < (int)mTracks.size()) {
     std::lock_guard<std::recursive_mutex> lock(mLock);
-    mTracks[trackIndex].soundFontEngine.setPreset(presetIndex);
+    if (mTracks[trackIndex].soundFontEngine)
+      mTracks[trackIndex].soundFontEngine->setPreset(presetIndex);
   }
 }
 
 int AudioEngine::getSoundFontPresetCount(int trackIndex) {
-  if (trackIndex >= 0 && trackIndex < (int)mTracks.size()) {
-    return mTracks[trackIndex].soundFontEngine.getPresetCount();
+  std::lock_guard<std::recursive_mutex> lock(mLock);
+  if (trackIndex >= 0 && trackIndex < (int)mTracks.size() &&
+      mTracks[trackIndex].soundFontEngine) {
+    return mTracks[trackIndex].soundFontEngine->getPresetCount();
   }
   return 0;
 }
 
 std::string AudioEngine::getSoundFontPresetName(int trackIndex,
                                                 int presetIndex) {
-  if (trackIndex >= 0 && trackIndex < (int)mTracks.size()) {
-    return mTracks[trackIndex].soundFontEngine.getPresetName(presetIndex);
+  std::lock_guard<std::recursive_mutex> lock(mLock);
+  if (trackIndex >= 0 && trackIndex < (int)mTracks.size() &&
+      mTracks[trackIndex].soundFontEngine) {
+    return mTracks[trackIndex].soundFontEngine->getPresetName(presetIndex);
   }
   return "";
 }
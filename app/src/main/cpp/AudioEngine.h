@@ -1,13 +1,20 @@
 #ifndef AUDIO_ENGINE_H
 #define AUDIO_ENGINE_H
 
+#include <bitset>
 #include <memory>
 #include <mutex>
 #include <oboe/Oboe.h>
+#include <string>
 #include <vector>
 
 #include "Arpeggiator.h"
+#include "AudioBackend.h"
 #include "EnvelopeFollower.h"
+#include "FxGraph.h"
+#include "FxTail.h"
+#include "InputRing.h"
+#include "Oversampler.h"
 #include "RoutingMatrix.h"
 #include "Sequencer.h"
 #include "engines/AnalogDrumEngine.h"
@@ -16,7 +23,9 @@
 #include "engines/BitcrusherFx.h"
 #include "engines/ChorusFx.h"
 #include "engines/CompressorFx.h"
+#include "engines/ConvolutionReverbFx.h"
 #include "engines/DelayFx.h"
+#include "engines/EngineSlot.h"
 #include "engines/FilterLfoFx.h"
 #include "engines/FlangerFx.h"
 #include "engines/FmDrumEngine.h"
@@ -112,17 +121,21 @@ public:
   void normalizeSample(int trackIndex);
   void resetSampler(int trackIndex);
   void loadSample(int trackIndex, const std::string &path);
+  void setCompactStorage(int trackIndex, bool compact);
   void loadWavetable(int trackIndex, const std::string &path);
   void loadDefaultWavetable(int trackIndex);
   void saveSample(int trackIndex, const std::string &path); // New
   void trimSample(int trackIndex);
   void loadSoundFont(int trackIndex, const std::string &path);
+  void loadImpulseResponse(const std::string &path);
   void setSoundFontPreset(int trackIndex, int presetIndex);
   void setSoundFontMapping(int trackIndex, int knobIndex, int paramId);
   int getSoundFontPresetCount(int trackIndex);
   std::string getSoundFontPresetName(int trackIndex, int presetIndex);
   void clearSequencer(int trackIndex);
   void setMasterVolume(float volume);
+  void setVoiceLimit(int voices);
+  void setTrackVoicePriority(int trackIndex, int priority);
   bool getStepActive(int trackIndex, int stepIndex, int drumIndex = -1);
   void getStepActiveStates(int trackIndex, bool *out, int maxSize);
   std::vector<Step> getSequencerSteps(int trackIndex);
@@ -138,7 +151,12 @@ public:
   void setArpTriplet(int trackIndex, bool isTriplet);
   void setArpRate(int trackIndex, float rate, int divisionMode);
   float getCpuLoad();
+  std::string getFootprintReport();
+  std::string getProfileReport();
   void setInputDevice(int deviceId);
+  void setDuplexMode(bool enabled);
+  void setDuplexInput(std::unique_ptr<DuplexInput> input);
+  void renderOutput(float *output, int numFrames, int numChannels);
   void setTrackActive(int trackIndex, bool active);
   void setTrackPan(int trackIndex, float pan);
 
@@ -189,27 +207,56 @@ private:
 
   std::atomic<float> mCpuLoad{0.0f};
   std::shared_ptr<oboe::AudioStream> mStream;
+  // The input stream and its settings. Opening a stream takes tens of ms,
+  // so they're guarded by a mutex of their own. The audio thread only sees
+  // mDuplexInput, under mLock.
+  std::mutex mInputStreamMutex;
   std::shared_ptr<oboe::AudioStream> mInputStream;
+  int mInputDeviceId = 0;
+  bool mDuplexMode = false;
+  std::unique_ptr<DuplexInput> mDuplexInput;
+  // Set while renderStereo should take mInputBlock as is (duplex)
+  const float *mDuplexFrames = nullptr;
+  // With mInputStreamMutex held
+  void openInputStream(int channelCount, bool duplex);
+  void closeInputStream();
+  void captureInput(const float *input, int numFrames, int channels);
+
+  static const int kMaxRenderBlock = 256; // Engines render in blocks of this
+
+  // A track's engines and what their parameters dispatch on. Only
+  // instantiated while in use. The slot for engineType is always filled
+  // (see ensureEngine); the others may be empty, so anything that isn't
+  // dispatched on engineType has to check first. New engines are built in
+  // a set of their own, off the lock, and swapped in.
+  struct TrackEngines {
+    int engineType = 0; // 0=Subtractive, 1=FM, 2=Sampler, etc.
+    int selectedFmDrumInstrument = 0;
+    EngineSlot<SubtractiveEngine> subtractiveEngine;
+    EngineSlot<FmEngine> fmEngine;
+    EngineSlot<FmDrumEngine> fmDrumEngine;
+    EngineSlot<SamplerEngine> samplerEngine;
+    EngineSlot<GranularEngine> granularEngine;
+    EngineSlot<WavetableEngine> wavetableEngine;
+    EngineSlot<AnalogDrumEngine> analogDrumEngine;
+    EngineSlot<AudioInEngine> audioInEngine;
+    EngineSlot<SoundFontEngine> soundFontEngine;
+  };
 
-  struct Track {
+  struct Track : TrackEngines {
     float volume = 0.8f;
     float smoothedVolume = 0.8f;
     float pan = 0.5f;
     float smoothedPan = 0.5f;
-    int engineType = 0; // 0=Subtractive, 1=FM, 2=Sampler, etc.
-    int selectedFmDrumInstrument = 0;
-    SubtractiveEngine subtractiveEngine;
-    FmEngine fmEngine;
-    FmDrumEngine fmDrumEngine;
-    SamplerEngine samplerEngine;
-    GranularEngine granularEngine;
-    WavetableEngine wavetableEngine;
-    AnalogDrumEngine analogDrumEngine;
-    AudioInEngine audioInEngine;
-    SoundFontEngine soundFontEngine;
+    int voicePriority = 1; // 0 low .. 2 high, for the global voice budget
+    int fmPreset = -1;   // Last loadFmPreset, replayed into a new FM engine
+    int filterMode = 0;  // Subtractive filter mode (setFilterMode)
+    bool compactStorage = false; // 16 bit samples, see setCompactStorage
 
     float parameters[2500] = {0.0f};
     float appliedParameters[2500] = {0.0f}; // Values after P-locks and Mods
+    // Which parameters were set explicitly, replayed into new engines
+    std::bitset<2500> parametersSet;
 
     struct RecordingNote {
       int note;
@@ -224,9 +271,9 @@ private:
     Sequencer drumSequencers[16];
     Arpeggiator arpeggiator;
     EnvelopeFollower follower;
-    float fxSends[17] = {0.0f}; // Increased to 17 for separate Filter pedals
-    float smoothedFxSends[17] = {0.0f};
-    float fxMix[17] = {0.0f};
+    float fxSends[FxPlan::kSlots] = {0.0f};
+    float smoothedFxSends[FxPlan::kSlots] = {0.0f};
+    float fxMix[FxPlan::kSlots] = {0.0f};
 
     bool isActive = false;
     float currentFrequency = 440.0f;
@@ -274,7 +321,38 @@ private:
                                       -1, -1, -1, -1, -1, -1, -1, -1};
     std::string lastSamplePath = "";
     int mSilenceFrames = 0;
+
+    // Engine output for the current render block
+    float blockL[kMaxRenderBlock] = {0.0f};
+    float blockR[kMaxRenderBlock] = {0.0f};
+  };
+
+  // Lazy engines. ensureEngine and prepareEngine take mLock themselves and
+  // only briefly, the rest need it held.
+  struct EngineSeed {
+    float sampleRate = 48000.0f;
+    int filterMode = 0;
+    int fmPreset = -1;
+    bool compactStorage = false;
+    float parameters[700] = {0.0f};
+    std::bitset<700> set;
   };
+  void ensureEngine(int trackIndex, int type);
+  bool prepareEngine(int trackIndex, int type, TrackEngines &built,
+                     EngineSeed &seed);
+  void installEngine(int trackIndex, int type, TrackEngines &built,
+                     const EngineSeed &seed);
+  static void applyEngineDefaults(TrackEngines &engines, int type);
+  static void applyEngineParameter(TrackEngines &engines, int parameterId,
+                                   float value);
+  static void swapEngine(TrackEngines &a, TrackEngines &b, int type);
+  static bool hasEngine(const TrackEngines &engines, int type);
+  static bool isReplayedId(int parameterId);
+  bool engineHoldsContent(int trackIndex, int type);
+
+  // Global polyphony (call with mLock held)
+  template <typename F> static bool withPolyEngine(Track &track, F &&f);
+  void enforceVoiceLimit();
 
   std::vector<Track> mTracks;
   RoutingMatrix mRoutingMatrix;
@@ -299,25 +377,26 @@ private:
   void releaseNoteLocked(int trackIndex, int note,
                          bool isSequencerTrigger = false);
   void setupTracks();
+  void renderTrackBlock(Track &track, int numFrames);
 
   // Global Effects
   GalacticReverb mReverbFx;
   DelayFx mDelayFx;
-  SlicerFx mSlicerFxL, mSlicerFxR;
+  SlicerFx mSlicerFx;
   CompressorFx mCompressorFx;
   FilterLfoFx mFilterLfoFx{FilterLfoMode::LowPass};
 
-  // New Effects (Mono per channel)
-  ChorusFx mChorusFxL, mChorusFxR;
-  PhaserFx mPhaserFxL, mPhaserFxR;
-  OverdriveFx mOverdriveFxL, mOverdriveFxR;
-  BitcrusherFx mBitcrusherFxL, mBitcrusherFxR;
+  // New Effects (Stereo, processed a block at a time)
+  ChorusFx mChorusFx;
+  PhaserFx mPhaserFx;
+  OverdriveFx mOverdriveFx;
+  BitcrusherFx mBitcrusherFx;
   TapeWobbleFx mTapeWobbleFx; // Stereo Linked!
-  FlangerFx mFlangerFxL, mFlangerFxR;
-  SimpleFilterFx mFilterPedalL[3]; // 3 Stereo Pairs of Filters
-  SimpleFilterFx mFilterPedalR[3];
-  TapeEchoFx mTapeEchoFxL, mTapeEchoFxR;
-  OctaverFx mOctaverFxL, mOctaverFxR;
+  FlangerFx mFlangerFx;
+  SimpleFilterFx mFilterPedal[3];
+  TapeEchoFx mTapeEchoFx;
+  OctaverFx mOctaverFx;
+  ConvolutionReverbFx mConvolutionFx; // Slot 17
 
   // Generic LFOs for Routing
   LfoEngine mLfos[6];
@@ -337,10 +416,24 @@ public:
 
   // FX Chaining (Soft Routing)
   // Maps SourceFX Index -> DestinationFX Index. -1 means Master Mix.
-  int mFxChainDest[17];
-  // Feedback buffers for backward-chaining effects (1-sample latency)
-  float mFxFeedbacksL[17] = {0.0f};
-  float mFxFeedbacksR[17] = {0.0f};
+  int mFxChainDest[FxPlan::kSlots];
+  // Run order compiled from mFxChainDest by setFxChain
+  FxPlan mFxPlan;
+  // Per block: what reaches each slot (sends plus upstream slots), one
+  // slot's output, and the dry and wet halves of the master
+  float mFxBusL[FxPlan::kSlots][kMaxRenderBlock];
+  float mFxBusR[FxPlan::kSlots][kMaxRenderBlock];
+  float mFxOutL[kMaxRenderBlock], mFxOutR[kMaxRenderBlock];
+  float mDryL[kMaxRenderBlock], mDryR[kMaxRenderBlock];
+  float mWetL[kMaxRenderBlock], mWetR[kMaxRenderBlock];
+  // Which slots are asleep and what each costs, sleeping blocks count as free
+  FxTail mFxTail[FxPlan::kSlots];
+  CostMeter mFxCost[FxPlan::kSlots];
+  int fxTailSamples(int slot, float sampleRate) const;
+  float processFxSlot(int slot, int numFrames, float sampleRate);
+  // Bit per slot that has had something sent or chained to it
+  uint32_t mFxMemoryWanted = 0;
+  void reserveDelayMemory();
 
   // FX Split Filter LFO Effects (Slots 9/10)
   FilterLfoFx mHpLfoL{FilterLfoMode::HighPass};
@@ -351,12 +444,10 @@ public:
   int mSidechainSourceTrack = -1;
   int mSidechainSourceDrumIdx = -1;
   float mMasterVolume = 0.8f;
-  float mFxMixLevels[17] = {1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f,
-                            1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f,
-                            1.0f, 1.0f, 1.0f, 1.0f, 1.0f}; // Default to 1.0
-  float mInputRingBuffer[8192] = {0.0f};
-  std::atomic<uint32_t> mInputWritePtr{0};
-  uint32_t mInputReadPtr = 0;
+  int mVoiceLimit = 48; // Across all tracks
+  float mFxMixLevels[FxPlan::kSlots]; // 1.0 from the constructor
+  InputRing mInputRing;
+  float mInputBlock[kMaxRenderBlock] = {0.0f};
   std::atomic<int> mGlobalVoiceCount{0};
   std::string mAppDataDir = "";
 };
@@ -0,0 +1,212 @@
+#ifndef DELAY_LINE_H
+#define DELAY_LINE_H
+
+#include "Utils.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+// Storage that starts on a cache line, so a line's first frames don't share
+// one with whatever was allocated before it
+template <typename T> struct CacheAligned {
+  static constexpr std::size_t kAlign = 64;
+  using value_type = T;
+
+  CacheAligned() = default;
+  template <typename U> CacheAligned(const CacheAligned<U> &) {}
+
+  T *allocate(std::size_t n) {
+    return static_cast<T *>(
+        ::operator new(n * sizeof(T), std::align_val_t(kAlign)));
+  }
+  void deallocate(T *p, std::size_t) {
+    ::operator delete(p, std::align_val_t(kAlign));
+  }
+
+  template <typename U> bool operator==(const CacheAligned<U> &) const {
+    return true;
+  }
+  template <typename U> bool operator!=(const CacheAligned<U> &) const {
+    return false;
+  }
+};
+
+// How a line stores its samples. Float as is, or 16 bit fixed point: half
+// the memory and bandwidth for a noise floor near -88dB. It keeps 6dB of
+// headroom, the reverb tank clamps at the same point, and clips past it.
+// The conversions are plain loops in the block calls, so they vectorize
+// like any other.
+template <typename Sample> struct DelayStorage {
+  static float load(Sample s) { return s; }
+  static Sample store(float x) { return x; }
+};
+
+template <> struct DelayStorage<int16_t> {
+  static constexpr float kRange = 2.0f;
+  static float load(int16_t s) { return (float)s * (kRange / 32767.0f); }
+  // Rounds toward zero rather than to nearest. In a feedback loop that
+  // lets a decaying tail reach zero, rounding to nearest can leave it
+  // cycling a few steps above it for good.
+  static int16_t store(float x) {
+    x = std::max(-32767.0f, std::min(32767.0f, x * (32767.0f / kRange)));
+    return (int16_t)x;
+  }
+};
+
+// What the FX lines are built with. FX_DELAY_16BIT trades the float lines
+// for 16 bit ones, for devices short on cache and memory bandwidth.
+#if defined(FX_DELAY_16BIT)
+using FxDelaySample = int16_t;
+#else
+using FxDelaySample = float;
+#endif
+
+// Circular buffer behind every FX delay, comb and allpass. The size is
+// rounded up to a power of two so positions wrap with a mask, never a
+// modulo or a loop.
+//
+// Delays count back from the most recent write: read(0) is the sample just
+// written, read(d) the one d writes before it. A line of size() frames
+// holds delays up to size() - 1. FX that read before writing want one less
+// than the distance to the sample they're about to write.
+//
+// Sample is the storage type, the interface is float either way.
+template <typename Sample = FxDelaySample> class DelayLine {
+  using Storage = DelayStorage<Sample>;
+
+public:
+  // Not from the audio thread
+  void setSize(int frames) {
+    mBuffer.assign(nextPowerOfTwo(std::max(frames, 1)), Sample());
+    mMask = (int)mBuffer.size() - 1;
+    mWritePos = 0;
+  }
+  int size() const { return (int)mBuffer.size(); }
+  bool empty() const { return mBuffer.empty(); }
+  std::size_t bytes() const { return mBuffer.size() * sizeof(Sample); }
+
+  void clear() {
+    std::fill(mBuffer.begin(), mBuffer.end(), Sample());
+    mWritePos = 0;
+  }
+
+  // Trades storage with another line, for lines sized off the audio thread
+  void swap(DelayLine &other) {
+    mBuffer.swap(other.mBuffer);
+    std::swap(mMask, other.mMask);
+    std::swap(mWritePos, other.mWritePos);
+  }
+
+  void write(float x) {
+    mBuffer[mWritePos] = Storage::store(x);
+    mWritePos = (mWritePos + 1) & mMask;
+  }
+
+  float read(int delay) const {
+    return Storage::load(mBuffer[(mWritePos - 1 - delay) & mMask]);
+  }
+
+  // Fractional delays. Linear is cheapest, cubic is the 4 point Hermite and
+  // needs delay >= 1. Allpass has flat magnitude, good inside feedback
+  // loops, but keeps a state per tap and wants slowly moving delays.
+  float readLinear(float delay) const {
+    int d = (int)delay;
+    float frac = delay - (float)d;
+    int p = (mWritePos - 1 - d) & mMask;
+    float a = Storage::load(mBuffer[p]);
+    float b = Storage::load(mBuffer[(p - 1) & mMask]);
+    return a + (b - a) * frac;
+  }
+
+  float readCubic(float delay) const {
+    int d = (int)delay;
+    float frac = delay - (float)d;
+    int p = (mWritePos - 1 - d) & mMask;
+    float newer = Storage::load(mBuffer[(p + 1) & mMask]);
+    float y0 = Storage::load(mBuffer[p]);
+    float y1 = Storage::load(mBuffer[(p - 1) & mMask]);
+    float older = Storage::load(mBuffer[(p - 2) & mMask]);
+    // Hermite runs older to newer, the fraction back from y0
+    return cubicInterpolation(older, y1, y0, newer, 1.0f - frac);
+  }
+
+  float readAllpass(float delay, float &state) const {
+    int d = (int)delay;
+    float frac = delay - (float)d;
+    int p = (mWritePos - 1 - d) & mMask;
+    float coeff = (1.0f - frac) / (1.0f + frac);
+    float older = Storage::load(mBuffer[(p - 1) & mMask]);
+    float y = coeff * (older - state) + Storage::load(mBuffer[p]);
+    state = y;
+    return y;
+  }
+
+  // --- Blocks ---
+
+  void writeBlock(const float *in, int n) {
+    int first = std::min(n, size() - mWritePos);
+    Sample *b = mBuffer.data() + mWritePos;
+    for (int i = 0; i < first; ++i)
+      b[i] = Storage::store(in[i]);
+    b = mBuffer.data() - first;
+    for (int i = first; i < n; ++i)
+      b[i] = Storage::store(in[i]);
+    mWritePos = (mWritePos + n) & mMask;
+  }
+
+  // What read(delay) returns just before each of the next n writes. Only
+  // reaches back to samples already written while n <= delay + 1.
+  void readNext(float *out, int n, int delay) const {
+    copyFrom(mWritePos - 1 - delay, out, n);
+  }
+
+  // What read(delay) returned right after each of the last n writes
+  void readLast(float *out, int n, int delay) const {
+    copyFrom(mWritePos - n - delay, out, n);
+  }
+
+  // acc += gain * readLast(delay)
+  void addLast(float *acc, int n, int delay, float gain) const {
+    int p = (mWritePos - n - delay) & mMask;
+    int first = std::min(n, size() - p);
+    const Sample *b = mBuffer.data() + p;
+    for (int i = 0; i < first; ++i)
+      acc[i] += gain * Storage::load(b[i]);
+    b = mBuffer.data() - first;
+    for (int i = first; i < n; ++i)
+      acc[i] += gain * Storage::load(b[i]);
+  }
+
+  // readLinear() right after each of the last n writes, a delay per sample
+  void readLinearLast(float *out, const float *delays, int n) const {
+    const int pos = mWritePos - n;
+    for (int i = 0; i < n; ++i) {
+      int d = (int)delays[i];
+      float frac = delays[i] - (float)d;
+      int p = (pos + i - d) & mMask;
+      float a = Storage::load(mBuffer[p]);
+      float b = Storage::load(mBuffer[(p - 1) & mMask]);
+      out[i] = a + (b - a) * frac;
+    }
+  }
+
+private:
+  void copyFrom(int start, float *out, int n) const {
+    int p = start & mMask;
+    int first = std::min(n, size() - p);
+    const Sample *b = mBuffer.data() + p;
+    for (int i = 0; i < first; ++i)
+      out[i] = Storage::load(b[i]);
+    b = mBuffer.data() - first;
+    for (int i = first; i < n; ++i)
+      out[i] = Storage::load(b[i]);
+  }
+
+  std::vector<Sample, CacheAligned<Sample>> mBuffer;
+  int mMask = 0;
+  int mWritePos = 0;
+};
+
+#endif // DELAY_LINE_H
@@ -0,0 +1,192 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <vector>
+
+// Minimal in-place radix-2 FFT. Size must be a power of two.
+// transform() is used off the audio thread (table generation), so it favours
+// clarity. RealPlan is the one for the audio path.
+namespace FFT {
+
+inline bool isPowerOfTwo(size_t n) { return n && !(n & (n - 1)); }
+
+// Forward uses e^{-i}, inverse e^{+i}. Inverse is unscaled (caller divides).
+inline void transform(std::vector<std::complex<float>> &data, bool inverse) {
+  const size_t n = data.size();
+  if (!isPowerOfTwo(n))
+    return;
+
+  // Bit reversal
+  for (size_t i = 1, j = 0; i < n; ++i) {
+    size_t bit = n >> 1;
+    for (; j & bit; bit >>= 1)
+      j ^= bit;
+    j ^= bit;
+    if (i < j)
+      std::swap(data[i], data[j]);
+  }
+
+  for (size_t len = 2; len <= n; len <<= 1) {
+    double ang = 2.0 * M_PI / len * (inverse ? 1.0 : -1.0);
+    std::complex<double> wl(std::cos(ang), std::sin(ang));
+    for (size_t i = 0; i < n; i += len) {
+      std::complex<double> w(1.0, 0.0);
+      for (size_t k = 0; k < len / 2; ++k) {
+        std::complex<float> wf((float)w.real(), (float)w.imag());
+        std::complex<float> u = data[i + k];
+        std::complex<float> v = data[i + k + len / 2] * wf;
+        data[i + k] = u + v;
+        data[i + k + len / 2] = u - v;
+        w *= wl;
+      }
+    }
+  }
+}
+
+// Real FFT with its tables built up front, so transforms don't allocate or
+// call cos/sin. N real samples go through an N/2 point complex FFT (even
+// samples as the real parts, odd ones as the imaginary) plus an unpacking
+// pass, giving bins 0..N/2.
+//
+// Spectra are split into real and imaginary arrays. Every butterfly stage is
+// a flat loop over contiguous floats with the twiddles stored per stage, so
+// the compiler vectorizes them (4 wide on NEON/SSE) once a stage's span
+// reaches 4. Not thread safe: each thread needs its own plan.
+class RealPlan {
+public:
+  RealPlan() = default;
+  explicit RealPlan(int n) { init(n); }
+
+  void init(int n) {
+    if (n < 4 || !isPowerOfTwo(n))
+      n = 4;
+    mN = n;
+    mHalf = n / 2;
+    mRe.assign(mHalf, 0.0f);
+    mIm.assign(mHalf, 0.0f);
+
+    mRev.assign(mHalf, 0);
+    for (int i = 1, j = 0; i < mHalf; ++i) {
+      int bit = mHalf >> 1;
+      for (; j & bit; bit >>= 1)
+        j ^= bit;
+      j ^= bit;
+      mRev[i] = j;
+    }
+
+    // Stage with span s uses entries s - 1 .. 2s - 2
+    mTwRe.assign(std::max(1, mHalf - 1), 1.0f);
+    mTwIm.assign(std::max(1, mHalf - 1), 0.0f);
+    for (int span = 1; span < mHalf; span <<= 1)
+      for (int k = 0; k < span; ++k) {
+        double ang = -M_PI * k / span;
+        mTwRe[span - 1 + k] = (float)std::cos(ang);
+        mTwIm[span - 1 + k] = (float)std::sin(ang);
+      }
+
+    // Unpacking twiddles e^{-2 pi i k / N}
+    mUnRe.assign(mHalf + 1, 0.0f);
+    mUnIm.assign(mHalf + 1, 0.0f);
+    for (int k = 0; k <= mHalf; ++k) {
+      double ang = -2.0 * M_PI * k / n;
+      mUnRe[k] = (float)std::cos(ang);
+      mUnIm[k] = (float)std::sin(ang);
+    }
+  }
+
+  int size() const { return mN; }
+  int bins() const { return mHalf + 1; }
+
+  // in: size() samples. re, im: bins() each.
+  void forward(const float *in, float *re, float *im) {
+    float *zr = mRe.data(), *zi = mIm.data();
+    for (int m = 0; m < mHalf; ++m) {
+      zr[mRev[m]] = in[2 * m];
+      zi[mRev[m]] = in[2 * m + 1];
+    }
+    butterflies(zr, zi);
+
+    re[0] = zr[0] + zi[0];
+    im[0] = 0.0f;
+    re[mHalf] = zr[0] - zi[0];
+    im[mHalf] = 0.0f;
+    for (int k = 1; k < mHalf; ++k) {
+      // Even and odd halves from Z[k] and conj(Z[N/2 - k])
+      float ar = zr[k], ai = zi[k];
+      float cr = zr[mHalf - k], ci = zi[mHalf - k];
+      float er = 0.5f * (ar + cr), ei = 0.5f * (ai - ci);
+      float orr = 0.5f * (ai + ci), oi = -0.5f * (ar - cr);
+      re[k] = er + mUnRe[k] * orr - mUnIm[k] * oi;
+      im[k] = ei + mUnRe[k] * oi + mUnIm[k] * orr;
+    }
+  }
+
+  // Unscaled like transform(): out comes back multiplied by size()
+  void inverse(const float *re, const float *im, float *out) {
+    float *zr = mRe.data(), *zi = mIm.data();
+    for (int k = 0; k < mHalf; ++k) {
+      float ar = re[k], ai = im[k];
+      float cr = re[mHalf - k], ci = im[mHalf - k];
+      float er = ar + cr, ei = ai - ci;
+      // (X[k] - conj(X[N/2 - k])) * conj(w), w the unpacking twiddle
+      float dr = ar - cr, di = ai + ci;
+      float orr = dr * mUnRe[k] + di * mUnIm[k];
+      float oi = di * mUnRe[k] - dr * mUnIm[k];
+      // Z = E + iO, conjugated so the forward butterflies do the inverse
+      int r = mRev[k];
+      zr[r] = er - oi;
+      zi[r] = -(ei + orr);
+    }
+    butterflies(zr, zi);
+    for (int m = 0; m < mHalf; ++m) {
+      out[2 * m] = zr[m];
+      out[2 * m + 1] = -zi[m];
+    }
+  }
+
+private:
+  // In-place complex FFT on bit reversed input
+  void butterflies(float *re, float *im) const {
+    // Span 1 has no twiddle
+    for (int i = 0; i < mHalf; i += 2) {
+      float tr = re[i + 1], ti = im[i + 1];
+      re[i + 1] = re[i] - tr;
+      im[i + 1] = im[i] - ti;
+      re[i] += tr;
+      im[i] += ti;
+    }
+    for (int span = 2; span < mHalf; span <<= 1)
+      for (int i = 0; i < mHalf; i += 2 * span)
+        butterfly(re + i, im + i, re + i + span, im + i + span,
+                  &mTwRe[span - 1], &mTwIm[span - 1], span);
+  }
+
+  // The two halves never overlap. Saying so keeps the compiler from giving
+  // up on the loop over the number of alias checks it would need.
+  static void butterfly(float *__restrict ar, float *__restrict ai,
+                        float *__restrict br, float *__restrict bi,
+                        const float *wr, const float *wi, int span) {
+    for (int k = 0; k < span; ++k) {
+      float tr = br[k] * wr[k] - bi[k] * wi[k];
+      float ti = br[k] * wi[k] + bi[k] * wr[k];
+      br[k] = ar[k] - tr;
+      bi[k] = ai[k] - ti;
+      ar[k] += tr;
+      ai[k] += ti;
+    }
+  }
+
+  int mN = 0;
+  int mHalf = 0;
+  std::vector<int> mRev;
+  std::vector<float> mRe, mIm;     // Scratch, N/2 complex
+  std::vector<float> mTwRe, mTwIm; // Per stage
+  std::vector<float> mUnRe, mUnIm; // Real unpacking
+};
+
+} // namespace FFT
+
+#endif // FFT_H
@@ -0,0 +1,59 @@
+#ifndef FX_GRAPH_H
+#define FX_GRAPH_H
+
+#include <cstdint>
+
+// Execution plan for the FX section. Every slot sends its output to one
+// other slot or to the master, so the routing is a graph with one edge out
+// of each slot. compile() orders the slots so each one runs before the slot
+// it feeds, which lets a whole block go through the slots one after the
+// other with no feedback buffers in between.
+//
+// With a single destination per slot a cycle has no way out to the master.
+// Slots caught in one, or feeding into one, are flagged and left out of the
+// order instead of looping through a delay nobody hears.
+struct FxPlan {
+  static const int kSlots = 18;
+
+  int order[kSlots];
+  int count = 0;
+  uint32_t cyclic = 0; // Bit per slot that can't reach the master
+
+  bool isCyclic(int slot) const { return (cyclic >> slot) & 1u; }
+
+  void compile(const int (&dest)[kSlots]) {
+    // Hops from each slot to the master. Any walk longer than the number of
+    // slots has to be going round a cycle.
+    int depth[kSlots];
+    cyclic = 0;
+    for (int s = 0; s < kSlots; ++s) {
+      int hops = 0;
+      for (int at = s; at >= 0 && at < kSlots && hops <= kSlots; ++hops)
+        at = dest[at];
+      depth[s] = hops;
+      if (hops > kSlots)
+        cyclic |= 1u << s;
+    }
+
+    // Furthest from the master first. Equal depths keep the order the
+    // slots always ran in, so unchained setups sound exactly as before.
+    count = 0;
+    for (int k = 0; k < kSlots; ++k) {
+      int slot = kDefaultOrder[k];
+      if (isCyclic(slot))
+        continue;
+      int pos = count++;
+      while (pos > 0 && depth[order[pos - 1]] < depth[slot]) {
+        order[pos] = order[pos - 1];
+        --pos;
+      }
+      order[pos] = slot;
+    }
+  }
+
+private:
+  static constexpr int kDefaultOrder[kSlots] = {
+      0, 1, 9, 10, 2, 3, 4, 5, 6, 7, 8, 11, 12, 15, 16, 13, 14, 17};
+};
+
+#endif // FX_GRAPH_H
@@ -0,0 +1,45 @@
+#ifndef FX_TAIL_H
+#define FX_TAIL_H
+
+#include <algorithm>
+
+// Sleep state of one FX slot. A slot wakes on input and stays awake until
+// its input and its output have both been under the floor for the FX's
+// tail: the longest its output can stay quiet while something is still in
+// it, a delay line's length say. Anything longer and whatever's left inside
+// is under the floor too. Asleep, the slot is skipped for whole blocks.
+//
+// Loudness is the block's mean square over both sides, so one odd sample
+// can't keep a slot up and a quiet tail isn't cut on a zero crossing.
+class FxTail {
+public:
+  static constexpr float kFloor = 1.0e-12f; // -120 dB
+
+  static float meanSquare(const float *left, const float *right, int n) {
+    float sum = 0.0f;
+    for (int i = 0; i < n; ++i)
+      sum += left[i] * left[i] + right[i] * right[i];
+    return n > 0 ? sum / (float)(2 * n) : 0.0f;
+  }
+
+  // Before each block, with the input's mean square. True to skip it.
+  bool sleep(float input, int tail) {
+    mAsleep = !(input > kFloor) && mQuiet >= tail;
+    return mAsleep;
+  }
+  bool asleep() const { return mAsleep; }
+
+  // After a block that ran
+  void update(float input, float output, int n) {
+    bool loud = input > kFloor || output > kFloor;
+    mQuiet = loud ? 0 : std::min(mQuiet + n, kQuietCap);
+  }
+
+private:
+  static const int kQuietCap = 1 << 30;
+
+  int mQuiet = kQuietCap;
+  bool mAsleep = true;
+};
+
+#endif // FX_TAIL_H
@@ -0,0 +1,201 @@
+#ifndef INPUT_RING_H
+#define INPUT_RING_H
+
+#include "Utils.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+
+// Carries the mic from the input stream's callback to the output stream's.
+// The two streams run on separate clocks, so the reader can't just keep a
+// fixed distance behind the writer: the gap creeps until it has to jump.
+// Instead the reader steps through the ring at a rate a little off 1.0
+// (cubic interpolation between samples) and a PI loop steers that rate.
+// What it steers is the lowest fill seen per half second window, held just
+// above what one output block needs, so the latency settles at whatever
+// the callback jitter actually requires. The integral term ends up at the
+// clock ratio itself.
+//
+// One writer thread, one reader thread. Stats are written by the reader and
+// read relaxed from anywhere.
+class InputRing {
+public:
+  static const int kSize = 8192; // Power of two
+  static const int kMask = kSize - 1;
+
+  struct Stats {
+    float latency = 0.0f; // Average fill over the last window, samples
+    float floor = 0.0f;   // Lowest fill the loop aims for, samples
+    float driftPpm = 0.0f;
+    uint32_t resyncs = 0;
+    uint32_t underruns = 0;
+  };
+
+  void setSampleRate(float sr) { mSampleRate = sr; }
+
+  // Input callback
+  void write(const float *in, int n) {
+    uint32_t w = mWritePos.load(std::memory_order_relaxed);
+    for (int i = 0; i < n; ++i)
+      mRing[(w + i) & kMask] = in[i];
+    mInBlock.store(n, std::memory_order_relaxed);
+    mWritePos.store(w + n, std::memory_order_release);
+  }
+
+  // Output callback. Always fills n samples, with silence while the input
+  // hasn't delivered enough.
+  void read(float *out, int n) {
+    const uint32_t w = mWritePos.load(std::memory_order_acquire);
+    float fill = (float)(int32_t)(w - mReadPos) - mFrac;
+    const float floor = n * (1.0f + kMaxDrift) + kGuard + mSafety;
+
+    if (mSynced && (fill < floor - mSafety || fill > kSize - kMaxBlock)) {
+      if (fill < floor - mSafety) {
+        mUnderruns.fetch_add(1, std::memory_order_relaxed);
+        mSafety = std::min(kMaxSafety, mSafety + 0.5f * n);
+      }
+      mResyncs.fetch_add(1, std::memory_order_relaxed);
+      mSynced = false;
+      fadeOut(out, n, fill);
+      return;
+    }
+    if (!mSynced) {
+      // Wait for one input block beyond the floor, then jump in behind the
+      // writer and fade up so the jump doesn't click. The loop takes it
+      // from there.
+      float start =
+          floor + (float)std::max(n, mInBlock.load(std::memory_order_relaxed));
+      if (fill < start) {
+        std::fill(out, out + n, 0.0f);
+        return;
+      }
+      mReadPos = w - (uint32_t)start;
+      mFrac = 0.0f;
+      fill = (float)(uint32_t)start;
+      mFade = 0.0f;
+      resetWindow();
+      mSynced = true;
+    }
+
+    mWinMin = std::min(mWinMin, fill);
+    mWinSum += fill;
+    ++mWinReads;
+    mWinSamples += n;
+    if (mWinSamples >= (int)(mSampleRate * kWindow))
+      steer(floor);
+
+    // Fractional read, cubic between the two samples around the position
+    const float step = mRatio;
+    float last = mLast;
+    for (int i = 0; i < n; ++i) {
+      uint32_t p = mReadPos;
+      float y = cubicInterpolation(mRing[(p - 1) & kMask], mRing[p & kMask],
+                                   mRing[(p + 1) & kMask],
+                                   mRing[(p + 2) & kMask], mFrac);
+      last = y;
+      if (mFade < 1.0f) {
+        mFade = std::min(1.0f, mFade + kFadeStep);
+        y *= mFade;
+      }
+      out[i] = y;
+      mFrac += step;
+      int whole = (int)mFrac;
+      mReadPos += whole;
+      mFrac -= (float)whole;
+    }
+    mLast = last;
+  }
+
+  Stats stats() const {
+    Stats s;
+    s.latency = mLatency.load(std::memory_order_relaxed);
+    s.floor = mFloor.load(std::memory_order_relaxed);
+    s.driftPpm = mDriftPpm.load(std::memory_order_relaxed);
+    s.resyncs = mResyncs.load(std::memory_order_relaxed);
+    s.underruns = mUnderruns.load(std::memory_order_relaxed);
+    return s;
+  }
+
+private:
+  static const int kMaxBlock = 1024;     // Largest callback either side
+  static constexpr float kGuard = 3.0f;  // Interpolator lookahead + slack
+  static constexpr float kWindow = 0.5f; // Seconds per loop update
+  static constexpr float kMaxDrift = 0.002f; // 2000 ppm, far past any crystal
+  static constexpr float kMaxSafety = 1024.0f;
+  static constexpr float kFadeStep = 1.0f / 256.0f;
+
+  // Losing sync ramps down instead of cutting to silence. The ramp is the
+  // fade in's, steeper only if the block is too short for it. It plays what
+  // the ring still has, then holds the last sample.
+  void fadeOut(float *out, int n, float fill) {
+    int avail = std::min(n, std::max(0, (int)((fill - kGuard) / mRatio)));
+    const float step = std::max(kFadeStep, mFade / (float)std::max(n, 1));
+    float y = mLast;
+    for (int i = 0; i < n; ++i) {
+      if (i < avail) {
+        uint32_t p = mReadPos;
+        y = cubicInterpolation(mRing[(p - 1) & kMask], mRing[p & kMask],
+                               mRing[(p + 1) & kMask], mRing[(p + 2) & kMask],
+                               mFrac);
+        mFrac += mRatio;
+        int whole = (int)mFrac;
+        mReadPos += whole;
+        mFrac -= (float)whole;
+      }
+      mFade = std::max(0.0f, mFade - step);
+      out[i] = y * mFade;
+    }
+    mFade = 0.0f;
+  }
+
+  void resetWindow() {
+    mWinMin = 1e9f;
+    mWinSum = 0.0f;
+    mWinReads = 0;
+    mWinSamples = 0;
+  }
+
+  // Once per window. The window minimum moves in input-block steps as the
+  // two callbacks slide past each other, so being above the floor is only
+  // worked off gently. Dipping below it is corrected within a couple of
+  // windows. The integral settles on the clock ratio.
+  void steer(float floor) {
+    float err = (mWinMin - floor) / mSampleRate;
+    if (err > 0.0f)
+      err *= 0.1f;
+    mIntegral = std::clamp(mIntegral + err * kWindow * 0.25f, -kMaxDrift,
+                           kMaxDrift);
+    mRatio = 1.0f + std::clamp(mIntegral + err, -kMaxDrift, kMaxDrift);
+
+    mLatency.store(mWinSum / mWinReads, std::memory_order_relaxed);
+    mFloor.store(floor, std::memory_order_relaxed);
+    mDriftPpm.store(mIntegral * 1e6f, std::memory_order_relaxed);
+    resetWindow();
+  }
+
+  float mRing[kSize] = {0.0f};
+  std::atomic<uint32_t> mWritePos{0};
+  std::atomic<int> mInBlock{0};
+
+  // Reader side
+  uint32_t mReadPos = 0;
+  float mFrac = 0.0f;
+  float mRatio = 1.0f;
+  float mIntegral = 0.0f;
+  float mSafety = 32.0f; // Headroom over one block, grows on underruns
+  float mWinMin = 1e9f, mWinSum = 0.0f;
+  int mWinReads = 0, mWinSamples = 0;
+  float mFade = 1.0f;
+  float mLast = 0.0f; // Last sample read, before the fade
+  float mSampleRate = 48000.0f;
+  bool mSynced = false;
+
+  std::atomic<float> mLatency{0.0f};
+  std::atomic<float> mFloor{0.0f};
+  std::atomic<float> mDriftPpm{0.0f};
+  std::atomic<uint32_t> mResyncs{0};
+  std::atomic<uint32_t> mUnderruns{0};
+};
+
+#endif // INPUT_RING_H
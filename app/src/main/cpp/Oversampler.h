@@ -0,0 +1,218 @@
+#ifndef OVERSAMPLER_H
+#define OVERSAMPLER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define OVERSAMPLER_NEON 1
+#elif defined(__SSE__) || defined(__x86_64__)
+#include <xmmintrin.h>
+#define OVERSAMPLER_SSE 1
+#endif
+
+// Runs a waveshaper at 2x or 4x the engine rate so the harmonics it creates
+// above Nyquist are filtered out instead of folding back as aliasing.
+// Modules keep one per channel (or voice) and wrap only their nonlinear part:
+//
+//   y = mOversampler.process(x, [](float s) { return fast_tanh(s); });
+//
+// Factor 1 calls the shaper directly, so the wrapper can stay in place when
+// oversampling is off. Up and down use linear-phase halfband FIRs in
+// polyphase form: half the taps of a halfband are zero and the centre tap is
+// 0.5, so each doubled sample costs one short dot product or a plain copy.
+namespace oversampling {
+
+// Halfband with K nonzero taps per side (4K - 1 taps in all). Kernel holds
+// them doubled for the upsampler, in window order (oldest sample first).
+template <int K> struct Halfband {
+  static_assert(K % 2 == 0, "2K taps have to split into float4s");
+  float g[2 * K];
+  explicit constexpr Halfband(const float (&c)[K]) : g{} {
+    for (int j = 0; j < K; ++j)
+      g[K + j] = g[K - 1 - j] = 2.0f * c[j];
+  }
+};
+
+// Kaiser windowed, beta 8: flat to 0.4 of the base rate, -80 dB by 0.66
+inline constexpr float kStage1Taps[10] = {
+    0.315014613f,   -0.0965987519f, 0.0489196187f,   -0.0269019725f,
+    0.0145461964f,  -0.00734679713f, 0.00331062906f, -0.00124788709f,
+    0.000343532826f, -3.9181334e-05f};
+// 2x -> 4x only has to clear the images of an already band limited signal,
+// beta 7: -70 dB above 0.82 of the 2x rate
+inline constexpr float kStage2Taps[4] = {0.297802339f, -0.0569304365f,
+                                         0.00939776838f, -0.000269671192f};
+
+template <int N> static inline float dot(const float *a, const float *b) {
+#if defined(OVERSAMPLER_NEON)
+  float32x4_t acc = vmulq_f32(vld1q_f32(a), vld1q_f32(b));
+  for (int i = 4; i < N; i += 4)
+    acc = vmlaq_f32(acc, vld1q_f32(a + i), vld1q_f32(b + i));
+  float32x2_t s = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+  return vget_lane_f32(vpadd_f32(s, s), 0);
+#elif defined(OVERSAMPLER_SSE)
+  __m128 acc = _mm_mul_ps(_mm_loadu_ps(a), _mm_loadu_ps(b));
+  for (int i = 4; i < N; i += 4)
+    acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+  float tmp[4];
+  _mm_storeu_ps(tmp, acc);
+  return (tmp[0] + tmp[1]) + (tmp[2] + tmp[3]);
+#else
+  float acc = 0.0f;
+  for (int i = 0; i < N; ++i)
+    acc += a[i] * b[i];
+  return acc;
+#endif
+}
+
+// Writes x twice into a ring of 2N so the last N samples are always one
+// contiguous window. Returns that window, oldest first.
+template <int N>
+static inline const float *push(float (&ring)[2 * N], int &pos, float x) {
+  ring[pos] = ring[pos + N] = x;
+  if (++pos == N)
+    pos = 0;
+  return ring + pos;
+}
+
+// One 2x step: up() turns a sample into two at the doubled rate, down()
+// turns two back into one. Each direction keeps its own history.
+template <int K, const float (&Taps)[K]> class HalfbandStage {
+public:
+  // Round trip delay in samples at the lower rate
+  static constexpr float kLatency = 2.0f * K - 1.5f;
+
+  void reset() { *this = HalfbandStage(); }
+
+  void up(float x, float *out) {
+    const float *w = push<2 * K>(mUp, mUpPos, x);
+    out[0] = dot<2 * K>(w, kKernel.g);
+    out[1] = w[K]; // Centre tap, the other phase is a pure delay
+  }
+
+  float down(float even, float odd) {
+    const float *e = push<K>(mEven, mEvenPos, even);
+    const float *o = push<2 * K>(mOdd, mOddPos, odd);
+    return 0.5f * (dot<2 * K>(o, kKernel.g) + e[0]);
+  }
+
+private:
+  static constexpr Halfband<K> kKernel{Taps};
+
+  float mUp[4 * K] = {0};
+  float mOdd[4 * K] = {0};
+  float mEven[2 * K] = {0};
+  int mUpPos = 0, mOddPos = 0, mEvenPos = 0;
+};
+
+} // namespace oversampling
+
+class Oversampler {
+public:
+  // 1, 2 or 4, anything else rounds down. A change clears the history.
+  void setFactor(int factor) {
+    int f = factor >= 4 ? 4 : (factor >= 2 ? 2 : 1);
+    if (f == mFactor)
+      return;
+    mFactor = f;
+    reset();
+  }
+  int factor() const { return mFactor; }
+
+  void reset() {
+    mStage1.reset();
+    mStage2.reset();
+  }
+
+  // Delay the filters add at the given factor, in base rate samples
+  static float latencyFor(int factor) {
+    if (factor >= 4)
+      return Stage1::kLatency + 0.5f * Stage2::kLatency;
+    return factor >= 2 ? Stage1::kLatency : 0.0f;
+  }
+  float latency() const { return latencyFor(mFactor); }
+
+  template <typename Shaper> float process(float x, Shaper &&shaper) {
+    if (mFactor == 1)
+      return shaper(x);
+    float a[2];
+    mStage1.up(x, a);
+    if (mFactor == 2)
+      return mStage1.down(shaper(a[0]), shaper(a[1]));
+    float b[4];
+    mStage2.up(a[0], b);
+    mStage2.up(a[1], b + 2);
+    for (int k = 0; k < 4; ++k)
+      b[k] = shaper(b[k]);
+    a[0] = mStage2.down(b[0], b[1]);
+    a[1] = mStage2.down(b[2], b[3]);
+    return mStage1.down(a[0], a[1]);
+  }
+
+  template <typename Shaper>
+  void processBlock(float *buf, int n, Shaper &&shaper) {
+    for (int i = 0; i < n; ++i)
+      buf[i] = process(buf[i], shaper);
+  }
+
+private:
+  using Stage1 =
+      oversampling::HalfbandStage<10, oversampling::kStage1Taps>;
+  using Stage2 = oversampling::HalfbandStage<4, oversampling::kStage2Taps>;
+
+  Stage1 mStage1;
+  Stage2 mStage2;
+  int mFactor = 1;
+};
+
+// Average cost of a call in ns for the profile report. One call in 256 is
+// timed, enough to follow changes without touching the clock per sample.
+// Calls covering a block pass its length and the cost comes out per frame.
+class CostMeter {
+public:
+  float ns() const { return mNs; }
+
+  template <typename F> float measure(F &&f, int frames = 1) {
+    if ((++mCalls & 255) != 0)
+      return f();
+    auto t0 = Clock::now();
+    float y = f();
+    float ns = elapsedNs(t0) - clockOverheadNs();
+    mNs += 0.1f * (std::max(0.0f, ns) / (float)frames - mNs);
+    return y;
+  }
+
+  // A call that was skipped, counts as free
+  void skip() {
+    if ((++mCalls & 255) == 0)
+      mNs -= 0.1f * mNs;
+  }
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  static float elapsedNs(Clock::time_point t0) {
+    return (float)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               Clock::now() - t0)
+        .count();
+  }
+
+  // Two back to back clock reads, taken off each timed call
+  static float clockOverheadNs() {
+    static const float overhead = [] {
+      float best = 1e9f;
+      for (int i = 0; i < 16; ++i)
+        best = std::min(best, elapsedNs(Clock::now()));
+      return best;
+    }();
+    return overhead;
+  }
+
+  uint32_t mCalls = 0;
+  float mNs = 0.0f;
+};
+
+#endif // OVERSAMPLER_H
@@ -0,0 +1,170 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define RESAMPLER_NEON 1
+#elif defined(__SSE__) || defined(__x86_64__)
+#include <xmmintrin.h>
+#define RESAMPLER_SSE 1
+#endif
+
+// Offline windowed-sinc polyphase resampler.
+// Meant for load/export time, not the audio callback: samples get converted to
+// the engine rate once so voices never have to correct the pitch ratio.
+class Resampler {
+public:
+  static const int kTaps = 32;    // Per phase, multiple of 4 for the SIMD dot
+  static const int kPhases = 256; // Sub-sample positions (linear between them)
+
+  Resampler() = default;
+  Resampler(double sourceRate, double targetRate) {
+    setRates(sourceRate, targetRate);
+  }
+
+  // Rebuilds the filter bank. Cutoff drops below Nyquist of the slower rate
+  // so downsampling doesn't alias.
+  void setRates(double sourceRate, double targetRate) {
+    if (sourceRate <= 0.0 || targetRate <= 0.0)
+      sourceRate = targetRate = 48000.0;
+    mRatio = sourceRate / targetRate;
+    double cutoff = 0.95 * std::min(1.0, targetRate / sourceRate);
+    buildTable(cutoff);
+  }
+
+  double getRatio() const { return mRatio; }
+
+  // Mono in, mono out. Output length is size / ratio.
+  std::vector<float> process(const std::vector<float> &in) const {
+    if (in.empty())
+      return {};
+    if (std::abs(mRatio - 1.0) < 1e-9)
+      return in;
+
+    const int half = kTaps / 2;
+    // Zero-padded copy so the kernel never has to bounds check
+    std::vector<float> padded(in.size() + kTaps + 1, 0.0f);
+    std::copy(in.begin(), in.end(), padded.begin() + half);
+
+    size_t outSize = static_cast<size_t>(in.size() / mRatio);
+    std::vector<float> out(outSize);
+    for (size_t i = 0; i < outSize; ++i) {
+      double pos = i * mRatio;
+      size_t idx = static_cast<size_t>(pos);
+      float phasePos = static_cast<float>(pos - idx) * kPhases;
+      int phase = static_cast<int>(phasePos);
+      float frac = phasePos - phase;
+
+      // Taps are centred on idx: padded[idx + 1 .. idx + kTaps]
+      const float *src = &padded[idx + 1];
+      float a = dot(src, &mTable[phase * kTaps]);
+      float b = dot(src, &mTable[(phase + 1) * kTaps]);
+      out[i] = a + (b - a) * frac;
+    }
+    return out;
+  }
+
+  // Interleaved multi-channel input, each channel converted independently.
+  std::vector<float> processInterleaved(const std::vector<float> &in,
+                                        int numChannels) const {
+    if (numChannels <= 1)
+      return process(in);
+    size_t frames = in.size() / numChannels;
+    std::vector<std::vector<float>> chans(numChannels);
+    for (int c = 0; c < numChannels; ++c) {
+      chans[c].resize(frames);
+      for (size_t f = 0; f < frames; ++f)
+        chans[c][f] = in[f * numChannels + c];
+      chans[c] = process(chans[c]);
+    }
+    size_t outFrames = chans[0].size();
+    std::vector<float> out(outFrames * numChannels);
+    for (size_t f = 0; f < outFrames; ++f)
+      for (int c = 0; c < numChannels; ++c)
+        out[f * numChannels + c] = chans[c][f];
+    return out;
+  }
+
+  // One-shot helper
+  static std::vector<float> convert(const std::vector<float> &in,
+                                    double sourceRate, double targetRate,
+                                    int numChannels = 1) {
+    if (std::abs(sourceRate - targetRate) < 1.0)
+      return in;
+    Resampler r(sourceRate, targetRate);
+    return r.processInterleaved(in, numChannels);
+  }
+
+private:
+  // Kaiser windowed sinc, kPhases + 1 rows so phase + 1 never wraps
+  void buildTable(double cutoff) {
+    const double beta = 8.0;
+    const double i0Beta = besselI0(beta);
+    const int half = kTaps / 2;
+    mTable.assign((kPhases + 1) * kTaps, 0.0f);
+    for (int p = 0; p <= kPhases; ++p) {
+      double frac = (double)p / kPhases;
+      double sum = 0.0;
+      for (int t = 0; t < kTaps; ++t) {
+        // Distance of tap t from the fractional read position
+        double x = (t + 1 - half) - frac;
+        double s = (std::abs(x) < 1e-9)
+                       ? cutoff
+                       : std::sin(M_PI * cutoff * x) / (M_PI * x);
+        double w = x / half;
+        double win = (std::abs(w) >= 1.0)
+                         ? 0.0
+                         : besselI0(beta * std::sqrt(1.0 - w * w)) / i0Beta;
+        mTable[p * kTaps + t] = (float)(s * win);
+        sum += s * win;
+      }
+      // Unity DC gain per phase
+      if (sum != 0.0) {
+        for (int t = 0; t < kTaps; ++t)
+          mTable[p * kTaps + t] = (float)(mTable[p * kTaps + t] / sum);
+      }
+    }
+  }
+
+  static double besselI0(double x) {
+    double sum = 1.0, term = 1.0, halfX = x * 0.5;
+    for (int k = 1; k < 32; ++k) {
+      term *= (halfX / k) * (halfX / k);
+      sum += term;
+      if (term < 1e-12 * sum)
+        break;
+    }
+    return sum;
+  }
+
+  static inline float dot(const float *a, const float *b) {
+#if defined(RESAMPLER_NEON)
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (int i = 0; i < kTaps; i += 4)
+      acc = vmlaq_f32(acc, vld1q_f32(a + i), vld1q_f32(b + i));
+    float32x2_t s = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+    return vget_lane_f32(vpadd_f32(s, s), 0);
+#elif defined(RESAMPLER_SSE)
+    __m128 acc = _mm_setzero_ps();
+    for (int i = 0; i < kTaps; i += 4)
+      acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    float tmp[4];
+    _mm_storeu_ps(tmp, acc);
+    return (tmp[0] + tmp[1]) + (tmp[2] + tmp[3]);
+#else
+    float acc = 0.0f;
+    for (int i = 0; i < kTaps; ++i)
+      acc += a[i] * b[i];
+    return acc;
+#endif
+  }
+
+  double mRatio = 1.0;
+  std::vector<float> mTable;
+};
+
+#endif // RESAMPLER_H
@@ -2,8 +2,10 @@
 #define UTILS_H
 
 #include <algorithm>
+#include "FastMath.h"
 #include <android/log.h>
 #include <cmath>
+#include <cstdint>
 #include <vector>
 
 #define LOG_TAG "Groovebox"
@@ -28,6 +30,34 @@ static inline float cubicInterpolation(float y0, float y1, float y2, float y3,
   return (a0 * mu * mu2) + (a1 * mu2) + (a2 * mu) + a3;
 }
 
+// Smallest power of two >= n, for ring buffers indexed with a mask
+static inline int nextPowerOfTwo(int n) {
+  int size = 1;
+  while (size < n)
+    size <<= 1;
+  return size;
+}
+
+// Small per-engine PRNG (xorshift32). Replaces rand() on the audio thread:
+// no global state, no locking, a few instructions per draw.
+struct XorShift32 {
+  uint32_t state;
+
+  explicit XorShift32(uint32_t seed = 2463534242u) : state(seed ? seed : 1u) {}
+
+  inline uint32_t next() {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+
+  // [0, 1)
+  inline float nextFloat() { return (next() >> 8) * (1.0f / 16777216.0f); }
+  // [-0.5, 0.5)
+  inline float nextCentered() { return nextFloat() - 0.5f; }
+};
+
 // Fast Sine Approximation using Look-Up Table
 struct FastSine {
   static const int TABLE_SIZE = 2048;
@@ -85,6 +115,37 @@ struct FastSine {
   }
 };
 
+// tan(pi * f / sr) lookup for SVF coefficients, linear interpolation over
+// normalized frequency. Max rel error 3.7e-5 (next to the 0.49 clamp),
+// ~4e-8 in the audible range.
+struct SvfCoeffTable {
+  static const int TABLE_SIZE = 4096; // Entries over [0, 0.5)
+  std::vector<float> table;
+
+  SvfCoeffTable() {
+    table.resize(TABLE_SIZE + 1);
+    for (int i = 0; i <= TABLE_SIZE; ++i) {
+      double x = std::min(0.4999, 0.5 * i / TABLE_SIZE);
+      table[i] = (float)std::tan(M_PI * x);
+    }
+  }
+
+  static SvfCoeffTable &getInstance() {
+    static SvfCoeffTable instance;
+    return instance;
+  }
+
+  // normFreq = cutoff / sampleRate, clamped just below Nyquist
+  static inline float tanPi(float normFreq) {
+    const float *t = getInstance().table.data();
+    float x = std::max(0.0f, std::min(0.49f, normFreq));
+    float pos = x * (2.0f * TABLE_SIZE);
+    int i = (int)pos;
+    float frac = pos - (float)i;
+    return t[i] + frac * (t[i + 1] - t[i]);
+  }
+};
+
 // T-SVF (Zero-Delay Feedback State Variable Filter)
 // Based on Andrew Simper's Trapezoidal integration method.
 // Extremely stable even at high frequencies and high resonance.
@@ -93,16 +154,38 @@ public:
   enum Type { LowPass, HighPass, BandPass, Notch, Peak };
 
   void setParams(float cutoff, float resonance, float sampleRate) {
-    float f = tanf(M_PI * cutoff / sampleRate);
-    float k = 1.0f / std::max(0.1f, resonance);
-    mA1 = 1.0f / (1.0f + f * (f + k));
-    mA2 = f * mA1;
-    mA3 = f * mA2;
-    mF = f;
-    mK = k;
+    computeCoeffs(cutoff, resonance, sampleRate, mA1, mA2, mA3, mK);
+    mRamp = 0;
+  }
+
+  // Glides to the new coefficients over rampSamples instead of jumping.
+  // Meant for control-rate updates (every 16 samples) to avoid zipper noise.
+  void setParamsSmooth(float cutoff, float resonance, float sampleRate,
+                       int rampSamples = 16) {
+    float a1, a2, a3, k;
+    computeCoeffs(cutoff, resonance, sampleRate, a1, a2, a3, k);
+    if (rampSamples <= 1) {
+      mA1 = a1, mA2 = a2, mA3 = a3, mK = k;
+      mRamp = 0;
+      return;
+    }
+    float inv = 1.0f / rampSamples;
+    mDA1 = (a1 - mA1) * inv;
+    mDA2 = (a2 - mA2) * inv;
+    mDA3 = (a3 - mA3) * inv;
+    mDK = (k - mK) * inv;
+    mRamp = rampSamples;
   }
 
   float process(float input, Type type) {
+    if (mRamp > 0) {
+      mA1 += mDA1;
+      mA2 += mDA2;
+      mA3 += mDA3;
+      mK += mDK;
+      --mRamp;
+    }
+
     float v3 = input - mSvfZ2;
     float v1 = mA1 * mSvfZ1 + mA2 * v3;
     float v2 = mSvfZ2 + mA2 * mSvfZ1 + mA3 * v3;
@@ -132,11 +215,109 @@ public:
     }
   }
 
+  static inline void computeCoeffs(float cutoff, float resonance,
+                                   float sampleRate, float &a1, float &a2,
+                                   float &a3, float &k) {
+    float f = SvfCoeffTable::tanPi(cutoff / sampleRate);
+    k = 1.0f / std::max(0.1f, resonance);
+    a1 = 1.0f / (1.0f + f * (f + k));
+    a2 = f * a1;
+    a3 = f * a2;
+  }
+
+  // Output = wIn * in + (wBp + wK * k) * v1 + wLp * v2 for each mode, used
+  // by the lane version to stay branch-free
+  static inline void modeWeights(Type type, float &wIn, float &wBp, float &wK,
+                                 float &wLp) {
+    wIn = 0.0f, wBp = 0.0f, wK = 0.0f, wLp = 0.0f;
+    switch (type) {
+    case HighPass:
+      wIn = 1.0f, wK = -1.0f, wLp = -1.0f;
+      break;
+    case BandPass:
+      wBp = 1.0f;
+      break;
+    case Notch:
+      wIn = 1.0f, wK = -1.0f;
+      break;
+    case Peak:
+      wIn = 1.0f, wK = -1.0f, wLp = -2.0f;
+      break;
+    default:
+      wLp = 1.0f;
+      break;
+    }
+  }
+
 private:
   float mSvfZ1 = 0.0f;
   float mSvfZ2 = 0.0f;
   float mA1 = 0.0f, mA2 = 0.0f, mA3 = 0.0f;
-  float mF = 0.0f, mK = 0.0f;
+  float mK = 0.0f;
+  float mDA1 = 0.0f, mDA2 = 0.0f, mDA3 = 0.0f, mDK = 0.0f;
+  int mRamp = 0;
+};
+
+// N independent TSvfs as structure-of-arrays, one sample per lane per call.
+// Same math and ramps as TSvf; the mode is shared, so the loop is
+// branch-free and vectorizes across lanes (voices).
+template <int N> struct TSvfLanes {
+  alignas(16) float a1[N], a2[N], a3[N], k[N];
+  alignas(16) float da1[N], da2[N], da3[N], dk[N];
+  alignas(16) float ramp[N]; // Remaining ramp samples, as float for selects
+  alignas(16) float z1[N], z2[N];
+
+  TSvfLanes() {
+    for (int i = 0; i < N; ++i) {
+      set(i, 1000.0f, 0.7f, 48000.0f);
+      z1[i] = z2[i] = 0.0f;
+    }
+  }
+
+  void set(int lane, float cutoff, float resonance, float sampleRate) {
+    TSvf::computeCoeffs(cutoff, resonance, sampleRate, a1[lane], a2[lane],
+                        a3[lane], k[lane]);
+    da1[lane] = da2[lane] = da3[lane] = dk[lane] = 0.0f;
+    ramp[lane] = 0.0f;
+  }
+
+  void setSmooth(int lane, float cutoff, float resonance, float sampleRate,
+                 int rampSamples = 16) {
+    float t1, t2, t3, tk;
+    TSvf::computeCoeffs(cutoff, resonance, sampleRate, t1, t2, t3, tk);
+    float inv = 1.0f / std::max(1, rampSamples);
+    da1[lane] = (t1 - a1[lane]) * inv;
+    da2[lane] = (t2 - a2[lane]) * inv;
+    da3[lane] = (t3 - a3[lane]) * inv;
+    dk[lane] = (tk - k[lane]) * inv;
+    ramp[lane] = (float)std::max(1, rampSamples);
+  }
+
+  void reset(int lane) { z1[lane] = z2[lane] = 0.0f; }
+
+  // x[0..n) in place
+  void process(float *x, int n, TSvf::Type type) {
+    float wIn, wBp, wK, wLp;
+    TSvf::modeWeights(type, wIn, wBp, wK, wLp);
+    for (int i = 0; i < n; ++i) {
+      float step = ramp[i] > 0.0f ? 1.0f : 0.0f;
+      a1[i] += da1[i] * step;
+      a2[i] += da2[i] * step;
+      a3[i] += da3[i] * step;
+      k[i] += dk[i] * step;
+      ramp[i] -= step;
+
+      float in = x[i];
+      float v3 = in - z2[i];
+      float v1 = a1[i] * z1[i] + a2[i] * v3;
+      float v2 = z2[i] + a2[i] * z1[i] + a3[i] * v3;
+      float nz1 = 2.0f * v1 - z1[i];
+      float nz2 = 2.0f * v2 - z2[i];
+      z1[i] = std::abs(nz1) < 1e-9f ? 0.0f : nz1;
+      z2[i] = std::abs(nz2) < 1e-9f ? 0.0f : nz2;
+      x[i] = wIn * in + (wBp + wK * k[i]) * v1 + wLp * v2;
+    }
+  }
 };
 
 #endif // UTILS_H
@@ -1,6 +1,7 @@
 #ifndef ADSR_H
 #define ADSR_H
 
+#include <algorithm>
 #include <cmath>
 
 enum class AdsrStage { Idle, Attack, Decay, Sustain, Release };
@@ -9,25 +10,32 @@ class Adsr {
 public:
   void setSampleRate(float sr) { mSampleRate = sr; }
   void setParameters(float a, float d, float s, float r) {
+    // Called on every note-on, skip the exp() work when nothing changed
+    if (a == mAttack && d == mDecay && s == mSustain && r == mRelease &&
+        mSampleRate == mCoeffSampleRate)
+      return;
     mAttack = a;
     mDecay = d;
     mSustain = s;
     mRelease = r;
-    // Pre-calculate coefficients could be done here for optimization,
-    // but calculating per-sample is okay for now or valid in nextValue with
-    // pow/exp approximations. For simple exp decay: val *= coeff.
+    mCoeffSampleRate = mSampleRate;
     // Cubic curve for fine control at low values
     float aCurve = mAttack * mAttack * mAttack;
     float dCurve = mDecay * mDecay * mDecay;
     float rCurve = mRelease * mRelease * mRelease;
 
     // Max times: Attack 2s, Decay 3s, Release 3s
-    mDecayCoeff = exp(-1.0f / (dCurve * mSampleRate * 3.0f + 1.0f));
-    mReleaseCoeff = exp(-1.0f / (rCurve * mSampleRate * 3.0f + 1.0f));
+    mDecayLog = -1.0f / (dCurve * mSampleRate * 3.0f + 1.0f);
+    mReleaseLog = -1.0f / (rCurve * mSampleRate * 3.0f + 1.0f);
+    mDecayCoeff = exp(mDecayLog);
+    mReleaseCoeff = exp(mReleaseLog);
     mAttackRate = 1.0f / (aCurve * mSampleRate * 2.0f + 1.0f);
   }
 
-  void trigger() { mStage = AdsrStage::Attack; }
+  void trigger() {
+    mStage = AdsrStage::Attack;
+    mFastRelease = false;
+  }
 
   void release() {
     if (mStage != AdsrStage::Idle) {
@@ -35,9 +43,22 @@ public:
     }
   }
 
+  // ~5 ms fade to silence for a stolen voice. Sticks until the next
+  // trigger, setParameters only touches the normal release, so envelope
+  // edits reaching live voices can't bring the voice back.
+  void fastRelease() {
+    if (mStage == AdsrStage::Idle)
+      return;
+    mStage = AdsrStage::Release;
+    mFastRelease = true;
+    mFastLog = -9.2f / (0.005f * mSampleRate); // ln(1e-4) over 5 ms
+    mFastCoeff = exp(mFastLog);
+  }
+
   void reset() {
     mStage = AdsrStage::Idle;
     mValue = 0.0f;
+    mFastRelease = false;
   }
 
   float nextValue() {
@@ -65,7 +86,7 @@ public:
       mValue = mSustain;
       break;
     case AdsrStage::Release:
-      mValue *= mReleaseCoeff;
+      mValue *= mFastRelease ? mFastCoeff : mReleaseCoeff;
       if (mValue < 0.0001f) {
         mValue = 0.0f;
         mStage = AdsrStage::Idle;
@@ -75,16 +96,120 @@ public:
     return mValue;
   }
 
+  // Renders n values one segment at a time: linear attack, geometric
+  // decay/release via closed-form segment lengths, no per-sample switch.
+  // Returns how many samples ran before the envelope went idle (n if it
+  // didn't), matching where nextValue() callers would stop the voice.
+  int process(float *out, int n) {
+    int i = 0;
+    while (i < n) {
+      int todo = n - i;
+      switch (mStage) {
+      case AdsrStage::Idle:
+        std::fill(out + i, out + n, 0.0f);
+        return i;
+      case AdsrStage::Attack: {
+        int len = (int)std::ceil((1.0f - mValue) / mAttackRate);
+        len = std::max(1, len);
+        int count = std::min(len, todo);
+        float start = mValue;
+        for (int k = 0; k < count; ++k)
+          out[i + k] = start + mAttackRate * (float)(k + 1);
+        if (count == len) {
+          out[i + count - 1] = 1.0f;
+          mStage = AdsrStage::Decay;
+        }
+        mValue = out[i + count - 1];
+        i += count;
+        break;
+      }
+      case AdsrStage::Decay: {
+        float dist = mValue - mSustain;
+        int len = segmentLength(dist, mDecayLog);
+        int count = std::min(len, todo);
+        geometric(out + i, count, mSustain, dist, mDecayCoeff);
+        if (count == len) {
+          out[i + count - 1] = mSustain;
+          mStage = AdsrStage::Sustain;
+        }
+        mValue = out[i + count - 1];
+        i += count;
+        break;
+      }
+      case AdsrStage::Sustain:
+        mValue = mSustain;
+        std::fill(out + i, out + n, mSustain);
+        return n;
+      case AdsrStage::Release: {
+        const float log = mFastRelease ? mFastLog : mReleaseLog;
+        const float coeff = mFastRelease ? mFastCoeff : mReleaseCoeff;
+        int len = segmentLength(mValue, log);
+        int count = std::min(len, todo);
+        geometric(out + i, count, 0.0f, mValue, coeff);
+        if (count == len) {
+          out[i + count - 1] = 0.0f;
+          mStage = AdsrStage::Idle;
+          mValue = 0.0f;
+          std::fill(out + i + count, out + n, 0.0f);
+          return i + count - 1;
+        }
+        mValue = out[i + count - 1];
+        i += count;
+        break;
+      }
+      }
+    }
+    return n;
+  }
+
   bool isActive() const { return mStage != AdsrStage::Idle; }
   float getValue() const { return mValue; }
+  bool isReleasing() const { return mStage == AdsrStage::Release; }
+  // Level the voice is headed for, so a note still in its attack isn't
+  // mistaken for a quiet one
+  float keepLevel() const {
+    return mStage == AdsrStage::Attack ? 1.0f : mValue;
+  }
 
 private:
+  // Samples until dist * coeff^k drops under the 1e-4 threshold. Takes
+  // ln(coeff) exactly, coeff is too close to 1 for an approximate log.
+  static int segmentLength(float dist, float logCoeff) {
+    if (dist < 0.0001f)
+      return 1;
+    float k = std::log(0.0001f / dist) / logCoeff;
+    return std::max(1, (int)std::ceil(std::min(k, 1.0e9f)));
+  }
+
+  // out[k] = base + dist * coeff^(k + 1), four independent lanes so the
+  // loop vectorizes instead of chaining one multiply per sample
+  static void geometric(float *out, int count, float base, float dist,
+                        float coeff) {
+    float c2 = coeff * coeff;
+    float lanes[4] = {dist * coeff, dist * c2, dist * c2 * coeff,
+                      dist * c2 * c2};
+    const float c4 = c2 * c2;
+    int k = 0;
+    for (; k + 4 <= count; k += 4) {
+      for (int j = 0; j < 4; ++j) {
+        out[k + j] = base + lanes[j];
+        lanes[j] *= c4;
+      }
+    }
+    for (int j = 0; k < count; ++k, ++j)
+      out[k] = base + lanes[j];
+  }
+
   float mSampleRate = 48000.0f;
+  float mCoeffSampleRate = 0.0f;
   float mAttack = 0.01f, mDecay = 0.1f, mSustain = 0.8f, mRelease = 0.5f;
 
+  float mDecayLog = -0.001f, mReleaseLog = -0.001f;
   float mDecayCoeff = 0.999f;
   float mReleaseCoeff = 0.999f;
   float mAttackRate = 0.01f;
+  bool mFastRelease = false;
+  float mFastLog = -0.001f, mFastCoeff = 0.999f;
 
   float mValue = 0.0f;
   AdsrStage mStage = AdsrStage::Idle;
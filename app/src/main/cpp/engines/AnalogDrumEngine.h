@@ -118,9 +118,9 @@ private:
         if (tone > 0.5f) {
           float x = sine * 1.4f;
           if (x > 1.0f)
-            x = 1.0f - expf(1.0f - x);
+            x = 1.0f - FastMath::exp(1.0f - x);
           else if (x < -1.0f)
-            x = -1.0f + expf(1.0f + x);
+            x = -1.0f + FastMath::exp(1.0f + x);
           float x2 = x * x;
           sine = x * (27.0f + x2) / (27.0f + 9.0f * x2);
         }
@@ -136,7 +136,7 @@ private:
           return 0.0f;
         }
         phase += baseFreq * dt;
-        float shell = std::sin(phase * 6.28318f) * envTone;
+        float shell = FastMath::sin2pi(phase) * envTone;
         float noise = rng.next();
         float hpCoeff = 0.1f + (tone * 0.6f);
         filterState += (noise - filterState) * hpCoeff;
@@ -228,7 +228,7 @@ private:
           return 0.0f;
         }
         phase += baseFreq * dt;
-        float sine = std::sin(phase * 6.28318f);
+        float sine = FastMath::sin2pi(phase);
         return sine * env * 0.8f * velocity;
       }
 
@@ -349,7 +349,7 @@ public:
         mLastRenders[i] = 0.0f;
       }
     }
-    return std::tanh(out * 0.9f);
+    return FastMath::tanh(out * 0.9f);
   }
 
   bool isActive() const {
@@ -164,7 +164,7 @@ public:
     // Exponential mapping
     float low = 20.0f;
     float high = std::min(mSampleRate * 0.49f, 20000.0f);
-    float freq = low * powf(high / low, cutoffNormalized);
+    float freq = low * FastMath::pow(high / low, cutoffNormalized);
 
     float resonance = std::max(0.1f, mResonance);
     v.svf.setParams(freq, resonance, mSampleRate);
@@ -1,6 +1,7 @@
 #ifndef AUTO_PANNER_FX_H
 #define AUTO_PANNER_FX_H
 
+#include "../FastMath.h"
 #include <algorithm>
 #include <cmath>
 
@@ -26,7 +27,7 @@ public:
     float lfo = 0.0f;
     // Shape: 0=Sine, 1=Triangle, 2=Square
     if (mShape < 0.5f) {
-      lfo = std::sin(2.0f * (float)M_PI * mPhase);
+      lfo = FastMath::sin2pi(mPhase);
     } else if (mShape < 1.5f) {
       // Precise Triangle
       lfo = (mPhase < 0.5f) ? (4.0f * mPhase - 1.0f) : (3.0f - 4.0f * mPhase);
@@ -44,8 +45,8 @@ public:
 
     // Constant Power Panning Law
     float angle = (currentPan + 1.0f) * (float)M_PI * 0.25f; // 0 to PI/2
-    float gainL = std::cos(angle);
-    float gainR = std::sin(angle);
+    float gainL = FastMath::cos(angle);
+    float gainR = FastMath::sin(angle);
 
     float wetL = monoSum * gainL;
     float wetR = monoSum * gainR;
@@ -1,6 +1,9 @@
 #ifndef BITCRUSHER_FX_H
 #define BITCRUSHER_FX_H
 
+#include "../FastMath.h"
+#include "../Oversampler.h"
+#include <algorithm>
 #include <cmath>
 
 class BitcrusherFx {
@@ -16,45 +19,77 @@ public:
   void setRate(float v) { setDownsample(v); }
   void setMix(float v) { mMix = v; }
 
-  float process(float input) {
-    // Parameter Smoothing
-    mSmoothedBits += 0.01f * (mBits - mSmoothedBits);
-    mSmoothedRate += 0.01f * (mDownsample - mSmoothedRate);
+  // 1x, 2x or 4x for the quantizer. The rate reduction stays at the base
+  // rate, its aliasing is the point.
+  void setOversampling(int factor) {
+    for (auto &ch : mCh)
+      ch.oversampler.setFactor(factor);
+  }
+  int oversampling() const { return mCh[0].oversampler.factor(); }
+  float latency() const { return mCh[0].oversampler.latency(); }
+  // Both sides per frame
+  float costNs() const { return mCost.ns(); }
 
-    // Sample rate reduction
-    int effectiveRate = (int)mSmoothedRate;
-    if (effectiveRate < 1)
-      effectiveRate = 1;
+  // The last held sample, then the oversampler's latency
+  int tailSamples(float sampleRate) const {
+    return (int)latency() + mDownsample + 32;
+  }
 
-    if (mCounter++ % effectiveRate != 0) {
-      return mLastOutput;
-    }
+  // In place. Insert Logic: returns crushed - input.
+  void processBlock(float *left, float *right, int n) {
+    // Parameter smoothing, advanced a whole block at a time: the one-pole
+    // step of 0.01 per sample, n times over
+    const float k = 1.0f - FastMath::exp2(kSmoothLog2 * (float)n);
+    mSmoothedBits += k * (mBits - mSmoothedBits);
+    mSmoothedRate += k * (mDownsample - mSmoothedRate);
 
+    // Sample rate reduction
+    const int effectiveRate = std::max(1, (int)mSmoothedRate);
     // Bit depth reduction
     // Use symmetric rounding to prevent DC offset/crackle on silent signals
-    float step = powf(2.0f, mSmoothedBits - 1.0f);
-    float crushed = roundf(input * step) / step;
+    const float step = FastMath::exp2(mSmoothedBits - 1.0f);
+    const float invStep = 1.0f / step;
+    auto quantize = [step, invStep](float s) {
+      return roundf(s * step) * invStep;
+    };
 
-    mLastOutput = crushed;
-
-    // Output LPF (One Pole @ ~12kHz)
-    // Coeff approx for 12kHz at 48k is ~0.6
-    mLpfState += 0.6f * (crushed - mLpfState);
-    crushed = mLpfState;
-
-    // Insert Logic: Return crushed - input
-    return (crushed * mMix) - input;
+    for (int i = 0; i < n; ++i) {
+      if (mCounter++ % effectiveRate == 0) {
+        mCh[0].held = left[i];
+        mCh[1].held = right[i];
+      }
+      float crushed[2];
+      mCost.measure([&] {
+        for (int c = 0; c < 2; ++c)
+          crushed[c] = mCh[c].oversampler.process(mCh[c].held, quantize);
+        return 0.0f;
+      });
+      // Output LPF (One Pole @ ~12kHz)
+      // Coeff approx for 12kHz at 48k is ~0.6
+      mCh[0].lpfState += 0.6f * (crushed[0] - mCh[0].lpfState);
+      mCh[1].lpfState += 0.6f * (crushed[1] - mCh[1].lpfState);
+      left[i] = mCh[0].lpfState * mMix - left[i];
+      right[i] = mCh[1].lpfState * mMix - right[i];
+    }
   }
 
 private:
+  static constexpr float kSmoothLog2 = -0.014499569695115089f; // log2(0.99)
+
+  struct Channel {
+    Oversampler oversampler;
+    float held = 0.0f;
+    float lpfState = 0.0f;
+  };
+
   float mBits = 8.0f;
   float mSmoothedBits = 8.0f; // Smoothed
   int mDownsample = 4;
   float mSmoothedRate = 4.0f; // Smoothed
   int mCounter = 0;
-  float mLastOutput = 0.0f;
   float mMix = 1.0f;
-  float mLpfState = 0.0f;
+  Channel mCh[2];
+  CostMeter mCost;
 };
 
 #endif // BITCRUSHER_FX_H
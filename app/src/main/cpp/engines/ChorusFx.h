@@ -1,12 +1,17 @@
 #ifndef CHORUS_FX_H
 #define CHORUS_FX_H
 
+#include "../DelayLine.h"
+#include "../FastMath.h"
+#include <algorithm>
 #include <cmath>
-#include <vector>
 
 class ChorusFx {
 public:
-  ChorusFx(int maxDelay = 4096) { mBuffer.resize(maxDelay, 0.0f); }
+  ChorusFx(int maxDelay = 4096) {
+    mLine[0].setSize(maxDelay);
+    mLine[1].setSize(maxDelay);
+  }
 
   void setRate(float v) { mRate = v; }
   void setDepth(float v) { mDepth = v; }
@@ -27,71 +32,101 @@ public:
   }
 
   void clear() {
-    std::fill(mBuffer.begin(), mBuffer.end(), 0.0f);
-    mWritePos = 0;
+    for (auto &line : mLine)
+      line.clear();
     mPhase = 0.0f;
-    mHpState = 0.0f;
+    mHpState[0] = mHpState[1] = 0.0f;
   }
 
-  float process(float input, float sampleRate) {
-    mPhase += (2.0f * M_PI * mRate) / sampleRate;
-    if (mPhase > 2.0f * M_PI)
-      mPhase -= 2.0f * M_PI;
-
-    float wetSignal = 0.0f;
-    // Spread voices across phase
-    float phaseOffsetStep = (2.0f * M_PI) / (float)mVoices;
-
-    for (int v = 0; v < mVoices; ++v) {
-      float vPhase = mPhase + (v * phaseOffsetStep);
-      // Modulate delay time between 10ms and 30ms with offset per voice
-      // Enhanced Depth: modulate slightly wider
-      float delaySamples =
-          (25.0f + sinf(vPhase) * mDepth * 15.0f) * (sampleRate / 1000.0f);
+  // The longest voice delay
+  int tailSamples(float sampleRate) const {
+    int longest = (int)((25.0f + mDepth * 15.0f) * sampleRate / 1000.0f) + 2;
+    return std::min(longest, mLine[0].size());
+  }
 
-      float tap = getInterpolatedTap(delaySamples);
-      wetSignal += tap;
+  std::size_t lineBytes() const { return mLine[0].bytes() + mLine[1].bytes(); }
+
+  // In place, wet only. Both sides share the LFO. The voice delays are
+  // worked out every kControlFrames and ramped in between: the voices sweep
+  // hundreds of samples, so a whole block per ramp would bend them by a
+  // noticeable fraction of a sample. No voice reaches back less than 10ms,
+  // so each chunk goes into the lines first and the voices read it a whole
+  // chunk at a time.
+  void processBlock(float *left, float *right, int n, float sampleRate) {
+    if (n <= 0)
+      return;
+    const float twoPi = 2.0f * (float)M_PI;
+    const float inc = twoPi * mRate / sampleRate;
+    const int voices = std::clamp(mVoices, 1, kMaxVoices);
+    const float phaseOffsetStep = twoPi / (float)voices;
+    // Modulate delay time between 10ms and 30ms with offset per voice
+    const float center = 25.0f * sampleRate / 1000.0f;
+    const float swing = mDepth * 15.0f * sampleRate / 1000.0f;
+
+    const float norm = 1.0f / (float)voices;
+    float delay[kMaxVoices], delayStep[kMaxVoices];
+    alignas(16) float wetL[kControlFrames], wetR[kControlFrames];
+    alignas(16) float delays[kControlFrames], tap[kControlFrames];
+    for (int start = 0; start < n; start += kControlFrames) {
+      const int count = std::min(kControlFrames, n - start);
+      for (int v = 0; v < voices; ++v) {
+        float first = mPhase + inc + v * phaseOffsetStep;
+        delay[v] = center + FastMath::sin(first) * swing;
+        float end =
+            center + FastMath::sin(first + inc * (float)(count - 1)) * swing;
+        delayStep[v] = count > 1 ? (end - delay[v]) / (float)(count - 1) : 0.0f;
+      }
+      mPhase += inc * (float)count;
+      if (mPhase > twoPi)
+        mPhase -= twoPi;
+
+      mLine[0].writeBlock(left + start, count);
+      mLine[1].writeBlock(right + start, count);
+      std::fill(wetL, wetL + count, 0.0f);
+      std::fill(wetR, wetR + count, 0.0f);
+      for (int v = 0; v < voices; ++v) {
+        for (int i = 0; i < count; ++i)
+          delays[i] = delay[v] + delayStep[v] * (float)i;
+        mLine[0].readLinearLast(tap, delays, count);
+        for (int i = 0; i < count; ++i)
+          wetL[i] += tap[i];
+        mLine[1].readLinearLast(tap, delays, count);
+        for (int i = 0; i < count; ++i)
+          wetR[i] += tap[i];
+      }
+      for (int i = 0; i < count; ++i) {
+        left[start + i] = wetL[i] * norm;
+        right[start + i] = wetR[i] * norm;
+      }
     }
 
-    // Normalize wet signal
-    wetSignal /= (float)mVoices;
-
-    // Character: High Pass Wet Signal to remove muddiness
-    mHpState += 0.05f * (wetSignal - mHpState);
-    wetSignal = wetSignal - mHpState;
-
-    // Character: Warmth (Saturation on Wet)
-    wetSignal = std::tanh(wetSignal * 1.5f);
-
-    mBuffer[mWritePos] = input;
-    mWritePos = (mWritePos + 1) % mBuffer.size();
-
-    return std::tanh(wetSignal) * mMix; // Wet Only for Parallel Mix
+    // Character: high pass the wet signal to remove muddiness, then warmth
+    // (saturation) on top
+    float *out[2] = {left, right};
+    for (int c = 0; c < 2; ++c) {
+      float *x = out[c];
+      float hp = mHpState[c];
+      for (int i = 0; i < n; ++i) {
+        hp += 0.05f * (x[i] - hp);
+        x[i] -= hp;
+      }
+      mHpState[c] = hp;
+      for (int i = 0; i < n; ++i)
+        x[i] = FastMath::tanh(FastMath::tanh(x[i] * 1.5f)) * mMix;
+    }
   }
 
 private:
-  float getInterpolatedTap(float delaySamples) {
-    float readPos = (float)mWritePos - delaySamples;
-    while (readPos < 0)
-      readPos += mBuffer.size();
-    while (readPos >= mBuffer.size())
-      readPos -= mBuffer.size();
-
-    int i1 = (int)readPos;
-    int i2 = (i1 + 1) % mBuffer.size();
-    float frac = readPos - i1;
-
-    return mBuffer[i1] * (1.0f - frac) + mBuffer[i2] * frac;
-  }
+  static const int kMaxVoices = 7;
+  static const int kControlFrames = 32;
 
-  std::vector<float> mBuffer;
-  int mWritePos = 0;
+  DelayLine<> mLine[2];
   float mPhase = 0.0f;
   float mRate = 1.0f;
   float mDepth = 0.5f;
   float mMix = 0.5f;
   int mVoices = 3;
-  float mHpState = 0.0f;
+  float mHpState[2] = {0.0f, 0.0f};
 };
 
 #endif // CHORUS_FX_H
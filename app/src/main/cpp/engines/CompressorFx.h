@@ -1,6 +1,7 @@
 #ifndef COMPRESSOR_FX_H
 #define COMPRESSOR_FX_H
 
+#include "../FastMath.h"
 #include <algorithm>
 #include <cmath>
 
@@ -17,7 +18,41 @@ public:
   }
   void setMakeup(float dB) { mMakeup = powf(10.0f, dB / 20.0f); }
 
+  // The envelope only scales what comes in
+  int tailSamples(float sampleRate) const { return 0; }
+
   float process(float input, float sidechain) {
+    float out = input * detect(sidechain) * mMakeup;
+    // Soft clip at 0dB to prevent harsh digital distortion
+    return FastMath::tanh(out);
+  }
+
+  // In place. The detector runs L then R each frame, same as feeding the
+  // two sides through process() interleaved. No sidechain means a silent
+  // one: once the envelope has fallen under the gate nothing can raise it,
+  // and the block is just makeup and the soft clip.
+  void processBlock(float *left, float *right, int n,
+                    const float *sideLeft = nullptr,
+                    const float *sideRight = nullptr) {
+    if (!sideLeft && !sideRight && !(mEnvelope > kGate)) {
+      mEnvelope *= std::pow(1.0f - mReleaseRate, 2.0f * n);
+      for (int i = 0; i < n; ++i) {
+        left[i] = FastMath::tanh(left[i] * mMakeup);
+        right[i] = FastMath::tanh(right[i] * mMakeup);
+      }
+      return;
+    }
+    for (int i = 0; i < n; ++i) {
+      left[i] = process(left[i], sideLeft ? sideLeft[i] : 0.0f);
+      right[i] = process(right[i], sideRight ? sideRight[i] : 0.0f);
+    }
+  }
+
+private:
+  static constexpr float kGate = 0.0001f; // Envelope below this: no gain
+
+  // Steps the envelope and returns the gain for it
+  float detect(float sidechain) {
     // Level detection on sidechain signal
     float absSide = std::abs(sidechain);
 
@@ -33,9 +68,9 @@ public:
 
     // Gain processing
     float gain = 1.0f;
-    if (mEnvelope > 0.0001f && mThreshold > 0.0f) {
-      float detDb = 20.0f * log10f(mEnvelope);
-      float threshDb = 20.0f * log10f(mThreshold);
+    if (mEnvelope > kGate && mThreshold > 0.0f) {
+      float detDb = FastMath::gainToDb(mEnvelope);
+      float threshDb = FastMath::gainToDb(mThreshold);
       float overDb = detDb - threshDb;
 
       // Soft Knee (3dB knee)
@@ -46,19 +81,15 @@ public:
           overDb = (overDb + knee) * (overDb + knee) / (4.0f * knee);
         }
         float reductionDb = overDb * (1.0f - 1.0f / mRatio);
-        gain = powf(10.0f, -reductionDb / 20.0f);
+        gain = FastMath::dbToGain(-reductionDb);
       }
     }
 
     if (!std::isfinite(gain))
       gain = 1.0f;
-
-    float out = input * gain * mMakeup;
-    // Soft clip at 0dB to prevent harsh digital distortion
-    return std::tanh(out);
+    return gain;
   }
 
-private:
   float mThreshold = 0.5f;
   float mRatio = 4.0f;
   float mAttackRate = 0.01f;
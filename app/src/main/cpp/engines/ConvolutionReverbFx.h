@@ -0,0 +1,373 @@
+#ifndef CONVOLUTION_REVERB_FX_H
+#define CONVOLUTION_REVERB_FX_H
+
+#include "../FFT.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Uniformly partitioned overlap-save convolution for one channel. The IR is
+// cut into partitions of `size` samples, each transformed once at load. Every
+// call takes the next `size` input samples, transforms them once, and sums
+// them against all the partitions through a delay line of past input
+// spectra, so the cost per sample barely grows with the IR length.
+class ConvolutionStage {
+public:
+  void init(const float *ir, int length, int size) {
+    mSize = size;
+    mPlan.init(2 * size);
+    mBins = mPlan.bins();
+    mParts = std::max(1, (length + size - 1) / size);
+
+    // Kernel spectra, scaled for the unscaled inverse
+    std::vector<float> block(2 * size);
+    mKernelRe.assign(mParts * mBins, 0.0f);
+    mKernelIm.assign(mParts * mBins, 0.0f);
+    const float scale = 1.0f / (2 * size);
+    for (int p = 0; p < mParts; ++p) {
+      std::fill(block.begin(), block.end(), 0.0f);
+      int count = std::max(0, std::min(size, length - p * size));
+      for (int i = 0; i < count; ++i)
+        block[i] = ir[p * size + i] * scale;
+      mPlan.forward(block.data(), &mKernelRe[p * mBins],
+                    &mKernelIm[p * mBins]);
+    }
+
+    mInputRe.assign(mParts * mBins, 0.0f);
+    mInputIm.assign(mParts * mBins, 0.0f);
+    mAccRe.assign(mBins, 0.0f);
+    mAccIm.assign(mBins, 0.0f);
+    mWindow.assign(2 * size, 0.0f);
+    mTime.assign(2 * size, 0.0f);
+    mNewest = 0;
+  }
+
+  void reset() {
+    std::fill(mInputRe.begin(), mInputRe.end(), 0.0f);
+    std::fill(mInputIm.begin(), mInputIm.end(), 0.0f);
+    std::fill(mWindow.begin(), mWindow.end(), 0.0f);
+    mNewest = 0;
+  }
+
+  // size() samples in, size() samples out
+  void process(const float *in, float *out) {
+    std::copy(mWindow.begin() + mSize, mWindow.end(), mWindow.begin());
+    std::copy(in, in + mSize, mWindow.begin() + mSize);
+    mNewest = mNewest > 0 ? mNewest - 1 : mParts - 1;
+    mPlan.forward(mWindow.data(), &mInputRe[mNewest * mBins],
+                  &mInputIm[mNewest * mBins]);
+
+    // Input spectrum p blocks back meets kernel partition p
+    std::fill(mAccRe.begin(), mAccRe.end(), 0.0f);
+    std::fill(mAccIm.begin(), mAccIm.end(), 0.0f);
+    for (int p = 0; p < mParts; ++p) {
+      int slot = mNewest + p < mParts ? mNewest + p : mNewest + p - mParts;
+      multiplyAdd(&mInputRe[slot * mBins], &mInputIm[slot * mBins],
+                  &mKernelRe[p * mBins], &mKernelIm[p * mBins], mAccRe.data(),
+                  mAccIm.data(), mBins);
+    }
+
+    // Overlap-save: the first half wrapped around, the second is valid
+    mPlan.inverse(mAccRe.data(), mAccIm.data(), mTime.data());
+    std::copy(mTime.begin() + mSize, mTime.end(), out);
+  }
+
+  // Moves on by a block of silence without computing any output
+  void skip() {
+    std::copy(mWindow.begin() + mSize, mWindow.end(), mWindow.begin());
+    std::fill(mWindow.begin() + mSize, mWindow.end(), 0.0f);
+    mNewest = mNewest > 0 ? mNewest - 1 : mParts - 1;
+    std::fill_n(&mInputRe[mNewest * mBins], mBins, 0.0f);
+    std::fill_n(&mInputIm[mNewest * mBins], mBins, 0.0f);
+  }
+
+  int size() const { return mSize; }
+
+private:
+  static void multiplyAdd(const float *__restrict xr,
+                          const float *__restrict xi,
+                          const float *__restrict hr,
+                          const float *__restrict hi, float *__restrict accR,
+                          float *__restrict accI, int n) {
+    for (int k = 0; k < n; ++k) {
+      accR[k] += xr[k] * hr[k] - xi[k] * hi[k];
+      accI[k] += xr[k] * hi[k] + xi[k] * hr[k];
+    }
+  }
+
+  FFT::RealPlan mPlan;
+  int mSize = 0;
+  int mBins = 0;
+  int mParts = 0;
+  std::vector<float> mKernelRe, mKernelIm; // mParts spectra
+  std::vector<float> mInputRe, mInputIm;   // Ring of the last mParts inputs
+  int mNewest = 0;
+  std::vector<float> mAccRe, mAccIm;
+  std::vector<float> mWindow; // Previous block then the new one
+  std::vector<float> mTime;
+};
+
+// Convolution reverb for an FX slot. Two partition sizes: the head of the IR
+// runs on the audio thread in short partitions, the rest in long ones on a
+// worker thread. A long partition's output isn't due until kTailSize samples
+// after its input block completes, which is the worker's deadline, so the
+// audio thread never waits on it. The whole thing is kHeadSize samples late,
+// a little like a short pre-delay.
+class ConvolutionReverbFx {
+public:
+  static const int kHeadSize = 128;
+  static const int kTailSize = 1024;
+  // Tail partitions start here, the head covers everything before
+  static const int kTailStart = 2 * kTailSize;
+  // Tail blocks in flight. Each in-slot is refilled kSlots blocks later and
+  // each out-slot is done playing before its next block can be computed.
+  static const int kSlots = 4;
+
+  // Partitions and spectra for an IR, built off the audio thread, and the
+  // worker that runs its tail. Each IR has its own so an old one can wind
+  // down while the next already plays. Destroying it joins the worker.
+  struct Convolver {
+    ConvolutionStage head[2], tail[2];
+    bool hasTail = false;
+    int length = 0;
+    int longestGap = 0; // Longest quiet run before the IR's last loud sample
+
+    float tailIn[kSlots][2][kTailSize] = {};
+    float tailOut[kSlots][2][kTailSize] = {};
+    std::atomic<int64_t> tailQueued{0}; // Input blocks handed over
+    std::atomic<int64_t> tailDone{0};   // Output blocks ready
+    // A reset asked for by the audio side, and the last one the worker did.
+    // Tail output only counts while they match.
+    std::atomic<uint32_t> epoch{0};
+    std::atomic<uint32_t> ackEpoch{0};
+
+    std::thread worker;
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    bool running = false;
+
+    ~Convolver() {
+      if (!worker.joinable())
+        return;
+      {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        running = false;
+      }
+      wake.notify_one();
+      worker.join();
+    }
+
+    void startWorker() {
+      running = true;
+      worker = std::thread([this] { workerLoop(); });
+    }
+
+    void workerLoop() {
+      int64_t next = 0;
+      std::unique_lock<std::mutex> lock(wakeMutex);
+      while (running) {
+        const uint32_t e = epoch.load(std::memory_order_acquire);
+        if (e != ackEpoch.load(std::memory_order_relaxed)) {
+          for (int c = 0; c < 2; ++c)
+            tail[c].reset();
+          next = 0;
+          tailDone.store(0, std::memory_order_relaxed);
+          ackEpoch.store(e, std::memory_order_release);
+        }
+        // The audio thread notifies without the mutex, so a wake-up can slip
+        // between the check and the wait. The timeout bounds that.
+        if (tailQueued.load(std::memory_order_acquire) <= next) {
+          wake.wait_for(lock, std::chrono::milliseconds(2));
+          continue;
+        }
+        lock.unlock();
+        while (next < tailQueued.load(std::memory_order_acquire) &&
+               epoch.load(std::memory_order_relaxed) == e) {
+          int slot = (int)(next % kSlots);
+          // Far enough behind that the input slot is being refilled: give
+          // that block up, it was going to play as silence anyway
+          bool stale =
+              tailQueued.load(std::memory_order_acquire) - next >= kSlots - 1;
+          for (int c = 0; c < 2; ++c) {
+            if (stale)
+              tail[c].skip();
+            else
+              tail[c].process(tailIn[slot][c], tailOut[slot][c]);
+          }
+          ++next;
+          tailDone.store(next, std::memory_order_release);
+        }
+        lock.lock();
+      }
+    }
+  };
+
+  // Channels at the engine rate. Scaled to unit energy per channel so IRs of
+  // any length come out at about the level that went in. Slow.
+  static std::unique_ptr<Convolver> build(std::vector<float> left,
+                                          std::vector<float> right) {
+    if (right.empty())
+      right = left;
+    int length = (int)std::min(left.size(), right.size());
+    if (length == 0)
+      return nullptr;
+
+    auto conv = std::make_unique<Convolver>();
+    conv->length = length;
+    conv->hasTail = length > kTailStart;
+    std::vector<float> *channels[2] = {&left, &right};
+    for (int c = 0; c < 2; ++c) {
+      std::vector<float> &ir = *channels[c];
+      double energy = 0.0;
+      for (int i = 0; i < length; ++i)
+        energy += (double)ir[i] * ir[i];
+      float gain = energy > 1e-12 ? (float)(1.0 / std::sqrt(energy)) : 0.0f;
+      for (float &v : ir)
+        v *= gain;
+
+      conv->head[c].init(ir.data(), std::min(length, kTailStart), kHeadSize);
+      if (conv->hasTail)
+        conv->tail[c].init(ir.data() + kTailStart, length - kTailStart,
+                           kTailSize);
+    }
+    // -120 dB on the normalized IR
+    for (int i = 0, lastLoud = -1; i < length; ++i) {
+      if (std::abs(left[i]) < 1.0e-6f && std::abs(right[i]) < 1.0e-6f)
+        continue;
+      conv->longestGap = std::max(conv->longestGap, i - lastLoud - 1);
+      lastLoud = i;
+    }
+    if (conv->hasTail)
+      conv->startWorker();
+    return conv;
+  }
+
+  // Swaps the IR and hands back the old one. Its worker may still be busy,
+  // so free it after letting go of any lock the audio thread takes. Null
+  // unloads.
+  std::unique_ptr<Convolver> setConvolver(std::unique_ptr<Convolver> conv) {
+    mConv.swap(conv);
+    resetState();
+    return conv;
+  }
+
+  bool loaded() const { return mConv != nullptr; }
+  float lengthSeconds(float sampleRate) const {
+    return mConv ? mConv->length / sampleRate : 0.0f;
+  }
+  // Tail blocks the worker didn't finish in time, played as silence
+  uint32_t lateBlocks() const { return mLate.load(std::memory_order_relaxed); }
+
+  void setMix(float v) { mMix = v; }
+
+  // Never waits on the worker, it resets the tail when it next looks
+  void clear() { resetState(); }
+
+  // The output only goes quiet with signal still inside across a gap in the
+  // IR, and all of it comes kHeadSize late
+  int tailSamples(float sampleRate) const {
+    return mConv ? mConv->longestGap + kHeadSize : 0;
+  }
+
+  // In place, wet only
+  void processBlock(float *left, float *right, int n) {
+    if (!mConv) {
+      std::fill(left, left + n, 0.0f);
+      std::fill(right, right + n, 0.0f);
+      return;
+    }
+    Convolver &conv = *mConv;
+    float *io[2] = {left, right};
+
+    for (int start = 0; start < n;) {
+      // Chunks stop at head boundaries, which the tail's line up with
+      const int pos = (int)(mClock % kHeadSize);
+      const int count = std::min(n - start, kHeadSize - pos);
+      const int tailPos = (int)(mClock % kTailSize);
+
+      // Tail block j plays from j * kTailSize + kTailStart + kHeadSize
+      if (conv.hasTail && tailPos == kHeadSize && mClock >= kTailDue) {
+        int64_t block = (mClock - kTailDue) / kTailSize;
+        bool current = conv.ackEpoch.load(std::memory_order_acquire) ==
+                       conv.epoch.load(std::memory_order_relaxed);
+        if (current &&
+            conv.tailDone.load(std::memory_order_acquire) > block) {
+          mTailReadSlot = (int)(block % kSlots);
+        } else {
+          mTailReadSlot = -1;
+          mLate.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+      const int readPos = (tailPos - kHeadSize + kTailSize) % kTailSize;
+      const int writeSlot = (int)((mClock / kTailSize) % kSlots);
+
+      for (int c = 0; c < 2; ++c) {
+        float *x = io[c] + start;
+        float *headIn = mHeadIn[c] + pos;
+        const float *headOut = mHeadOut[c] + pos;
+        float *tailIn = conv.tailIn[writeSlot][c] + tailPos;
+        for (int i = 0; i < count; ++i) {
+          headIn[i] = x[i];
+          tailIn[i] = x[i];
+          x[i] = headOut[i];
+        }
+        if (mTailReadSlot >= 0) {
+          const float *tailOut = conv.tailOut[mTailReadSlot][c] + readPos;
+          for (int i = 0; i < count; ++i)
+            x[i] += tailOut[i];
+        }
+        for (int i = 0; i < count; ++i)
+          x[i] *= mMix;
+      }
+
+      mClock += count;
+      start += count;
+      if (mClock % kHeadSize == 0)
+        for (int c = 0; c < 2; ++c)
+          conv.head[c].process(mHeadIn[c], mHeadOut[c]);
+      if (conv.hasTail && mClock % kTailSize == 0) {
+        conv.tailQueued.store(mClock / kTailSize, std::memory_order_release);
+        conv.wake.notify_one();
+      }
+    }
+  }
+
+private:
+  static const int64_t kTailDue = kTailStart + kHeadSize;
+
+  // Audio side state. The tail stages belong to the worker, it's asked to
+  // reset them and its output is ignored until it has.
+  void resetState() {
+    for (int c = 0; c < 2; ++c) {
+      std::fill_n(mHeadIn[c], kHeadSize, 0.0f);
+      std::fill_n(mHeadOut[c], kHeadSize, 0.0f);
+    }
+    mClock = 0;
+    mTailReadSlot = -1;
+    if (!mConv)
+      return;
+    for (int c = 0; c < 2; ++c)
+      mConv->head[c].reset();
+    mConv->tailQueued.store(0, std::memory_order_relaxed);
+    mConv->epoch.fetch_add(1, std::memory_order_release);
+    mConv->wake.notify_one();
+  }
+
+  std::unique_ptr<Convolver> mConv;
+  float mMix = 1.0f;
+  int64_t mClock = 0; // Frames through since the last reset
+
+  float mHeadIn[2][kHeadSize] = {};
+  float mHeadOut[2][kHeadSize] = {};
+  int mTailReadSlot = -1;
+  std::atomic<uint32_t> mLate{0};
+};
+
+#endif // CONVOLUTION_REVERB_FX_H
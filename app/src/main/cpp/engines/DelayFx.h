@@ -1,59 +1,66 @@
 #ifndef DELAY_FX_H
 #define DELAY_FX_H
 
+#include "../DelayLine.h"
 #include "../Utils.h"
 #include <algorithm>
 #include <cmath>
-#include <vector>
 
 namespace DelayDetails {
 class TinyAllPass {
 public:
   void setBufferSize(int size) {
-    mBuffer.assign(size, 0.0f);
-    mSize = size;
+    mLine.setSize(size);
+    mDelay = size - 1;
   }
   float process(float input, float feedback) {
-    float delayed = mBuffer[mReadPos];
+    float delayed = mLine.read(mDelay);
     float out = -input + delayed;
     // Anti-denormal injection for internal feedback loop
-    float newVal = input + delayed * feedback;
-    mBuffer[mReadPos] = newVal + 1.0e-18f;
-    if (std::abs(mBuffer[mReadPos]) < 1.0e-18f)
-      mBuffer[mReadPos] = 0.0f;
-
-    mReadPos = (mReadPos + 1) % mSize;
+    float newVal = input + delayed * feedback + 1.0e-18f;
+    if (std::abs(newVal) < 1.0e-18f)
+      newVal = 0.0f;
+    mLine.write(newVal);
     return out;
   }
+  std::size_t bytes() const { return mLine.bytes(); }
 
 private:
-  std::vector<float> mBuffer;
-  int mSize = 0;
-  int mReadPos = 0;
+  DelayLine<> mLine;
+  int mDelay = 0;
 };
 } // namespace DelayDetails
 
+// The lines start out empty and the delay stays silent until the engine
+// hands it some with swapLines(), sized by capacityFor() for the stream's
+// rate. That way an unused delay costs no memory and the allocation never
+// happens on the audio thread.
 class DelayFx {
 public:
-  DelayFx(int maxDelayFrames = 192000) {
-    mBufferL.assign(maxDelayFrames, 0.0f);
-    mBufferR.assign(maxDelayFrames, 0.0f);
+  static constexpr float kMaxSeconds = 1.5f; // User requested max 1500ms
+
+  DelayFx() {
     for (int i = 0; i < 3; ++i) {
       mDiffL[i].setBufferSize(150 + i * 77);
       mDiffR[i].setBufferSize(163 + i * 81);
     }
   }
 
-  void setDelay(float frames) {
-    if (frames < mBufferL.size())
-      mTargetDelayFrames = frames;
+  // Frames per side for the whole delay range at this rate
+  static int capacityFor(float sampleRate) {
+    return nextPowerOfTwo((int)std::ceil(kMaxSeconds * sampleRate) + 2);
+  }
+  int capacity() const { return mLineL.size(); }
+
+  // Takes fresh lines, handing back the old ones to be freed by the caller.
+  // Whatever was in the old ones is dropped.
+  void swapLines(DelayLine<> &left, DelayLine<> &right) {
+    mLineL.swap(left);
+    mLineR.swap(right);
   }
+
   void setDelayTime(float value) {
-    // User requested max 1500ms
-    float maxFrames = 1.5f * 48000.0f; // 72000
-    mTargetDelayFrames = value * maxFrames;
-    if (mTargetDelayFrames < 1.0f)
-      mTargetDelayFrames = 1.0f;
+    mTargetDelaySeconds = std::max(0.0f, value * kMaxSeconds);
   }
 
   void setFeedback(float feedback) {
@@ -80,9 +87,8 @@ public:
   } // 0=Digital, 1=Tape, 2=PingPong, 3=Reverse
 
   void clear() {
-    std::fill(mBufferL.begin(), mBufferL.end(), 0.0f);
-    std::fill(mBufferR.begin(), mBufferR.end(), 0.0f);
-    mWriteIndex = 0;
+    mLineL.clear();
+    mLineR.clear();
     mSvfZ1L = mSvfZ2L = mSvfZ1R = mSvfZ2R = 0.0f;
     mSmoothedDelay = mTargetDelayFrames;
     mFeedback = mTargetFeedback;
@@ -98,7 +104,13 @@ public:
     if (!std::isfinite(inR))
       inR = 0.0f;
 
+    if (mLineL.empty()) {
+      outL = outR = 0.0f;
+      return;
+    }
+
     // Smooth Transitions
+    mTargetDelayFrames = std::max(1.0f, mTargetDelaySeconds * sampleRate);
     if (!std::isfinite(mTargetDelayFrames))
       mTargetDelayFrames = 11025.0f;
     if (!std::isfinite(mTargetFeedback))
@@ -119,40 +131,14 @@ public:
     mFilterMix += 0.001f * (mTargetFilterMix - mFilterMix);
     mResonance += 0.001f * (mTargetResonance - mResonance);
 
-    float delayedL = 0.0f, delayedR = 0.0f;
-
     // Read from Delay Lines
-    float bufferSize = (float)mBufferL.size();
-    if (bufferSize < 4.0f)
-      return; // Extreme safety
-
     float safeDelay = mSmoothedDelay;
     if (!std::isfinite(safeDelay) || safeDelay < 0.0f)
       safeDelay = 1.0f;
-    if (safeDelay > bufferSize - 2.0f)
-      safeDelay = bufferSize - 2.0f;
-
-    // mWriteIndex points to the NEXT write.
-    // Recent sample is at mWriteIndex - 1.
-    float rp = (float)mWriteIndex - 1.0f - safeDelay;
-    while (rp < 0.0f)
-      rp += bufferSize;
-
-    int i0 = static_cast<int>(rp);
-    if (i0 < 0)
-      i0 = 0;
-    if (i0 >= (int)mBufferL.size())
-      i0 = (int)mBufferL.size() - 1;
-
-    int i1 = (i0 + 1) % mBufferL.size();
-    float frac = rp - static_cast<float>(i0);
-    if (frac < 0.0f)
-      frac = 0.0f;
-    if (frac > 1.0f)
-      frac = 1.0f;
-
-    delayedL = mBufferL[i0] * (1.0f - frac) + mBufferL[i1] * frac;
-    delayedR = mBufferR[i0] * (1.0f - frac) + mBufferR[i1] * frac;
+    safeDelay = std::min(safeDelay, (float)(mLineL.size() - 2));
+
+    float delayedL = mLineL.readLinear(safeDelay);
+    float delayedR = mLineR.readLinear(safeDelay);
 
     if (mType == 1) { // Tape
       delayedL = fast_tanh(delayedL * 1.5f);
@@ -191,7 +177,7 @@ public:
     float cutoff = 20.0f + (mFilterMix * mFilterMix * 19980.0f);
     cutoff = std::max(20.0f, std::min(sampleRate * 0.45f, cutoff));
 
-    float g = tanf(M_PI * cutoff / sampleRate);
+    float g = FastMath::tanPi(cutoff / sampleRate);
     float k = 2.0f - (mResonance * 1.95f);
 
     float filteredL = processFilter(delayedL, mSvfZ1L, mSvfZ2L, g, k);
@@ -218,12 +204,8 @@ public:
     if (std::abs(nextR) < 1.0e-9f)
       nextR = 0.0f;
 
-    mBufferL[mWriteIndex] = fast_tanh(nextL);
-    mBufferR[mWriteIndex] = fast_tanh(nextR);
-    if (mBufferL.size() > 0)
-      mWriteIndex = (mWriteIndex + 1) % mBufferL.size();
-    else
-      mWriteIndex = 0;
+    mLineL.write(fast_tanh(nextL));
+    mLineR.write(fast_tanh(nextR));
 
     // Diffusion Smear (Lushness)
     for (int i = 0; i < 3; i++) {
@@ -233,17 +215,19 @@ public:
 
     outL = filteredL * mMix;
     outR = filteredR * mMix;
+  }
 
-    // Silence tracking
-    if (std::abs(outL) < 1e-9f && std::abs(outR) < 1e-9f) {
-      if (mSilentCounter < 48000)
-        mSilentCounter++;
-    } else {
-      mSilentCounter = 0;
-    }
+  // The gap between two repeats, plus the diffusers trailing each one
+  int tailSamples(float sampleRate) const {
+    return (int)std::max(mSmoothedDelay, mTargetDelayFrames) + kDiffusionTail;
   }
 
-  bool isSilent() const { return mSilentCounter >= 48000; }
+  std::size_t lineBytes() const {
+    std::size_t bytes = mLineL.bytes() + mLineR.bytes();
+    for (int i = 0; i < 3; ++i)
+      bytes += mDiffL[i].bytes() + mDiffR[i].bytes();
+    return bytes;
+  }
 
   float process(float input, float sampleRate = 48000.0f) {
     float l = 0, r = 0;
@@ -252,10 +236,11 @@ public:
   }
 
 private:
-  std::vector<float> mBufferL;
-  std::vector<float> mBufferR;
-  int mWriteIndex = 0;
-  float mTargetDelayFrames = 11025.0f;
+  static const int kDiffusionTail = 768; // The three allpasses end to end
+
+  DelayLine<> mLineL, mLineR;
+  float mTargetDelaySeconds = 11025.0f / 48000.0f;
+  float mTargetDelayFrames = 11025.0f; // At the last block's rate
   float mSmoothedDelay = 11025.0f;
   int mCounter = 1;
   int mPingPongCounter = 0;
@@ -269,7 +254,6 @@ private:
   int mType = 0;
   int mFilterMode = 0; // 0=LP, 1=HP, 2=BP
   DelayDetails::TinyAllPass mDiffL[3], mDiffR[3];
-  uint32_t mSilentCounter = 48000;
 };
 
 #endif // DELAY_FX_H
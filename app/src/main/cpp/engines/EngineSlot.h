@@ -0,0 +1,103 @@
+#ifndef ENGINE_SLOT_H
+#define ENGINE_SLOT_H
+
+#include <mutex>
+#include <new>
+#include <vector>
+
+// Recycles engine storage per type. Switching a track back and forth between
+// engines reuses the same blocks instead of going back to the allocator (and
+// faulting in fresh pages) every time. A couple of spares are kept per type,
+// anything beyond that is freed.
+template <typename T> class EnginePool {
+public:
+  static const int kMaxSpare = 2;
+
+  static void *allocate() {
+    Pool &p = pool();
+    {
+      std::lock_guard<std::mutex> lock(p.mutex);
+      if (!p.spare.empty()) {
+        void *mem = p.spare.back();
+        p.spare.pop_back();
+        return mem;
+      }
+    }
+    return ::operator new(sizeof(T), std::align_val_t(alignof(T)));
+  }
+
+  static void deallocate(void *mem) {
+    Pool &p = pool();
+    {
+      std::lock_guard<std::mutex> lock(p.mutex);
+      if ((int)p.spare.size() < kMaxSpare) {
+        p.spare.push_back(mem);
+        return;
+      }
+    }
+    ::operator delete(mem, std::align_val_t(alignof(T)));
+  }
+
+private:
+  struct Pool {
+    std::mutex mutex;
+    std::vector<void *> spare;
+  };
+  static Pool &pool() {
+    static Pool p;
+    return p;
+  }
+};
+
+// Owning handle for an engine that is only instantiated while a track uses
+// it. Empty by default; create() builds a fresh engine in pooled storage.
+// Engines are built and freed in slots the audio thread can't see, and only
+// moved in and out of a track's under the engine lock, so no extra
+// synchronisation here.
+template <typename T> class EngineSlot {
+public:
+  EngineSlot() = default;
+  ~EngineSlot() { release(); }
+
+  EngineSlot(EngineSlot &&other) noexcept : mEngine(other.mEngine) {
+    other.mEngine = nullptr;
+  }
+  EngineSlot &operator=(EngineSlot &&other) noexcept {
+    if (this != &other) {
+      release();
+      mEngine = other.mEngine;
+      other.mEngine = nullptr;
+    }
+    return *this;
+  }
+  EngineSlot(const EngineSlot &) = delete;
+  EngineSlot &operator=(const EngineSlot &) = delete;
+
+  T *get() const { return mEngine; }
+  T *operator->() const { return mEngine; }
+  T &operator*() const { return *mEngine; }
+  explicit operator bool() const { return mEngine != nullptr; }
+
+  // Returns true if a new engine was built
+  bool create() {
+    if (mEngine)
+      return false;
+    mEngine = new (EnginePool<T>::allocate()) T();
+    return true;
+  }
+
+  void release() {
+    if (!mEngine)
+      return;
+    mEngine->~T();
+    EnginePool<T>::deallocate(mEngine);
+    mEngine = nullptr;
+  }
+
+  static constexpr size_t engineBytes() { return sizeof(T); }
+
+private:
+  T *mEngine = nullptr;
+};
+
+#endif // ENGINE_SLOT_H
@@ -56,7 +56,7 @@ public:
       int shapeIdx = static_cast<int>(mShape * 4.99f);
       switch (shapeIdx) {
       case 0: { // Sine
-        lfoValue = sinf(mPhase * 2.0f * (float)M_PI);
+        lfoValue = FastMath::sin2pi(mPhase);
         break;
       }
       case 1: // Triangle
@@ -84,7 +84,7 @@ public:
     mSmoothedCutoff += 0.01f * (currentCutoff - mSmoothedCutoff);
     mSmoothedRes += 0.01f * (mResonance - mSmoothedRes);
 
-    float targetFreq = 10.0f * powf(2000.0f, mSmoothedCutoff);
+    float targetFreq = 10.0f * FastMath::pow(2000.0f, mSmoothedCutoff);
     targetFreq = std::min(targetFreq, sampleRate * 0.45f);
 
     mSvf.setParams(targetFreq, std::max(0.1f, mSmoothedRes * 4.0f), sampleRate);
@@ -102,6 +102,9 @@ public:
     mSvf.setParams(1000.0f, 0.7f, sampleRate);
   }
 
+  // The LFO can park the cutoff at 10Hz, a period of that ring
+  int tailSamples(float sampleRate) const { return (int)(sampleRate / 10.0f); }
+
 private:
   FilterLfoMode mMode;
   float mRate = 0.5f;
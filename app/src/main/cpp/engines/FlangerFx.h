@@ -1,66 +1,57 @@
 #ifndef FLANGER_FX_H
 #define FLANGER_FX_H
 
+#include "../DelayLine.h"
+#include "../FastMath.h"
 #include <algorithm>
 #include <cmath>
-#include <vector>
 
 class FlangerFx {
 public:
   FlangerFx() {
-    mBuffer.resize(44100, 0.0f); // 1 sec buffer
+    // The deepest sweep, 17ms, up to 192kHz
+    mLine[0].setSize(4096);
+    mLine[1].setSize(4096);
   }
 
-  float process(float input, float sampleRate) {
-    if (mMix <= 0.001f)
-      return 0.0f; // Return 0 if not active (send effect logic)
-    // Actually, if it's an insert, we might want to return input, but this is a
-    // send bus usually. Wait, current FX are parallel sends. So returning 0
-    // means "no effect signal".
-
-    // LFO
-    mPhase += mRate / sampleRate;
-    if (mPhase >= 1.0f)
-      mPhase -= 1.0f;
-
-    float lfoVal =
-        0.5f * (1.0f + std::sin(2.0f * 3.14159265f * mPhase)); // 0..1
-
-    // Delay Time
-    float minDelay = mBaseDelay;
-    float maxDelay = mBaseDelay + 0.006f;
-    float currentDelay = minDelay + (maxDelay - minDelay) * mDepth * lfoVal;
-
-    float delaySamples = currentDelay * sampleRate;
-
-    // Read Pointer
-    float readPos = (float)mWritePos - delaySamples;
-    while (readPos < 0.0f)
-      readPos += mBuffer.size();
-    while (readPos >= mBuffer.size())
-      readPos -= mBuffer.size();
-
-    int i0 = (int)readPos;
-    int i1 = i0 + 1;
-    if (i1 >= mBuffer.size())
-      i1 = 0;
-    float frac = readPos - i0;
-
-    float delayed = mBuffer[i0] * (1.0f - frac) + mBuffer[i1] * frac;
-
-    // Feedback
-    float feedback = delayed * mFeedback;
-
-    // Write
-    float toWrite = input + feedback;
-    if (std::abs(toWrite) < 1.0e-15f)
-      toWrite = 0.0f;
-    mBuffer[mWritePos] = toWrite;
-    mWritePos++;
-    if (mWritePos >= mBuffer.size())
-      mWritePos = 0;
-
-    return delayed * mMix;
+  // In place, wet only. Silent while the mix is down, this is a send. The
+  // delay time follows the LFO at both ends of the block and is ramped in
+  // between.
+  void processBlock(float *left, float *right, int n, float sampleRate) {
+    if (mMix <= 0.001f) {
+      std::fill(left, left + n, 0.0f);
+      std::fill(right, right + n, 0.0f);
+      return;
+    }
+    if (n <= 0)
+      return;
+
+    const float inc = mRate / sampleRate;
+    float delay = delaySamples(mPhase + inc, sampleRate);
+    float end = delaySamples(mPhase + inc * (float)n, sampleRate);
+    const float delayStep = n > 1 ? (end - delay) / (float)(n - 1) : 0.0f;
+    mPhase += inc * (float)n;
+    mPhase -= (float)(int)mPhase;
+
+    const float longest = (float)(mLine[0].size() - 2);
+    for (int i = 0; i < n; ++i) {
+      // Read before this sample goes in, so one less back from the last
+      float back = std::min(delay + delayStep * i - 1.0f, longest);
+      float delayedL = mLine[0].readLinear(back);
+      float delayedR = mLine[1].readLinear(back);
+
+      float toWriteL = left[i] + delayedL * mFeedback;
+      float toWriteR = right[i] + delayedR * mFeedback;
+      if (std::abs(toWriteL) < 1.0e-15f)
+        toWriteL = 0.0f;
+      if (std::abs(toWriteR) < 1.0e-15f)
+        toWriteR = 0.0f;
+      mLine[0].write(toWriteL);
+      mLine[1].write(toWriteR);
+
+      left[i] = delayedL * mMix;
+      right[i] = delayedR * mMix;
+    }
   }
 
   void setParameters(float rate, float depth, float feedback, float mix) {
@@ -71,11 +62,18 @@ public:
   }
 
   void clear() {
-    std::fill(mBuffer.begin(), mBuffer.end(), 0.0f);
-    mWritePos = 0;
+    for (auto &line : mLine)
+      line.clear();
     mPhase = 0.0f;
   }
 
+  // One trip round the feedback loop at the deepest point of the sweep
+  int tailSamples(float sampleRate) const {
+    return (int)((mBaseDelay + 0.006f * mDepth) * sampleRate) + 2;
+  }
+
+  std::size_t lineBytes() const { return mLine[0].bytes() + mLine[1].bytes(); }
+
   void setRate(float v) { mRate = 0.05f + (v * v * v) * 5.0f; }
   void setDepth(float v) { mDepth = v; }
   void setFeedback(float v) { mFeedback = v * 0.95f; }
@@ -85,8 +83,13 @@ public:
   void setMix(float v) { mMix = v; }
 
 private:
-  std::vector<float> mBuffer;
-  int mWritePos = 0;
+  float delaySamples(float phase, float sampleRate) const {
+    float lfoVal = 0.5f * (1.0f + FastMath::sin2pi(phase)); // 0..1
+    // Sweeps 6ms up from the base delay
+    return (mBaseDelay + 0.006f * mDepth * lfoVal) * sampleRate;
+  }
+
+  DelayLine<> mLine[2];
   float mPhase = 0.0f;
 
   float mRate = 0.5f;
@@ -248,12 +248,31 @@ public:
   }
 
   float render() {
-    float mixed = 0.0f;
-    for (int i = 0; i < 8; ++i) {
-      mLastRenders[i] = mEngines[i].render() * mGains[i];
-      mixed += mLastRenders[i];
+    float out;
+    renderBlock(&out, 1);
+    return out;
+  }
+
+  void renderBlock(float *out, int n) {
+    while (n > FmEngine::kMaxBlock) {
+      renderBlock(out, FmEngine::kMaxBlock);
+      out += FmEngine::kMaxBlock;
+      n -= FmEngine::kMaxBlock;
+    }
+    std::fill(out, out + n, 0.0f);
+    for (int d = 0; d < 8; ++d) {
+      if (!mEngines[d].isActive()) {
+        mLastRenders[d] = 0.0f;
+        continue;
+      }
+      mEngines[d].renderBlock(mScratch, n);
+      for (int i = 0; i < n; ++i)
+        out[i] += mScratch[i] * mGains[d];
+      mLastRenders[d] = mScratch[n - 1] * mGains[d];
     }
-    return std::tanh(mixed * 1.1f); // Reduced boost + cleaner saturation
+    for (int i = 0; i < n; ++i)
+      out[i] *= 1.1f; // Reduced boost + cleaner saturation
+    FastMath::tanhBlock(out, out, n);
   }
 
   void setVoiceGain(int index, float gain) {
@@ -279,6 +298,7 @@ public:
 private:
   FmEngine mEngines[8];
   float mLastRenders[8] = {0.0f};
+  float mScratch[FmEngine::kMaxBlock];
   float mGains[8] = {0.65f, 0.65f, 0.65f, 0.65f, 0.65f, 0.65f, 0.65f, 0.65f};
 };
 
@@ -2,7 +2,9 @@
 #define FM_ENGINE_H
 
 #include "../Utils.h"
+#include "../Waveshaper.h"
 #include "Adsr.h"
+#include "VoiceAllocator.h"
 #include <algorithm>
 #include <android/log.h>
 #include <cmath>
@@ -33,6 +35,21 @@ public:
     return out * (mUseEnvelope ? mEnvelope.nextValue() : 1.0f);
   }
 
+  // Block path: envelope rendered up front by renderEnvelope()
+  inline float nextSample(float modulation, float pitchMod, float env) {
+    mPhase += mPhaseInc * pitchMod;
+    if (mPhase >= 1.0)
+      mPhase -= 1.0;
+    return FastSine::get(mPhase + modulation) * env;
+  }
+
+  void renderEnvelope(float *env, int n) {
+    if (mUseEnvelope)
+      mEnvelope.process(env, n);
+    else
+      std::fill(env, env + n, 1.0f);
+  }
+
   void trigger() {
     mPhase = 0.0;
     mEnvelope.trigger();
@@ -63,6 +80,7 @@ public:
     float pitchEnv = 1.0f;
     float pitchEnvDecay = 0.001f;
     Adsr masterEnv;
+    AntiAliasedShaper<shapes::SoftClip> saturator;
     uint32_t controlCounter = 0;
 
     void reset() {
@@ -76,6 +94,7 @@ public:
       lastOp5Out = 0.0f;
       op5FeedbackHistory = 0.0f;
       masterEnv.reset();
+      saturator.reset();
       controlCounter = 0;
     }
   };
@@ -123,6 +142,7 @@ public:
       v.active = false;
       v.masterEnv.reset();
     }
+    mVoiceAlloc.clearAll();
   }
 
   void setAlgorithm(int algo) { mAlgorithm = std::max(0, std::min(4, algo)); }
@@ -165,24 +185,20 @@ public:
   void setPitchSweep(float sweep) { mPitchSweepAmount = sweep; }
 
   void triggerNote(int note, int velocity) {
-    int idx = -1;
-    for (int i = 0; i < 16; ++i)
-      if (!mVoices[i].active) {
-        idx = i;
-        break;
-      }
+    int idx = mVoiceAlloc.freeVoice((int)mVoices.size());
     if (idx == -1)
-      idx = 0;
+      idx = mVoiceAlloc.victim([this](int i) { return keepScore(i); }, false);
 
     Voice &v = mVoices[idx];
     v.reset();
     v.active = true;
+    mVoiceAlloc.setActive(idx);
     v.note = note;
     v.amplitude = velocity / 127.0f;
 
     float baseFreq = mIgnoreNoteFrequency
                          ? mFrequency
-                         : 440.0f * powf(2.0f, (note - 69) / 12.0f);
+                         : FastMath::noteToFreq((float)note);
     v.targetFrequency = baseFreq;
     v.frequency = (mGlide > 0.001f) ? mLastFrequency : baseFreq;
     mLastFrequency = baseFreq;
@@ -265,6 +281,9 @@ public:
       }
     } else if (id == 355) {
       setGlide(value);
+    } else if (id == 357) { // Saturation anti-aliasing, see AntiAlias
+      for (auto &v : mVoices)
+        v.saturator.setMode((AntiAlias)(int)value);
     }
   }
 
@@ -446,43 +465,160 @@ public:
     }
   }
 
-  float render() {
-    float mixedOutput = 0.0f;
-    int activeCount = 0;
+  static const int kMaxBlock = 256;
 
-    for (auto &v : mVoices) {
+  // Renders n mono samples. The algorithm kernel is picked once per block,
+  // voices then run back to back so their state stays in registers.
+  void renderBlock(float *out, int n) {
+    while (n > kMaxBlock) {
+      renderBlock(out, kMaxBlock);
+      out += kMaxBlock;
+      n -= kMaxBlock;
+    }
+    std::fill(out, out + n, 0.0f);
+    std::fill(mBlockVoices, mBlockVoices + n, 0);
+
+    const VoiceKernel kernel = kernelFor(mAlgorithm);
+    for (uint32_t m = mVoiceAlloc.mask(); m; m &= m - 1) {
+      const int i = __builtin_ctz(m);
+      Voice &v = mVoices[i];
+      if (v.active)
+        (this->*kernel)(v, out, n);
       if (!v.active)
-        continue;
-      float mEnv = v.masterEnv.nextValue();
-      if (mEnv < 0.0001f && !v.masterEnv.isActive()) {
-        v.active = false;
-        continue;
-      }
+        mVoiceAlloc.clear(i);
+    }
+
+    for (int i = 0; i < n; ++i)
+      if (mBlockVoices[i] > 1)
+        out[i] *= 0.7f;
+  }
+
+  float render() {
+    float out;
+    renderBlock(&out, 1);
+    return out;
+  }
+
+
+  bool isActive() const { return mVoiceAlloc.any(); }
+
+  // For the profile report: per sample cost of all playing voices
+  AntiAlias antiAlias() const { return mVoices[0].saturator.mode(); }
+  float shaperCostNs() const {
+    float ns = 0.0f;
+    mVoiceAlloc.forEach([&](int i) { ns += mVoices[i].saturator.costNs(); });
+    return ns;
+  }
+
+  // Global voice budget, see AudioEngine::enforceVoiceLimit
+  int liveVoiceCount() const { return mVoiceAlloc.liveCount(); }
+  int stealCandidate(float &score) const {
+    return mVoiceAlloc.victim([this](int i) { return keepScore(i); }, true,
+                              &score);
+  }
+  void stealVoice(int i) {
+    mVoices[i].masterEnv.fastRelease();
+    mVoiceAlloc.markStolen(i);
+  }
+
+private:
+  float keepScore(int i) const {
+    const Voice &v = mVoices[i];
+    return v.amplitude * v.masterEnv.keepLevel() +
+           (v.masterEnv.isReleasing() ? 0.0f : 1.0f);
+  }
+
+  using VoiceKernel = void (FmEngine::*)(Voice &, float *, int);
+
+  VoiceKernel kernelFor(int algorithm) const {
+    switch (algorithm) {
+    case 0:
+      return &FmEngine::renderVoice<0>;
+    case 1:
+      return &FmEngine::renderVoice<1>;
+    case 2:
+      return &FmEngine::renderVoice<2>;
+    default:
+      return &FmEngine::renderVoice<3>;
+    }
+  }
+
+  // Operator topology, resolved at compile time per algorithm
+  template <int Algo>
+  static inline void runOperators(Voice &v, float *o, float fbIn,
+                                  float pitchMod, float modScale,
+                                  float velModScale,
+                                  const float (*env)[kMaxBlock], int i) {
+    FmOperator *op = v.operators;
+    if constexpr (Algo == 2) { // Parallel
+      for (int k = 0; k < 6; ++k)
+        o[k] = op[k].nextSample(fbIn, pitchMod, env[k][i]) * velModScale;
+    } else {
+      o[5] = op[5].nextSample(fbIn, pitchMod, env[5][i]) * velModScale;
+      o[4] = op[4].nextSample(o[5] * modScale, pitchMod, env[4][i]) *
+             velModScale;
+      o[3] = op[3].nextSample(o[4] * modScale, pitchMod, env[3][i]) *
+             velModScale;
+      if constexpr (Algo == 0) // Serial
+        o[2] = op[2].nextSample(o[3] * modScale, pitchMod, env[2][i]) *
+               velModScale;
+      else if constexpr (Algo == 1) // 2 Branches
+        o[2] = op[2].nextSample(fbIn, pitchMod, env[2][i]) * velModScale;
+      else // Branching
+        o[2] = op[2].nextSample(o[5] * modScale, pitchMod, env[2][i]) *
+               velModScale;
+      o[1] = op[1].nextSample(o[2] * modScale, pitchMod, env[1][i]) *
+             velModScale;
+      o[0] = op[0].nextSample(o[1] * modScale, pitchMod, env[0][i]);
+    }
+  }
+
+  template <int Algo> void renderVoice(Voice &v, float *out, int n) {
+    // Block constants
+    const float modScale = mBrightness;
+    const float fbDrive = 1.0f + mFeedbackDrive * 3.0f;
+    const float velModScale = 1.0f - (0.6f * (1.0f - v.amplitude));
+    const float cutoffHz =
+        20.0f *
+        FastMath::pow(900.0f, std::max(0.001f, std::min(0.999f, mCutoff)));
+    const float resonance = 0.7f + mResonance * 4.0f;
+    const TSvf::Type filterType = (TSvf::Type)mFilterMode;
+    float carrier[6];
+    for (int i = 0; i < 6; ++i)
+      carrier[i] = (mCarrierMask & (1 << i)) ? mOpLevels[i] : 0.0f;
+
+    // Envelopes for the whole block; the voice ends where the master does
+    float masterEnv[kMaxBlock];
+    float opEnv[6][kMaxBlock];
+    const int live = v.masterEnv.process(masterEnv, n);
+    for (int k = 0; k < 6; ++k)
+      v.operators[k].renderEnvelope(opEnv[k], live);
+    if (live < n)
+      v.active = false;
+
+    for (int i = 0; i < live; ++i) {
+      const float mEnv = masterEnv[i];
 
       if (mGlide > 0.001f) {
         float glideTimeSamples = mGlide * mSampleRate * 0.5f;
         float glideAlpha = 1.0f / (glideTimeSamples + 1.0f);
         v.frequency += (v.targetFrequency - v.frequency) * glideAlpha;
-        for (int i = 0; i < 6; ++i) {
-          v.operators[i].setFrequency(v.frequency, mOpRatios[i], mSampleRate);
-        }
+        for (int k = 0; k < 6; ++k)
+          v.operators[k].setFrequency(v.frequency, mOpRatios[k], mSampleRate);
       } else {
         v.frequency = v.targetFrequency;
-        // Optimization: periodically update op frequencies if ratios changed
+        // Periodically pick up ratio changes
         if (v.controlCounter % 256 == 0) {
-          for (int i = 0; i < 6; ++i)
-            v.operators[i].setFrequency(v.frequency, mOpRatios[i], mSampleRate);
+          for (int k = 0; k < 6; ++k)
+            v.operators[k].setFrequency(v.frequency, mOpRatios[k], mSampleRate);
         }
       }
 
-      activeCount++;
+      mBlockVoices[i]++;
 
-      float velModScale = 1.0f - (0.6f * (1.0f - v.amplitude));
       float fbSignal = (v.op5FeedbackHistory + v.lastOp5Out) * 0.5f;
       // Soft-clip feedback to prevent runaway noise
-      fbSignal = fast_tanh(fbSignal * (1.0f + mFeedbackDrive * 3.0f));
-      float fbIn = fbSignal * mFeedback;
-      float modScale = mBrightness;
+      float fbIn = fast_tanh(fbSignal * fbDrive) * mFeedback;
 
       // Pitch Sweep Logic
       float pitchMod = 1.0f + (v.pitchEnv * mPitchSweepAmount);
@@ -491,74 +627,25 @@ public:
         v.pitchEnv = 0.0f;
 
       float o[6];
-      if (mAlgorithm == 0) { // Serial
-        o[5] = v.operators[5].nextSample(fbIn, pitchMod) * velModScale;
-        o[4] =
-            v.operators[4].nextSample(o[5] * modScale, pitchMod) * velModScale;
-        o[3] =
-            v.operators[3].nextSample(o[4] * modScale, pitchMod) * velModScale;
-        o[2] =
-            v.operators[2].nextSample(o[3] * modScale, pitchMod) * velModScale;
-        o[1] =
-            v.operators[1].nextSample(o[2] * modScale, pitchMod) * velModScale;
-        o[0] = v.operators[0].nextSample(o[1] * modScale, pitchMod);
-      } else if (mAlgorithm == 1) { // 2 Branches
-        o[5] = v.operators[5].nextSample(fbIn, pitchMod) * velModScale;
-        o[4] =
-            v.operators[4].nextSample(o[5] * modScale, pitchMod) * velModScale;
-        o[3] =
-            v.operators[3].nextSample(o[4] * modScale, pitchMod) * velModScale;
-        o[2] = v.operators[2].nextSample(fbIn, pitchMod) * velModScale;
-        o[1] =
-            v.operators[1].nextSample(o[2] * modScale, pitchMod) * velModScale;
-        o[0] = v.operators[0].nextSample(o[1] * modScale, pitchMod);
-      } else if (mAlgorithm == 2) { // Parallel
-        for (int i = 0; i < 6; ++i)
-          o[i] = v.operators[i].nextSample(fbIn, pitchMod) * velModScale;
-      } else { // Branching
-        o[5] = v.operators[5].nextSample(fbIn, pitchMod) * velModScale;
-        o[4] =
-            v.operators[4].nextSample(o[5] * modScale, pitchMod) * velModScale;
-        o[3] =
-            v.operators[3].nextSample(o[4] * modScale, pitchMod) * velModScale;
-        o[2] =
-            v.operators[2].nextSample(o[5] * modScale, pitchMod) * velModScale;
-        o[1] =
-            v.operators[1].nextSample(o[2] * modScale, pitchMod) * velModScale;
-        o[0] = v.operators[0].nextSample(o[1] * modScale, pitchMod);
-      }
+      runOperators<Algo>(v, o, fbIn, pitchMod, modScale, velModScale, opEnv,
+                         i);
 
-      float out = 0.0f;
-      for (int i = 0; i < 6; ++i)
-        if (mCarrierMask & (1 << i))
-          out += o[i] * mOpLevels[i];
+      float sum = o[0] * carrier[0] + o[1] * carrier[1] + o[2] * carrier[2] +
+                  o[3] * carrier[3] + o[4] * carrier[4] + o[5] * carrier[5];
 
       v.op5FeedbackHistory = v.lastOp5Out;
       v.lastOp5Out = o[5];
 
-      float cutoffNormalized = std::max(0.001f, std::min(0.999f, mCutoff));
-      if (v.controlCounter++ % 16 == 0) {
-        float freq = 20.0f * powf(900.0f, cutoffNormalized);
-        v.svf.setParams(freq, 0.7f + mResonance * 4.0f, mSampleRate);
-      }
-      float filtered =
-          v.svf.process(out * v.amplitude * mEnv, (TSvf::Type)mFilterMode);
-      mixedOutput += fast_tanh(filtered);
+      if (v.controlCounter++ % 16 == 0)
+        v.svf.setParamsSmooth(cutoffHz, resonance, mSampleRate, 16);
+      float filtered = v.svf.process(sum * v.amplitude * mEnv, filterType);
+      out[i] += v.saturator.process(filtered);
     }
-    if (activeCount > 1)
-      mixedOutput *= 0.7f;
-    return mixedOutput;
-  }
-
-  bool isActive() const {
-    for (const auto &v : mVoices)
-      if (v.active)
-        return true;
-    return false;
   }
 
-private:
+  uint8_t mBlockVoices[kMaxBlock] = {0};
   std::vector<Voice> mVoices;
+  VoiceAllocator mVoiceAlloc;
   std::vector<float> mOpLevels, mOpRatios, mOpAttack, mOpDecay, mOpSustain,
       mOpRelease;
   float mCutoff = 0.5f, mResonance = 0.0f, mBrightness = 1.0f, mDetune = 0.0f,
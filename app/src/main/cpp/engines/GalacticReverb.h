@@ -1,6 +1,8 @@
 #ifndef GALACTIC_REVERB_H
 #define GALACTIC_REVERB_H
 
+#include "../DelayLine.h"
+#include "../FastMath.h"
 #include <algorithm>
 #include <cmath>
 #include <vector>
@@ -8,59 +10,15 @@
 // Helper Classes for Dattorro Reverb
 namespace Galactic {
 
-class DelayLine {
-public:
-  void setBufferSize(int size) {
-    mBuffer.assign(size, 0.0f);
-    mSize = size;
-    mWritePos = 0;
-  }
-
-  void clear() {
-    std::fill(mBuffer.begin(), mBuffer.end(), 0.0f);
-    mWritePos = 0;
-  }
-
-  inline void write(float input) {
-    mBuffer[mWritePos] = input;
-    if (++mWritePos >= mSize)
-      mWritePos = 0;
-  }
-
-  inline float read(int delaySamps) const {
-    // mWritePos points to the index for the NEXT write.
-    // The most recent sample is at mWritePos - 1.
-    int readPos = (mWritePos - 1) - delaySamps;
-    while (readPos < 0)
-      readPos += mSize;
-    return mBuffer[readPos];
-  }
-
-  // Linear Interpolation for Modulation
-  inline float readMod(float delaySamps) const {
-    int i1 = (int)delaySamps;
-    int i2 = i1 + 1;
-    float frac = delaySamps - i1;
-
-    int p1 = mWritePos - i1;
-    while (p1 < 0)
-      p1 += mSize;
-    int p2 = mWritePos - i2;
-    while (p2 < 0)
-      p2 += mSize;
-
-    return mBuffer[p1] * (1.0f - frac) + mBuffer[p2] * frac;
-  }
-
-private:
-  std::vector<float> mBuffer;
-  int mSize = 0;
-  int mWritePos = 0;
-};
+// Frames the block path runs through one stage before moving to the next.
+// Every way back into a buffer is longer than this (the shortest is an
+// input allpass at 107 samples), so no sample in a chunk depends on another
+// one computed in the same chunk and each stage is a flat loop.
+static const int kChunk = 64;
 
 class AllPass {
 public:
-  void setBufferSize(int size) { mDelay.setBufferSize(size); }
+  void setBufferSize(int size) { mDelay.setSize(size); }
   void clear() { mDelay.clear(); }
   inline float process(float input, float feedback) {
     float delayed = mDelay.read(mDelaySize - 1);
@@ -93,12 +51,29 @@ public:
     return bufOut - inVal * feedback;
   }
 
+  // processDiffusion() over a block, in place. n <= size + 1.
+  void diffuseBlock(float *x, int n, float feedback) {
+    alignas(16) float v[kChunk];
+    mDelay.readNext(v, n, mDelaySize);
+    for (int i = 0; i < n; ++i) {
+      float bufOut = v[i];
+      float inVal = x[i] + bufOut * feedback;
+      v[i] = inVal;
+      x[i] = bufOut - inVal * feedback;
+    }
+    mDelay.writeBlock(v, n);
+  }
+
   inline float read(int delaySamps) const { return mDelay.read(delaySamps); }
+  std::size_t bytes() const { return mDelay.bytes(); }
+  void addLast(float *acc, int n, int delaySamps, float gain) const {
+    mDelay.addLast(acc, n, delaySamps, gain);
+  }
 
   void setSize(int s) { mDelaySize = s; }
 
 private:
-  DelayLine mDelay;
+  DelayLine<> mDelay;
   int mDelaySize = 0;
 };
 
@@ -106,8 +81,12 @@ private:
 
 class GalacticReverb {
 public:
+  // Tank is the Dattorro plate. Fdn is a denser and cheaper feedback delay
+  // network with no modulation.
+  enum class Algorithm { Tank, Fdn };
+
   GalacticReverb() {
-    mPreDelay.setBufferSize(9600); // 200ms max
+    mPreDelay.setSize(9600); // 200ms max
 
     // Dattorro fixed sizes (approximate for 48kHz)
     mInputAP[0].setBufferSize(1000);
@@ -120,15 +99,18 @@ public:
     mInputAP[3].setSize(277);
 
     // Tank sizes
-    mDelayL.setBufferSize(8000);
+    mDelayL.setSize(8000);
     mLoopAPL.setBufferSize(4000);
     mLoopAPL.setSize(672);
-    mDelayAfterAPL.setBufferSize(6000);
+    mDelayAfterAPL.setSize(6000);
 
-    mDelayR.setBufferSize(8000);
+    mDelayR.setSize(8000);
     mLoopAPR.setBufferSize(4000);
     mLoopAPR.setSize(908);
-    mDelayAfterAPR.setBufferSize(6000);
+    mDelayAfterAPR.setSize(6000);
+
+    mFdnLines.assign(kFdnFrames * kFdnLines, FxDelaySample());
+    updateFdn();
   }
 
   void clear() {
@@ -144,143 +126,44 @@ public:
     mFilterL = mFilterR = 0.0f;
     mToneFilterL = mToneFilterR = 0.0f;
     mModPhase = 0.0f;
+    std::fill(mFdnLines.begin(), mFdnLines.end(), FxDelaySample());
+    std::fill(mFdnDamp, mFdnDamp + kFdnLines, 0.0f);
+    mFdnPos = 0;
   }
 
   void processStereoWet(float inL, float inR, float &outL, float &outR) {
-    if (!std::isfinite(inL) || !std::isfinite(inR)) {
-      outL = outR = 0.0f;
-      return;
-    }
-
-    float mono = (inL + inR) * 0.5f;
-
-    // Anti-denormal injection (DC offset to prevent CPU spikes at silence)
-    mono += 1.0e-18f;
-
-    // Pre-Delay
-    mPreDelay.write(mono);
-    // Ensure pre-delay value is safe
-    float readPoint = mPreDelayMilli * 0.001f * mSampleRate;
-    if (readPoint < 0.0f)
-      readPoint = 0.0f;
-    if (readPoint > 9590.0f)
-      readPoint = 9590.0f;
-
-    float input = mPreDelay.read((int)readPoint);
-
-    // Diffusion
-    input = mInputAP[0].processDiffusion(input, 0.5f);
-    input = mInputAP[1].processDiffusion(input, 0.5f);
-    input = mInputAP[2].processDiffusion(input, 0.5f);
-    input = mInputAP[3].processDiffusion(input, 0.5f);
-
-    // Modulation
-    mModPhase += 0.0001f + mModDepth * 0.001f;
-    if (mModPhase > 1.0f)
-      mModPhase -= 1.0f;
-    float mod = 15.0f * (0.5f + 0.5f * sinf(mModPhase * 2.0f * 3.14159f));
-
-    // Right branch feedback into Left loop
-    float readR = mDelayAfterAPR.read(
-        3000); // 4200 sample delay point? Dattorro uses taps.
-    // Let's use simplified taps for standard tank
-    float sideR = readR * mFeedback;
-
-    // Safety Clamping
-    if (!std::isfinite(sideR))
-      sideR = 0.0f;
-    sideR = std::max(-2.0f, std::min(2.0f, sideR));
-
-    float leftIn = input + sideR;
-
-    float apLOut = mLoopAPL.processDiffusion(
-        leftIn, 0.5f); // 0.7 used in some, 0.5 in Dattorro
-    mDelayL.write(apLOut);
-    float delayLOut = mDelayL.readMod(4000 + mod); // Modulated 4453
-
-    // Damping L
-    mFilterL += mDamp * (delayLOut - mFilterL);
-    if (!std::isfinite(mFilterL))
-      mFilterL = 0.0f;
-    float dampenedL = std::max(
-        -2.0f,
-        std::min(
-            2.0f,
-            mFilterL *
-                mDecay)); // Decay separate from feedback? Dattorro combines
-
-    // Tone L (New)
-    mToneFilterL += mTone * (dampenedL - mToneFilterL) + 1.0e-18f;
-    if (!std::isfinite(mToneFilterL) || std::abs(mToneFilterL) < 1.0e-18f)
-      mToneFilterL = 0.0f;
-    float tonedL = mToneFilterL;
-
-    mDelayAfterAPL.write(tonedL);
-
-    // Left branch feedback into Right loop
-    float readL = mDelayAfterAPL.read(3000);
-    float sideL = readL * mFeedback;
-
-    // Safety Clamping
-    if (!std::isfinite(sideL))
-      sideL = 0.0f;
-    sideL = std::max(-2.0f, std::min(2.0f, sideL));
-
-    float rightIn = input + sideL;
-
-    float apROut = mLoopAPR.processDiffusion(rightIn, 0.5f);
-    mDelayR.write(apROut);
-    float delayROut = mDelayR.readMod(4200 - mod); // Inverse mod
-
-    // Damping R
-    mFilterR += mDamp * (delayROut - mFilterR);
-    if (!std::isfinite(mFilterR))
-      mFilterR = 0.0f;
-    float dampenedR = std::max(-2.0f, std::min(2.0f, mFilterR * mDecay));
-
-    // Tone R (New)
-    mToneFilterR += mTone * (dampenedR - mToneFilterR) + 1.0e-18f;
-    if (!std::isfinite(mToneFilterR) || std::abs(mToneFilterR) < 1.0e-18f)
-      mToneFilterR = 0.0f;
-    float tonedR = mToneFilterR;
-
-    mDelayAfterAPR.write(tonedR);
-
-    // Dattorro extraction taps for "Lush" sound (Plate extraction style)
-    // Left: Taps from Right Tank half-delays and Allpasses
-    // Right: Taps from Left Tank half-delays and Allpasses
-
-    float wetL = (mDelayAfterAPR.read(266) + mDelayAfterAPR.read(2974) -
-                  mLoopAPR.read(1913) + mDelayAfterAPR.read(1996) -
-                  mDelayAfterAPL.read(1990) - mLoopAPL.read(187) -
-                  mDelayAfterAPL.read(1066)) *
-                 mMix * 0.8f; // Reduced from 1.5f to fix loudness
-
-    float wetR = (mDelayAfterAPL.read(353) + mDelayAfterAPL.read(3627) -
-                  mLoopAPL.read(1228) + mDelayAfterAPL.read(2673) -
-                  mDelayAfterAPR.read(2111) - mLoopAPR.read(335) -
-                  mDelayAfterAPR.read(121)) *
-                 mMix * 0.8f;
+    processBlockWet(&inL, &inR, &outL, &outR, 1);
+  }
 
-    // Global Panic Check: Reset if audio becomes non-finite
-    if (!std::isfinite(wetL) || !std::isfinite(wetR)) {
-      clear();
-      wetL = wetR = 0.0f;
+  // Wet only. Runs in chunks of Galactic::kChunk, see there.
+  void processBlockWet(const float *inL, const float *inR, float *outL,
+                       float *outR, int n) {
+    for (int start = 0; start < n; start += Galactic::kChunk) {
+      int count = std::min(Galactic::kChunk, n - start);
+      processChunk(inL + start, inR + start, outL + start, outR + start,
+                   count);
     }
+  }
 
-    outL = wetL;
-    outR = wetR;
-
-    // Silence tracking
-    if (std::abs(wetL) < 1e-9f && std::abs(wetR) < 1e-9f) {
-      if (mSilentCounter < 48000)
-        mSilentCounter++;
-    } else {
-      mSilentCounter = 0;
-    }
+  // Pre-delay, then the longest way in to an output tap: through the
+  // diffusers and round one side of the tank, or along the longest line
+  int tailSamples(float sampleRate) const {
+    int preDelay = (int)(mPreDelayMilli * 0.001f * mSampleRate);
+    if (mAlgorithm == Algorithm::Fdn)
+      return preDelay + *std::max_element(mFdnLength, mFdnLength + kFdnLines);
+    return preDelay + kTankSpan;
   }
 
-  bool isSilent() const { return mSilentCounter >= 48000; }
+  // Delay memory held, for the footprint report
+  std::size_t lineBytes() const {
+    std::size_t bytes = mPreDelay.bytes() + mLoopAPL.bytes() +
+                        mLoopAPR.bytes() + mDelayL.bytes() + mDelayR.bytes() +
+                        mDelayAfterAPL.bytes() + mDelayAfterAPR.bytes() +
+                        mFdnLines.size() * sizeof(FxDelaySample);
+    for (const auto &ap : mInputAP)
+      bytes += ap.bytes();
+    return bytes;
+  }
 
   // Parameter Setters
   void setSize(float v) {
@@ -289,9 +172,22 @@ public:
     // If Space (type 3), reduce max feedback to 70%
     if (mType == 3)
       mDecay = 0.3f + v * 0.4f; // Max 0.7
+    updateFdn();
   }
 
-  void setSampleRate(float sr) { mSampleRate = sr; }
+  void setSampleRate(float sr) {
+    mSampleRate = sr;
+    updateFdn();
+  }
+
+  // Switching drops the tail, the other algorithm's state is stale
+  void setAlgorithm(Algorithm a) {
+    if (a == mAlgorithm)
+      return;
+    mAlgorithm = a;
+    clear();
+  }
+  Algorithm getAlgorithm() const { return mAlgorithm; }
   void setDamp(float v) { mDamp = 0.05f + (1.0f - v) * 0.8f; } // Lowpass coeff
   void setDamping(float v) { setDamp(v); }
   void setModDepth(float v) { mModDepth = v; }
@@ -324,6 +220,197 @@ public:
   void setToneParam(float v) { setTone(v); }
 
 private:
+  void processChunk(const float *inL, const float *inR, float *outL,
+                    float *outR, int n) {
+    alignas(16) float input[Galactic::kChunk];
+    for (int i = 0; i < n; ++i) {
+      float mono = (inL[i] + inR[i]) * 0.5f;
+      if (!std::isfinite(mono))
+        mono = 0.0f;
+      // Anti-denormal injection (DC offset to prevent CPU spikes at silence)
+      input[i] = mono + 1.0e-18f;
+    }
+
+    // Pre-Delay
+    mPreDelay.writeBlock(input, n);
+    float readPoint = mPreDelayMilli * 0.001f * mSampleRate;
+    readPoint = std::max(0.0f, std::min(9590.0f, readPoint));
+    mPreDelay.readLast(input, n, (int)readPoint);
+
+    if (mAlgorithm == Algorithm::Fdn)
+      processFdn(input, outL, outR, n);
+    else
+      processTank(input, outL, outR, n);
+
+    // Global Panic Check: Reset if audio becomes non-finite
+    bool finite = true;
+    for (int i = 0; i < n; ++i)
+      finite &= std::isfinite(outL[i]) && std::isfinite(outR[i]);
+    if (!finite) {
+      clear();
+      std::fill(outL, outL + n, 0.0f);
+      std::fill(outR, outR + n, 0.0f);
+    }
+  }
+
+  void processTank(float *input, float *outL, float *outR, int n) {
+    const int kChunk = Galactic::kChunk;
+    alignas(16) float mod[kChunk], delays[kChunk];
+    alignas(16) float side[kChunk], branch[kChunk];
+
+    // Diffusion
+    for (auto &ap : mInputAP)
+      ap.diffuseBlock(input, n, 0.5f);
+
+    // Modulation
+    const float inc = 0.0001f + mModDepth * 0.001f;
+    for (int i = 0; i < n; ++i)
+      mod[i] = mModPhase + inc * (float)(i + 1);
+    mModPhase += inc * (float)n;
+    while (mModPhase > 1.0f)
+      mModPhase -= 1.0f;
+    FastMath::sin2piBlock(mod, mod, n);
+    for (int i = 0; i < n; ++i)
+      mod[i] = 15.0f * (0.5f + 0.5f * mod[i]);
+
+    // Right branch feedback into Left loop. The chunk is shorter than the
+    // 3000 sample tap, so it only sees what the right side wrote before.
+    mDelayAfterAPR.readNext(side, n, 3000);
+    for (int i = 0; i < n; ++i)
+      branch[i] =
+          input[i] + std::max(-2.0f, std::min(2.0f, side[i] * mFeedback));
+    mLoopAPL.diffuseBlock(branch, n, 0.5f); // 0.7 used in some, 0.5 in Dattorro
+    mDelayL.writeBlock(branch, n);
+    // 4000 back from the next write, counted from the last one
+    for (int i = 0; i < n; ++i)
+      delays[i] = 3999.0f + mod[i]; // Modulated 4453
+    mDelayL.readLinearLast(branch, delays, n);
+    dampAndTone(branch, n, mFilterL, mToneFilterL);
+    mDelayAfterAPL.writeBlock(branch, n);
+
+    // Left branch feedback into Right loop
+    mDelayAfterAPL.readLast(side, n, 3000);
+    for (int i = 0; i < n; ++i)
+      branch[i] =
+          input[i] + std::max(-2.0f, std::min(2.0f, side[i] * mFeedback));
+    mLoopAPR.diffuseBlock(branch, n, 0.5f);
+    mDelayR.writeBlock(branch, n);
+    for (int i = 0; i < n; ++i)
+      delays[i] = 4199.0f - mod[i]; // Inverse mod
+    mDelayR.readLinearLast(branch, delays, n);
+    dampAndTone(branch, n, mFilterR, mToneFilterR);
+    mDelayAfterAPR.writeBlock(branch, n);
+
+    // Dattorro extraction taps for "Lush" sound (Plate extraction style)
+    // Left: Taps from Right Tank half-delays and Allpasses
+    // Right: Taps from Left Tank half-delays and Allpasses
+    std::fill(outL, outL + n, 0.0f);
+    std::fill(outR, outR + n, 0.0f);
+    mDelayAfterAPR.addLast(outL, n, 266, 1.0f);
+    mDelayAfterAPR.addLast(outL, n, 2974, 1.0f);
+    mLoopAPR.addLast(outL, n, 1913, -1.0f);
+    mDelayAfterAPR.addLast(outL, n, 1996, 1.0f);
+    mDelayAfterAPL.addLast(outL, n, 1990, -1.0f);
+    mLoopAPL.addLast(outL, n, 187, -1.0f);
+    mDelayAfterAPL.addLast(outL, n, 1066, -1.0f);
+
+    mDelayAfterAPL.addLast(outR, n, 353, 1.0f);
+    mDelayAfterAPL.addLast(outR, n, 3627, 1.0f);
+    mLoopAPL.addLast(outR, n, 1228, -1.0f);
+    mDelayAfterAPL.addLast(outR, n, 2673, 1.0f);
+    mDelayAfterAPR.addLast(outR, n, 2111, -1.0f);
+    mLoopAPR.addLast(outR, n, 335, -1.0f);
+    mDelayAfterAPR.addLast(outR, n, 121, -1.0f);
+
+    const float gain = mMix * 0.8f; // Reduced from 1.5f to fix loudness
+    for (int i = 0; i < n; ++i) {
+      outL[i] *= gain;
+      outR[i] *= gain;
+    }
+  }
+
+  // Damping then tone, in place. These recurse sample to sample so they
+  // stay serial, the rest of the tank runs as flat loops around them.
+  void dampAndTone(float *x, int n, float &filter, float &tone) {
+    for (int i = 0; i < n; ++i) {
+      filter += mDamp * (x[i] - filter);
+      if (!std::isfinite(filter))
+        filter = 0.0f;
+      float dampened = std::max(-2.0f, std::min(2.0f, filter * mDecay));
+      tone += mTone * (dampened - tone) + 1.0e-18f;
+      if (!std::isfinite(tone) || std::abs(tone) < 1.0e-18f)
+        tone = 0.0f;
+      x[i] = tone;
+    }
+  }
+
+  // Eight delay lines through a Householder matrix, I - (2/8) * 11^T. It's
+  // orthogonal, so the per line gains alone set the decay, and every line
+  // gets the same correction so mixing costs one sum. The lines live
+  // interleaved in one buffer, which keeps the inner loops 8 floats wide.
+  void processFdn(const float *input, float *outL, float *outR, int n) {
+    // Input and output sign patterns, orthogonal to each other so the two
+    // sides decorrelate and the input isn't cancelled by the first mix
+    static const float kIn[kFdnLines] = {1, -1, 1, -1, 1, -1, 1, -1};
+    static const float kOutL[kFdnLines] = {1, 1, -1, -1, 1, 1, -1, -1};
+    static const float kOutR[kFdnLines] = {1, -1, 1, -1, -1, 1, -1, 1};
+
+    using Storage = DelayStorage<FxDelaySample>;
+    FxDelaySample *lines = mFdnLines.data();
+    const float gain = mMix * kFdnLevel;
+    for (int i = 0; i < n; ++i) {
+      alignas(16) float x[kFdnLines];
+      for (int j = 0; j < kFdnLines; ++j)
+        x[j] = Storage::load(
+            lines[((mFdnPos - mFdnLength[j]) & kFdnMask) * kFdnLines + j]);
+
+      // Damping per line, same lowpass as the tank
+      float sum = 0.0f, l = 0.0f, r = 0.0f;
+      for (int j = 0; j < kFdnLines; ++j) {
+        mFdnDamp[j] += mDamp * (x[j] - mFdnDamp[j]);
+        sum += mFdnDamp[j];
+        l += kOutL[j] * mFdnDamp[j];
+        r += kOutR[j] * mFdnDamp[j];
+      }
+
+      FxDelaySample *w = lines + mFdnPos * kFdnLines;
+      const float reflect = sum * (2.0f / kFdnLines);
+      for (int j = 0; j < kFdnLines; ++j)
+        w[j] = Storage::store((mFdnDamp[j] - reflect) * mFdnGain[j] +
+                              kIn[j] * input[i]);
+      mFdnPos = (mFdnPos + 1) & kFdnMask;
+
+      // Tone
+      mToneFilterL += mTone * (l - mToneFilterL);
+      mToneFilterR += mTone * (r - mToneFilterR);
+      outL[i] = mToneFilterL * gain;
+      outR[i] = mToneFilterR * gain;
+    }
+  }
+
+  // Line lengths for the sample rate, and the gain each one needs so the
+  // whole network decays by 60dB in the time the size knob asks for
+  void updateFdn() {
+    // Mutually prime lengths at 48kHz, 24ms to 62ms
+    static const int kBase[kFdnLines] = {1153, 1327, 1559, 1801,
+                                         2053, 2311, 2647, 2999};
+    // Follows mDecay so Space keeps its shorter cap: 0.3s up to 7.5s
+    float amount = std::max(0.0f, (mDecay - 0.3f) / 0.69f);
+    float t60 = 0.3f * std::pow(25.0f, amount);
+    for (int j = 0; j < kFdnLines; ++j) {
+      mFdnLength[j] =
+          std::min(kFdnFrames - 1, (int)(kBase[j] * mSampleRate / 48000.0f));
+      mFdnGain[j] =
+          std::pow(10.0f, -3.0f * (float)mFdnLength[j] / (t60 * mSampleRate));
+    }
+  }
+
+  static const int kTankSpan = 905 + 908 + 4215 + 3627;
+  static const int kFdnLines = 8;
+  static const int kFdnFrames = 8192; // Longest line at 96kHz fits
+  static const int kFdnMask = kFdnFrames - 1;
+  static constexpr float kFdnLevel = 0.7f; // Roughly matches the tank
+
   float mSampleRate = 48000.0f;
   float mFeedback = 0.6f; // Cross-feedback gain, bumped for lushness
   float mDecay = 0.5f;    // Recirculation gain
@@ -339,14 +426,21 @@ private:
   // State
   float mFilterL = 0.0f, mFilterR = 0.0f;
   float mToneFilterL = 0.0f, mToneFilterR = 0.0f;
-  uint32_t mSilentCounter = 48000; // Start silent
 
-  Galactic::DelayLine mPreDelay;
+  DelayLine<> mPreDelay;
   Galactic::AllPass mInputAP[4];
 
   Galactic::AllPass mLoopAPL, mLoopAPR;
-  Galactic::DelayLine mDelayL, mDelayR;
-  Galactic::DelayLine mDelayAfterAPL, mDelayAfterAPR;
+  DelayLine<> mDelayL, mDelayR;
+  DelayLine<> mDelayAfterAPL, mDelayAfterAPR;
+
+  Algorithm mAlgorithm = Algorithm::Tank;
+  // kFdnFrames frames of kFdnLines, stored like the other FX lines
+  std::vector<FxDelaySample, CacheAligned<FxDelaySample>> mFdnLines;
+  int mFdnPos = 0;
+  int mFdnLength[kFdnLines] = {};
+  alignas(16) float mFdnGain[kFdnLines] = {};
+  alignas(16) float mFdnDamp[kFdnLines] = {};
 };
 
 #endif // GALACTIC_REVERB_H
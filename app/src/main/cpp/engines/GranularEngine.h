@@ -1,7 +1,9 @@
 #ifndef GRANULAR_ENGINE_H
 #define GRANULAR_ENGINE_H
 
+#include "../FastMath.h"
 #include "Adsr.h"
+#include "SampleBuffer.h"
 #include <algorithm>
 #include <cmath>
 #include <memory> // Added for std::shared_ptr
@@ -24,71 +26,37 @@ public:
   void setGlide(float g) { mGlide = g; }
   void setSampleRate(float sr) { mSampleRate = sr; }
 
-  struct Grain {
-    float position;
-    float speed;
-    float lOffset; // Stereo left
-    float rOffset; // Stereo right
-    float envValue;
-    float attackStep;
-    float decayStep;
-    int life;
-    int initialLife;
-    bool isReverse;
-    bool isActive;
-    int voiceIdx; // Link to voice for ADSR and mixing
-
-    // 4-point, 3rd-order Hermite Interpolation
-    inline float cubicInterp(float y0, float y1, float y2, float y3, float mu) {
-      float mu2 = mu * mu;
-      float a0 = -0.5f * y0 + 1.5f * y1 - 1.5f * y2 + 0.5f * y3;
-      float a1 = y0 - 2.5f * y1 + 2.0f * y2 - 0.5f * y3;
-      float a2 = -0.5f * y0 + 0.5f * y2;
-      float a3 = y1;
-      return (a0 * mu * mu2) + (a1 * mu2) + (a2 * mu) + a3;
-    }
-
-    float nextSample(const std::vector<float> &source) {
-      if (!isActive || source.empty())
-        return 0.0f;
-
-      // -- GRAIN ENVELOPE (Windowing) --
-      if (life > initialLife * 0.9f) { // Attack 10%
-        envValue += attackStep;
-      } else { // Decay 90%
-        envValue -= decayStep;
-      }
-      envValue = std::max(0.0f, std::min(1.0f, envValue));
-
-      // Parameter Setters
-
-      int size = static_cast<int>(source.size());
-      int idx = static_cast<int>(position);
-      float frac = position - static_cast<float>(idx);
-
-      int i0 = (idx - 1 + size) % size;
-      int i1 = idx;
-      int i2 = (idx + 1) % size;
-      int i3 = (idx + 2) % size;
-
-      float s =
-          cubicInterp(source[i0], source[i1], source[i2], source[i3], frac);
-
-      if (isReverse) {
-        position -= speed;
-        if (position < 0)
-          position += static_cast<float>(size);
-      } else {
-        position += speed;
-        if (position >= static_cast<float>(size))
-          position -= static_cast<float>(size);
-      }
-
-      life--;
-      if (life <= 0)
-        isActive = false;
+  static const int kMaxGrains = 512;
+  static const int kMaxBlock = 256;
+  static const int kWindowSize = 1024;
+
+  enum WindowShape { Classic, Hann, Tukey, Trapezoid, NumWindowShapes };
+
+  // Live grains as structure-of-arrays, packed into [0, count). Finished
+  // grains are swapped out with the last one, so loops never skip holes.
+  struct GrainPool {
+    float position[kMaxGrains];
+    float speed[kMaxGrains]; // Negative plays in reverse
+    float window[kMaxGrains]; // Read position in the window table
+    float windowInc[kMaxGrains];
+    float gainL[kMaxGrains];
+    float gainR[kMaxGrains];
+    int life[kMaxGrains];
+    int voice[kMaxGrains];
+    int start[kMaxGrains]; // Offset into the current block (new grains)
+    int count = 0;
 
-      return s * envValue;
+    void remove(int i) {
+      int last = --count;
+      position[i] = position[last];
+      speed[i] = speed[last];
+      window[i] = window[last];
+      windowInc[i] = windowInc[last];
+      gainL[i] = gainL[last];
+      gainR[i] = gainR[last];
+      life[i] = life[last];
+      voice[i] = voice[last];
+      start[i] = start[last];
     }
   };
 
@@ -107,7 +75,7 @@ public:
 
       float val = 0.0f;
       if (shape < 1.0f) {
-        val = sinf(phase * 2.0f * M_PI);
+        val = FastMath::sin2pi(phase);
       } else if (shape < 2.0f) {
         val = phase < 0.5f ? phase * 4.0f - 1.0f : 3.0f - phase * 4.0f;
       } else if (shape < 3.0f) {
@@ -131,12 +99,11 @@ public:
 
   GranularEngine() {
     mLFOS.resize(3);
-    mGrains.resize(100);
     mVoices.resize(16);
-    for (auto &g : mGrains)
-      g.isActive = false;
     for (auto &v : mVoices)
       v.active = false;
+    mGrains = std::make_shared<GrainPool>();
+    buildWindows();
 
     mDensity = 0.5;
     mGrainSize = 0.2;
@@ -161,6 +128,7 @@ public:
     mMainSustain = 1.0f;
     mMainRelease = 0.2f;
     mGain = 1.0f;
+    mWindowShape = Classic;
     for (int i = 0; i < 3; ++i) {
       mLFOS[i].phase = 0.0f;
       mLFOS[i].rate = 0.1f;
@@ -177,9 +145,15 @@ public:
 
   void setSource(const std::vector<float> &source) {
     std::lock_guard<std::mutex> lock(*mBufferLock);
-    mSource = source;
+    mSource.assign(source);
+  }
+  std::vector<float> getSampleData() const { return mSource.toVector(); }
+  void setCompactStorage(bool compact) {
+    std::lock_guard<std::mutex> lock(*mBufferLock);
+    mSource.setCompact(compact);
   }
-  const std::vector<float> &getSampleData() const { return mSource; }
+  size_t getSampleMemoryBytes() const { return mSource.bytes(); }
+  bool hasContent() const { return !mSource.empty(); }
   void clearSource() {
     std::lock_guard<std::mutex> lock(*mBufferLock);
     mSource.clear();
@@ -193,13 +167,9 @@ public:
     std::lock_guard<std::mutex> lock(*mBufferLock);
     if (mSource.empty())
       return;
-    float maxVal = 0.0f;
-    for (float s : mSource)
-      maxVal = std::max(maxVal, std::abs(s));
-    if (maxVal > 0.0001f) {
-      for (float &s : mSource)
-        s /= maxVal;
-    }
+    float maxVal = mSource.peak();
+    if (maxVal > 0.0001f)
+      mSource.applyGain(1.0f / maxVal);
   }
 
   void trim(float start, float end) {
@@ -210,10 +180,8 @@ public:
         0, std::min((int)(start * mSource.size()), (int)mSource.size()));
     int e =
         std::max(0, std::min((int)(end * mSource.size()), (int)mSource.size()));
-    if (e > s) {
-      std::vector<float> trimmed(mSource.begin() + s, mSource.begin() + e);
-      mSource = trimmed;
-    }
+    if (e > s)
+      mSource.keepRange(s, e);
   }
 
   void triggerNote(int note, int velocity) {
@@ -232,7 +200,7 @@ public:
     v.active = true;
     v.note = note;
     v.amplitude = velocity / 127.0f;
-    float targetPitch = powf(2.0f, (note - 60) / 12.0f);
+    float targetPitch = FastMath::semitonesToRatio((float)(note - 60));
     v.targetBasePitch = targetPitch;
     v.basePitch = (mGlide > 0.001f) ? mLastBasePitch : targetPitch;
     mLastBasePitch = targetPitch;
@@ -254,10 +222,7 @@ public:
   }
 
   void allNotesOff() {
-    for (auto &g : mGrains) {
-      g.isActive = false;
-      g.life = 0;
-    }
+    mGrains->count = 0;
     for (auto &v : mVoices) {
       v.active = false;
       v.envelope.reset();
@@ -334,6 +299,9 @@ public:
       mGain = value * 2.5f; // 0 to 250% Gain
     else if (id == 355)
       setGlide(value);
+    else if (id == 430)
+      mWindowShape = std::min((int)NumWindowShapes - 1,
+                              static_cast<int>(value * NumWindowShapes));
 
     // Apply to live voices
     for (auto &v : mVoices) {
@@ -347,88 +315,123 @@ public:
     for (const auto &v : mVoices)
       if (v.active)
         return true;
-    for (const auto &g : mGrains)
-      if (g.isActive)
-        return true;
-    return false;
+    return mGrains->count > 0;
   }
 
-  void render(float *left, float *right) {
-    std::lock_guard<std::mutex> lock(*mBufferLock);
-    if (mSource.empty()) {
-      *left = *right = 0.0f;
-      return;
+  void render(float *left, float *right) { renderBlock(left, right, 1); }
+
+  // Control (LFOs, glide, spawning) runs per sample in a cheap first pass,
+  // recording where new grains start. Grains are then rendered one at a
+  // time across the block: gathered Hermite reads, window table, voice
+  // gain, pan.
+  void renderBlock(float *left, float *right, int n) {
+    while (n > kMaxBlock) {
+      renderBlock(left, right, kMaxBlock);
+      left += kMaxBlock;
+      right += kMaxBlock;
+      n -= kMaxBlock;
     }
+    std::fill(left, left + n, 0.0f);
+    std::fill(right, right + n, 0.0f);
 
-    bool hasActive = isActive();
-    if (!hasActive) {
-      *left = *right = 0.0f;
+    std::lock_guard<std::mutex> lock(*mBufferLock);
+    if (mSource.empty() || !isActive())
       return;
-    }
-
-    // Process LFOs
-    float lfoOffsets[3] = {mLFOS[0].nextValue(), mLFOS[1].nextValue(),
-                           mLFOS[2].nextValue()};
 
-    for (int i = 0; i < 16; ++i) {
-      Voice &v = mVoices[i];
-      if (!v.active)
-        continue;
-
-      if (mGlide > 0.001f) {
-        float glideTimeSamples = mGlide * mSampleRate * 0.5f;
-        float glideAlpha = 1.0f / (glideTimeSamples + 1.0f);
-        v.basePitch += (v.targetBasePitch - v.basePitch) * glideAlpha;
+    GrainPool &pool = *mGrains;
+
+    // Voice envelopes for the block. Grains of released voices keep
+    // reading the (idle) envelope value, as before.
+    int liveUntil[16];
+    for (int v = 0; v < 16; ++v) {
+      Voice &voice = mVoices[v];
+      float *gain = mVoiceGain[v];
+      if (voice.active) {
+        liveUntil[v] = voice.envelope.process(gain, n);
+        for (int i = 0; i < n; ++i)
+          gain[i] *= voice.amplitude;
       } else {
-        v.basePitch = v.targetBasePitch;
-      }
-
-      float envVal = v.envelope.nextValue();
-      if (envVal < 0.0001f && !v.envelope.isActive()) {
-        v.active = false;
-      }
-
-      // Spawn logic
-      float grainDuration = (mGrainSize * 48000.0f * 2.0f) + 100.0f;
-      float overlap = 0.1f + (mDensity * 4.0f);
-      float interval = grainDuration / overlap;
-      if (interval < 1.0f)
-        interval = 1.0f;
-
-      v.spawnCounter += 1.0f;
-      if (v.spawnCounter >= interval) {
-        v.spawnCounter = 0.0f;
-        spawnGrain(lfoOffsets, i);
+        liveUntil[v] = -1;
+        std::fill(gain, gain + n,
+                  voice.envelope.getValue() * voice.amplitude);
       }
     }
 
-    // 2. Render and Mix Grains
-    float lMixed = 0.0f, rMixed = 0.0f;
-    int activeCount = 0;
-    for (auto &g : mGrains) {
-      if (g.isActive) {
-        float sample = g.nextSample(mSource);
-
-        // Multiplier from parent voice (ADSR + Velocity)
-        float masterGain = 0.0f;
-        if (g.voiceIdx >= 0 && g.voiceIdx < 16) {
-          masterGain = mVoices[g.voiceIdx].envelope.getValue() *
-                       mVoices[g.voiceIdx].amplitude;
+    // Spawn pass
+    float grainDuration = (mGrainSize * 48000.0f * 2.0f) + 100.0f;
+    float overlap = 0.1f + (mDensity * 4.0f);
+    float interval = std::max(1.0f, grainDuration / overlap);
+    float glideAlpha = 1.0f / (mGlide * mSampleRate * 0.5f + 1.0f);
+    for (int i = 0; i < n; ++i) {
+      float lfoOffsets[3] = {mLFOS[0].nextValue(), mLFOS[1].nextValue(),
+                             mLFOS[2].nextValue()};
+      for (int v = 0; v < 16; ++v) {
+        // The voice still spawns on the sample its envelope ends
+        if (i > liveUntil[v])
+          continue;
+        Voice &voice = mVoices[v];
+        if (mGlide > 0.001f)
+          voice.basePitch +=
+              (voice.targetBasePitch - voice.basePitch) * glideAlpha;
+        else
+          voice.basePitch = voice.targetBasePitch;
+
+        voice.spawnCounter += 1.0f;
+        if (voice.spawnCounter >= interval) {
+          voice.spawnCounter = 0.0f;
+          spawnGrain(lfoOffsets, v, i);
         }
+      }
+    }
+    for (int v = 0; v < 16; ++v)
+      if (liveUntil[v] >= 0 && liveUntil[v] < n)
+        mVoices[v].active = false;
+
+    // Grain pass
+    int activeCount[kMaxBlock] = {0};
+    float grainOut[kMaxBlock];
+    const float *window = mWindows[mWindowShape];
+    for (int g = pool.count - 1; g >= 0; --g) {
+      const int first = pool.start[g];
+      const int count = std::min(n - first, pool.life[g]);
+      pool.start[g] = 0;
+      if (count <= 0)
+        continue;
 
-        float out = sample * masterGain;
-        lMixed += out * (1.0f - g.lOffset);
-        rMixed += out * (1.0f - g.rOffset);
-        activeCount++;
+      pool.position[g] = mSource.readCubicRun(pool.position[g], pool.speed[g],
+                                              grainOut, count);
+      const float *voiceGain = mVoiceGain[pool.voice[g]] + first;
+      const float gL = pool.gainL[g], gR = pool.gainR[g];
+      float w = pool.window[g];
+      const float wInc = pool.windowInc[g];
+      float *outL = left + first;
+      float *outR = right + first;
+      int *counts = activeCount + first;
+      for (int k = 0; k < count; ++k) {
+        w += wInc;
+        float wp = std::min(w, (float)kWindowSize);
+        int wi = std::min((int)wp, kWindowSize - 1);
+        float wf = wp - (float)wi;
+        float env = window[wi] + wf * (window[wi + 1] - window[wi]);
+        float out = grainOut[k] * env * voiceGain[k];
+        outL[k] += out * gL;
+        outR[k] += out * gR;
+        counts[k]++;
       }
+      pool.window[g] = w;
+      pool.life[g] -= count;
+      if (pool.life[g] <= 0)
+        pool.remove(g);
     }
 
-    float norm = activeCount > 0 ? 1.0f / sqrtf(activeCount) : 0.0f;
     // Boost output gain (2.5x)
-    float finalGain = norm * 2.5f * mGain; // Apply user gain
-
-    *left = lMixed * finalGain;
-    *right = rMixed * finalGain;
+    const float finalGain = 2.5f * mGain;
+    for (int i = 0; i < n; ++i) {
+      float norm = activeCount[i] > 0 ? 1.0f / sqrtf((float)activeCount[i])
+                                      : 0.0f;
+      left[i] *= norm * finalGain;
+      right[i] *= norm * finalGain;
+    }
   }
 
   struct PlayheadInfo {
@@ -436,21 +439,16 @@ public:
     float vol;
   };
   void getPlayheads(PlayheadInfo *out, int maxCount) {
-    int count = 0;
-    for (const auto &g : mGrains) {
-      if (g.isActive && count < maxCount) {
-        out[count].pos = g.position / mSource.size();
-
-        // VISIBILITY FIX: Multiply grain envelope by voice envelope so it fades
-        // correctly
-        float voiceEnv = 0.0f;
-        if (g.voiceIdx >= 0 && g.voiceIdx < 16) {
-          voiceEnv = mVoices[g.voiceIdx].envelope.getValue();
-        }
-
-        out[count].vol = g.envValue * voiceEnv;
-        count++;
-      }
+    const GrainPool &pool = *mGrains;
+    const float *window = mWindows[mWindowShape];
+    int count = std::min(pool.count, maxCount);
+    for (int g = 0; g < count; ++g) {
+      out[g].pos = pool.position[g] / mSource.size();
+
+      // VISIBILITY FIX: Multiply grain envelope by voice envelope so it fades
+      // correctly
+      int wi = std::min((int)pool.window[g], kWindowSize);
+      out[g].vol = window[wi] * mVoices[pool.voice[g]].envelope.getValue();
     }
     for (int i = count; i < maxCount; ++i) {
       out[i].pos = -1.0f;
@@ -479,8 +477,13 @@ public:
 private:
   std::shared_ptr<std::mutex> mBufferLock = std::make_shared<std::mutex>();
   float mBasePitch = 1.0f;
-  std::vector<float> mSource;
-  std::vector<Grain> mGrains;
+  SampleBuffer mSource;
+  // Heap-allocated, the pool is ~18 KB and engines live inside Track
+  std::shared_ptr<GrainPool> mGrains;
+  float mWindows[NumWindowShapes][kWindowSize + 1];
+  int mWindowShape = Classic;
+  float mVoiceGain[16][kMaxBlock];
+  XorShift32 mRng;
   std::vector<LFO> mLFOS;
   std::vector<Voice> mVoices;
 
@@ -507,58 +510,64 @@ private:
   float mMainRelease = 0.1f;
   float mGain = 1.0f;
 
-  void spawnGrain(float *lfoOffsets, int voiceIdx) {
-    if (mSource.empty())
+  void buildWindows() {
+    for (int i = 0; i <= kWindowSize; ++i) {
+      float x = (float)i / kWindowSize;
+      // Original grain shape: 10% linear attack, 90% linear decay
+      mWindows[Classic][i] = x < 0.1f ? x * 10.0f : (1.0f - x) / 0.9f;
+      mWindows[Hann][i] = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * x);
+      // Tukey, alpha 0.5: cosine tapers on the outer quarters
+      float edge = std::min(x, 1.0f - x);
+      mWindows[Tukey][i] =
+          edge < 0.25f ? 0.5f - 0.5f * cosf((float)M_PI * edge * 4.0f) : 1.0f;
+      mWindows[Trapezoid][i] = std::min(1.0f, edge * 4.0f);
+    }
+  }
+
+  void spawnGrain(float *lfoOffsets, int voiceIdx, int offset) {
+    GrainPool &pool = *mGrains;
+    if (pool.count >= kMaxGrains)
       return;
     Voice &v = mVoices[voiceIdx];
-    // Find inactive grain
-    for (auto &g : mGrains) {
-      if (!g.isActive) {
-        float p = mPosition;
-        if (mLFOS[0].target == 1)
-          p += lfoOffsets[0];
-        p +=
-            (static_cast<float>(rand()) / static_cast<float>(RAND_MAX) - 0.5f) *
-            mSpray;
-        p = std::max(0.0f, std::min(1.0f, p));
-
-        float sp = mSpeed;
-        if (mLFOS[0].target == 2)
-          sp *= (1.0f + lfoOffsets[0]);
-
-        float grainPitch = mPitch;
-        if (mLFOS[1].target == 5)
-          grainPitch *= (1.0f + lfoOffsets[1]);
-        grainPitch +=
-            (static_cast<float>(rand()) / static_cast<float>(RAND_MAX) - 0.5f) *
-            mDetune;
-
-        g.position = p * mSource.size();
-        g.speed = sp * v.basePitch * grainPitch;
-        g.isReverse = (static_cast<float>(rand()) /
-                       static_cast<float>(RAND_MAX)) < mReverseProb;
-
-        float length = mGrainSize;
-        if (mLFOS[1].target == 1)
-          length *= (1.0f + lfoOffsets[1]);
-        g.initialLife = static_cast<int>(length * 48000.0f * 2.0f + 100);
-        g.life = g.initialLife;
-        g.envValue = 0.0f;
-        g.voiceIdx = voiceIdx; // Link to voice
-
-        g.attackStep = 1.0f / (g.initialLife * 0.1f);
-        g.decayStep = 1.0f / (g.initialLife * 0.9f);
-
-        float pan =
-            (static_cast<float>(rand()) / static_cast<float>(RAND_MAX) - 0.5f) *
-            mWidth;
-        g.lOffset = 0.5f + pan;
-        g.rOffset = 0.5f - pan;
-
-        g.isActive = true;
-        break;
-      }
-    }
+
+    float p = mPosition;
+    if (mLFOS[0].target == 1)
+      p += lfoOffsets[0];
+    p += mRng.nextCentered() * mSpray;
+    p = std::max(0.0f, std::min(1.0f, p));
+
+    float sp = mSpeed;
+    if (mLFOS[0].target == 2)
+      sp *= (1.0f + lfoOffsets[0]);
+
+    float grainPitch = mPitch;
+    if (mLFOS[1].target == 5)
+      grainPitch *= (1.0f + lfoOffsets[1]);
+    grainPitch += mRng.nextCentered() * mDetune;
+
+    const float size = (float)mSource.size();
+    float position = p * size;
+    if (position >= size)
+      position = 0.0f;
+    bool reverse = mRng.nextFloat() < mReverseProb;
+
+    float length = mGrainSize;
+    if (mLFOS[1].target == 1)
+      length *= (1.0f + lfoOffsets[1]);
+    int life = std::max(1, static_cast<int>(length * 48000.0f * 2.0f + 100));
+
+    float pan = mRng.nextCentered() * mWidth;
+
+    int g = pool.count++;
+    pool.position[g] = position;
+    pool.speed[g] = sp * v.basePitch * grainPitch * (reverse ? -1.0f : 1.0f);
+    pool.window[g] = 0.0f;
+    pool.windowInc[g] = (float)kWindowSize / life;
+    pool.gainL[g] = 0.5f - pan;
+    pool.gainR[g] = 0.5f + pan;
+    pool.life[g] = life;
+    pool.voice[g] = voiceIdx;
+    pool.start[g] = offset;
   }
 };
 
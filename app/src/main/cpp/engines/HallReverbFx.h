@@ -25,7 +25,7 @@ public:
     float newVal = input + (mFilterStore * feedback);
 
     // Safety Saturation (prevent explosion)
-    newVal = std::tanh(newVal);
+    newVal = FastMath::tanh(newVal);
 
     mBuffer[mWritePos] = newVal;
     mWritePos++;
@@ -71,7 +71,7 @@ public:
     float newVal = input + (bufOut * 0.5f);
 
     // Safety Saturation
-    newVal = std::tanh(newVal);
+    newVal = FastMath::tanh(newVal);
 
     mBuffer[mWritePos] = newVal;
     mWritePos++;
@@ -1,33 +1,34 @@
 #ifndef OCTAVER_FX_H
 #define OCTAVER_FX_H
 
+#include "../DelayLine.h"
+#include "../FastMath.h"
 #include <algorithm>
 #include <cmath>
-#include <vector>
 
 // Simple Granular Pitch Shifter for Octaver
 class OctaverFx {
 public:
   void updateSampleRate(float sr) {}
   OctaverFx() {
-    mBuffer.resize(8192, 0.0f); // ~180ms circular buffer
+    // A grain window and a bit per side, whatever the rate
+    mLine[0].setSize(kBufferSize);
+    mLine[1].setSize(kBufferSize);
   }
 
-  float process(float input, float sampleRate) {
-    if (mMix <= 0.001f)
-      return 0.0f;
-    if (!std::isfinite(input))
-      input = 0.0f;
-
-    // Write to circular buffer
-    mBuffer[mWritePos] = input;
-
-    // Render voices based on Mode
-    float wet = 0.0f;
-
-    // Main Pitch Logic:
-    // pitchRatio 0.5 = Oct Down
-    // pitchRatio 2.0 = Oct Up
+  // In place, wet only. Silent while the mix is down.
+  //
+  // Delay-based pitch shifting: each voice reads the buffer through two
+  // grains half a window apart, the delay ramping by (1 - ratio) samples per
+  // sample. Ratio 0.5 (down) grows the delay by half a sample per sample,
+  // 2.0 (up) shrinks it by one. Triangular windows hide the wrap. The grain
+  // positions don't depend on the signal, so both sides share them.
+  void processBlock(float *left, float *right, int n, float sampleRate) {
+    if (mMix <= 0.001f) {
+      std::fill(left, left + n, 0.0f);
+      std::fill(right, right + n, 0.0f);
+      return;
+    }
 
     // 0: Oct Up
     // 1: Octs Up (1up, 2up)
@@ -35,93 +36,52 @@ public:
     // 3: Octs Down (1down, 2down)
     // 4: Up/Down
     // 5..11: Chords
-
+    // Only up, down and up/down are voiced so far, everything else plays
+    // the octave up.
     int mode = (int)(mMode * 11.9f);
-
-    auto processVoice = [&](float ratio, float &phase,
-                            float &windowPhase) -> float {
-      // Grain Logic:
-      // Traversing buffer at speed 'ratio'.
-      // But we are constantly writing.
-      // Effective read speed needs to stay within buffer relative to write
-      // head. Simple Pitch Shifter: ReadRate = Ratio. But we need to window to
-      // avoid clicks.
-
-      // Increment Phase
-      float rate = ratio;
-      // Correction: If reading faster (2.0), we pass write head.
-      // We need typically 2 overlapping windows.
-      // Let's use a simpler "phasor" approach for pitch shifting.
-      // Phasor 0..1 at freq = (1 - ratio) / WindowSize?
-      // Actually, for real-time delay-based pitch shifting:
-      // Delay ramps from 0 to WindowSize.
-      // Slope determines pitch.
-
-      // Delay modulation rate:
-      // (1.0 - ratio) samples per sample.
-      // If ratio 0.5 (Down), delay increases by 0.5 samples/sample.
-      // If ratio 2.0 (Up), delay decreases by 1.0 samples/sample.
-
-      float drift = 1.0f - ratio;
-      phase += drift;
-
-      // Wrap / Window
-      const float windowSize = 2048.0f; // ~46ms
-
-      auto getGrain = [&](float p) -> float {
-        while (p < 0.0f)
-          p += windowSize;
-        while (p >= windowSize)
-          p -= windowSize;
-
-        // Actual delay
-        float delay = p; // 0..Window
-
-        float rPos = (float)mWritePos - delay;
-        while (rPos < 0.0f)
-          rPos += mBuffer.size();
-        while (rPos >= mBuffer.size())
-          rPos -= mBuffer.size();
-
-        int i0 = (int)rPos;
-        int i1 = (i0 + 1) % mBuffer.size();
-        float f = rPos - i0;
-        float samp = mBuffer[i0] * (1.0f - f) + mBuffer[i1] * f;
-
-        // Triangular Window
-        float win = 1.0f - std::abs(2.0f * (p / windowSize) - 1.0f);
-        return samp * win;
-      };
-
-      float v1 = getGrain(phase);
-      float v2 = getGrain(phase + windowSize * 0.5f); // Offset 50%
-
-      return v1 + v2;
-    };
-
+    float ratio1 = 2.0f, ratio2 = 0.0f;
     if (mode == 0) { // Oct Up
-      wet += processVoice(2.0f, mPhase1, mWin1);
       if (mUnison > 0.3f)
-        wet += processVoice(2.01f, mPhase2, mWin2); // Detuned
-    } else if (mode == 2) {                         // Oct Down
-      wet += processVoice(0.5f, mPhase1, mWin1);
+        ratio2 = 2.01f; // Detuned
+    } else if (mode == 2) { // Oct Down
+      ratio1 = 0.5f;
       if (mUnison > 0.3f)
-        wet += processVoice(0.505f, mPhase2, mWin2);
+        ratio2 = 0.505f;
     } else if (mode == 4) { // Up/Down
-      wet += processVoice(2.0f, mPhase1, mWin1);
-      wet += processVoice(0.5f, mPhase2, mWin2);
-    } else {
-      // Default placeholder for complex chord modes
-      // Just Oct Up/Down mix for now
-      wet += processVoice(2.0f, mPhase1, mWin1);
+      ratio2 = 0.5f;
     }
+    const float drift1 = 1.0f - ratio1;
+    const float drift2 = 1.0f - ratio2;
+    const bool second = ratio2 > 0.0f;
+
+    for (int i = 0; i < n; ++i) {
+      float inL = left[i], inR = right[i];
+      if (!std::isfinite(inL))
+        inL = 0.0f;
+      if (!std::isfinite(inR))
+        inR = 0.0f;
+      // Write to circular buffer
+      mLine[0].write(inL);
+      mLine[1].write(inR);
+
+      float wetL = 0.0f, wetR = 0.0f;
+      auto voice = [&](float &phase, float drift) {
+        // Kept within one window, the grains repeat with it anyway
+        phase += drift;
+        if (phase < 0.0f)
+          phase += kWindowSize;
+        else if (phase >= kWindowSize)
+          phase -= kWindowSize;
+        grain(phase, wetL, wetR);
+        grain(phase + kWindowSize * 0.5f, wetL, wetR);
+      };
+      voice(mPhase1, drift1);
+      if (second)
+        voice(mPhase2, drift2);
 
-    // Advance Write
-    mWritePos++;
-    if (mWritePos >= mBuffer.size())
-      mWritePos = 0;
-
-    return std::tanh(wet) * mMix;
+      left[i] = FastMath::tanh(wetL) * mMix;
+      right[i] = FastMath::tanh(wetR) * mMix;
+    }
   }
 
   void setParameters(float mix, float detune, float unison, float mode) {
@@ -136,13 +96,30 @@ public:
   void setUnison(float v) { mUnison = v; }
   void setMode(float v) { mMode = v; }
 
+  // Grains read up to a window back
+  int tailSamples(float sampleRate) const { return (int)kWindowSize + 2; }
+  std::size_t lineBytes() const { return mLine[0].bytes() + mLine[1].bytes(); }
+
 private:
-  std::vector<float> mBuffer;
-  int mWritePos = 0;
+  static const int kBufferSize = 4096; // Power of two over the window
+  static constexpr float kWindowSize = 2048.0f; // ~46ms
+
+  // One windowed grain p samples back, added to both sides. p is under one
+  // and a half windows, the second grain runs half a window ahead.
+  void grain(float p, float &wetL, float &wetR) const {
+    if (p >= kWindowSize)
+      p -= kWindowSize;
+
+    // Triangular Window
+    float win = 1.0f - std::abs(2.0f * (p / kWindowSize) - 1.0f);
+    wetL += mLine[0].readLinear(p) * win;
+    wetR += mLine[1].readLinear(p) * win;
+  }
+
+  DelayLine<> mLine[2];
 
   // Voices state
   float mPhase1 = 0.0f, mPhase2 = 0.0f, mPhase3 = 0.0f;
-  float mWin1 = 0.0f, mWin2 = 0.0f, mWin3 = 0.0f;
 
   float mMix = 0.0f;
   float mDetune = 0.0f;
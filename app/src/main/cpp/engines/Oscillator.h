@@ -1,6 +1,8 @@
 #ifndef OSCILLATOR_H
 #define OSCILLATOR_H
 
+#include "../Utils.h"
+#include "../Waveshaper.h"
 #include <android/log.h>
 #include <cmath>
 
@@ -22,55 +24,46 @@ public:
 
   void resetPhase() { mPhase = 0.0f; }
 
-  float foldWave(float sample, float amount) {
+  // Fold threshold for an amount in [0, 1]
+  static float foldThreshold(float amount) {
+    return std::max(0.1f, 1.0f - (amount * 0.9f));
+  }
+
+  // Reflects at +-threshold until the sample lands inside, normalized to
+  // +-1. Closed form, constant cost however hard it's driven.
+  static float foldWave(float sample, float amount) {
     if (amount <= 0.0f)
       return sample;
-    float threshold = 1.0f - (amount * 0.9f);
-    if (threshold < 0.1f)
-      threshold = 0.1f;
-
-    // Recursive folding
-    while (std::abs(sample) > threshold) {
-      if (sample > threshold) {
-        sample = threshold - (sample - threshold);
-      } else if (sample < -threshold) {
-        sample = -threshold - (sample + threshold);
-      }
-    }
-    return sample / threshold;
+    return shapes::TriangleFold::f(sample / foldThreshold(amount));
   }
 
   float nextSample(float modulation = 0.0f, float fmFreqMult = 1.0f,
                    float waveFold = 0.0f) {
     float sample = 0.0f;
     float phaseWithMod = mPhase + modulation;
-    // Keep phase in [0, 1]
-    phaseWithMod -= floorf(phaseWithMod);
+    // Keep phase in [0, 1), floorf only for deep modulation
+    if (phaseWithMod >= 1.0f)
+      phaseWithMod -= 1.0f;
+    else if (phaseWithMod < 0.0f)
+      phaseWithMod += 1.0f;
+    if (phaseWithMod >= 1.0f || phaseWithMod < 0.0f)
+      phaseWithMod -= floorf(phaseWithMod);
+
+    // Per-sample phase step, sets the width of the BLEP/BLAMP corrections
+    float dt = std::min(0.5f, std::abs(mPhaseIncrement * fmFreqMult));
 
     switch (mWaveform) {
     case Waveform::Sine:
-      sample = sinf(phaseWithMod * 2.0f * M_PI);
+      sample = FastSine::get(phaseWithMod);
       break;
-    case Waveform::Triangle: {
-      float tri =
-          2.0f * fabsf(2.0f * (phaseWithMod - floorf(phaseWithMod + 0.5f))) -
-          1.0f;
-      // Pulse width on triangle (leaning)
-      if (mShape != 0.5f) {
-        if (phaseWithMod < mShape) {
-          tri = (phaseWithMod / mShape) * 2.0f - 1.0f;
-        } else {
-          tri = 1.0f - ((phaseWithMod - mShape) / (1.0f - mShape)) * 2.0f;
-        }
-      }
-      sample = tri;
+    case Waveform::Triangle:
+      sample = triangle(phaseWithMod, dt, mShape);
       break;
-    }
     case Waveform::Square:
-      sample = (phaseWithMod < mShape) ? 1.0f : -1.0f;
+      sample = square(phaseWithMod, dt, mShape);
       break;
     case Waveform::Sawtooth:
-      sample = 2.0f * (phaseWithMod - floorf(phaseWithMod + 0.5f));
+      sample = saw(phaseWithMod, dt);
       break;
     }
 
@@ -85,7 +78,58 @@ public:
     return sample;
   }
 
+  // Stateless band-limited kernels, phase in [0, 1), dt = phase step.
+  // Also used directly by engines that keep phases in their own arrays.
+
+  // Zero at phase 0, edge at 0.5 (matches the old naive saw)
+  static inline float saw(float phase, float dt) {
+    float t = wrap01(phase + 0.5f);
+    return 2.0f * t - 1.0f - polyBlep(t, dt);
+  }
+
+  static inline float square(float phase, float dt, float pw) {
+    float sample = (phase < pw) ? 1.0f : -1.0f;
+    sample += polyBlep(phase, dt);
+    sample -= polyBlep(wrap01(phase - pw + 1.0f), dt);
+    return sample;
+  }
+
+  // Skewed triangle, min at 0, max at skew (0.5 = symmetric)
+  static inline float triangle(float phase, float dt, float skew) {
+    float s = std::max(0.01f, std::min(0.99f, skew));
+    float sample = (phase < s) ? (phase / s) * 2.0f - 1.0f
+                               : 1.0f - ((phase - s) / (1.0f - s)) * 2.0f;
+    // Slope change at both corners, smoothed with BLAMP
+    float k = 2.0f / s + 2.0f / (1.0f - s);
+    sample += 0.5f * k * dt *
+              (polyBlamp(phase, dt) - polyBlamp(wrap01(phase - s + 1.0f), dt));
+    return sample;
+  }
+
 private:
+  static inline float wrap01(float x) { return x >= 1.0f ? x - 1.0f : x; }
+
+  // 2-sample polynomial band-limited step residual (unit-height edge = 2).
+  // Written with selects only so lane loops over it vectorize.
+  static inline float polyBlep(float t, float dt) {
+    float inv = 1.0f / dt;
+    float a = t * inv;
+    float b = (t - 1.0f) * inv;
+    float head = a + a - a * a - 1.0f;
+    float tail = b * b + b + b + 1.0f;
+    return t < dt ? head : (t > 1.0f - dt ? tail : 0.0f);
+  }
+
+  // Integrated BLEP, for slope discontinuities
+  static inline float polyBlamp(float t, float dt) {
+    float inv = 1.0f / dt;
+    float a = t * inv - 1.0f;
+    float b = (t - 1.0f) * inv + 1.0f;
+    float head = -1.0f / 3.0f * a * a * a;
+    float tail = 1.0f / 3.0f * b * b * b;
+    return t < dt ? head : (t > 1.0f - dt ? tail : 0.0f);
+  }
+
   float mPhase = 0.0f;
   float mPhaseIncrement = 0.0f;
   float mShape = 0.5f; // Default square pulse width
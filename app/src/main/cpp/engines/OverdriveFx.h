@@ -1,64 +1,196 @@
 #ifndef OVERDRIVE_FX_H
 #define OVERDRIVE_FX_H
 
+#include "../FastMath.h"
+#include "../Waveshaper.h"
 #include <algorithm>
 #include <cmath>
 
+// The overdrive's stages as shapes, so the plain, ADAA and oversampled paths
+// all run the same curves
+namespace shapes {
+
+// 2. Extra Distortion Stage: reflects once at +-1 with half the slope
+struct DriveFold {
+  static float f(float x) {
+    if (std::abs(x) <= 1.0f)
+      return x;
+    return std::copysign(1.5f, x) - 0.5f * x;
+  }
+  static double F1(double x) {
+    double a = std::abs(x);
+    if (a <= 1.0)
+      return 0.5 * x * x;
+    return 0.5 + 1.5 * (a - 1.0) - 0.25 * (a * a - 1.0);
+  }
+};
+
+// 3. Asymmetric clipper: tanh above zero, x / (1 - x) below
+struct AsymClip {
+  static float f(float x) {
+    return (x > 0) ? FastMath::tanh(x) : (x / (1.0f - x));
+  }
+  static double F1(double x) {
+    if (x > 0.0)
+      return x + std::log1p(std::exp(-2.0 * x)) - 0.6931471805599453;
+    return -x - std::log1p(-x);
+  }
+};
+
+// Wavefolder component for "grit", added once the clipper passes 0.6
+struct Grit {
+  float amount = 0.02f;
+  float f(float c) const {
+    if (std::abs(c) <= 0.6f)
+      return c;
+    return c + FastMath::sin(c * 4.0f) * amount;
+  }
+  double F1(double c) const {
+    double F = 0.5 * c * c;
+    if (std::abs(c) > 0.6)
+      F += amount * (-0.7373937155412454 - std::cos(4.0 * c)) * 0.25;
+    return F;
+  }
+};
+
+} // namespace shapes
+
 class OverdriveFx {
 public:
   void setParameters(float drive, float tone, float level) {
+    setDrive(drive);
+    setTone(tone);
+    mLevel = level;
+  }
+  void setDrive(float drive) {
     mDrive = drive * 10.0f + 1.0f; // Range 1.0 to 11.0
+    for (auto &ch : mCh) {
+      ch.grit.shape.amount = 0.2f * mDrive * 0.1f;
+      ch.grit.refresh();
+    }
+  }
+  void setTone(float tone) {
     mTone = tone;
-    mLevel = level;
+    updateToneCoeff();
   }
-  void setDrive(float drive) { mDrive = drive * 10.0f + 1.0f; }
-  void setTone(float tone) { mTone = tone; }
   void setLevel(float level) { mLevel = level; }
   void setMix(float mix) { mMix = mix; }
 
-  float process(float input) {
-    // 1. Tighten Bass (150Hz HP)
-    mHpState += 0.15f * (input - mHpState);
-    float x = (input - mHpState) * mDrive;
-
-    // 2. Extra Distortion Stage (New)
-    if (mDist > 0.0f) {
-      // Hard clipping / Folding
-      x *= (1.0f + mDist * 5.0f);
-      if (std::abs(x) > 1.0f) {
-        float overflow = std::abs(x) - 1.0f;
-        x = (x > 0 ? 1.0f : -1.0f) - (overflow * 0.5f); // Fold back
+  // Off, first order ADAA per stage, or 2x/4x oversampling of everything
+  // after the bass cut. Only first order shapes here, Adaa2 runs as Adaa1.
+  void setAntiAlias(AntiAlias mode) {
+    if (mode == AntiAlias::Adaa2)
+      mode = AntiAlias::Adaa1;
+    mAntiAlias = mode;
+    for (auto &ch : mCh)
+      ch.oversampler.setFactor(mode == AntiAlias::Oversample4x   ? 4
+                               : mode == AntiAlias::Oversample2x ? 2
+                                                                 : 1);
+    updateToneCoeff();
+  }
+  AntiAlias antiAlias() const { return mAntiAlias; }
+  float latency() const {
+    if (mAntiAlias != AntiAlias::Adaa1)
+      return mCh[0].oversampler.latency();
+    // Half a sample per ADAA stage
+    return (mDist > 0.0f ? 4.0f : 3.0f) * Adaa1<shapes::Tanh>::kLatency;
+  }
+  // Both sides per frame
+  float costNs() const { return mCost.ns(); }
+
+  // Oversampler latency plus a little for the tone filter to settle
+  int tailSamples(float sampleRate) const { return (int)latency() + 32; }
+
+  // In place. RETURNS (WET - INPUT) for Insert Behavior in Parallel Chain
+  void processBlock(float *left, float *right, int n) {
+    if (mAntiAlias == AntiAlias::Adaa1)
+      processFrames<true>(left, right, n);
+    else
+      processFrames<false>(left, right, n);
+  }
+
+  void setDistortion(float dist) { mDist = dist; }
+
+private:
+  // Same one-pole cutoff at any factor: k steps at the higher rate decay
+  // as much as one at the base rate
+  void updateToneCoeff() {
+    float alpha = 0.05f + mTone * 0.6f;
+    mToneAlpha =
+        1.0f -
+        std::pow(1.0f - alpha, 1.0f / (float)mCh[0].oversampler.factor());
+  }
+
+  // The anti-aliasing mode is fixed for the block, so is the path through
+  // the stages
+  template <bool Adaa> void processFrames(float *left, float *right, int n) {
+    float *io[2] = {left, right};
+    for (int i = 0; i < n; ++i) {
+      // 1. Tighten Bass (150Hz HP)
+      float x[2];
+      for (int c = 0; c < 2; ++c) {
+        mCh[c].hpState += 0.15f * (io[c][i] - mCh[c].hpState);
+        x[c] = (io[c][i] - mCh[c].hpState) * mDrive;
       }
+      mCost.measure([&] {
+        for (int c = 0; c < 2; ++c) {
+          Channel &ch = mCh[c];
+          // Clipping, tone and output saturation, at the oversampled rate
+          // when enabled. The tone filter has to go along, the output tanh
+          // would alias again otherwise.
+          if (Adaa)
+            x[c] = processAdaa(ch, x[c]);
+          else
+            x[c] = ch.oversampler.process(
+                x[c], [&](float s) { return output(ch, shape(s)); });
+        }
+        return 0.0f;
+      });
+      left[i] = x[0] - left[i];
+      right[i] = x[1] - right[i];
     }
+  }
 
-    // 3. Multi-stage Clipping & Wavefolding for "Texture"
-    float stage1 = (x > 0) ? std::tanh(x) : (x / (1.0f - x)); // Asymmetric
+  // Per side state, the parameters are shared
+  struct Channel {
+    Oversampler oversampler;
+    Adaa1<shapes::DriveFold> fold;
+    Adaa1<shapes::AsymClip> clip;
+    Adaa1<shapes::Grit> grit;
+    Adaa1<shapes::Tanh> out;
+    float lastOutput = 0.0f;
+    float hpState = 0.0f;
+  };
 
-    // Wavefolder component for "grit"
-    float grit = 0.0f;
-    if (std::abs(stage1) > 0.6f) {
-      grit = std::sin(stage1 * 4.0f) * 0.2f * mDrive * 0.1f;
-    }
-    float mixed = stage1 + grit;
+  float shape(float x) const {
+    if (mDist > 0.0f)
+      x = shapes::DriveFold::f(x * (1.0f + mDist * 5.0f));
+    return mCh[0].grit.shape.f(shapes::AsymClip::f(x));
+  }
 
+  float output(Channel &ch, float mixed) const {
     // Dynamic Low Pass (Tone)
-    float lpAlpha = 0.05f + mTone * 0.6f;
-    mLastOutput += lpAlpha * (mixed - mLastOutput);
-
+    ch.lastOutput += mToneAlpha * (mixed - ch.lastOutput);
     // Output Level + Strong Boost for volume parity
-    float out = mLastOutput * mLevel * 2.8f * mMix;
-    // RETURNS (WET - INPUT) for Insert Behavior in Parallel Chain
-    return std::tanh(out) - input;
+    return FastMath::tanh(ch.lastOutput * mLevel * 2.8f * mMix);
   }
 
-  void setDistortion(float dist) { mDist = dist; }
+  // Same chain with every stage antiderivative anti-aliased at base rate
+  float processAdaa(Channel &ch, float x) const {
+    if (mDist > 0.0f)
+      x = ch.fold.process(x * (1.0f + mDist * 5.0f));
+    float mixed = ch.grit.process(ch.clip.process(x));
+    ch.lastOutput += mToneAlpha * (mixed - ch.lastOutput);
+    return ch.out.process(ch.lastOutput * mLevel * 2.8f * mMix);
+  }
 
-private:
+  AntiAlias mAntiAlias = AntiAlias::Off;
+  Channel mCh[2];
+  CostMeter mCost;
   float mDrive = 1.0f;
   float mTone = 0.5f;
+  float mToneAlpha = 0.35f;
   float mLevel = 0.8f;
-  float mLastOutput = 0.0f;
-  float mHpState = 0.0f;
   float mMix = 1.0f;
   float mDist = 0.0f;
 };
@@ -1,6 +1,7 @@
 #ifndef PHASER_FX_H
 #define PHASER_FX_H
 
+#include "../FastMath.h"
 #include <cmath>
 #include <vector>
 
@@ -19,41 +20,79 @@ public:
   }
 
   void clear() {
-    for (int i = 0; i < 4; ++i)
-      mStageZ[i] = 0.0f;
-    mLastOutput = 0.0f;
+    for (int c = 0; c < 2; ++c) {
+      for (int i = 0; i < 4; ++i)
+        mStageZ[c][i] = 0.0f;
+      mLastOutput[c] = 0.0f;
+    }
     mPhase = 0.0f;
   }
 
-  float process(float input, float sampleRate) {
-    mPhase += (2.0f * M_PI * mRate) / sampleRate;
-    if (mPhase > 2.0f * M_PI)
-      mPhase -= 2.0f * M_PI;
-
-    float lfo = (sinf(mPhase) + 1.0f) * 0.5f; // 0.0 to 1.0
-    float freq = 200.0f + lfo * mDepth * 4000.0f;
-    float alpha = tanf(M_PI * freq / sampleRate);
-    float a1 = (alpha - 1.0f) / (alpha + 1.0f);
+  // No delay line, only the allpass ring. A period at the lowest sweep
+  // frequency is as long as it can cross zero for.
+  int tailSamples(float sampleRate) const { return (int)(sampleRate / 200.0f); }
 
-    float x = input + mFeedback * mLastOutput;
+  // In place, wet only. The allpass coefficient comes from the LFO at both
+  // ends of the block and is ramped in between, so the tan runs twice per
+  // block instead of per sample and channel.
+  void processBlock(float *left, float *right, int n, float sampleRate) {
+    if (n <= 0)
+      return;
+    const float twoPi = 2.0f * (float)M_PI;
+    const float inc = twoPi * mRate / sampleRate;
+    float a1 = coefficient(mPhase + inc, sampleRate);
+    float a1End = coefficient(mPhase + inc * (float)n, sampleRate);
+    const float a1Step = n > 1 ? (a1End - a1) / (float)(n - 1) : 0.0f;
+    mPhase += inc * (float)n;
+    while (mPhase > twoPi)
+      mPhase -= twoPi;
 
-    for (int i = 0; i < 4; ++i) {
-      float y = a1 * x + mStageZ[i];
-      mStageZ[i] = x - a1 * y;
-      x = y;
+    float *out[2] = {left, right};
+    for (int c = 0; c < 2; ++c) {
+      float *x = out[c];
+      float z0 = mStageZ[c][0], z1 = mStageZ[c][1];
+      float z2 = mStageZ[c][2], z3 = mStageZ[c][3];
+      float last = mLastOutput[c];
+      for (int i = 0; i < n; ++i) {
+        const float a = a1 + a1Step * i;
+        float s = x[i] + mFeedback * last;
+        float y = a * s + z0;
+        z0 = s - a * y;
+        s = y;
+        y = a * s + z1;
+        z1 = s - a * y;
+        s = y;
+        y = a * s + z2;
+        z2 = s - a * y;
+        s = y;
+        y = a * s + z3;
+        z3 = s - a * y;
+        // Denormal protection on phaser output
+        if (std::abs(y) < 1.0e-15f)
+          y = 0.0f;
+        last = y;
+        x[i] = y;
+      }
+      mStageZ[c][0] = z0;
+      mStageZ[c][1] = z1;
+      mStageZ[c][2] = z2;
+      mStageZ[c][3] = z3;
+      mLastOutput[c] = last;
+      for (int i = 0; i < n; ++i)
+        x[i] = FastMath::tanh(x[i]) * mMix;
     }
-
-    // Denormal protection on phaser output
-    if (std::abs(x) < 1.0e-15f)
-      x = 0.0f;
-
-    mLastOutput = x;
-    return std::tanh(x) * mMix; // Wet Only for Parallel Mix
   }
 
 private:
-  float mStageZ[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-  float mLastOutput = 0.0f;
+  float coefficient(float phase, float sampleRate) const {
+    float lfo = (FastMath::sin(phase) + 1.0f) * 0.5f; // 0.0 to 1.0
+    float freq = 200.0f + lfo * mDepth * 4000.0f;
+    float alpha = FastMath::tanPi(freq / sampleRate);
+    return (alpha - 1.0f) / (alpha + 1.0f);
+  }
+
+  float mStageZ[2][4] = {};
+  float mLastOutput[2] = {0.0f, 0.0f};
   float mPhase = 0.0f;
   float mRate = 0.5f;
   float mDepth = 0.5f;
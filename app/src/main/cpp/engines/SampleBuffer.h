@@ -0,0 +1,196 @@
+#ifndef SAMPLE_BUFFER_H
+#define SAMPLE_BUFFER_H
+
+#include "../Utils.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Mono sample storage shared by Sampler and Granular.
+// Float by default. Compact mode keeps int16 + one float scale (block-float
+// with a single block), halving RAM and cache traffic. Reads convert on the
+// fly, interpolation applies the scale once after mixing the taps.
+class SampleBuffer {
+public:
+  bool isCompact() const { return mCompact; }
+
+  void setCompact(bool compact) {
+    if (compact == mCompact)
+      return;
+    if (compact) {
+      std::vector<float> data = std::move(mFloat);
+      mFloat.clear();
+      mFloat.shrink_to_fit();
+      mCompact = true;
+      assign(data);
+    } else {
+      std::vector<float> data = toVector();
+      mPcm.clear();
+      mPcm.shrink_to_fit();
+      mCompact = false;
+      mFloat = std::move(data);
+    }
+  }
+
+  void assign(const std::vector<float> &data) {
+    if (!mCompact) {
+      mFloat = data;
+      return;
+    }
+    float peak = 0.0f;
+    for (float s : data)
+      peak = std::max(peak, std::abs(s));
+    // Full-scale by default so recordings appended later don't clip
+    mScale = std::max(peak, 1.0f) / 32767.0f;
+    float inv = 1.0f / mScale;
+    mPcm.resize(data.size());
+    for (size_t i = 0; i < data.size(); ++i)
+      mPcm[i] = quantize(data[i] * inv);
+  }
+
+  void push_back(float s) {
+    if (mCompact)
+      mPcm.push_back(quantize(s / mScale));
+    else
+      mFloat.push_back(s);
+  }
+
+  void clear() {
+    mFloat.clear();
+    mPcm.clear();
+    mScale = 1.0f / 32767.0f;
+  }
+
+  size_t size() const { return mCompact ? mPcm.size() : mFloat.size(); }
+  bool empty() const { return size() == 0; }
+
+  size_t bytes() const {
+    return mCompact ? mPcm.size() * sizeof(int16_t)
+                    : mFloat.size() * sizeof(float);
+  }
+
+  inline float operator[](size_t i) const {
+    return mCompact ? mPcm[i] * mScale : mFloat[i];
+  }
+
+  // Hermite read with wrap-around, idx must be in [0, size)
+  inline float cubicWrapped(int idx, float frac) const {
+    int size = static_cast<int>(this->size());
+    int i0 = (idx - 1 + size) % size;
+    int i1 = idx;
+    int i2 = (idx + 1) % size;
+    int i3 = (idx + 2) % size;
+    if (mCompact) {
+      return cubicInterpolation(mPcm[i0], mPcm[i1], mPcm[i2], mPcm[i3], frac) *
+             mScale;
+    }
+    return cubicInterpolation(mFloat[i0], mFloat[i1], mFloat[i2], mFloat[i3],
+                              frac);
+  }
+
+  // Hermite reads for n samples starting at pos, stepping by speed (negative
+  // plays backwards), wrapping like cubicWrapped. Returns the end position.
+  // Taps are gathered first, then interpolated in a separate loop that
+  // vectorizes.
+  float readCubicRun(float pos, float speed, float *out, int n) const {
+    if (mCompact)
+      return readRun(mPcm.data(), mScale, pos, speed, out, n);
+    return readRun(mFloat.data(), 1.0f, pos, speed, out, n);
+  }
+
+  float peak() const {
+    if (mCompact) {
+      int maxVal = 0;
+      for (int16_t s : mPcm)
+        maxVal = std::max(maxVal, std::abs((int)s));
+      return maxVal * mScale;
+    }
+    float maxVal = 0.0f;
+    for (float s : mFloat)
+      maxVal = std::max(maxVal, std::abs(s));
+    return maxVal;
+  }
+
+  // Compact mode just rescales, no requantization
+  void applyGain(float gain) {
+    if (mCompact) {
+      mScale *= gain;
+      return;
+    }
+    for (auto &s : mFloat)
+      s *= gain;
+  }
+
+  void keepRange(size_t start, size_t end) {
+    end = std::min(end, size());
+    if (start >= end)
+      return;
+    if (mCompact)
+      mPcm = std::vector<int16_t>(mPcm.begin() + start, mPcm.begin() + end);
+    else
+      mFloat = std::vector<float>(mFloat.begin() + start, mFloat.begin() + end);
+  }
+
+  std::vector<float> toVector() const {
+    if (!mCompact)
+      return mFloat;
+    std::vector<float> out(mPcm.size());
+    for (size_t i = 0; i < mPcm.size(); ++i)
+      out[i] = mPcm[i] * mScale;
+    return out;
+  }
+
+private:
+  template <typename T>
+  float readRun(const T *data, float scale, float pos, float speed,
+                float *out, int n) const {
+    const int size = static_cast<int>(this->size());
+    const float fSize = static_cast<float>(size);
+    float y0[kRunChunk], y1[kRunChunk], y2[kRunChunk], y3[kRunChunk];
+    float fr[kRunChunk];
+    for (int start = 0; start < n; start += kRunChunk) {
+      const int count = std::min(kRunChunk, n - start);
+      for (int k = 0; k < count; ++k) {
+        int idx = static_cast<int>(pos);
+        fr[k] = pos - static_cast<float>(idx);
+        if (idx >= 1 && idx + 2 < size) {
+          y0[k] = data[idx - 1];
+          y1[k] = data[idx];
+          y2[k] = data[idx + 1];
+          y3[k] = data[idx + 2];
+        } else {
+          y0[k] = data[(idx - 1 + size) % size];
+          y1[k] = data[idx];
+          y2[k] = data[(idx + 1) % size];
+          y3[k] = data[(idx + 2) % size];
+        }
+        pos += speed;
+        if (pos >= fSize)
+          pos -= fSize;
+        else if (pos < 0.0f)
+          pos += fSize;
+        if (pos >= fSize) // -tiny + size can round up to size
+          pos = 0.0f;
+      }
+      float *dst = out + start;
+      for (int k = 0; k < count; ++k)
+        dst[k] = cubicInterpolation(y0[k], y1[k], y2[k], y3[k], fr[k]) * scale;
+    }
+    return pos;
+  }
+
+  static const int kRunChunk = 64;
+
+  static inline int16_t quantize(float v) {
+    v = std::max(-32767.0f, std::min(32767.0f, v));
+    return static_cast<int16_t>(lrintf(v));
+  }
+
+  bool mCompact = false;
+  float mScale = 1.0f / 32767.0f;
+  std::vector<float> mFloat;
+  std::vector<int16_t> mPcm;
+};
+
+#endif // SAMPLE_BUFFER_H
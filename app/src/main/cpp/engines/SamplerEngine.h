@@ -3,6 +3,8 @@
 
 #include "../Utils.h"
 #include "Adsr.h"
+#include "SampleBuffer.h"
+#include "VoiceAllocator.h"
 #include <algorithm>
 #include <android/log.h>
 #include <cmath>
@@ -79,10 +81,18 @@ public:
 
   void setSample(const std::vector<float> &data) {
     std::lock_guard<std::recursive_mutex> lock(*mBufferLock);
-    mBuffer = data;
+    mBuffer.assign(data);
   }
   void loadSample(const std::vector<float> &data) { setSample(data); }
-  const std::vector<float> &getSampleData() const { return mBuffer; }
+  std::vector<float> getSampleData() const { return mBuffer.toVector(); }
+
+  // int16 storage, half the memory. UI thread only, it rebuilds the buffer.
+  void setCompactStorage(bool compact) {
+    std::lock_guard<std::recursive_mutex> lock(*mBufferLock);
+    mBuffer.setCompact(compact);
+  }
+  size_t getSampleMemoryBytes() const { return mBuffer.bytes(); }
+  bool hasContent() const { return !mBuffer.empty(); }
 
   void setSlicePoints(const std::vector<float> &points) {
     std::lock_guard<std::recursive_mutex> lock(*mBufferLock);
@@ -112,6 +122,7 @@ public:
     mSlices.clear();
     for (auto &v : mVoices)
       v.active = false;
+    mVoiceAlloc.clearAll();
   }
 
   void pushSample(float sample) {
@@ -123,14 +134,9 @@ public:
     std::lock_guard<std::recursive_mutex> lock(*mBufferLock);
     if (mBuffer.empty())
       return;
-    float maxVal = 0.0f;
-    for (float s : mBuffer)
-      maxVal = std::max(maxVal, std::abs(s));
-    if (maxVal > 0.0001f) {
-      float gain = 0.95f / maxVal;
-      for (auto &s : mBuffer)
-        s *= gain;
-    }
+    float maxVal = mBuffer.peak();
+    if (maxVal > 0.0001f)
+      mBuffer.applyGain(0.95f / maxVal);
   }
 
   void trim() {
@@ -147,14 +153,13 @@ public:
       else
         return;
     }
-    std::vector<float> newBuffer(mBuffer.begin() + start,
-                                 mBuffer.begin() + end);
-    mBuffer = std::move(newBuffer);
+    mBuffer.keepRange(start, end);
     mTrimStart = 0.0f;
     mTrimEnd = 1.0f;
     mSlices.clear();
     for (auto &v : mVoices)
       v.active = false;
+    mVoiceAlloc.clearAll();
   }
 
   void allNotesOff() {
@@ -163,6 +168,7 @@ public:
       v.envelope.reset();
       v.active = false; // "isPlaying" equivalent
     }
+    mVoiceAlloc.clearAll();
   }
 
   void setSampleRate(float sr) {
@@ -190,20 +196,16 @@ public:
         break;
       }
     }
-    if (voiceIdx == -1) {
-      for (int i = 0; i < 16; ++i) {
-        if (!mVoices[i].active) {
-          voiceIdx = i;
-          break;
-        }
-      }
-    }
     if (voiceIdx == -1)
-      voiceIdx = 0;
+      voiceIdx = mVoiceAlloc.freeVoice((int)mVoices.size());
+    if (voiceIdx == -1)
+      voiceIdx =
+          mVoiceAlloc.victim([this](int i) { return keepScore(i); }, false);
 
     Voice &v = mVoices[voiceIdx];
     v.reset();
     v.active = true;
+    mVoiceAlloc.setActive(voiceIdx);
     v.note = note;
     v.baseVelocity = velocity / 127.0f;
 
@@ -250,7 +252,8 @@ public:
                       mPlayMode == LoopChops)
                          ? 0.0f
                          : (float)(note - 60);
-    float targetRatio = powf(2.0f, (mPitch + keyShift) / 12.0f) * mSpeed;
+    float targetRatio =
+        FastMath::semitonesToRatio(mPitch + keyShift) * mSpeed;
     v.targetPitchRatio = targetRatio;
     v.pitchRatio = (mGlide > 0.001f) ? mLastPitchRatio : targetRatio;
     mLastPitchRatio = targetRatio;
@@ -367,13 +370,18 @@ public:
     float mixedOutput = 0.0f;
     int activeCount = 0;
 
-    for (auto &v : mVoices) {
-      if (!v.active)
+    for (uint32_t m = mVoiceAlloc.mask(); m; m &= m - 1) {
+      const int i = __builtin_ctz(m);
+      Voice &v = mVoices[i];
+      if (!v.active) {
+        mVoiceAlloc.clear(i);
         continue;
+      }
 
       float env = mUseEnvelope ? v.envelope.nextValue() : 1.0f;
       if (env < 0.0001f && (!mUseEnvelope || !v.envelope.isActive())) {
         v.active = false;
+        mVoiceAlloc.clear(i);
         continue;
       }
       activeCount++;
@@ -504,7 +512,8 @@ public:
         cutoff += env * mFilterEnvAmount * 12000.0f;
         cutoff = std::max(20.0f, std::min(20000.0f, cutoff));
 
-        v.filter.setParams(cutoff, 0.7f + mFilterResonance * 5.0f, 48000.0f);
+        v.filter.setParamsSmooth(cutoff, 0.7f + mFilterResonance * 5.0f,
+                                 48000.0f, 16);
       }
       voiceOutput = v.filter.process(voiceOutput, TSvf::LowPass);
 
@@ -606,11 +615,22 @@ public:
     return result;
   }
 
-  bool isActive() const {
-    for (const auto &v : mVoices)
-      if (v.active)
-        return true;
-    return false;
+  bool isActive() const { return mVoiceAlloc.any(); }
+
+  // Global voice budget, see AudioEngine::enforceVoiceLimit
+  int liveVoiceCount() const { return mVoiceAlloc.liveCount(); }
+  int stealCandidate(float &score) const {
+    return mVoiceAlloc.victim([this](int i) { return keepScore(i); }, true,
+                              &score);
+  }
+  void stealVoice(int i) {
+    if (!mUseEnvelope) {
+      mVoices[i].active = false;
+      mVoiceAlloc.clear(i);
+      return;
+    }
+    mVoices[i].envelope.fastRelease();
+    mVoiceAlloc.markStolen(i);
   }
 
   std::shared_ptr<std::recursive_mutex> mBufferLock =
@@ -618,7 +638,14 @@ public:
   bool mReverse = false;
 
 private:
+  float keepScore(int i) const {
+    const Voice &v = mVoices[i];
+    return v.baseVelocity * v.envelope.keepLevel() +
+           (v.envelope.isReleasing() ? 0.0f : 1.0f);
+  }
+
   std::vector<Voice> mVoices;
+  VoiceAllocator mVoiceAlloc;
   float mTrimStart = 0.0f;
   float mTrimEnd = 1.0f;
   float mPitch = 0.0f;
@@ -632,7 +659,7 @@ private:
   int mSampleRate = 48000;
 
   std::vector<Slice> mSlices;
-  std::vector<float> mBuffer;
+  SampleBuffer mBuffer;
 };
 
 #endif // SAMPLER_ENGINE_H
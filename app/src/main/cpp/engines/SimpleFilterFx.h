@@ -32,51 +32,72 @@ public:
 
   void setMix(float mix) { mMix = mix; }
 
-  // Process mono sample
-  float process(float input, float sampleRate) {
-    if (mMix <= 0.001f || sampleRate <= 0.0f)
-      return input;
-
-    // Smooth parameters
-    mCutoff += 0.002f * (mTargetCutoff - mCutoff);
-    mResonance += 0.002f * (mTargetResonance - mResonance);
+  // In place. Cutoff and resonance are smoothed a block at a time, the
+  // coefficients computed once at the block's end and ramped across it, so
+  // the tan only runs once per block.
+  void processBlock(float *left, float *right, int n, float sampleRate) {
+    if (mMix <= 0.001f || sampleRate <= 0.0f || n <= 0)
+      return;
+
+    // Smooth parameters: the 0.002 per sample one-pole, n steps at once
+    const float k = 1.0f - std::exp2(kSmoothLog2 * (float)n);
+    mCutoff += k * (mTargetCutoff - mCutoff);
+    mResonance += k * (mTargetResonance - mResonance);
 
     float f_clipped = std::clamp(mCutoff, 20.0f, sampleRate / 6.0f);
-    float g = std::tan((float)M_PI * f_clipped / sampleRate);
-    float q = 1.0f / mResonance;
-    float d = 1.0f / (1.0f + g * (g + q));
-
-    float hp = (input - (q + g) * mState1 - mState2) * d;
-    float bp = g * hp + mState1;
-    mState1 = g * hp + bp;
-    float lp = g * bp + mState2;
-    mState2 = g * bp + lp;
-
-    float wet = 0.0f;
-    switch (mMode) {
-    case LP:
-      wet = lp;
-      break;
-    case HP:
-      wet = hp;
-      break;
-    case BP:
-      wet = bp;
-      break;
-    default:
-      wet = lp;
-      break;
+    const float g1 = std::tan((float)M_PI * f_clipped / sampleRate);
+    const float q1 = 1.0f / mResonance;
+    if (mG <= 0.0f) {
+      mG = g1;
+      mQ = q1;
     }
-
-    return input * (1.0f - mMix) + wet * mMix;
+    const float gStep = (g1 - mG) / (float)n;
+    const float qStep = (q1 - mQ) / (float)n;
+
+    // Mode picked once, as weights on the three outputs
+    const float wLp = mMode == LP ? mMix : 0.0f;
+    const float wHp = mMode == HP ? mMix : 0.0f;
+    const float wBp = mMode == BP ? mMix : 0.0f;
+    const float dry = 1.0f - mMix;
+
+    float *io[2] = {left, right};
+    for (int c = 0; c < 2; ++c) {
+      float *x = io[c];
+      float s1 = mState[c][0], s2 = mState[c][1];
+      for (int i = 0; i < n; ++i) {
+        const float g = mG + gStep * (float)(i + 1);
+        const float q = mQ + qStep * (float)(i + 1);
+        const float d = 1.0f / (1.0f + g * (g + q));
+
+        float hp = (x[i] - (q + g) * s1 - s2) * d;
+        float bp = g * hp + s1;
+        s1 = g * hp + bp;
+        float lp = g * bp + s2;
+        s2 = g * bp + lp;
+
+        x[i] = x[i] * dry + lp * wLp + hp * wHp + bp * wBp;
+      }
+      mState[c][0] = s1;
+      mState[c][1] = s2;
+    }
+    mG = g1;
+    mQ = q1;
   }
 
   void clear() {
-    mState1 = 0.0f;
-    mState2 = 0.0f;
+    mState[0][0] = mState[0][1] = 0.0f;
+    mState[1][0] = mState[1][1] = 0.0f;
+  }
+
+  // A resonant ring only goes quiet around its zero crossings, so a period
+  // at the cutoff
+  int tailSamples(float sampleRate) const {
+    return (int)(sampleRate / mCutoff) + 1;
   }
 
 private:
+  static constexpr float kSmoothLog2 = -0.0028882793248265117f; // log2(0.998)
+
   float mCutoff = 1000.0f;
   float mTargetCutoff = 1000.0f;
   float mResonance = 0.707f;
@@ -84,9 +105,12 @@ private:
   float mMix = 0.0f;
   Mode mMode = LP;
 
-  // Filter State (TPT form)
-  float mState1 = 0.0f;
-  float mState2 = 0.0f;
+  // Coefficients at the end of the last block, ramped from
+  float mG = 0.0f;
+  float mQ = 0.0f;
+
+  // Filter State (TPT form), per side
+  float mState[2][2] = {};
 };
 
 #endif // SIMPLE_FILTER_FX_H
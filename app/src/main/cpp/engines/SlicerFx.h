@@ -15,6 +15,9 @@ public:
   void setActive3(bool v) { mActive3 = v; }
   void setDepth(float v) { mDepth = v; }
 
+  // Gain only, nothing is held
+  int tailSamples(float sampleRate) const { return 0; }
+
   void setParameters(float rate1, float rate2, float rate3, bool active1,
                      bool active2, bool active3, float depth) {
     mRate1 = rate1;
@@ -26,40 +29,42 @@ public:
     mDepth = depth;
   }
 
-  float process(float input, double sampleCount, double samplesPerStep) {
+  // In place. Insert Logic: writes (activeGain - 1) * input, so a gain of
+  // 1 adds nothing and a gain of 0 cancels the dry signal. sampleCount is
+  // the position of the block's first frame.
+  void processBlock(float *left, float *right, int n, double sampleCount,
+                    double samplesPerStep) {
     if (samplesPerStep <= 0)
-      return input;
-
-    float activeGain = 1.0f;
+      return;
 
-    // Slicer 1
-    if (mActive1 && mRate1 > 0) {
-      double cycle = samplesPerStep / (double)mRate1;
-      double pos = std::fmod(sampleCount, cycle) / cycle;
-      if (pos > 0.5)
-        activeGain *= (1.0f - mDepth);
+    // Where each slicer is within its cycle, found once per block and then
+    // stepped along a frame at a time
+    const bool active[3] = {mActive1 && mRate1 > 0, mActive2 && mRate2 > 0,
+                            mActive3 && mRate3 > 0};
+    const float rates[3] = {mRate1, mRate2, mRate3};
+    double cycle[3] = {1.0, 1.0, 1.0}, pos[3] = {0.0, 0.0, 0.0};
+    for (int s = 0; s < 3; ++s) {
+      if (!active[s])
+        continue;
+      cycle[s] = samplesPerStep / (double)rates[s];
+      pos[s] = std::fmod(sampleCount, cycle[s]);
     }
 
-    // Slicer 2
-    if (mActive2 && mRate2 > 0) {
-      double cycle = samplesPerStep / (double)mRate2;
-      double pos = std::fmod(sampleCount, cycle) / cycle;
-      if (pos > 0.5)
-        activeGain *= (1.0f - mDepth);
+    const float cut = 1.0f - mDepth;
+    for (int i = 0; i < n; ++i) {
+      float activeGain = 1.0f;
+      for (int s = 0; s < 3; ++s) {
+        if (!active[s])
+          continue;
+        if (pos[s] > 0.5 * cycle[s])
+          activeGain *= cut;
+        pos[s] += 1.0;
+        if (pos[s] >= cycle[s])
+          pos[s] -= cycle[s];
+      }
+      left[i] *= activeGain - 1.0f;
+      right[i] *= activeGain - 1.0f;
     }
-
-    // Slicer 3
-    if (mActive3 && mRate3 > 0) {
-      double cycle = samplesPerStep / (double)mRate3;
-      double pos = std::fmod(sampleCount, cycle) / cycle;
-      if (pos > 0.5)
-        activeGain *= (1.0f - mDepth);
-    }
-
-    // Insert Logic: return (activeGain - 1) * input
-    // If gain is 1, return 0 (Add nothing).
-    // If gain is 0, return -input (Cancel dry).
-    return input * (activeGain - 1.0f);
   }
 
 private:
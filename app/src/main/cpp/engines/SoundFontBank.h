@@ -0,0 +1,96 @@
+#ifndef SOUNDFONT_BANK_H
+#define SOUNDFONT_BANK_H
+
+#include "../libs/tsf.h"
+#include <fcntl.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// One parsed .sf2 shared by every track that loads the same path. The file is
+// mmapped and its 16-bit sample pool played in place (tsf_load_mapped), so a
+// large GM bank costs page cache rather than a float heap copy, and only once.
+// Tracks get their own tsf_copy (voices, channels, output rate).
+class SoundFontBank {
+public:
+  ~SoundFontBank() {
+    if (mTsf) {
+      std::lock_guard<std::mutex> lock(cache().mutex);
+      tsf_close(mTsf);
+    }
+    if (mMap != MAP_FAILED)
+      munmap(mMap, mMapSize);
+  }
+
+  static std::shared_ptr<SoundFontBank> open(const std::string &path) {
+    {
+      Cache &c = cache();
+      std::lock_guard<std::mutex> lock(c.mutex);
+      auto it = c.entries.find(path);
+      if (it != c.entries.end())
+        if (auto bank = it->second.lock())
+          return bank;
+    }
+
+    // Parse outside the cache lock, big banks take a while
+    auto bank = std::make_shared<SoundFontBank>();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+      struct stat st;
+      if (fstat(fd, &st) == 0 && st.st_size > 0 && st.st_size < 0x7fffffff) {
+        bank->mMapSize = (size_t)st.st_size;
+        bank->mMap = mmap(nullptr, bank->mMapSize, PROT_READ, MAP_PRIVATE, fd, 0);
+      }
+      ::close(fd);
+    }
+    if (bank->mMap != MAP_FAILED)
+      bank->mTsf = tsf_load_mapped(bank->mMap, (int)bank->mMapSize);
+    else
+      bank->mTsf = tsf_load_filename(path.c_str());
+    if (!bank->mTsf)
+      return nullptr;
+
+    Cache &c = cache();
+    std::lock_guard<std::mutex> lock(c.mutex);
+    // Another track may have finished loading the same file meanwhile
+    auto &entry = c.entries[path];
+    if (auto existing = entry.lock())
+      return existing;
+    entry = bank;
+    return bank;
+  }
+
+  // Independent playback instance, close with closeInstance
+  tsf *instance() const {
+    std::lock_guard<std::mutex> lock(cache().mutex);
+    return tsf_copy(mTsf);
+  }
+
+  // tsf_copy/tsf_close share a plain refcount, so both go through the lock
+  static void closeInstance(tsf *t) {
+    if (!t)
+      return;
+    std::lock_guard<std::mutex> lock(cache().mutex);
+    tsf_close(t);
+  }
+
+private:
+  struct Cache {
+    std::mutex mutex;
+    std::map<std::string, std::weak_ptr<SoundFontBank>> entries;
+  };
+  static Cache &cache() {
+    static Cache c;
+    return c;
+  }
+
+  tsf *mTsf = nullptr;
+  void *mMap = MAP_FAILED;
+  size_t mMapSize = 0;
+};
+
+#endif // SOUNDFONT_BANK_H
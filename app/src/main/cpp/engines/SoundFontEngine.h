@@ -1,7 +1,9 @@
 #ifndef SOUNDFONT_ENGINE_H
 #define SOUNDFONT_ENGINE_H
 
-#include "../libs/tsf.h"
+#include "../FastMath.h"
+#include "SoundFontBank.h"
+#include <algorithm>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -13,55 +15,73 @@ public:
 
   // Explicit move semantics required due to custom destructor + unique_ptr
   SoundFontEngine(SoundFontEngine &&other) noexcept
-      : mTsf(other.mTsf), mGlide(other.mGlide), mLastNote(other.mLastNote),
+      : mBank(std::move(other.mBank)), mTsf(other.mTsf),
+        mGlide(other.mGlide), mLastNote(other.mLastNote),
         mCurrentPitchWheel(other.mCurrentPitchWheel),
-        mSampleRate(other.mSampleRate), mBufferPos(other.mBufferPos),
-        mBufferFrames(other.mBufferFrames), mMutex(std::move(other.mMutex)) {
+        mSampleRate(other.mSampleRate), mMutex(std::move(other.mMutex)) {
     other.mTsf = nullptr;
-    memcpy(mInternalBuffer, other.mInternalBuffer, sizeof(mInternalBuffer));
   }
 
   SoundFontEngine &operator=(SoundFontEngine &&other) noexcept {
     if (this != &other) {
-      if (mTsf)
-        tsf_close(mTsf);
+      SoundFontBank::closeInstance(mTsf);
+      mBank = std::move(other.mBank);
       mTsf = other.mTsf;
       other.mTsf = nullptr;
       mGlide = other.mGlide;
       mLastNote = other.mLastNote;
       mCurrentPitchWheel = other.mCurrentPitchWheel;
       mSampleRate = other.mSampleRate;
-      mBufferPos = other.mBufferPos;
-      mBufferFrames = other.mBufferFrames;
       mMutex = std::move(other.mMutex);
-      memcpy(mInternalBuffer, other.mInternalBuffer, sizeof(mInternalBuffer));
     }
     return *this;
   }
 
-  ~SoundFontEngine() {
-    if (mTsf)
-      tsf_close(mTsf);
+  ~SoundFontEngine() { SoundFontBank::closeInstance(mTsf); }
+
+  // A bank and a playback instance of it
+  struct Loaded {
+    std::shared_ptr<SoundFontBank> bank;
+    tsf *instance = nullptr;
+  };
+
+  // Opens the shared bank and copies out an instance. Slow, so call it
+  // without any lock the audio thread takes and hand the result to install().
+  static Loaded open(const std::string &path, float sampleRate) {
+    Loaded loaded;
+    loaded.bank = SoundFontBank::open(path);
+    loaded.instance = loaded.bank ? loaded.bank->instance() : nullptr;
+    if (loaded.instance) {
+      tsf_set_output(loaded.instance, TSF_STEREO_UNWEAVED, (int)sampleRate,
+                     0.0f);
+      tsf_channel_set_pitchrange(loaded.instance, 0, 24.0f); // +/- 2 octaves
+    }
+    return loaded;
   }
 
-  void load(const std::string &path) {
-    if (mMutex) {
-      std::lock_guard<std::mutex> lock(*mMutex);
-      if (mTsf)
-        tsf_close(mTsf);
-      mTsf = tsf_load_filename(path.c_str());
-      if (mTsf) {
-        tsf_set_output(mTsf, TSF_STEREO_INTERLEAVED, 48000, 0.0f);
-        tsf_channel_set_pitchrange(mTsf, 0, 24.0f); // +/- 2 octaves
-        mBufferPos = 128;                           // Force reload
-      }
-    }
+  // Only swaps pointers. Returns what it replaced, for release() once the
+  // caller has let go of its locks.
+  Loaded install(Loaded next) {
+    if (!mMutex)
+      return next;
+    std::lock_guard<std::mutex> lock(*mMutex);
+    Loaded old{std::move(mBank), mTsf};
+    mBank = std::move(next.bank);
+    mTsf = next.instance;
+    return old;
+  }
+
+  // Closing an instance, or the last one of a bank, frees the sample pool
+  static void release(Loaded &loaded) {
+    SoundFontBank::closeInstance(loaded.instance);
+    loaded.instance = nullptr;
+    loaded.bank.reset();
   }
 
   void setSampleRate(float sr) {
     mSampleRate = sr;
     if (mTsf) {
-      tsf_set_output(mTsf, TSF_STEREO_INTERLEAVED, (int)sr, 0.0f);
+      tsf_set_output(mTsf, TSF_STEREO_UNWEAVED, (int)sr, 0.0f);
     }
   }
 
@@ -86,6 +106,7 @@ public:
   }
 
   int getPresetCount() { return mTsf ? tsf_get_presetcount(mTsf) : 0; }
+  bool hasContent() const { return mTsf != nullptr; }
 
   void noteOn(int note, int velocity) {
     if (mTsf) {
@@ -105,34 +126,38 @@ public:
       tsf_channel_note_off(mTsf, 0, note);
   }
 
+  // Renders straight into left/right. Glide updates the pitch wheel every
+  // 64 frames, the same rate TSF refreshes its voice parameters.
   void render(float *left, float *right, int numFrames) {
-    if (mMutex && mTsf) {
-      std::lock_guard<std::mutex> lock(*mMutex);
+    if (!mMutex || !mTsf || !mMutex->try_lock()) {
+      std::fill(left, left + numFrames, 0.0f);
+      std::fill(right, right + numFrames, 0.0f);
+      return;
+    }
+    std::lock_guard<std::mutex> lock(*mMutex, std::adopt_lock);
+    if (!mTsf) {
+      std::fill(left, left + numFrames, 0.0f);
+      std::fill(right, right + numFrames, 0.0f);
+      return;
+    }
+
+    for (int done = 0; done < numFrames;) {
+      int n = std::min(kGlideBlock, numFrames - done);
       if (mGlide > 0.001f) {
         float glideTimeSamples = mGlide * mSampleRate * 0.5f;
         float glideAlpha = 1.0f / (glideTimeSamples + 1.0f);
-        mCurrentPitchWheel += (0.0f - mCurrentPitchWheel) * glideAlpha;
-        updatePitchWheel();
+        // n one-pole steps at once
+        mCurrentPitchWheel *= FastMath::pow(1.0f - glideAlpha, (float)n);
       } else {
         mCurrentPitchWheel = 0.0f;
-        updatePitchWheel();
       }
+      updatePitchWheel();
 
-      for (int i = 0; i < numFrames; ++i) {
-        if (mBufferPos >= mBufferFrames) {
-          // Render next internal block (64 samples interleaved)
-          mBufferFrames = 64;
-          tsf_render_float(mTsf, mInternalBuffer, mBufferFrames, 0);
-          mBufferPos = 0;
-        }
-        left[i] = mInternalBuffer[mBufferPos * 2];
-        right[i] = mInternalBuffer[mBufferPos * 2 + 1];
-        mBufferPos++;
-      }
-    } else {
-      for (int i = 0; i < numFrames; ++i) {
-        left[i] = right[i] = 0.0f;
-      }
+      // Unweaved output is [L block][R block]
+      tsf_render_float(mTsf, mScratch, n, 0);
+      std::copy(mScratch, mScratch + n, left + done);
+      std::copy(mScratch + n, mScratch + 2 * n, right + done);
+      done += n;
     }
   }
 
@@ -182,15 +207,16 @@ private:
     tsf_channel_set_pitchwheel(mTsf, 0, (int)wheelValue);
   }
 
+  static const int kGlideBlock = 64;
+
+  std::shared_ptr<SoundFontBank> mBank;
   tsf *mTsf;
   float mGlide = 0.0f;
   int mLastNote = -1;
   float mCurrentPitchWheel = 0.0f;
   float mSampleRate = 48000.0f;
 
-  float mInternalBuffer[128]; // 64 stereo frames
-  int mBufferPos = 128;
-  int mBufferFrames = 128;
+  float mScratch[2 * kGlideBlock];
   std::unique_ptr<std::mutex> mMutex;
 };
 
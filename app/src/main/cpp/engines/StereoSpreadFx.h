@@ -1,6 +1,7 @@
 #ifndef STEREO_SPREAD_FX_H
 #define STEREO_SPREAD_FX_H
 
+#include "../FastMath.h"
 #include <cmath>
 #include <vector>
 
@@ -35,7 +36,7 @@ public:
     mPhase += mRate / sampleRate;
     if (mPhase >= 1.0f)
       mPhase -= 1.0f;
-    float lfo = std::sin(2.0f * 3.14159265f * mPhase);
+    float lfo = FastMath::sin2pi(mPhase);
 
     // Modulate Delay Times inversely for widening
     float baseDelay = 0.010f; // 10ms
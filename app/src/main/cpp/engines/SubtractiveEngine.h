@@ -2,8 +2,10 @@
 #define SUBTRACTIVE_ENGINE_H
 
 #include "../Utils.h"
+#include "../Waveshaper.h"
 #include "Adsr.h"
 #include "Oscillator.h"
+#include "VoiceAllocator.h"
 #include <android/log.h>
 #include <cmath>
 #include <memory>
@@ -21,15 +23,9 @@ public:
     float amplitude = 1.0f;
     Adsr ampEnv;
     Adsr filterEnv;
-    std::vector<Oscillator> oscillators;
-
-    // SVF state
-    TSvf svf;
     float currentFilterEnvVal = 0.0f;
     uint32_t controlCounter = 0;
 
-    Voice() { oscillators.resize(4); }
-
     void reset() {
       active = false;
       isNoteHeld = false;
@@ -38,14 +34,29 @@ public:
       targetFrequency = 440.0f;
       ampEnv.reset();
       filterEnv.reset();
-      svf.setParams(1000.0f, 0.7f, 44100.0f);
     }
   };
 
+  static const int kMaxVoices = 16;
+
+  // Per-sample voice state as structure-of-arrays. Oscillators, mixing and
+  // the ZDF SVF run as plain loops over voice lanes so they vectorize
+  // (NEON/SSE, 4 lanes). Envelopes stay per Voice (branchy stage machine).
+  struct alignas(16) VoiceLanes {
+    float phase[4][kMaxVoices];
+    float osc[4][kMaxVoices];
+    float inc[kMaxVoices];  // freq / sr
+    float gain[kMaxVoices]; // amplitude * env, 0 on idle lanes
+    float noise[kMaxVoices];
+    float x[kMaxVoices];
+  };
+
   SubtractiveEngine() {
-    mVoices.resize(16);
-    for (auto &v : mVoices)
-      v.reset();
+    mVoices.resize(kMaxVoices);
+    for (int i = 0; i < kMaxVoices; ++i) {
+      mVoices[i].reset();
+      mFilter.set(i, 1000.0f, 0.7f, 44100.0f);
+    }
     mOscVolumes.assign(4, 0.0f);
     mOscVolumes[0] = 0.6f;
     mOscVolumes[1] = 0.4f;
@@ -96,13 +107,6 @@ public:
       // 0.6=Saw, 0.8=Square, 0.0=Sine. Mapping is in setOscWaveform logic.
       // Or simpler: iterate voices directly:
     }
-    for (auto &v : mVoices) {
-      v.oscillators[0].setWaveform(mOscWaveforms[0]);
-      v.oscillators[1].setWaveform(mOscWaveforms[1]);
-      v.oscillators[2].setWaveform(mOscWaveforms[2]);
-      v.oscillators[3].setWaveform(mOscWaveforms[3]);
-    }
-
     updateLiveEnvelopes();
   }
 
@@ -129,26 +133,23 @@ public:
       v.ampEnv.reset();
       v.filterEnv.reset();
     }
+    mVoiceAlloc.clearAll();
   }
 
   void triggerNote(int note, int velocity) {
-    int idx = -1;
-    for (int i = 0; i < 16; ++i)
-      if (!mVoices[i].active) {
-        idx = i;
-        break;
-      }
+    int idx = mVoiceAlloc.freeVoice(kMaxVoices);
     if (idx == -1)
-      idx = 0;
+      idx = mVoiceAlloc.victim([this](int i) { return keepScore(i); }, false);
 
     Voice &v = mVoices[idx];
     v.active = true;
+    mVoiceAlloc.setActive(idx);
     v.isNoteHeld = true;
     v.note = note;
     v.amplitude = velocity / 127.0f;
     float baseFreq = mIgnoreNoteFrequency
                          ? mFrequency
-                         : 440.0f * powf(2.0f, (note - 69) / 12.0f);
+                         : FastMath::noteToFreq((float)note);
 
     v.targetFrequency = baseFreq;
     v.frequency = (mGlide > 0.001f) ? mLastFrequency : baseFreq;
@@ -161,12 +162,11 @@ public:
 
     v.ampEnv.trigger();
     v.filterEnv.trigger();
-    v.svf.setParams(1000.0f, 0.7f, mSampleRate);
+    mFilter.set(idx, 1000.0f, 0.7f, mSampleRate);
 
-    for (int i = 0; i < 4; ++i) {
-      v.oscillators[i].setFrequency(v.frequency, mSampleRate);
-      v.oscillators[i].resetPhase();
-    }
+    mLanes.inc[idx] = v.frequency / mSampleRate;
+    for (int i = 0; i < 4; ++i)
+      mLanes.phase[i][idx] = 0.0f;
   }
 
   void releaseNote(int note) {
@@ -254,14 +254,14 @@ public:
       mOscFold[id - 180] = value;
     else if (id >= 190 && id <= 193) {
       mOscPW[id - 190] = value;
-      for (auto &v : mVoices)
-        v.oscillators[id - 190].setWaveShape(value);
     } else if (id >= 107 && id <= 109) {
       setOscVolume(id - 107, value);
     } else if (id == 110) {
       setNoiseLevel(value);
     } else if (id == 355) {
       setGlide(value);
+    } else if (id == 357) { // Anti-aliasing for fold and output saturation
+      mSaturator.setMode((AntiAlias)(int)value);
     } else if (id == 155) { // Sub Shape
       setOscWaveform(2, value);
     }
@@ -281,104 +281,183 @@ public:
       else
         w = Waveform::Sawtooth;
       mOscWaveforms[index] = w;
-      for (auto &v : mVoices)
-        v.oscillators[index].setWaveform(w);
     }
   }
 
   void setFilterMode(int mode) { mFilterMode = mode; }
 
   float render() {
-    float mixedOutput = 0.0f;
-    int activeCount = 0;
     float lfo =
-        sinf(mControlCounter * 6.283185f * mLfoRate / mSampleRate) * mLfoDepth;
+        FastMath::sin2pi(mControlCounter * mLfoRate / mSampleRate) * mLfoDepth;
+    mControlCounter++;
 
-    for (auto &v : mVoices) {
-      if (!v.active)
+    // Scalar pass: glide, envelopes, filter coefficients, for the voices in
+    // the active mask only. Voices are allocated lowest-first, so only lanes
+    // up to the last live one are run.
+    int activeCount = 0;
+    int lastLive = -1;
+    std::fill(mLanes.gain, mLanes.gain + kMaxVoices, 0.0f);
+    std::fill(mLanes.noise, mLanes.noise + kMaxVoices, 0.0f);
+    for (uint32_t m = mVoiceAlloc.mask(); m; m &= m - 1) {
+      const int i = __builtin_ctz(m);
+      Voice &v = mVoices[i];
+      if (!v.active) {
+        mVoiceAlloc.clear(i);
         continue;
+      }
 
       if (mGlide > 0.001f) {
         float glideTimeSamples = mGlide * mSampleRate * 0.5f;
         float glideAlpha = 1.0f / (glideTimeSamples + 1.0f);
         v.frequency += (v.targetFrequency - v.frequency) * glideAlpha;
-        for (int i = 0; i < 4; ++i) {
-          v.oscillators[i].setFrequency(v.frequency, mSampleRate);
-        }
       } else {
         v.frequency = v.targetFrequency;
       }
+      mLanes.inc[i] = v.frequency / mSampleRate;
 
       float envVal = mUseEnvelope ? v.ampEnv.nextValue() : 1.0f;
       if (envVal < 0.0001f && mUseEnvelope && !v.ampEnv.isActive()) {
         v.active = false;
+        mVoiceAlloc.clear(i);
         continue;
       }
       activeCount++;
+      lastLive = i;
       v.currentFilterEnvVal = v.filterEnv.nextValue();
-
-      float osc1Pitch = mOscPitch[0];
-      float osc2Pitch = mOscPitch[1] * (1.0f + mDetune * 0.05f);
-      float osc3Pitch = mOscPitch[2];
-      float osc4Pitch = mOscPitch[3];
-
-      if (mOscSync && v.oscillators[0].hasWrapped()) {
-        v.oscillators[1].resetPhase();
-      }
-
-      float osc1Val = v.oscillators[0].nextSample(0.0f, osc1Pitch, mOscFold[0]);
-      float osc2Val = v.oscillators[1].nextSample(0.0f, osc2Pitch, mOscFold[1]);
-      float osc3Val = v.oscillators[2].nextSample(0.0f, osc3Pitch, mOscFold[2]);
-      float osc4Val = v.oscillators[3].nextSample(0.0f, osc4Pitch, mOscFold[3]);
-
-      float subOutput = 0.0f;
-      if (mRingMod) {
-        subOutput = (osc1Val * mOscVolumes[0] * mOscDrive[0]) *
-                    (osc2Val * mOscVolumes[1] * mOscDrive[1]);
-      } else {
-        subOutput = (osc1Val * mOscVolumes[0] * mOscDrive[0]) +
-                    (osc2Val * mOscVolumes[1] * mOscDrive[1]);
-      }
-      subOutput += (osc3Val * mOscVolumes[2] * mOscDrive[2]);
-      subOutput += (osc4Val * mOscVolumes[3] * mOscDrive[3]);
+      mLanes.gain[i] = v.amplitude * envVal;
 
       mNoiseSeed = mNoiseSeed * 1103515245 + 12345;
-      subOutput +=
-          (((float)(mNoiseSeed & 0x7fffffff) / (float)0x7fffffff) * 2.0f -
-           1.0f) *
-          mNoiseLevel;
-      float output = subOutput * 1.0f * v.amplitude * envVal;
+      mLanes.noise[i] =
+          ((float)(mNoiseSeed & 0x7fffffff) / (float)0x7fffffff) * 2.0f - 1.0f;
 
       if (v.controlCounter++ % 16 == 0) {
         float modCutoff = std::max(
             0.0f,
             std::min(0.999f, mCutoff + v.currentFilterEnvVal * mF_Amt + lfo));
-        v.svf.setParams(20.0f + modCutoff * modCutoff * 14000.0f,
-                        std::max(0.1f, mResonance * 5.0f), mSampleRate);
+        mFilter.setSmooth(i, 20.0f + modCutoff * modCutoff * 14000.0f,
+                          std::max(0.1f, mResonance * 5.0f), mSampleRate, 16);
       }
+    }
+    if (lastLive < 0)
+      return 0.0f;
+    const int n = lastLive + 1;
+
+    if (mOscSync) {
+      for (int i = 0; i < n; ++i)
+        if (mLanes.phase[0][i] + mLanes.inc[i] >= 1.0f)
+          mLanes.phase[1][i] = 0.0f;
+    }
 
-      TSvf::Type type = TSvf::LowPass;
-      if (mFilterMode == 1)
-        type = TSvf::HighPass;
-      else if (mFilterMode == 2)
-        type = TSvf::BandPass;
-      else if (mFilterMode == 3)
-        type = TSvf::Notch;
-
-      mixedOutput += v.svf.process(output, type);
+    renderOscLanes(0, mOscPitch[0], n);
+    renderOscLanes(1, mOscPitch[1] * (1.0f + mDetune * 0.05f), n);
+    renderOscLanes(2, mOscPitch[2], n);
+    renderOscLanes(3, mOscPitch[3], n);
+
+    // Mix
+    const float g0 = mOscVolumes[0] * mOscDrive[0];
+    const float g1 = mOscVolumes[1] * mOscDrive[1];
+    const float g2 = mOscVolumes[2] * mOscDrive[2];
+    const float g3 = mOscVolumes[3] * mOscDrive[3];
+    const float ring = mRingMod ? 1.0f : 0.0f;
+    for (int i = 0; i < n; ++i) {
+      float a = mLanes.osc[0][i] * g0;
+      float b = mLanes.osc[1][i] * g1;
+      float sub = ring * (a * b) + (1.0f - ring) * (a + b);
+      sub += mLanes.osc[2][i] * g2 + mLanes.osc[3][i] * g3;
+      sub += mLanes.noise[i] * mNoiseLevel;
+      mLanes.x[i] = sub * mLanes.gain[i];
     }
-    mControlCounter++;
-    return fast_tanh(mixedOutput * (activeCount > 1 ? 0.7f : 1.0f));
+
+    // ZDF SVF across lanes (idle lanes just decay on zero input)
+    mFilter.process(mLanes.x, n, (TSvf::Type)mFilterMode);
+
+    float mixedOutput = 0.0f;
+    for (int i = 0; i < n; ++i)
+      if (mVoices[i].active)
+        mixedOutput += mLanes.x[i];
+
+    return mSaturator.process(mixedOutput * (activeCount > 1 ? 0.7f : 1.0f));
   }
 
-  bool isActive() const {
-    for (const auto &v : mVoices)
-      if (v.active)
-        return true;
-    return false;
+  bool isActive() const { return mVoiceAlloc.any(); }
+
+  // For the profile report
+  AntiAlias antiAlias() const { return mSaturator.mode(); }
+  float shaperCostNs() const { return mSaturator.costNs(); }
+
+  // Global voice budget, see AudioEngine::enforceVoiceLimit
+  int liveVoiceCount() const { return mVoiceAlloc.liveCount(); }
+  int stealCandidate(float &score) const {
+    return mVoiceAlloc.victim([this](int i) { return keepScore(i); }, true,
+                              &score);
+  }
+  void stealVoice(int i) {
+    Voice &v = mVoices[i];
+    if (!mUseEnvelope) {
+      v.active = false;
+      mVoiceAlloc.clear(i);
+      return;
+    }
+    v.ampEnv.fastRelease();
+    mVoiceAlloc.markStolen(i);
   }
 
 private:
+  // One oscillator slot for n voice lanes. Waveform is shared by all voices,
+  // so the switch sits outside the lane loop.
+  void renderOscLanes(int slot, float pitch, int n) {
+    float *phase = mLanes.phase[slot];
+    float *out = mLanes.osc[slot];
+    const float pw = mOscPW[slot];
+    switch (mOscWaveforms[slot]) {
+    case Waveform::Sine: {
+      // FastSine lookup inlined, phases are already in [0, 1)
+      const float *table = FastSine::getInstance().table.data();
+      for (int i = 0; i < n; ++i) {
+        float idx = phase[i] * (float)FastSine::TABLE_SIZE;
+        int i0 = (int)idx & FastSine::MASK;
+        float frac = idx - (float)(int)idx;
+        out[i] = table[i0] + frac * (table[i0 + 1] - table[i0]);
+      }
+      break;
+    }
+    case Waveform::Triangle:
+      for (int i = 0; i < n; ++i)
+        out[i] = Oscillator::triangle(
+            phase[i], std::min(0.5f, mLanes.inc[i] * pitch), pw);
+      break;
+    case Waveform::Square:
+      for (int i = 0; i < n; ++i)
+        out[i] = Oscillator::square(phase[i],
+                                    std::min(0.5f, mLanes.inc[i] * pitch), pw);
+      break;
+    case Waveform::Sawtooth:
+      for (int i = 0; i < n; ++i)
+        out[i] =
+            Oscillator::saw(phase[i], std::min(0.5f, mLanes.inc[i] * pitch));
+      break;
+    }
+    if (mOscFold[slot] > 0.01f) {
+      if (mSaturator.mode() == AntiAlias::Off) {
+        for (int i = 0; i < n; ++i)
+          out[i] = Oscillator::foldWave(out[i], mOscFold[slot]);
+      } else {
+        const float gain = 1.0f / Oscillator::foldThreshold(mOscFold[slot]);
+        for (int i = 0; i < n; ++i)
+          out[i] = mFoldAdaa[slot][i].process(out[i] * gain);
+      }
+    }
+    for (int i = 0; i < n; ++i) {
+      float p = phase[i] + mLanes.inc[i] * pitch;
+      phase[i] = p >= 1.0f ? p - 1.0f : p;
+    }
+  }
+
+  float keepScore(int i) const {
+    const Voice &v = mVoices[i];
+    return v.amplitude * v.ampEnv.keepLevel() + (v.isNoteHeld ? 1.0f : 0.0f);
+  }
+
   void updateLiveEnvelopes() {
     for (auto &v : mVoices)
       if (v.active) {
@@ -387,6 +466,13 @@ private:
       }
   }
   std::vector<Voice> mVoices;
+  VoiceAllocator mVoiceAlloc;
+  VoiceLanes mLanes{};
+  TSvfLanes<kMaxVoices> mFilter;
+  AntiAliasedShaper<shapes::SoftClip> mSaturator;
+  // Fold can't be oversampled (the oscillators would have to be), it gets
+  // first order ADAA per lane whenever anti-aliasing is on
+  Adaa1<shapes::TriangleFold> mFoldAdaa[4][kMaxVoices];
   std::vector<float> mOscVolumes;
   std::vector<Waveform> mOscWaveforms;
   uint32_t mControlCounter = 0;
@@ -1,116 +1,114 @@
 #ifndef TAPE_ECHO_FX_H
 #define TAPE_ECHO_FX_H
 
+#include "../DelayLine.h"
 #include "../Utils.h"
 #include <algorithm>
 #include <cmath>
-#include <vector>
 
+// Starts with no tape. Like DelayFx the engine sizes the lines for the
+// stream's rate with capacityFor() and hands them over with swapLines()
+// before the echo is first used, until then it's silent.
 class TapeEchoFx {
 public:
-  TapeEchoFx() {
-    mBuffer.resize(192000, 0.0f); // 4 sec at 48k
+  // Longest the time knob reaches, with the wow and flutter stretching it
+  static constexpr float kMaxSeconds = 1.5f * (1.0f + 0.006f + 0.003f);
+
+  // Frames per side, the Hermite read needs a couple past the delay
+  static int capacityFor(float sampleRate) {
+    return nextPowerOfTwo((int)std::ceil(kMaxSeconds * sampleRate) + 4);
+  }
+  int capacity() const { return mLine[0].size(); }
+
+  // Takes fresh lines, the old ones go back to the caller to be freed
+  void swapLines(DelayLine<> &left, DelayLine<> &right) {
+    mLine[0].swap(left);
+    mLine[1].swap(right);
   }
 
   void clear() {
-    std::fill(mBuffer.begin(), mBuffer.end(), 0.0f);
-    mWritePos = 0;
-    mFilterState = 0.0f;
+    for (auto &line : mLine)
+      line.clear();
+    mFilterState[0] = mFilterState[1] = 0.0f;
     mSmoothedFeedback = mFeedback;
     mSmoothedSaturation = mSaturation;
     mSmoothedMix = mMix;
   }
 
-  float process(float input, float sampleRate) {
-    if (!std::isfinite(input))
-      input = 0.0f;
+  // In place, wet only. Both sides run off one tape transport: the wow and
+  // flutter LFOs are evaluated at the ends of the block and the delay target
+  // ramped in between, the read head still glides per sample. Feedback,
+  // saturation and mix are smoothed a block at a time.
+  void processBlock(float *left, float *right, int n, float sampleRate) {
+    if (n <= 0)
+      return;
+    if (mLine[0].empty()) {
+      std::fill(left, left + n, 0.0f);
+      std::fill(right, right + n, 0.0f);
+      return;
+    }
 
     // Wow & Flutter LFOs
-    mWowPhase += 0.5f / sampleRate;
-    if (mWowPhase >= 1.0f)
-      mWowPhase -= 1.0f;
-    mFlutterPhase += 12.0f / sampleRate;
-    if (mFlutterPhase >= 1.0f)
-      mFlutterPhase -= 1.0f;
-
-    float modulation = (FastSine::get(mWowPhase) * mWowAmount) +
-                       (FastSine::get(mFlutterPhase) * mFlutterAmount);
-
-    float targetDelaySamples = (mTime + modulation * mTime) * sampleRate;
-
-    // Faster smoothing for "rubbery" transitions
-    mSmoothedDelay += 0.001f * (targetDelaySamples - mSmoothedDelay);
-
-    // Read positions
-    // Read position relative to most recent sample (mWritePos - 1)
-    float readPos = (float)mWritePos - 1.0f - mSmoothedDelay;
-    while (readPos < 0.0f)
-      readPos += (float)mBuffer.size();
-    while (readPos >= (float)mBuffer.size())
-      readPos -= (float)mBuffer.size();
-
-    // Hermite Interpolation (4-point)
-    int i1 = (int)readPos;
-    int i2 = (i1 + 1) % mBuffer.size();
-    int i3 = (i2 + 1) % mBuffer.size();
-    int i0 = (i1 - 1 + mBuffer.size()) % mBuffer.size();
-
-    float frac = readPos - (float)i1;
-
-    float y0 = mBuffer[i0];
-    float y1 = mBuffer[i1];
-    float y2 = mBuffer[i2];
-    float y3 = mBuffer[i3];
-
-    float a = (3.0f * (y1 - y2) - y0 + y3) * 0.5f;
-    float b = 2.0f * y2 + y0 - 5.0f * y1 * 0.5f - y3 * 0.5f;
-    float c = (y2 - y0) * 0.5f;
-    float d = y1;
-
-    float echo = ((a * frac + b) * frac + c) * frac + d;
-
-    // Smooth Parameters
-    mSmoothedFeedback += 0.001f * (mFeedback - mSmoothedFeedback);
-    mSmoothedSaturation += 0.001f * (mSaturation - mSmoothedSaturation);
-    mSmoothedMix += 0.001f * (mMix - mSmoothedMix);
-
+    const float wowInc = 0.5f / sampleRate;
+    const float flutterInc = 12.0f / sampleRate;
+    float target = targetDelay(mWowPhase + wowInc, mFlutterPhase + flutterInc,
+                               sampleRate);
+    float targetEnd = targetDelay(mWowPhase + wowInc * n,
+                                  mFlutterPhase + flutterInc * n, sampleRate);
+    const float targetStep = n > 1 ? (targetEnd - target) / (n - 1) : 0.0f;
+    mWowPhase += wowInc * n;
+    mWowPhase -= (float)(int)mWowPhase;
+    mFlutterPhase += flutterInc * n;
+    mFlutterPhase -= (float)(int)mFlutterPhase;
+
+    // Smooth Parameters: the 0.001 per sample one-pole, n steps at once
+    const float k = 1.0f - std::exp2(kSmoothLog2 * (float)n);
+    mSmoothedFeedback += k * (mFeedback - mSmoothedFeedback);
+    mSmoothedSaturation += k * (mSaturation - mSmoothedSaturation);
+    mSmoothedMix += k * (mMix - mSmoothedMix);
     // Tape Saturation
-    if (mSmoothedSaturation > 0.0f) {
-      echo = fast_tanh(echo * (1.0f + mSmoothedSaturation * 4.0f));
-    }
-
-    float feedbackSig = echo * mSmoothedFeedback;
-    // Low-pass to simulate tape head wear & prevent high-freq "zipper"
-    // Denormal protection
-    feedbackSig += 1.0e-15f;
-    mFilterState += 0.05f * (feedbackSig - mFilterState);
-    if (std::abs(mFilterState) < 1.0e-15f)
-      mFilterState = 0.0f;
-    feedbackSig = mFilterState;
-
-    float toWrite = input + feedbackSig;
-    toWrite = fast_tanh(toWrite);
-
-    // REMOVED: Aggressive zeroing caused "clamped" sound artifacts
-    // toWrite += 1.0e-18f; // Removed redundant
-
-    mBuffer[mWritePos] = toWrite + 1.0e-18f;
-    mWritePos = (mWritePos + 1) % mBuffer.size();
-
-    float output = (echo * mSmoothedMix);
-
-    // Silence tracking
-    if (std::abs(output) < 1e-9f) {
-      if (mSilentCounter < 48000)
-        mSilentCounter++;
-    } else {
-      mSilentCounter = 0;
+    const bool saturate = mSmoothedSaturation > 0.0f;
+    const float satGain = 1.0f + mSmoothedSaturation * 4.0f;
+
+    const float longest = (float)(mLine[0].size() - 4);
+    float *io[2] = {left, right};
+    for (int i = 0; i < n; ++i) {
+      // Faster smoothing for "rubbery" transitions
+      mSmoothedDelay += 0.001f * (target + targetStep * i - mSmoothedDelay);
+      float delay = std::max(1.0f, std::min(mSmoothedDelay, longest));
+
+      for (int c = 0; c < 2; ++c) {
+        // Hermite Interpolation (4-point)
+        float echo = mLine[c].readCubic(delay);
+
+        if (saturate)
+          echo = fast_tanh(echo * satGain);
+
+        // Low-pass to simulate tape head wear & prevent high-freq "zipper"
+        // Denormal protection
+        float feedbackSig = echo * mSmoothedFeedback + 1.0e-15f;
+        float &state = mFilterState[c];
+        state += 0.05f * (feedbackSig - state);
+        if (std::abs(state) < 1.0e-15f)
+          state = 0.0f;
+
+        float input = io[c][i];
+        if (!std::isfinite(input))
+          input = 0.0f;
+        mLine[c].write(fast_tanh(input + state) + 1.0e-18f);
+
+        io[c][i] = echo * mSmoothedMix;
+      }
     }
+  }
 
-    return output;
+  // One repeat apart, at the furthest the wow and flutter stretch it
+  int tailSamples(float sampleRate) const {
+    float wobble = 1.0f + mWowAmount + mFlutterAmount;
+    return (int)std::max(mSmoothedDelay, mTime * wobble * sampleRate) + 4;
   }
 
-  bool isSilent() const { return mSilentCounter >= 48000; }
+  std::size_t lineBytes() const { return mLine[0].bytes() + mLine[1].bytes(); }
 
   void setParameters(float time, float feedback, float saturation, float mix) {
     setDelayTime(time);
@@ -132,12 +130,20 @@ public:
   void setMix(float v) { mMix = v; }
 
 private:
-  std::vector<float> mBuffer;
-  int mWritePos = 0;
+  static constexpr float kSmoothLog2 = -0.0014434168696687186f; // log2(0.999)
+
+  float targetDelay(float wowPhase, float flutterPhase,
+                    float sampleRate) const {
+    float modulation = (FastSine::get(wowPhase) * mWowAmount) +
+                       (FastSine::get(flutterPhase) * mFlutterAmount);
+    return (mTime + modulation * mTime) * sampleRate;
+  }
+
+  DelayLine<> mLine[2];
   float mSmoothedDelay = 1000.0f;
   float mWowPhase = 0.0f;
   float mFlutterPhase = 0.0f;
-  float mFilterState = 0.0f;
+  float mFilterState[2] = {0.0f, 0.0f};
 
   float mTime = 0.3f;
   float mFeedback = 0.4f;
@@ -149,7 +155,6 @@ private:
 
   float mWowAmount = 0.002f;
   float mFlutterAmount = 0.0005f;
-  uint32_t mSilentCounter = 48000;
 };
 
 #endif
@@ -1,16 +1,17 @@
 #ifndef TAPE_WOBBLE_FX_H
 #define TAPE_WOBBLE_FX_H
 
+#include "../DelayLine.h"
+#include "../FastMath.h"
+#include <algorithm>
 #include <cmath>
 #include <random>
-#include <vector>
 
 class TapeWobbleFx {
 public:
   TapeWobbleFx(int maxDelay = 2048) {
-    mBufferL.resize(maxDelay, 0.0f);
-    mBufferR.resize(maxDelay, 0.0f);
-    mBufferR.resize(maxDelay, 0.0f);
+    mLineL.setSize(maxDelay);
+    mLineR.setSize(maxDelay);
     mRandEngine.seed(std::random_device{}());
     mDist = std::uniform_real_distribution<float>(-0.2f, 0.2f);
   }
@@ -28,12 +29,18 @@ public:
   }
 
   void clear() {
-    std::fill(mBufferL.begin(), mBufferL.end(), 0.0f);
-    std::fill(mBufferR.begin(), mBufferR.end(), 0.0f);
-    mWritePos = 0;
+    mLineL.clear();
+    mLineR.clear();
     mPhase = 0.0f;
   }
 
+  // The read head sits 10ms back and wobbles up to 8ms either way
+  int tailSamples(float sampleRate) const {
+    return (int)((10.0f + mDepth * 8.0f) * sampleRate / 1000.0f) + 2;
+  }
+
+  std::size_t lineBytes() const { return mLineL.bytes() + mLineR.bytes(); }
+
   // Process stereo block (linked wobble)
   void processStereo(float inL, float inR, float &outL, float &outR,
                      float sampleRate) {
@@ -44,25 +51,25 @@ public:
       mRandomOffset = mDist(mRandEngine);
     }
 
-    float mod = sinf(mPhase + mRandomOffset);
+    float mod = FastMath::sin(mPhase + mRandomOffset);
     float targetDelay = (10.0f + mod * mDepth * 8.0f);
     // Smoother transition: 0.005 -> 0.0005 (reduce crackle)
     mSmoothedDelay += 0.0005f * (targetDelay - mSmoothedDelay);
     float delaySamples = mSmoothedDelay * (sampleRate / 1000.0f);
 
-    float tapL = getInterpolatedTap(mBufferL, mWritePos, delaySamples);
-    float tapR = getInterpolatedTap(mBufferR, mWritePos,
-                                    delaySamples); // Same delay samples
+    // Read ahead of this sample's write, one less back from the last one
+    float back = std::min(delaySamples - 1.0f, (float)(mLineL.size() - 2));
+    float tapL = mLineL.readLinear(back);
+    float tapR = mLineR.readLinear(back); // Same delay samples
 
     if (mSaturation > 0.0f) {
       float drive = 1.0f + mSaturation * 3.0f;
-      tapL = std::tanh(tapL * drive) / std::tanh(drive);
-      tapR = std::tanh(tapR * drive) / std::tanh(drive);
+      tapL = FastMath::tanh(tapL * drive) / FastMath::tanh(drive);
+      tapR = FastMath::tanh(tapR * drive) / FastMath::tanh(drive);
     }
 
-    mBufferL[mWritePos] = inL;
-    mBufferR[mWritePos] = inR;
-    mWritePos = (mWritePos + 1) % mBufferL.size();
+    mLineL.write(inL);
+    mLineR.write(inR);
 
     float wetL = inL * (1.0f - mMix) + tapL * mMix;
     float wetR = inR * (1.0f - mMix) + tapR * mMix;
@@ -79,23 +86,7 @@ public:
   }
 
 private:
-  float getInterpolatedTap(const std::vector<float> &buffer, int writePos,
-                           float delaySamples) {
-    float readPos = (float)writePos - delaySamples;
-    while (readPos < 0)
-      readPos += buffer.size();
-    while (readPos >= buffer.size())
-      readPos -= buffer.size();
-
-    int i1 = (int)readPos;
-    int i2 = (i1 + 1) % buffer.size();
-    float frac = readPos - i1;
-    return buffer[i1] * (1.0f - frac) + buffer[i2] * frac;
-  }
-
-  std::vector<float> mBufferL;
-  std::vector<float> mBufferR;
-  int mWritePos = 0;
+  DelayLine<> mLineL, mLineR;
   float mPhase = 0.0f;
   float mRate = 0.5f;
   float mDepth = 0.5f;
@@ -0,0 +1,87 @@
+#ifndef VOICE_ALLOCATOR_H
+#define VOICE_ALLOCATOR_H
+
+#include <algorithm>
+#include <cstdint>
+
+// Voice bookkeeping for the polyphonic engines. The playing set is a
+// bitmask, so idle checks are one compare and render loops walk only the
+// set bits. When an engine runs out of voices, or the global budget in
+// AudioEngine is exceeded, the victim is picked by level and age rather
+// than always taking voice 0.
+//
+// The mask may briefly keep a bit for a voice an engine switched off
+// directly (allNotesOff, clearBuffer...). Render loops still check the
+// voice and drop the bit then.
+class VoiceAllocator {
+public:
+  static const int kMaxVoices = 32;
+
+  uint32_t mask() const { return mActive; }
+  bool any() const { return mActive != 0; }
+  // Playing and not already fading out after a steal
+  int liveCount() const { return __builtin_popcount(mActive & ~mStolen); }
+  bool isStolen(int i) const { return mStolen & (1u << i); }
+
+  void setActive(int i) {
+    mActive |= 1u << i;
+    mStolen &= ~(1u << i);
+    mStamp[i] = ++mClock;
+  }
+  void clear(int i) {
+    mActive &= ~(1u << i);
+    mStolen &= ~(1u << i);
+  }
+  void clearAll() { mActive = mStolen = 0; }
+  void markStolen(int i) { mStolen |= (mActive & (1u << i)); }
+
+  // Lowest free voice below numVoices, -1 if all are playing
+  int freeVoice(int numVoices) const {
+    uint32_t all = numVoices >= 32 ? ~0u : (1u << numVoices) - 1;
+    uint32_t free = ~mActive & all;
+    return free ? __builtin_ctz(free) : -1;
+  }
+
+  // Voice to give up: lowest keep score. The engine scores a voice by its
+  // level, +1 while the key is held. Each later note-on costs it a little
+  // so among similar voices the oldest goes. Voices already fading after a
+  // steal go first unless skipStolen is set (the global budget already
+  // counted those). Returns -1 if nothing qualifies.
+  template <typename KeepScore>
+  int victim(KeepScore keepScore, bool skipStolen,
+             float *outScore = nullptr) const {
+    uint32_t m = skipStolen ? (mActive & ~mStolen) : mActive;
+    int best = -1;
+    float bestScore = 0.0f;
+    for (; m; m &= m - 1) {
+      int i = __builtin_ctz(m);
+      float age = (float)std::min<uint32_t>(mClock - mStamp[i], kMaxAge);
+      float score = keepScore(i) - kAgeWeight * age;
+      if (isStolen(i))
+        score -= 4.0f;
+      if (best < 0 || score < bestScore) {
+        best = i;
+        bestScore = score;
+      }
+    }
+    if (outScore)
+      *outScore = bestScore;
+    return best;
+  }
+
+  template <typename F> void forEach(F f) const {
+    for (uint32_t m = mActive; m; m &= m - 1)
+      f(__builtin_ctz(m));
+  }
+
+private:
+  static constexpr uint32_t kMaxAge = 16;
+  static constexpr float kAgeWeight = 0.02f;
+
+  uint32_t mActive = 0;
+  uint32_t mStolen = 0;
+  uint32_t mClock = 0;
+  uint32_t mStamp[kMaxVoices] = {0};
+};
+
+#endif // VOICE_ALLOCATOR_H
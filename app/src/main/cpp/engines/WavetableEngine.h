@@ -2,8 +2,11 @@
 #define WAVETABLE_ENGINE_H
 
 #include "../Utils.h"
+#include "../Waveshaper.h"
 #include "../WavFileUtils.h"
 #include "Adsr.h"
+#include "VoiceAllocator.h"
+#include "WavetableMips.h"
 #include <algorithm>
 #include <android/log.h>
 #include <cmath>
@@ -25,6 +28,7 @@ public:
     Adsr envelope;
     Adsr filterEnv;
     TSvf svf;
+    AntiAliasedShaper<shapes::SoftClip> saturator;
     float lastSample = 0.0f;
     float srateCounter = 0.0f;
     uint32_t controlCounter = 0;
@@ -40,6 +44,7 @@ public:
       targetFrequency = 440.0f;
       lastSample = 0.0f;
       srateCounter = 0.0f;
+      saturator.reset();
     }
   };
 
@@ -47,9 +52,7 @@ public:
     mVoices.resize(16);
     for (auto &v : mVoices)
       v.reset();
-    mTable.assign(2048, 0.0f); // Init with sine
-    for (int i = 0; i < 2048; ++i)
-      mTable[i] = sinf(i * 6.283185f / 2048.0f);
+    mMips = sineMips(); // Init with sine
     mMutex = std::make_shared<std::mutex>();
     resetToDefaults();
   }
@@ -68,7 +71,7 @@ public:
     mF_Sus = 0.0f;
     mF_Rel = 0.5f;
     mF_Amt = 0.0f;
-    mWarp = 0.0f;
+    setWarp(0.0f);
     mCrush = 0.0f;
     mDrive = 0.0f;
     mBits = 1.0f;
@@ -90,6 +93,7 @@ public:
       v.envelope.reset();
       v.filterEnv.reset();
     }
+    mVoiceAlloc.clearAll();
   }
 
   void setFrequency(float freq, float sampleRate) {
@@ -98,45 +102,43 @@ public:
   }
   void setGlide(float g) { mGlide = g; }
 
+  // Mips are built before taking the lock so the audio thread never waits
   void loadWavetable(const std::vector<float> &data) {
-    std::lock_guard<std::mutex> lock(*mMutex);
-    mTable = data;
-    mNumFrames = (mTable.size() > 2048) ? (int)(mTable.size() / 2048) : 1;
+    if (data.empty())
+      return;
+    setMips(WavetableMips::build(data));
   }
 
   void loadWavetable(const std::string &path) {
-    std::vector<float> data;
-    int sr, channels;
-    std::vector<float> slices;
-    if (WavFileUtils::loadWav(path, data, sr, channels, slices)) {
-      loadWavetable(data);
+    auto mips = WavetableMips::cached(path);
+    if (!mips) {
+      std::vector<float> data;
+      int sr, channels;
+      std::vector<float> slices;
+      if (!WavFileUtils::loadWav(path, data, sr, channels, slices) ||
+          data.empty())
+        return;
+      mips = WavetableMips::build(data);
+      WavetableMips::addToCache(path, mips);
     }
+    setMips(mips);
   }
 
-  void loadDefaultWavetable() {
-    std::lock_guard<std::mutex> lock(*mMutex);
-    mTable.assign(2048, 0.0f);
-    for (int i = 0; i < 2048; ++i)
-      mTable[i] = sinf(i * 6.283185f / 2048.0f);
-    mNumFrames = 1;
-  }
+  void loadDefaultWavetable() { setMips(sineMips()); }
+  bool hasContent() const { return mMips && mMips != sineMips(); }
 
   void triggerNote(int note, int velocity) {
-    int idx = -1;
-    for (int i = 0; i < 16; ++i)
-      if (!mVoices[i].active) {
-        idx = i;
-        break;
-      }
+    int idx = mVoiceAlloc.freeVoice((int)mVoices.size());
     if (idx == -1)
-      idx = 0;
+      idx = mVoiceAlloc.victim([this](int i) { return keepScore(i); }, false);
 
     Voice &v = mVoices[idx];
     v.reset();
     v.active = true;
+    mVoiceAlloc.setActive(idx);
     v.note = note;
     v.amplitude = velocity / 127.0f;
-    float baseFreq = 440.0f * powf(2.0f, (note - 69) / 12.0f);
+    float baseFreq = FastMath::noteToFreq((float)note);
     v.targetFrequency = baseFreq;
     v.frequency = (mGlide > 0.001f) ? mLastFrequency : baseFreq;
     mLastFrequency = baseFreq;
@@ -183,7 +185,7 @@ public:
       mF_Amt = value * 2.0f - 1.0f;
       break;
     case 15:
-      mWarp = value;
+      setWarp(value);
       break;
     case 16:
       mCrush = value;
@@ -212,35 +214,166 @@ public:
     case 355:
       setGlide(value);
       break;
+    case 357: // Drive anti-aliasing, see AntiAlias
+      for (auto &v : mVoices)
+        v.saturator.setMode((AntiAlias)(int)value);
+      break;
     }
   }
 
-  float render() {
-    float mixedOutput = 0.0f;
-    int activeCount = 0;
-    if (mTable.empty())
-      return 0.0f;
+  static const int kMaxBlock = 256;
 
-    for (auto &v : mVoices) {
+  void renderBlock(float *out, int n) {
+    while (n > kMaxBlock) {
+      renderBlock(out, kMaxBlock);
+      out += kMaxBlock;
+      n -= kMaxBlock;
+    }
+    std::fill(out, out + n, 0.0f);
+    mControlCounter += n;
+
+    // Table swap in progress, skip the block
+    std::unique_lock<std::mutex> lock(*mMutex, std::try_to_lock);
+    if (!lock.owns_lock() || !mMips)
+      return;
+
+    std::fill(mBlockVoices, mBlockVoices + n, 0);
+    for (uint32_t m = mVoiceAlloc.mask(); m; m &= m - 1) {
+      const int i = __builtin_ctz(m);
+      Voice &v = mVoices[i];
+      if (v.active)
+        renderVoice(v, out, n);
       if (!v.active)
-        continue;
+        mVoiceAlloc.clear(i);
+    }
+
+    for (int i = 0; i < n; ++i) {
+      if (mBlockVoices[i] > 1)
+        out[i] *= 0.7f;
+      out[i] = fast_tanh(out[i]);
+    }
+  }
 
-      if (mGlide > 0.001f) {
-        float glideTimeSamples = mGlide * mSampleRate * 0.5f;
-        float glideAlpha = 1.0f / (glideTimeSamples + 1.0f);
+  float render() {
+    float out;
+    renderBlock(&out, 1);
+    return out;
+  }
+
+  bool isActive() const { return mVoiceAlloc.any(); }
+
+  // For the profile report: per sample cost of all playing voices
+  AntiAlias antiAlias() const { return mVoices[0].saturator.mode(); }
+  float shaperCostNs() const {
+    float ns = 0.0f;
+    mVoiceAlloc.forEach([&](int i) { ns += mVoices[i].saturator.costNs(); });
+    return ns;
+  }
+
+  // Global voice budget, see AudioEngine::enforceVoiceLimit
+  int liveVoiceCount() const { return mVoiceAlloc.liveCount(); }
+  int stealCandidate(float &score) const {
+    return mVoiceAlloc.victim([this](int i) { return keepScore(i); }, true,
+                              &score);
+  }
+  void stealVoice(int i) {
+    mVoices[i].envelope.fastRelease();
+    mVoiceAlloc.markStolen(i);
+  }
+
+private:
+  static const int kWarpLutSize = 1024;
+
+  float keepScore(int i) const {
+    const Voice &v = mVoices[i];
+    return v.amplitude * v.envelope.keepLevel() +
+           (v.envelope.isReleasing() ? 0.0f : 1.0f);
+  }
+
+  static std::shared_ptr<const WavetableMips> sineMips() {
+    static std::shared_ptr<const WavetableMips> sine = [] {
+      std::vector<float> table(WavetableMips::kFrameSize);
+      for (int i = 0; i < WavetableMips::kFrameSize; ++i)
+        table[i] = sinf(i * 6.283185f / WavetableMips::kFrameSize);
+      return WavetableMips::build(table);
+    }();
+    return sine;
+  }
+
+  void setMips(std::shared_ptr<const WavetableMips> mips) {
+    std::lock_guard<std::mutex> lock(*mMutex);
+    mMips.swap(mips);
+    // Old set (if any) is released here, outside the audio callback
+  }
+
+  // Phase warp curve, rebuilt on change instead of pow() per sample
+  void setWarp(float warp) {
+    mWarp = warp;
+    mWarpOn = std::abs(warp) > 0.05f;
+    if (!mWarpOn)
+      return;
+    for (int i = 0; i <= kWarpLutSize; ++i) {
+      float x = (float)i / kWarpLutSize;
+      mWarpLut[i] = (warp > 0.0f) ? powf(x, 1.0f + warp * 3.0f)
+                                  : 1.0f - powf(1.0f - x, 1.0f - warp * 3.0f);
+    }
+  }
+
+  inline float warpPhase(float phase) const {
+    float pos = phase * kWarpLutSize;
+    int i = (int)pos;
+    float f = pos - (float)i;
+    return mWarpLut[i] + (mWarpLut[i + 1] - mWarpLut[i]) * f;
+  }
+
+  void renderVoice(Voice &v, float *out, int n) {
+    const WavetableMips &mips = *mMips;
+    const float voiceDetune = 1.0f + (mDetune * 0.02f);
+    const float glideAlpha =
+        1.0f / (mGlide * mSampleRate * 0.5f + 1.0f); // used if mGlide > 0.001
+
+    // Mip level for the block: worst case of current/target pitch, warp
+    // speeds up the read near the end of the cycle by up to its exponent
+    float maxFreq = std::max(v.frequency, v.targetFrequency) * voiceDetune;
+    if (mWarpOn)
+      maxFreq *= 1.0f + std::abs(mWarp) * 3.0f;
+    const int level = WavetableMips::levelFor(maxFreq, mSampleRate);
+    const int tableSize = mips.levelSize(level);
+
+    const int numFrames = mips.numFrames();
+    float pos = mPosition * (float)(numFrames - 1);
+    int frame1 = std::max(0, std::min(numFrames - 1, (int)pos));
+    int frame2 = std::min(numFrames - 1, frame1 + 1);
+    const float posFrac = pos - (float)frame1;
+    const float *t1 = mips.level(frame1, level);
+    const float *t2 = mips.level(frame2, level);
+
+    const bool decimate = mSrate > 0.05f;
+    const float period = 1.0f + mSrate * 64.0f;
+    const bool bitReduce = mBits < 0.99f;
+    const float bitSteps = FastMath::exp2(mBits * 16.0f);
+    const bool crush = mCrush > 0.05f;
+    const float crushSteps = 2.0f + (1.0f - mCrush) * 32.0f;
+    const bool drive = mDrive > 0.05f;
+    const float driveGain = 1.0f + mDrive * 4.0f;
+    const TSvf::Type filterType = (TSvf::Type)mFilterMode;
+
+    float ampEnv[kMaxBlock];
+    float filterEnv[kMaxBlock];
+    const int live = v.envelope.process(ampEnv, n);
+    v.filterEnv.process(filterEnv, live);
+    if (live < n)
+      v.active = false;
+
+    for (int i = 0; i < live; ++i) {
+      if (mGlide > 0.001f)
         v.frequency += (v.targetFrequency - v.frequency) * glideAlpha;
-      } else {
+      else
         v.frequency = v.targetFrequency;
-      }
 
-      float env = v.envelope.nextValue();
-      if (env < 0.0001f && !v.envelope.isActive()) {
-        v.active = false;
-        continue;
-      }
-      activeCount++;
+      const float env = ampEnv[i];
+      mBlockVoices[i]++;
 
-      float voiceDetune = 1.0f + (mDetune * 0.02f);
       double delta = (v.frequency * voiceDetune) / mSampleRate;
       v.phase += delta;
       while (v.phase >= 1.0)
@@ -248,91 +381,58 @@ public:
 
       // Sample Rate Reduction (Decimation)
       bool skipSample = false;
-      if (mSrate > 0.05f) {
-        float period = 1.0f + mSrate * 64.0f;
+      if (decimate) {
         v.srateCounter += 1.0f;
-        if (v.srateCounter < period) {
+        if (v.srateCounter < period)
           skipSample = true;
-        } else {
+        else
           v.srateCounter -= period;
-        }
       }
 
       if (!skipSample) {
-        double wPhase = v.phase;
-        if (mWarp > 0.05f) {
-          float p = 1.0f + mWarp * 3.0f;
-          wPhase = pow(wPhase, p);
-        } else if (mWarp < -0.05f) {
-          float p = 1.0f - mWarp * 3.0f;
-          wPhase = 1.0 - pow(1.0 - wPhase, p);
-        }
-
-        float pos = mPosition * (float)(mNumFrames - 1);
-        int frame1 = (int)pos;
-        int frame2 = std::min(mNumFrames - 1, frame1 + 1);
-        float posFrac = pos - (float)frame1;
-
-        auto getSample = [&](int frame, double phase) -> float {
-          int offset = frame * 2048;
-          double tablePos = phase * 2047.0;
-          int i1 = (int)tablePos;
-          int i2 = (i1 + 1) % 2048;
-          float f = (float)(tablePos - i1);
-          return (1.0f - f) * mTable[offset + i1] + f * mTable[offset + i2];
-        };
-
-        float sample = (1.0f - posFrac) * getSample(frame1, wPhase) +
-                       posFrac * getSample(frame2, wPhase);
+        float wPhase = (float)v.phase;
+        if (mWarpOn)
+          wPhase = warpPhase(wPhase);
+
+        float tablePos = wPhase * (float)tableSize;
+        int i1 = std::min((int)tablePos, tableSize - 1);
+        float f = tablePos - (float)i1;
+        float s1 = t1[i1] + (t1[i1 + 1] - t1[i1]) * f;
+        float s2 = t2[i1] + (t2[i1 + 1] - t2[i1]) * f;
+        float sample = s1 + (s2 - s1) * posFrac;
 
         // Bit Reduction
-        if (mBits < 0.99f) {
-          float steps = powf(2.0f, mBits * 16.0f);
-          sample = roundf(sample * steps) / steps;
-        }
-
-        if (mCrush > 0.05f) {
-          float st = 2.0f + (1.0f - mCrush) * 32.0f;
-          sample = roundf(sample * st) / st;
-        }
-        if (mDrive > 0.05f) {
-          sample = fast_tanh(sample * (1.0f + mDrive * 4.0f));
-        }
+        if (bitReduce)
+          sample = roundf(sample * bitSteps) / bitSteps;
+        if (crush)
+          sample = roundf(sample * crushSteps) / crushSteps;
         v.lastSample = sample;
       }
 
-      float fEnv = v.filterEnv.nextValue();
+      // Drive runs every sample on the held value so it can be anti-aliased
+      float driven = v.lastSample;
+      if (drive)
+        driven = v.saturator.process(driven * driveGain);
+
+      const float fEnv = filterEnv[i];
       if (v.controlCounter++ % 16 == 0) {
         float cutoff = 20.0f + mCutoff * mCutoff * 18000.0f;
         cutoff += fEnv * mF_Amt * 12000.0f;
         cutoff = std::max(20.0f, std::min(20000.0f, cutoff));
 
-        v.svf.setParams(cutoff, 0.7f + mResonance * 5.0f, mSampleRate);
+        v.svf.setParamsSmooth(cutoff, 0.7f + mResonance * 5.0f, mSampleRate,
+                              16);
       }
-      mixedOutput += v.svf.process(v.lastSample, (TSvf::Type)mFilterMode) *
-                     env * v.amplitude;
+      out[i] += v.svf.process(driven, filterType) * env * v.amplitude;
     }
-
-    if (activeCount > 1)
-      mixedOutput *= 0.7f;
-
-    // Fix: Increment control counter for LFOs
-    mControlCounter++; // Added this line
-
-    return fast_tanh(mixedOutput);
-  }
-
-  bool isActive() const {
-    for (const auto &v : mVoices)
-      if (v.active)
-        return true;
-    return false;
   }
 
-private:
   std::vector<Voice> mVoices;
-  std::vector<float> mTable;
-  int mNumFrames = 1;
+  VoiceAllocator mVoiceAlloc;
+  std::shared_ptr<const WavetableMips> mMips;
+  float mWarpLut[kWarpLutSize + 1] = {0};
+  bool mWarpOn = false;
+  uint8_t mBlockVoices[kMaxBlock] = {0};
   float mSampleRate = 48000.0f, mFrequency = 440.0f, mLastFrequency = 440.0f,
         mGlide = 0.0f;
   float mAttack = 0.01f, mDecay = 0.1f, mSustain = 0.8f, mRelease = 0.2f;
@@ -0,0 +1,125 @@
+#ifndef WAVETABLE_MIPS_H
+#define WAVETABLE_MIPS_H
+
+#include "../FFT.h"
+#include <algorithm>
+#include <complex>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Per-octave band-limited copies of a wavetable (2048-sample frames).
+// Level 0 is the raw frame, level l keeps harmonics up to 1024 >> l, so a
+// voice picks the level whose top harmonic stays under Nyquist.
+// Higher levels are stored shorter (8x oversampled, min 256) to keep the
+// whole set around 4.5x the source size. Each level has one guard sample so
+// linear interpolation never wraps.
+class WavetableMips {
+public:
+  static constexpr int kFrameSize = 2048;
+  static const int kNumLevels = 11;
+
+  int numFrames() const { return mNumFrames; }
+  int levelSize(int level) const { return mLevelSize[level]; }
+
+  const float *level(int frame, int level) const {
+    return &mData[(size_t)frame * mStride + mLevelOffset[level]];
+  }
+
+  // Smallest level with no harmonics above Nyquist for this frequency
+  static int levelFor(float freq, float sampleRate) {
+    float topHarmonicHz = freq * (kFrameSize / 2);
+    float nyquist = sampleRate * 0.5f;
+    int level = 0;
+    while (level < kNumLevels - 1 && topHarmonicHz > nyquist) {
+      topHarmonicHz *= 0.5f;
+      level++;
+    }
+    return level;
+  }
+
+  static std::shared_ptr<const WavetableMips>
+  build(const std::vector<float> &table) {
+    auto mips = std::make_shared<WavetableMips>();
+    int numFrames = std::max(1, (int)(table.size() / kFrameSize));
+    mips->mNumFrames = numFrames;
+
+    int offset = 0;
+    for (int l = 0; l < kNumLevels; ++l) {
+      int harmonics = (kFrameSize / 2) >> l;
+      int size = (l == 0) ? kFrameSize
+                          : std::min(kFrameSize, std::max(256, harmonics * 8));
+      mips->mLevelSize[l] = size;
+      mips->mLevelOffset[l] = offset;
+      offset += size + 1;
+    }
+    mips->mStride = offset;
+    mips->mData.assign((size_t)numFrames * offset, 0.0f);
+
+    std::vector<std::complex<float>> spectrum(kFrameSize);
+    std::vector<std::complex<float>> levelBuf;
+    for (int f = 0; f < numFrames; ++f) {
+      float *dst = &mips->mData[(size_t)f * offset];
+      for (int i = 0; i < kFrameSize; ++i) {
+        size_t src = (size_t)f * kFrameSize + i;
+        float s = src < table.size() ? table[src] : 0.0f;
+        dst[i] = s;
+        spectrum[i] = s;
+      }
+      dst[kFrameSize] = dst[0];
+      FFT::transform(spectrum, false);
+
+      for (int l = 1; l < kNumLevels; ++l) {
+        int size = mips->mLevelSize[l];
+        int harmonics = (kFrameSize / 2) >> l;
+        levelBuf.assign(size, std::complex<float>(0.0f, 0.0f));
+        levelBuf[0] = spectrum[0];
+        for (int k = 1; k <= harmonics; ++k) {
+          levelBuf[k] = spectrum[k];
+          levelBuf[size - k] = std::conj(spectrum[k]);
+        }
+        FFT::transform(levelBuf, true);
+        float *lvl = dst + mips->mLevelOffset[l];
+        for (int i = 0; i < size; ++i)
+          lvl[i] = levelBuf[i].real() / kFrameSize;
+        lvl[size] = lvl[0];
+      }
+    }
+    return mips;
+  }
+
+  // Imported tables are built once and shared between tracks, keyed by path
+  static std::shared_ptr<const WavetableMips> cached(const std::string &key) {
+    Cache &c = cache();
+    std::lock_guard<std::mutex> lock(c.mutex);
+    auto it = c.entries.find(key);
+    return it != c.entries.end() ? it->second.lock() : nullptr;
+  }
+
+  static void addToCache(const std::string &key,
+                         const std::shared_ptr<const WavetableMips> &mips) {
+    Cache &c = cache();
+    std::lock_guard<std::mutex> lock(c.mutex);
+    c.entries[key] = mips;
+  }
+
+private:
+  struct Cache {
+    std::mutex mutex;
+    std::map<std::string, std::weak_ptr<const WavetableMips>> entries;
+  };
+  static Cache &cache() {
+    static Cache c;
+    return c;
+  }
+
+  int mNumFrames = 1;
+  int mStride = 0;
+  int mLevelOffset[kNumLevels] = {0};
+  int mLevelSize[kNumLevels] = {0};
+  std::vector<float> mData;
+};
+
+#endif // WAVETABLE_MIPS_H
@@ -313,6 +313,12 @@ extern "C" JNIEXPORT void JNICALL Java_com_groovebox_NativeLib_loadSample(
   }
 }
 
+extern "C" JNIEXPORT void JNICALL Java_com_groovebox_NativeLib_setCompactStorage(
+    JNIEnv *env, jobject thiz, jint track_index, jboolean compact) {
+  if (engine)
+    engine->setCompactStorage(track_index, compact);
+}
+
 extern "C" JNIEXPORT void JNICALL
 Java_com_groovebox_NativeLib_startRecordingSample(JNIEnv *env, jobject thiz,
                                                   jint track_index) {
@@ -402,6 +408,24 @@ Java_com_groovebox_NativeLib_getCpuLoad(JNIEnv *env, jobject thiz) {
   return 0.0f;
 }
 
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_groovebox_NativeLib_getFootprintReport(JNIEnv *env, jobject thiz) {
+  if (engine) {
+    std::string report = engine->getFootprintReport();
+    return env->NewStringUTF(report.c_str());
+  }
+  return env->NewStringUTF("");
+}
+
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_groovebox_NativeLib_getProfileReport(JNIEnv *env, jobject thiz) {
+  if (engine) {
+    std::string report = engine->getProfileReport();
+    return env->NewStringUTF(report.c_str());
+  }
+  return env->NewStringUTF("");
+}
+
 extern "C" JNIEXPORT void JNICALL
 Java_com_groovebox_NativeLib_setGenericLfoParam(JNIEnv *env, jobject thiz,
                                                 jint lfo_index, jint param_id,
@@ -454,6 +478,22 @@ extern "C" JNIEXPORT void JNICALL Java_com_groovebox_NativeLib_setMasterVolume(
   }
 }
 
+extern "C" JNIEXPORT void JNICALL Java_com_groovebox_NativeLib_setVoiceLimit(
+    JNIEnv *env, jobject thiz, jint voices) {
+  if (engine) {
+    engine->setVoiceLimit(voices);
+  }
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_groovebox_NativeLib_setTrackVoicePriority(JNIEnv *env, jobject thiz,
+                                                   jint track_index,
+                                                   jint priority) {
+  if (engine) {
+    engine->setTrackVoicePriority(track_index, priority);
+  }
+}
+
 extern "C" JNIEXPORT void JNICALL Java_com_groovebox_NativeLib_loadFmPreset(
     JNIEnv *env, jobject thiz, jint track_index, jint preset_id) {
   if (engine)
@@ -486,6 +526,16 @@ extern "C" JNIEXPORT void JNICALL Java_com_groovebox_NativeLib_loadSoundFont(
   }
 }
 
+extern "C" JNIEXPORT void JNICALL
+Java_com_groovebox_NativeLib_loadImpulseResponse(JNIEnv *env, jobject thiz,
+                                                 jstring path) {
+  if (engine) {
+    const char *nativePath = env->GetStringUTFChars(path, 0);
+    engine->loadImpulseResponse(std::string(nativePath));
+    env->ReleaseStringUTFChars(path, nativePath);
+  }
+}
+
 extern "C" JNIEXPORT void JNICALL
 Java_com_groovebox_NativeLib_setSoundFontPreset(JNIEnv *env, jobject thiz,
                                                 jint track_index,
@@ -609,6 +659,12 @@ extern "C" JNIEXPORT void JNICALL Java_com_groovebox_NativeLib_setInputDevice(
     engine->setInputDevice(device_id);
 }
 
+extern "C" JNIEXPORT void JNICALL Java_com_groovebox_NativeLib_setDuplexMode(
+    JNIEnv *env, jobject thiz, jboolean enabled) {
+  if (engine)
+    engine->setDuplexMode(enabled);
+}
+
 extern "C" JNIEXPORT jfloatArray JNICALL
 Java_com_groovebox_NativeLib_getRecordedSampleData(JNIEnv *env, jobject thiz,
                                                    jint track_index,
@@ -46,11 +46,12 @@ data class TrackState(
     val fmCarrierMask: Int = 1,
     val fmActiveMask: Int = 63,
     val useEnvelope: Boolean = true,
-    val fxSends: List<Float> = List(17) { 0.0f },
-    val fxMix: List<Float> = List(17) { 0.0f },
+    val fxSends: List<Float> = List(18) { 0.0f },
+    val fxMix: List<Float> = List(18) { 0.0f },
     val midiInChannel: Int = 17,
     val midiOutChannel: Int = 1,
     val lastSamplePath: String = "",
+    val compactSamples: Boolean = false,
     val activeWavetableName: String = "Basic",
     val filterMode: Int = 0,
     val clockMultiplier: Float = 1.0f,
@@ -202,6 +203,7 @@ data class GrooveboxState(
     val selectedTab: Int = 0,
     val masterVolume: Float = 0.8f,
     val globalParameters: Map<Int, Float> = emptyMap(), 
+    val impulseResponsePath: String? = null, // Convolution pedal IR
     val sidechainSourceTrack: Int = -1,
     val sidechainSourceDrumIdx: Int = 0,
     val isSelectingSidechain: Boolean = false,
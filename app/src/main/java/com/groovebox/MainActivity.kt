@@ -322,6 +322,7 @@ fun syncNativeState(state: GrooveboxState, nativeLib: NativeLib) {
             if (t.engineType == EngineType.WAVETABLE) {
                 nativeLib.loadWavetable(trackIdx, t.lastSamplePath ?: "")
             } else if (t.engineType == EngineType.SAMPLER || t.engineType == EngineType.GRANULAR) {
+                nativeLib.setCompactStorage(trackIdx, t.compactSamples)
                 nativeLib.loadSample(trackIdx, t.lastSamplePath ?: "")
             }
         }
@@ -343,6 +344,7 @@ fun syncNativeState(state: GrooveboxState, nativeLib: NativeLib) {
     state.globalParameters.forEach { (pid, value) ->
         nativeLib.setParameter(0, pid, value)
     }
+    state.impulseResponsePath?.let { if (it.isNotEmpty()) nativeLib.loadImpulseResponse(it) }
 
     // 3. LFOs
     state.lfos.forEachIndexed { i, lfo ->
@@ -2399,6 +2401,7 @@ fun WavetableParameters(state: GrooveboxState, trackIndex: Int, onStateChange: (
                     Knob("Glide", 0.0f, 355, state, onStateChange, nativeLib, knobSize = 40.dp)
                     Knob("Bits", 1.0f, 475, state, onStateChange, nativeLib, knobSize = 40.dp)
                     Knob("Srate", 0.0f, 476, state, onStateChange, nativeLib, knobSize = 40.dp)
+                    Knob("AA", 0.0f, 357, state, onStateChange, nativeLib, knobSize = 40.dp, valueFormatter = { v -> listOf("OFF", "ADAA", "ADAA2", "2x", "4x")[(v * 4.99f).toInt()] })
                 }
             }
         }
@@ -2496,6 +2499,7 @@ fun InputSourceSelector(nativeLib: NativeLib) {
     
     var devices by remember { mutableStateOf<Array<android.media.AudioDeviceInfo>>(emptyArray()) }
     var selectedDeviceId by remember { mutableStateOf(0) } // 0: Auto/Default
+    var duplexMode by remember { mutableStateOf(false) }
 
     LaunchedEffect(audioManager) {
         audioManager?.let {
@@ -2528,6 +2532,17 @@ fun InputSourceSelector(nativeLib: NativeLib) {
     Column(modifier = Modifier.padding(vertical = 4.dp)) {
         Row(modifier = Modifier.fillMaxWidth(), verticalAlignment = androidx.compose.ui.Alignment.CenterVertically) {
             Text("HARDWARE INPUT", style = MaterialTheme.typography.labelSmall, color = Color.Gray, modifier = Modifier.weight(1f))
+            Button(
+                onClick = {
+                    duplexMode = !duplexMode
+                    nativeLib.setDuplexMode(duplexMode)
+                },
+                modifier = Modifier.height(24.dp),
+                shape = RoundedCornerShape(4.dp),
+                contentPadding = PaddingValues(horizontal = 8.dp, vertical = 0.dp),
+                colors = ButtonDefaults.buttonColors(containerColor = if (duplexMode) Color.Cyan else Color.DarkGray)
+            ) { Text("DUPLEX", fontSize = 8.sp, color = if (duplexMode) Color.Black else Color.White) }
+            Spacer(modifier = Modifier.width(4.dp))
             Button(
                 onClick = { 
                     audioManager?.let {
@@ -2685,6 +2700,7 @@ fun SubtractiveParameters(state: GrooveboxState, trackIndex: Int, onStateChange:
                         ToggleIcon("Ring", 151, state, onStateChange, nativeLib)
                         Knob("FM", 0.0f, 152, state, onStateChange, nativeLib, knobSize = 36.dp)
                         Knob("GLIDE", 0.0f, 355, state, onStateChange, nativeLib, knobSize = 36.dp)
+                        Knob("AA", 0.0f, 357, state, onStateChange, nativeLib, knobSize = 36.dp, valueFormatter = { v -> listOf("OFF", "ADAA", "ADAA2", "2x", "4x")[(v * 4.99f).toInt()] })
                     }
                 }
             }
@@ -3264,6 +3280,7 @@ fun FmParameters(state: GrooveboxState, trackIndex: Int, onStateChange: (Grooveb
                     Knob("DRIVE", 0.0f, 159, state, onStateChange, nativeLib, knobSize = 42.dp)
                     Knob("BRT", 0.5f, 157, state, onStateChange, nativeLib, knobSize = 42.dp)
                     Knob("GLIDE", 0.0f, 355, state, onStateChange, nativeLib, knobSize = 42.dp)
+                    Knob("AA", 0.0f, 357, state, onStateChange, nativeLib, knobSize = 42.dp, valueFormatter = { v -> listOf("OFF", "ADAA", "ADAA2", "2x", "4x")[(v * 4.99f).toInt()] })
                 }
             }
             ParameterGroup("Filter & Unison", modifier = Modifier.weight(2f), titleSize = 10) {
@@ -3560,6 +3577,10 @@ fun GranularParameters(state: GrooveboxState, trackIndex: Int, onStateChange: (G
                     Knob("COUNT", 0.2f, 418, state, onStateChange, nativeLib, knobSize = 40.dp)
                     Knob("WIDTH", 0.5f, 419, state, onStateChange, nativeLib, knobSize = 40.dp)
                 }
+                Row(modifier = Modifier.fillMaxWidth(), horizontalArrangement = Arrangement.SpaceEvenly, verticalAlignment = Alignment.CenterVertically) {
+                    Knob("WIN", 0.0f, 430, state, onStateChange, nativeLib, knobSize = 40.dp)
+                    CompactStorageSwitch(state, trackIndex, onStateChange, nativeLib)
+                }
             }
         }
     }
@@ -3792,6 +3813,23 @@ fun GeneratorMappingRow(label: String, knobId: Int, currentGenId: Int, trackInde
         }
     }
 }
+// 16 bit sample memory for the track, shared by the Sampler and Granular panels
+@Composable
+fun CompactStorageSwitch(state: GrooveboxState, trackIndex: Int, onStateChange: (GrooveboxState) -> Unit, nativeLib: NativeLib) {
+    Column(horizontalAlignment = Alignment.CenterHorizontally) {
+        Text("16 BIT", style = MaterialTheme.typography.labelSmall, fontSize = 8.sp, color = Color.Gray)
+        Switch(
+            checked = state.tracks[trackIndex].compactSamples,
+            onCheckedChange = { compact ->
+                val newTracks = state.tracks.mapIndexed { i, t -> if (i == trackIndex) t.copy(compactSamples = compact) else t }
+                onStateChange(state.copy(tracks = newTracks))
+                nativeLib.setCompactStorage(trackIndex, compact)
+            },
+            colors = SwitchDefaults.colors(checkedThumbColor = Color.Cyan)
+        )
+    }
+}
+
 @Composable
 fun SamplerParameters(state: GrooveboxState, trackIndex: Int, onStateChange: (GrooveboxState) -> Unit, nativeLib: NativeLib) {
     val track = state.tracks[trackIndex]
@@ -3860,6 +3898,7 @@ fun SamplerParameters(state: GrooveboxState, trackIndex: Int, onStateChange: (Gr
                     else if (v < 0.83f) "1 CHOP"
                     else "CHOP LOOP"
                 })
+                CompactStorageSwitch(state, trackIndex, onStateChange, nativeLib)
             }
         }
         
@@ -7280,8 +7319,9 @@ fun EffectsScreen(state: GrooveboxState, onStateChange: (GrooveboxState) -> Unit
                        GlobalKnob("BITS", 0.5f, 530, state, onStateChange, nativeLib, valueFormatter = { v -> "${(v * 15 + 1).toInt()} bits" })
                        GlobalKnob("SRATE", 0.2f, 531, state, onStateChange, nativeLib, valueFormatter = { v -> "${String.format("%.1f", 1.0f + v * 7.0f)}x" })
                    }
-                   Box(contentAlignment = Alignment.Center, modifier = Modifier.fillMaxWidth()) {
+                   Row(modifier = Modifier.fillMaxWidth(), horizontalArrangement = Arrangement.SpaceEvenly) {
                        GlobalKnob("MIX", 1.0f, 532, state, onStateChange, nativeLib)
+                       GlobalKnob("OS", 0.0f, 533, state, onStateChange, nativeLib, fullLabel = "Bitcrush Oversampling", valueFormatter = { v -> "${1 shl (v * 2.99f).toInt()}x" })
                    }
                 }
             }
@@ -7331,6 +7371,9 @@ fun EffectsScreen(state: GrooveboxState, onStateChange: (GrooveboxState) -> Unit
                         GlobalKnob("LEVEL", 0.5f, 542, state, onStateChange, nativeLib, fullLabel = "Overdrive Level")
                         GlobalKnob("TONE", 0.5f, 543, state, onStateChange, nativeLib, fullLabel = "Overdrive Tone")
                     }
+                    Box(contentAlignment = Alignment.Center, modifier = Modifier.fillMaxWidth()) {
+                        GlobalKnob("AA", 0.0f, 544, state, onStateChange, nativeLib, fullLabel = "Overdrive Anti-aliasing", valueFormatter = { v -> listOf("OFF", "ADAA", "2x", "4x")[(v * 3.99f).toInt()] })
+                    }
                 }
             }
             item {
@@ -7347,6 +7390,7 @@ fun EffectsScreen(state: GrooveboxState, onStateChange: (GrooveboxState) -> Unit
                                     else -> "SPACE"
                                 }
                             })
+                            GlobalKnob("ALGO", 0.0f, 507, state, onStateChange, nativeLib, knobSize = 36.dp, fullLabel = "Reverb Algorithm", valueFormatter = { v -> if (v < 0.5f) "TANK" else "FDN" })
                         }
                         Spacer(modifier = Modifier.height(8.dp))
                         Row(modifier = Modifier.fillMaxWidth(), horizontalArrangement = Arrangement.SpaceEvenly) {
@@ -7358,6 +7402,38 @@ fun EffectsScreen(state: GrooveboxState, onStateChange: (GrooveboxState) -> Unit
                    }
                 }
             }
+            item {
+                Pedal("CONVOLUTION", Color(0xFF80DEEA), state, 17, onStateChange, nativeLib) {
+                    val context = LocalContext.current
+                    var showIrDialog by remember { mutableStateOf(false) }
+                    val irDir = File(PersistenceManager.getLoomFolder(context), "impulses").apply { if (!exists()) mkdirs() }
+                    if (showIrDialog) {
+                        NativeFileDialog(
+                            directory = irDir,
+                            onDismiss = { showIrDialog = false },
+                            onFileSelected = { path ->
+                                nativeLib.loadImpulseResponse(path)
+                                onStateChange(state.copy(impulseResponsePath = path))
+                            },
+                            isSave = false,
+                            title = "LOAD IMPULSE RESPONSE"
+                        )
+                    }
+                    Column(horizontalAlignment = Alignment.CenterHorizontally) {
+                        GlobalKnob("LEVEL", 1.0f, 1540, state, onStateChange, nativeLib, fullLabel = "Convolution Level")
+                        Button(
+                            onClick = { showIrDialog = true },
+                            modifier = Modifier.height(32.dp),
+                            contentPadding = PaddingValues(horizontal = 8.dp),
+                            colors = ButtonDefaults.buttonColors(containerColor = Color.DarkGray),
+                            shape = RoundedCornerShape(4.dp)
+                        ) {
+                            val irName = state.impulseResponsePath?.let { File(it).nameWithoutExtension } ?: "LOAD IR"
+                            Text(irName, style = MaterialTheme.typography.labelSmall, color = Color(0xFF80DEEA), maxLines = 1)
+                        }
+                    }
+                }
+            }
             item {
                 Pedal("FLANGER", Color(0xFF9C27B0), state, 11, onStateChange, nativeLib) {
                     Column {
@@ -7710,7 +7786,8 @@ fun Pedal(
                         nativeLib.setParameter(latestState.selectedTrackIndex, 2000 + (fxIdx * 10), newValue)
                         val newTracks = latestState.tracks.mapIndexed { i, t ->
                             if (i == latestState.selectedTrackIndex) {
-                                val newSends = t.fxSends.toMutableList()
+                                // Projects saved before a slot was added have shorter lists
+                                val newSends = t.fxSends.toMutableList().apply { while (size <= fxIdx) add(0.0f) }
                                 newSends[fxIdx] = newValue
                                 t.copy(fxSends = newSends)
                             } else t
@@ -7732,7 +7809,7 @@ fun Pedal(
                         nativeLib.setParameter(latestState.selectedTrackIndex, 2000 + (fxIdx * 10) + 1, newValue)
                         val newTracks = latestState.tracks.mapIndexed { i, t ->
                             if (i == latestState.selectedTrackIndex) {
-                                val newMix = t.fxMix.toMutableList()
+                                val newMix = t.fxMix.toMutableList().apply { while (size <= fxIdx) add(0.0f) }
                                 newMix[fxIdx] = newValue
                                 t.copy(fxMix = newMix)
                             } else t
@@ -7998,7 +8075,7 @@ fun NativeFileDialog(
     }
 
     Dialog(onDismissRequest = onDismiss) {
-        val loomFolders = listOf("samples", "granular", "wavetables", "recordings", "sessions", "soundfonts")
+        val loomFolders = listOf("samples", "granular", "wavetables", "recordings", "sessions", "soundfonts", "impulses")
         Card(
             modifier = Modifier.fillMaxWidth().padding(16.dp),
             colors = CardDefaults.cardColors(containerColor = Color(0xFF1A1A1A)),
@@ -34,9 +34,11 @@ class NativeLib {
     external fun setIsRecording(isRecording: Boolean)
     external fun setResampling(isResampling: Boolean)
     external fun loadSample(trackIndex: Int, path: String)
+    external fun setCompactStorage(trackIndex: Int, compact: Boolean) // 16 bit sample memory
     external fun loadWavetable(trackIndex: Int, path: String)
     external fun loadDefaultWavetable(trackIndex: Int)
     external fun loadSoundFont(trackIndex: Int, path: String)
+    external fun loadImpulseResponse(path: String)
     external fun setSoundFontPreset(trackIndex: Int, presetIndex: Int)
     external fun getSoundFontPresetCount(trackIndex: Int): Int
     external fun getSoundFontPresetName(trackIndex: Int, presetIndex: Int): String
@@ -59,9 +61,13 @@ class NativeLib {
     external fun getSlicePoints(trackIndex: Int): FloatArray
     external fun clearSequencer(trackIndex: Int)
     external fun setMasterVolume(volume: Float)
+    external fun setVoiceLimit(voices: Int)
+    external fun setTrackVoicePriority(trackIndex: Int, priority: Int) // 0 low .. 2 high
     external fun panic()
     external fun getActiveNoteMask(trackIndex: Int): Int
     external fun getCpuLoad(): Float
+    external fun getFootprintReport(): String
+    external fun getProfileReport(): String
 
     // Routing / Macro Controls
     external fun setGenericLfoParam(lfoIndex: Int, paramId: Int, value: Float)
@@ -85,6 +91,7 @@ class NativeLib {
     external fun getAllStepActiveStates(trackIndex: Int): BooleanArray
     external fun getRecordedSampleData(trackIndex: Int, targetSampleRate: Float): FloatArray?
     external fun setInputDevice(deviceId: Int)
+    external fun setDuplexMode(enabled: Boolean)
     external fun setRecordingLocked(locked: Boolean)
     external fun setTrackActive(trackIndex: Int, active: Boolean)
     external fun setTrackPan(trackIndex: Int, pan: Float)
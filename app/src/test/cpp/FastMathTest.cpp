@@ -0,0 +1,114 @@
+// FastMath holds the error bounds listed in its header against double libm,
+// and the block forms agree with the scalar ones, SIMD body and tail alike
+#include "TestUtil.h"
+#include "FastMath.h"
+#include <cstring>
+
+static const double kPi = 3.14159265358979323846;
+
+struct MaxError {
+  double err = 0.0;
+  float at = 0.0f;
+  void add(double e, float x) {
+    if (e > err) {
+      err = e;
+      at = x;
+    }
+  }
+};
+
+static double relError(float got, double want) {
+  return std::fabs(got - want) / std::fabs(want);
+}
+
+static int ulpDistance(float a, float b) {
+  int32_t ia, ib;
+  std::memcpy(&ia, &a, sizeof(ia));
+  std::memcpy(&ib, &b, sizeof(ib));
+  // Map sign-magnitude onto a monotonic integer line
+  if (ia < 0)
+    ia = INT32_MIN - ia;
+  if (ib < 0)
+    ib = INT32_MIN - ib;
+  return (int)std::min<int64_t>(std::llabs((int64_t)ia - ib), INT32_MAX);
+}
+
+static void checkScalar() {
+  MaxError e;
+  for (float x = -126.0f; x <= 126.0f; x += 0.00137f)
+    e.add(relError(FastMath::exp2(x), std::exp2((double)x)), x);
+  EXPECT(e.err <= 2.5e-7, "exp2 rel %g at %g", e.err, e.at);
+
+  // Reference takes the same float exponent
+  e = MaxError();
+  const float b = 2.7f;
+  for (float a = 0.01f; a <= 50.0f; a += 0.0007f)
+    e.add(relError(FastMath::pow(a, b), std::pow((double)a, (double)b)), a);
+  EXPECT(e.err <= 1.4e-6, "pow rel %g at %g", e.err, e.at);
+
+  e = MaxError();
+  for (float x = -12.0f; x <= 12.0f; x += 0.0001f)
+    e.add(std::fabs(FastMath::tanh(x) - std::tanh((double)x)), x);
+  EXPECT(e.err <= 1.6e-7, "tanh abs %g at %g", e.err, e.at);
+
+  // Reduce the reference in double so large phases stay exact
+  e = MaxError();
+  auto sinRef = [](float p) {
+    double d = (double)p;
+    return std::sin(2.0 * kPi * (d - std::floor(d)));
+  };
+  for (float p = -4.0f; p <= 4.0f; p += 0.00003f)
+    e.add(std::fabs(FastMath::sin2pi(p) - sinRef(p)), p);
+  // Steps of a few ulp of the base, so every phase is distinct
+  for (float base : {1000.0f, -65536.0f, 4194000.0f, -4194000.0f})
+    for (int i = 0; i < 4096; ++i) {
+      float p = base + i * std::fabs(base) * (3.0f / (1 << 23));
+      e.add(std::fabs(FastMath::sin2pi(p) - sinRef(p)), p);
+    }
+  EXPECT(e.err <= 2.3e-7, "sin2pi abs %g at %g", e.err, e.at);
+
+  e = MaxError();
+  for (float x = 0.0001f; x <= 0.49f; x += 0.00001f)
+    e.add(relError(FastMath::tanPi(x), std::tan(kPi * (double)x)), x);
+  e.add(relError(FastMath::tanPi(0.49f), std::tan(kPi * (double)0.49f)),
+        0.49f);
+  EXPECT(e.err <= 3.3e-6, "tanPi rel %g at %g", e.err, e.at);
+  // Past Nyquist clamps rather than blowing up
+  EXPECT(FastMath::tanPi(0.7f) == FastMath::tanPi(0.49f), "tanPi clamp");
+}
+
+// Odd length so both the 4-lane body and the scalar tail get exercised,
+// once out of place and once in place
+template <typename Block, typename Scalar>
+static void checkBlock(const char *name, Block block, Scalar scalar,
+                       float lo, float hi) {
+  const int n = 4099;
+  std::vector<float> in(n), out(n), inPlace(n);
+  for (int i = 0; i < n; ++i)
+    in[i] = lo + (hi - lo) * i / (n - 1);
+  block(in.data(), out.data(), n);
+  inPlace = in;
+  block(inPlace.data(), inPlace.data(), n);
+  int worst = 0;
+  float at = 0.0f;
+  for (int i = 0; i < n; ++i) {
+    int d = std::max(ulpDistance(out[i], scalar(in[i])),
+                     ulpDistance(inPlace[i], out[i]));
+    if (d > worst) {
+      worst = d;
+      at = in[i];
+    }
+  }
+  EXPECT(worst <= 1, "%s block vs scalar %d ulp at %g", name, worst, at);
+}
+
+int main() {
+  checkScalar();
+  checkBlock("exp2", FastMath::exp2Block,
+             [](float x) { return FastMath::exp2(x); }, -126.0f, 126.0f);
+  checkBlock("tanh", FastMath::tanhBlock,
+             [](float x) { return FastMath::tanh(x); }, -12.0f, 12.0f);
+  checkBlock("sin2pi", FastMath::sin2piBlock,
+             [](float x) { return FastMath::sin2pi(x); }, -3.0f, 3.0f);
+  return testResult();
+}
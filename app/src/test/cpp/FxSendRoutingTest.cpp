@@ -0,0 +1,45 @@
+// A send opened only by modulation still gets its delay line: the delay and
+// tape echo lines are allocated lazily, from the UI thread
+#include "AudioEngine.h"
+#include "RoutingMatrix.h"
+#include "TestUtil.h"
+#include <memory>
+
+static const int kFrames = 256;
+
+// A held note on track 0 into the delay, with the delay's send knob at 0
+static std::vector<float> render(bool routeLfo) {
+  auto engine = std::make_unique<AudioEngine>();
+  engine->setParameter(0, 2051, 1.0f); // Delay mix
+  if (routeLfo) {
+    engine->setGenericLfoParam(0, 2, 2.0f); // Square, starts at +1
+    engine->setRouting(0, 0, (int)ModSource::LFO1,
+                       (int)ModDestination::Parameter, 1.0f, 2050);
+  }
+  engine->triggerNote(0, 60, 110);
+
+  std::vector<float> out, block(kFrames * 2);
+  for (int b = 0; b < 200; ++b) {
+    if (b == 20)
+      engine->releaseNote(0, 60);
+    engine->renderOutput(block.data(), kFrames, 2);
+    out.insert(out.end(), block.begin(), block.end());
+  }
+  return out;
+}
+
+int main() {
+  std::vector<float> dry = render(false);
+  std::vector<float> wet = render(true);
+  EXPECT(rms(dry) > 1.0e-3f, "the note plays, rms %g", rms(dry));
+
+  // Well after the release the dry note is gone, only repeats are left
+  const size_t tail = 120 * kFrames * 2;
+  std::vector<float> dryTail(dry.begin() + tail, dry.end());
+  std::vector<float> wetTail(wet.begin() + tail, wet.end());
+  EXPECT(rms(dryTail) < 1.0e-4f, "the dry note has ended, rms %g",
+         rms(dryTail));
+  EXPECT(rms(wetTail) > 1.0e-3f, "the LFO opened the delay send, rms %g",
+         rms(wetTail));
+  return testResult();
+}
@@ -0,0 +1,64 @@
+// The input stops mid-stream and comes back. The ring has to ramp out of
+// the underrun and back in without a step in the output.
+#include "InputRing.h"
+#include "TestUtil.h"
+
+static const int kBlock = 256;
+static const float kRate = 48000.0f;
+
+int main() {
+  InputRing ring;
+  ring.setSampleRate(kRate);
+
+  const float phaseStep = 2.0f * 3.14159265f * 440.0f / kRate;
+  long written = 0;
+  auto writeBlock = [&] {
+    float in[kBlock];
+    for (int i = 0; i < kBlock; ++i)
+      in[i] = 0.5f * std::sin(phaseStep * (float)(written + i));
+    ring.write(in, kBlock);
+    written += kBlock;
+  };
+
+  std::vector<float> out;
+  auto readBlock = [&] {
+    float block[kBlock];
+    ring.read(block, kBlock);
+    out.insert(out.end(), block, block + kBlock);
+  };
+
+  for (int b = 0; b < 3; ++b)
+    writeBlock();
+  for (int b = 0; b < 200; ++b) {
+    writeBlock();
+    readBlock();
+  }
+  // The input stalls, the reader drains the ring and underruns
+  for (int b = 0; b < 4; ++b)
+    readBlock();
+  for (int b = 0; b < 3; ++b)
+    writeBlock();
+  for (int b = 0; b < 100; ++b) {
+    writeBlock();
+    readBlock();
+  }
+
+  EXPECT(ring.stats().underruns == 1, "%u underruns",
+         (unsigned)ring.stats().underruns);
+  EXPECT(rms(std::vector<float>(out.end() - 20 * kBlock, out.end())) > 0.3f,
+         "no signal after the underrun");
+
+  // A 440Hz sine at 0.5 moves at most 0.029 per sample, fades add little
+  float worst = 0.0f;
+  size_t at = 0;
+  for (size_t i = 1; i < out.size(); ++i) {
+    float d = std::abs(out[i] - out[i - 1]);
+    if (d > worst) {
+      worst = d;
+      at = i;
+    }
+  }
+  EXPECT(worst < 0.04f, "step of %g at sample %zu", worst, at);
+
+  return testResult();
+}
@@ -0,0 +1,35 @@
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+// Host tests are plain executables: EXPECT logs and counts failures, main
+// returns testResult() for ctest
+static int gFailures = 0;
+
+#define EXPECT(cond, ...)                                                      \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      std::printf("%s:%d: expected %s: ", __FILE__, __LINE__, #cond);          \
+      std::printf(__VA_ARGS__);                                                \
+      std::printf("\n");                                                       \
+      ++gFailures;                                                             \
+    }                                                                          \
+  } while (0)
+
+static inline int testResult() {
+  if (gFailures)
+    std::printf("%d failure(s)\n", gFailures);
+  return gFailures ? 1 : 0;
+}
+
+static inline float rms(const std::vector<float> &x) {
+  double sum = 0.0;
+  for (float v : x)
+    sum += (double)v * v;
+  return x.empty() ? 0.0f : (float)std::sqrt(sum / x.size());
+}
+
+#endif // TEST_UTIL_H
@@ -0,0 +1,36 @@
+// A stolen voice fades out in a few ms and stays that way, even when an
+// envelope edit (knob, p-lock, mod route) reaches the live voices mid fade
+#include "TestUtil.h"
+#include "engines/SubtractiveEngine.h"
+#include <memory>
+
+static const float kRate = 48000.0f;
+
+int main() {
+  auto engine = std::make_unique<SubtractiveEngine>();
+  engine->setSampleRate(kRate);
+  engine->setRelease(1.0f); // 3 s
+  engine->triggerNote(60, 110);
+  float peak = 0.0f;
+  for (int i = 0; i < 2400; ++i)
+    peak = std::max(peak, std::abs(engine->render()));
+  EXPECT(peak > 0.05f, "note too quiet to tell, peak %g", peak);
+
+  float score;
+  int voice = engine->stealCandidate(score);
+  EXPECT(voice >= 0, "no voice to steal");
+  engine->stealVoice(voice);
+  engine->setRelease(0.9f);
+  EXPECT(engine->liveVoiceCount() == 0, "%d live voices",
+         engine->liveVoiceCount());
+
+  // 10 ms to fade, then nothing
+  for (int i = 0; i < 480; ++i)
+    engine->render();
+  float tail = 0.0f;
+  for (int i = 0; i < 4800; ++i)
+    tail = std::max(tail, std::abs(engine->render()));
+  EXPECT(tail < 1e-3f, "stolen voice still at %g after 10 ms", tail);
+
+  return testResult();
+}
@@ -0,0 +1,14 @@
+#ifndef TEST_STUB_ANDROID_LOG_H
+#define TEST_STUB_ANDROID_LOG_H
+
+// Just enough of the NDK's log.h for host builds, logging goes nowhere
+#define ANDROID_LOG_INFO 4
+#define ANDROID_LOG_DEBUG 3
+#define ANDROID_LOG_WARN 5
+#define ANDROID_LOG_ERROR 6
+
+static inline int __android_log_print(int, const char *, const char *, ...) {
+  return 0;
+}
+
+#endif // TEST_STUB_ANDROID_LOG_H
@@ -0,0 +1,14 @@
+#ifndef TEST_STUB_JNI_H
+#define TEST_STUB_JNI_H
+
+// AudioEngine.cpp includes jni.h but the engine itself never touches JNI
+#include <cstdint>
+
+typedef int32_t jint;
+typedef float jfloat;
+typedef uint8_t jboolean;
+
+#define JNIEXPORT
+#define JNICALL
+
+#endif // TEST_STUB_JNI_H
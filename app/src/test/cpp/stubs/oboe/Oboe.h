@@ -0,0 +1,81 @@
+#ifndef TEST_STUB_OBOE_H
+#define TEST_STUB_OBOE_H
+
+// The slice of Oboe the engine uses, for host builds. Streams open but never
+// call back, tests drive AudioEngine::renderOutput() themselves.
+#include <cstdint>
+#include <memory>
+
+namespace oboe {
+
+enum class Result {
+  OK,
+  ErrorDisconnected,
+  ErrorInvalidState,
+  ErrorUnavailable
+};
+enum class DataCallbackResult { Continue, Stop };
+enum class Direction { Output, Input };
+enum class AudioFormat { Float, I16 };
+enum class PerformanceMode { LowLatency };
+enum class SharingMode { Exclusive, Shared };
+enum class InputPreset { Camcorder };
+namespace ChannelCount {
+constexpr int Mono = 1;
+constexpr int Stereo = 2;
+} // namespace ChannelCount
+
+inline const char *convertToText(Result) { return ""; }
+
+template <typename T> struct ResultWithValue {
+  T value() const { return T(); }
+  explicit operator bool() const { return true; }
+};
+
+class AudioStream {
+public:
+  int32_t getFramesPerBurst() { return 192; }
+  Result setBufferSizeInFrames(int32_t) { return Result::OK; }
+  int32_t getSampleRate() { return 48000; }
+  int32_t getChannelCount() { return 2; }
+  int32_t getBufferSizeInFrames() { return 384; }
+  int32_t getDeviceId() { return 0; }
+  Direction getDirection() { return Direction::Output; }
+  Result requestStart() { return Result::OK; }
+  Result requestStop() { return Result::OK; }
+  Result start() { return Result::OK; }
+  Result stop() { return Result::OK; }
+  Result close() { return Result::OK; }
+  ResultWithValue<int32_t> read(void *, int32_t, int64_t) { return {}; }
+  ResultWithValue<int32_t> getXRunCount() { return {}; }
+};
+
+class AudioStreamCallback {
+public:
+  virtual ~AudioStreamCallback() = default;
+  virtual DataCallbackResult onAudioReady(AudioStream *, void *,
+                                          int32_t) = 0;
+  virtual void onErrorAfterClose(AudioStream *, Result) {}
+};
+
+class AudioStreamBuilder {
+public:
+  AudioStreamBuilder *setFormat(AudioFormat) { return this; }
+  AudioStreamBuilder *setChannelCount(int) { return this; }
+  AudioStreamBuilder *setPerformanceMode(PerformanceMode) { return this; }
+  AudioStreamBuilder *setSharingMode(SharingMode) { return this; }
+  AudioStreamBuilder *setCallback(AudioStreamCallback *) { return this; }
+  AudioStreamBuilder *setDirection(Direction) { return this; }
+  AudioStreamBuilder *setInputPreset(InputPreset) { return this; }
+  AudioStreamBuilder *setSampleRate(int32_t) { return this; }
+  AudioStreamBuilder *setDeviceId(int32_t) { return this; }
+  AudioStreamBuilder *setFramesPerDataCallback(int32_t) { return this; }
+  Result openStream(std::shared_ptr<AudioStream> &stream) {
+    stream = std::make_shared<AudioStream>();
+    return Result::OK;
+  }
+};
+
+} // namespace oboe
+
+#endif // TEST_STUB_OBOE_H